@@ -7,6 +7,29 @@
 
 struct settings settings;
 
+static int load_coalesce(json_t *root, const char *key)
+{
+    json_t *node = json_object_get(root, key);
+    if (node == NULL)
+        return 0;
+    if (!json_is_array(node))
+        return -__LINE__;
+
+    settings.coalesce_num = json_array_size(node);
+    settings.coalesce = malloc(sizeof(struct coalesce_method) * settings.coalesce_num);
+    for (size_t i = 0; i < settings.coalesce_num; ++i) {
+        json_t *row = json_array_get(node, i);
+        if (!json_is_object(row))
+            return -__LINE__;
+        ERR_RET_LN(read_cfg_str(row, "method", &settings.coalesce[i].method, NULL));
+        ERR_RET_LN(read_cfg_real(row, "cache_ttl", &settings.coalesce[i].cache_ttl, false, 0));
+        if (settings.coalesce[i].cache_ttl < 0)
+            return -__LINE__;
+    }
+
+    return 0;
+}
+
 static int read_config_from_json(json_t *root)
 {
     int ret;
@@ -52,7 +75,20 @@ static int read_config_from_json(json_t *root)
     }
 
     ERR_RET(read_cfg_real(root, "timeout", &settings.timeout, false, 1.0));
+    /* a request past the http timeout no longer counts for least_inflight */
+    rpc_clt_cfg *clts[] = { &settings.matchengine, &settings.marketprice, &settings.readhistory };
+    for (size_t i = 0; i < sizeof(clts) / sizeof(clts[0]); ++i) {
+        if (clts[i]->request_timeout == 0)
+            clts[i]->request_timeout = settings.timeout;
+    }
     ERR_RET(read_cfg_int(root, "worker_num", &settings.worker_num, false, 1));
+    ERR_RET(read_cfg_uint32(root, "batch_max", &settings.batch_max, false, 20));
+    ERR_RET(read_cfg_real(root, "batch_timeout", &settings.batch_timeout, false, settings.timeout));
+    ret = load_coalesce(root, "coalesce");
+    if (ret < 0) {
+        printf("load coalesce config fail: %d\n", ret);
+        return -__LINE__;
+    }
 
     return 0;
 }
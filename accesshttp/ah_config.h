@@ -36,9 +36,16 @@
 # include "ut_rpc_svr.h"
 # include "ut_rpc_cmd.h"
 # include "ut_http_svr.h"
+# include "ut_deflate.h"
 
 # define AH_LISTENER_BIND   "seqpacket@/tmp/accesshttp_listener.sock"
 
+struct coalesce_method {
+    char                *method;
+    /* seconds a successful result is reused, 0 to only share in flight calls */
+    double              cache_ttl;
+};
+
 struct settings {
     process_cfg         process;
     log_cfg             log;
@@ -50,6 +57,11 @@ struct settings {
     rpc_clt_cfg         readhistory;
     double              timeout;
     int                 worker_num;
+    /* json-rpc batch arrays, max elements and timeout of each element */
+    uint32_t            batch_max;
+    double              batch_timeout;
+    size_t              coalesce_num;
+    struct coalesce_method *coalesce;
 };
 
 extern struct settings settings;
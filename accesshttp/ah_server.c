@@ -14,19 +14,100 @@ static rpc_clt *listener;
 static rpc_clt *matchengine;
 static rpc_clt *marketprice;
 static rpc_clt *readhistory;
+static nw_timer status_timer;
+static nw_timer cache_timer;
 
-struct state_info {
+/* in flight requests shared by identical calls, and their cached results */
+static dict_t *flights;
+static dict_t *result_cache;
+static uint64_t flight_count;
+static uint64_t flight_join_count;
+static uint64_t cache_hit_count;
+
+struct request_info {
+    rpc_clt *clt;
+    uint32_t cmd;
+    /* not user scoped, identical calls can share one reply */
+    bool     shared;
+    bool     coalesce;
+    double   cache_ttl;
+};
+
+/* a json-rpc batch, answered as one array once every element has replied */
+struct batch {
+    nw_ses  *ses;
+    uint64_t ses_id;
+    uint32_t count;
+    /* replies still missing, plus one held while the elements are sent */
+    uint32_t pending;
+    bool     gzip;
+    sds     *replies;
+};
+
+/* where a reply goes, the http session itself or a slot of a batch */
+struct reply_target {
     nw_ses  *ses;
     uint64_t ses_id;
     int64_t  request_id;
+    struct batch *batch;
+    uint32_t index;
+    /* the client accepts gzip */
+    bool     gzip;
 };
 
-struct request_info {
-    rpc_clt *clt;
-    uint32_t cmd;
+struct state_info {
+    struct reply_target target;
+    /* set when the request leads a flight */
+    sds      flight_key;
+};
+
+struct flight {
+    double   cache_ttl;
+    uint32_t waiter_count;
+    uint32_t waiter_size;
+    struct reply_target *waiters;
+};
+
+/* the reply up to the id, shared by every hit */
+struct cache_val {
+    double   time;
+    deflate_head *head;
 };
 
-static void reply_error(nw_ses *ses, int64_t id, int code, const char *message, uint32_t status)
+static void batch_done(struct batch *batch)
+{
+    if (--batch->pending)
+        return;
+
+    if (batch->ses->id == batch->ses_id) {
+        sds reply = sdsnew("[");
+        for (uint32_t i = 0; i < batch->count; ++i) {
+            if (i)
+                reply = sdscatlen(reply, ",", 1);
+            reply = sdscatsds(reply, batch->replies[i]);
+        }
+        reply = sdscatlen(reply, "]", 1);
+        send_http_response_compressed(batch->ses, 200, reply, sdslen(reply), batch->gzip);
+        sdsfree(reply);
+    }
+    for (uint32_t i = 0; i < batch->count; ++i) {
+        sdsfree(batch->replies[i]);
+    }
+    free(batch->replies);
+    free(batch);
+}
+
+static void send_reply(struct reply_target *target, uint32_t status, const char *data, size_t size)
+{
+    if (target->batch) {
+        target->batch->replies[target->index] = sdsnewlen(data, size);
+        batch_done(target->batch);
+    } else if (target->ses->id == target->ses_id) {
+        send_http_response_compressed(target->ses, status, (void *)data, size, target->gzip);
+    }
+}
+
+static void reply_error(struct reply_target *target, int code, const char *message, uint32_t status)
 {
     json_t *error = json_object();
     json_object_set_new(error, "code", json_integer(code));
@@ -34,10 +115,10 @@ static void reply_error(nw_ses *ses, int64_t id, int code, const char *message,
     json_t *reply = json_object();
     json_object_set_new(reply, "error", error);
     json_object_set_new(reply, "result", json_null());
-    json_object_set_new(reply, "id", json_integer(id));
+    json_object_set_new(reply, "id", json_integer(target->request_id));
 
     char *reply_str = json_dumps(reply, 0);
-    send_http_response_simple(ses, status, reply_str, strlen(reply_str));
+    send_reply(target, status, reply_str, strlen(reply_str));
     free(reply_str);
     json_decref(reply);
 }
@@ -47,77 +128,284 @@ static void reply_bad_request(nw_ses *ses)
     send_http_response_simple(ses, 400, NULL, 0);
 }
 
-static void reply_internal_error(nw_ses *ses)
+static void reply_invalid_argument(struct reply_target *target)
 {
-    send_http_response_simple(ses, 500, NULL, 0);
+    reply_error(target, 1, "invalid argument", 400);
 }
 
-static void reply_not_found(nw_ses *ses, int64_t id)
+/* a batch element needs a body, plain requests keep the bare status */
+static void reply_internal_error(struct reply_target *target)
 {
-    reply_error(ses, id, 4, "method not found", 404);
+    if (target->batch) {
+        reply_error(target, 2, "internal error", 500);
+    } else {
+        send_reply(target, 500, NULL, 0);
+    }
 }
 
-static void reply_time_out(nw_ses *ses, int64_t id)
+static void reply_unavailable(struct reply_target *target)
 {
-    reply_error(ses, id, 5, "service timeout", 504);
+    if (target->batch) {
+        reply_error(target, 3, "service unavailable", 500);
+    } else {
+        send_reply(target, 500, NULL, 0);
+    }
 }
 
-static int on_http_request(nw_ses *ses, http_request_t *request)
+static void reply_not_found(struct reply_target *target)
 {
-    log_trace("new http request, url: %s, method: %u", request->url, request->method);
-    if (request->method != HTTP_POST || !request->body) {
-        reply_bad_request(ses);
-        return -__LINE__;
+    reply_error(target, 4, "method not found", 404);
+}
+
+static void reply_time_out(struct reply_target *target)
+{
+    reply_error(target, 5, "service timeout", 504);
+}
+
+static deflate_head *create_reply_head(const char *error, const char *result)
+{
+    sds plain = sdscatprintf(sdsempty(), "{\"error\": %s, \"result\": %s", error, result);
+    deflate_head *head = deflate_head_create(plain, sdslen(plain), settings.svr.gzip_level);
+    sdsfree(plain);
+    return head;
+}
+
+/* the head is gzipped once for all the clients accepting it */
+static void reply_head(struct reply_target *target, deflate_head *head)
+{
+    char tail[64];
+    int tail_len = snprintf(tail, sizeof(tail), ", \"id\": %"PRIi64"}", target->request_id);
+    size_t size = sdslen(head->plain) + tail_len;
+    if (!target->batch && target->gzip && settings.svr.gzip_level > 0 && size >= settings.svr.gzip_min_size) {
+        sds data = deflate_head_gzip(head, tail, tail_len);
+        if (data) {
+            if (target->ses->id == target->ses_id)
+                send_http_response_gzip(target->ses, 200, data, sdslen(data));
+            sdsfree(data);
+            return;
+        }
     }
 
-    json_t *body = json_loadb(request->body, sdslen(request->body), 0, NULL);
-    if (body == NULL) {
-        goto decode_error;
+    sds reply = sdscatlen(sdsdup(head->plain), tail, tail_len);
+    send_reply(target, 200, reply, sdslen(reply));
+    sdsfree(reply);
+}
+
+static int process_cache(struct reply_target *target, struct request_info *req, sds key)
+{
+    dict_entry *entry = dict_find(result_cache, key);
+    if (entry == NULL)
+        return 0;
+
+    struct cache_val *cache = entry->val;
+    if (current_timestamp() - cache->time > req->cache_ttl) {
+        dict_delete(result_cache, key);
+        return 0;
     }
-    json_t *id = json_object_get(body, "id");
-    if (!id || !json_is_integer(id)) {
-        goto decode_error;
+
+    cache_hit_count++;
+    reply_head(target, cache->head);
+    return 1;
+}
+
+/* ride along an identical request already sent to the backend */
+static int join_flight(struct reply_target *target, sds key)
+{
+    dict_entry *entry = dict_find(flights, key);
+    if (entry == NULL)
+        return 0;
+
+    struct flight *flight = entry->val;
+    if (flight->waiter_count == flight->waiter_size) {
+        uint32_t size = flight->waiter_size ? flight->waiter_size * 2 : 4;
+        struct reply_target *waiters = realloc(flight->waiters, sizeof(struct reply_target) * size);
+        if (waiters == NULL)
+            return 0;
+        flight->waiters = waiters;
+        flight->waiter_size = size;
     }
-    json_t *method = json_object_get(body, "method");
-    if (!method || !json_is_string(method)) {
-        goto decode_error;
+    memcpy(&flight->waiters[flight->waiter_count++], target, sizeof(struct reply_target));
+    flight_join_count++;
+    return 1;
+}
+
+static void land_flight(sds key, void *body, size_t body_size)
+{
+    dict_entry *entry = dict_find(flights, key);
+    if (entry == NULL)
+        return;
+    struct flight *flight = entry->val;
+
+    json_t *reply = NULL;
+    char *error = NULL;
+    char *result = NULL;
+    if (body) {
+        reply = json_loadb(body, body_size, 0, NULL);
+        if (reply && json_is_object(reply)) {
+            json_t *error_obj = json_object_get(reply, "error");
+            json_t *result_obj = json_object_get(reply, "result");
+            error = json_dumps(error_obj ? error_obj : json_null(), JSON_ENCODE_ANY);
+            result = json_dumps(result_obj ? result_obj : json_null(), JSON_ENCODE_ANY);
+        }
     }
-    json_t *params = json_object_get(body, "params");
-    if (!params || !json_is_array(params)) {
-        goto decode_error;
+
+    deflate_head *head = NULL;
+    if (error && result) {
+        head = create_reply_head(error, result);
     }
-    log_trace("from: %s body: %s", nw_sock_human_addr(&ses->peer_addr), request->body);
+    for (uint32_t i = 0; i < flight->waiter_count; ++i) {
+        struct reply_target *waiter = &flight->waiters[i];
+        if (body == NULL) {
+            reply_time_out(waiter);
+        } else if (head) {
+            reply_head(waiter, head);
+        } else {
+            reply_internal_error(waiter);
+        }
+    }
+
+    if (flight->cache_ttl > 0 && head && strcmp(error, "null") == 0 && strcmp(result, "null") != 0) {
+        struct cache_val val;
+        val.time = current_timestamp();
+        val.head = head;
+        dict_replace(result_cache, key, &val);
+    } else if (head) {
+        deflate_head_release(head);
+    }
+
+    free(error);
+    free(result);
+    if (reply)
+        json_decref(reply);
+    dict_delete(flights, key);
+}
+
+static void forward_request(struct reply_target *target, struct request_info *req, json_t *params, double timeout)
+{
+    sds key = NULL;
+    if (req->coalesce) {
+        char *params_str = json_dumps(params, JSON_SORT_KEYS | JSON_COMPACT);
+        key = sdscatprintf(sdsempty(), "%u-%s", req->cmd, params_str);
+        free(params_str);
+        if ((req->cache_ttl > 0 && process_cache(target, req, key)) || join_flight(target, key)) {
+            sdsfree(key);
+            return;
+        }
+    }
+
+    nw_state_entry *entry = nw_state_add(state, timeout, 0);
+    struct state_info *info = entry->data;
+    memcpy(&info->target, target, sizeof(struct reply_target));
+
+    if (key) {
+        struct flight *flight = malloc(sizeof(struct flight));
+        memset(flight, 0, sizeof(struct flight));
+        flight->cache_ttl = req->cache_ttl;
+        dict_add(flights, key, flight);
+        info->flight_key = key;
+        flight_count++;
+    }
+
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
+    pkg.command   = req->cmd;
+    pkg.sequence  = entry->id;
+    pkg.req_id    = target->request_id;
+    pkg.body      = json_dumps(params, 0);
+    pkg.body_size = strlen(pkg.body);
+
+    /* user scoped methods take user_id first, keep a user on one backend in hash mode */
+    json_t *first = json_array_get(params, 0);
+    if (first && json_is_integer(first)) {
+        rpc_clt_send_key(req->clt, &pkg, json_integer_value(first));
+    } else {
+        rpc_clt_send(req->clt, &pkg);
+    }
+    log_debug("send request to %s, cmd: %u, sequence: %u",
+            nw_sock_human_addr(rpc_clt_peer_addr(req->clt)), pkg.command, pkg.sequence);
+    free(pkg.body);
+}
+
+/* return < 0 if the request object is malformed, the caller answers that */
+static int process_request(struct reply_target *target, json_t *request, double timeout)
+{
+    json_t *id = json_object_get(request, "id");
+    if (!id || !json_is_integer(id))
+        return -__LINE__;
+    target->request_id = json_integer_value(id);
+    json_t *method = json_object_get(request, "method");
+    if (!method || !json_is_string(method))
+        return -__LINE__;
+    json_t *params = json_object_get(request, "params");
+    if (!params || !json_is_array(params))
+        return -__LINE__;
 
     dict_entry *entry = dict_find(methods, json_string_value(method));
     if (entry == NULL) {
-        reply_not_found(ses, json_integer_value(id));
-    } else {
-        struct request_info *req = entry->val;
-        if (!rpc_clt_connected(req->clt)) {
-            reply_internal_error(ses);
-            json_decref(body);
-            return 0;
+        reply_not_found(target);
+        return 0;
+    }
+    struct request_info *req = entry->val;
+    if (!rpc_clt_connected(req->clt)) {
+        reply_unavailable(target);
+        return 0;
+    }
+    forward_request(target, req, params, timeout);
+    return 0;
+}
+
+/* elements go out at once and are answered in order, a bad element gets
+ * an error in its slot and does not fail the others */
+static int process_batch(nw_ses *ses, json_t *body, bool gzip)
+{
+    size_t count = json_array_size(body);
+    if (count == 0 || count > settings.batch_max)
+        return -__LINE__;
+
+    struct batch *batch = malloc(sizeof(struct batch));
+    memset(batch, 0, sizeof(struct batch));
+    batch->ses = ses;
+    batch->ses_id = ses->id;
+    batch->count = count;
+    batch->pending = count + 1;
+    batch->gzip = gzip;
+    batch->replies = calloc(count, sizeof(sds));
+
+    for (size_t i = 0; i < count; ++i) {
+        struct reply_target target = { .ses = ses, .ses_id = ses->id, .batch = batch, .index = i };
+        json_t *request = json_array_get(body, i);
+        if (!json_is_object(request) || process_request(&target, request, settings.batch_timeout) < 0) {
+            reply_invalid_argument(&target);
         }
+    }
+    batch_done(batch);
 
-        nw_state_entry *entry = nw_state_add(state, settings.timeout, 0);
-        struct state_info *info = entry->data;
-        info->ses = ses;
-        info->ses_id = ses->id;
-        info->request_id = json_integer_value(id);
-
-        rpc_pkg pkg;
-        memset(&pkg, 0, sizeof(pkg));
-        pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
-        pkg.command   = req->cmd;
-        pkg.sequence  = entry->id;
-        pkg.req_id    = json_integer_value(id);
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
+    return 0;
+}
 
-        rpc_clt_send(req->clt, &pkg);
-        log_debug("send request to %s, cmd: %u, sequence: %u",
-                nw_sock_human_addr(rpc_clt_peer_addr(req->clt)), pkg.command, pkg.sequence);
-        free(pkg.body);
+static int on_http_request(nw_ses *ses, http_svr_request_t *request)
+{
+    log_trace("new http request, url: %.*s, method: %u", (int)request->url.size, request->url.data, request->method);
+    if (request->method != HTTP_POST || request->body.size == 0) {
+        reply_bad_request(ses);
+        return -__LINE__;
+    }
+
+    json_t *body = json_loadb(request->body.data, request->body.size, 0, NULL);
+    if (body == NULL) {
+        goto decode_error;
+    }
+    log_trace("from: %s body: %.*s", nw_sock_human_addr(&ses->peer_addr), (int)request->body.size, request->body.data);
+
+    bool gzip = http_svr_request_accept_gzip(request);
+    if (json_is_array(body)) {
+        if (process_batch(ses, body, gzip) < 0)
+            goto decode_error;
+    } else {
+        struct reply_target target = { .ses = ses, .ses_id = ses->id, .gzip = gzip };
+        if (!json_is_object(body) || process_request(&target, body, settings.timeout) < 0)
+            goto decode_error;
     }
 
     json_decref(body);
@@ -126,13 +414,25 @@ static int on_http_request(nw_ses *ses, http_request_t *request)
 decode_error:
     if (body)
         json_decref(body);
-    sds hex = hexdump(request->body, sdslen(request->body));
+    sds hex = hexdump(request->body.data, request->body.size);
     log_fatal("peer: %s, decode request fail, request body: \n%s", nw_sock_human_addr(&ses->peer_addr), hex);
     sdsfree(hex);
     reply_bad_request(ses);
     return -__LINE__;
 }
 
+static void on_status_timer(nw_timer *timer, void *privdata)
+{
+    sds status = sdsempty();
+    status = rpc_clt_status(matchengine, status);
+    status = rpc_clt_status(marketprice, status);
+    status = rpc_clt_status(readhistory, status);
+    status = sdscatprintf(status, "flights: %"PRIu64", joined: %"PRIu64", cache hits: %"PRIu64", cached: %u\n",
+            flight_count, flight_join_count, cache_hit_count, dict_size(result_cache));
+    log_info("backend status:\n%s", status);
+    sdsfree(status);
+}
+
 static uint32_t dict_hash_func(const void *key)
 {
     return dict_generic_hash_function(key, strlen(key));
@@ -165,12 +465,68 @@ static void dict_val_free(void *val)
     free(val);
 }
 
+static uint32_t sds_dict_hash_func(const void *key)
+{
+    return dict_generic_hash_function(key, sdslen((sds)key));
+}
+
+static int sds_dict_key_compare(const void *key1, const void *key2)
+{
+    return sdscmp((sds)key1, (sds)key2);
+}
+
+static void *sds_dict_key_dup(const void *key)
+{
+    return sdsdup((const sds)key);
+}
+
+static void sds_dict_key_free(void *key)
+{
+    sdsfree(key);
+}
+
+static void flight_dict_val_free(void *val)
+{
+    struct flight *flight = val;
+    free(flight->waiters);
+    free(flight);
+}
+
+static void *cache_dict_val_dup(const void *val)
+{
+    struct cache_val *obj = malloc(sizeof(struct cache_val));
+    memcpy(obj, val, sizeof(struct cache_val));
+    return obj;
+}
+
+static void cache_dict_val_free(void *val)
+{
+    struct cache_val *obj = val;
+    deflate_head_release(obj->head);
+    free(val);
+}
+
+static void on_cache_timer(nw_timer *timer, void *privdata)
+{
+    dict_clear(result_cache);
+}
+
 static void on_state_timeout(nw_state_entry *entry)
 {
     log_error("state id: %u timeout", entry->id);
     struct state_info *info = entry->data;
-    if (info->ses->id == info->ses_id) {
-        reply_time_out(info->ses, info->request_id);
+    reply_time_out(&info->target);
+    if (info->flight_key) {
+        land_flight(info->flight_key, NULL, 0);
+    }
+}
+
+static void on_state_release(nw_state_entry *entry)
+{
+    struct state_info *info = entry->data;
+    if (info->flight_key) {
+        dict_delete(flights, info->flight_key);
+        sdsfree(info->flight_key);
     }
 }
 
@@ -191,9 +547,11 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     nw_state_entry *entry = nw_state_get(state, pkg->sequence);
     if (entry) {
         struct state_info *info = entry->data;
-        if (info->ses->id == info->ses_id) {
-            log_trace("send response to: %s", nw_sock_human_addr(&info->ses->peer_addr));
-            send_http_response_simple(info->ses, 200, pkg->body, pkg->body_size);
+        log_trace("send response to: %s", nw_sock_human_addr(&info->target.ses->peer_addr));
+        /* backends echo req_id, the body fits a batch slot as it is */
+        send_reply(&info->target, 200, pkg->body, pkg->body_size);
+        if (info->flight_key) {
+            land_flight(info->flight_key, pkg->body, pkg->body_size);
         }
         nw_state_del(state, pkg->sequence);
     }
@@ -256,10 +614,40 @@ static int add_handler(char *method, rpc_clt *clt, uint32_t cmd)
     return 0;
 }
 
+/* reads that do not depend on who asks. user scoped reads stay out, a
+ * balance.query right after an order must not join a flight sent before it */
+static int add_shared_handler(char *method, rpc_clt *clt, uint32_t cmd)
+{
+    struct request_info info = { .clt = clt, .cmd = cmd, .shared = true };
+    if (dict_add(methods, method, &info) == NULL)
+        return __LINE__;
+    return 0;
+}
+
+static int init_coalesce(void)
+{
+    for (size_t i = 0; i < settings.coalesce_num; ++i) {
+        struct coalesce_method *cfg = &settings.coalesce[i];
+        dict_entry *entry = dict_find(methods, cfg->method);
+        if (entry == NULL) {
+            log_error("coalesce method: %s not found", cfg->method);
+            return -__LINE__;
+        }
+        struct request_info *req = entry->val;
+        if (!req->shared) {
+            log_error("coalesce method: %s is not a shared read", cfg->method);
+            return -__LINE__;
+        }
+        req->coalesce = true;
+        req->cache_ttl = cfg->cache_ttl;
+    }
+    return 0;
+}
+
 static int init_methods_handler(void)
 {
-    ERR_RET_LN(add_handler("asset.list", matchengine, CMD_ASSET_LIST));
-    ERR_RET_LN(add_handler("asset.summary", matchengine, CMD_ASSET_SUMMARY));
+    ERR_RET_LN(add_shared_handler("asset.list", matchengine, CMD_ASSET_LIST));
+    ERR_RET_LN(add_shared_handler("asset.summary", matchengine, CMD_ASSET_SUMMARY));
 
     ERR_RET_LN(add_handler("balance.query", matchengine, CMD_BALANCE_QUERY));
     ERR_RET_LN(add_handler("balance.update", matchengine, CMD_BALANCE_UPDATE));
@@ -268,22 +656,27 @@ static int init_methods_handler(void)
     ERR_RET_LN(add_handler("order.put_limit", matchengine, CMD_ORDER_PUT_LIMIT));
     ERR_RET_LN(add_handler("order.put_market", matchengine, CMD_ORDER_PUT_MARKET));
     ERR_RET_LN(add_handler("order.cancel", matchengine, CMD_ORDER_CANCEL));
-    ERR_RET_LN(add_handler("order.book", matchengine, CMD_ORDER_BOOK));
-    ERR_RET_LN(add_handler("order.depth", matchengine, CMD_ORDER_BOOK_DEPTH));
+    ERR_RET_LN(add_handler("order.put_stop_limit", matchengine, CMD_ORDER_PUT_STOP_LIMIT));
+    ERR_RET_LN(add_handler("order.put_stop_market", matchengine, CMD_ORDER_PUT_STOP_MARKET));
+    ERR_RET_LN(add_handler("order.cancel_stop", matchengine, CMD_ORDER_CANCEL_STOP));
+    ERR_RET_LN(add_handler("order.pending_stop", matchengine, CMD_ORDER_QUERY_STOP));
+    ERR_RET_LN(add_shared_handler("order.book", matchengine, CMD_ORDER_BOOK));
+    ERR_RET_LN(add_shared_handler("order.depth", matchengine, CMD_ORDER_BOOK_DEPTH));
     ERR_RET_LN(add_handler("order.pending", matchengine, CMD_ORDER_QUERY));
+    ERR_RET_LN(add_handler("order.pending_all", matchengine, CMD_ORDER_QUERY_ALL));
     ERR_RET_LN(add_handler("order.pending_detail", matchengine, CMD_ORDER_DETAIL));
     ERR_RET_LN(add_handler("order.deals", readhistory, CMD_ORDER_DEALS));
     ERR_RET_LN(add_handler("order.finished", readhistory, CMD_ORDER_HISTORY));
     ERR_RET_LN(add_handler("order.finished_detail", readhistory, CMD_ORDER_DETAIL_FINISHED));
 
-    ERR_RET_LN(add_handler("market.last", marketprice, CMD_MARKET_LAST));
-    ERR_RET_LN(add_handler("market.deals", marketprice, CMD_MARKET_DEALS));
-    ERR_RET_LN(add_handler("market.kline", marketprice, CMD_MARKET_KLINE));
-    ERR_RET_LN(add_handler("market.status", marketprice, CMD_MARKET_STATUS));
-    ERR_RET_LN(add_handler("market.status_today", marketprice, CMD_MARKET_STATUS_TODAY));
+    ERR_RET_LN(add_shared_handler("market.last", marketprice, CMD_MARKET_LAST));
+    ERR_RET_LN(add_shared_handler("market.deals", marketprice, CMD_MARKET_DEALS));
+    ERR_RET_LN(add_shared_handler("market.kline", marketprice, CMD_MARKET_KLINE));
+    ERR_RET_LN(add_shared_handler("market.status", marketprice, CMD_MARKET_STATUS));
+    ERR_RET_LN(add_shared_handler("market.status_today", marketprice, CMD_MARKET_STATUS_TODAY));
     ERR_RET_LN(add_handler("market.user_deals", readhistory, CMD_MARKET_USER_DEALS));
-    ERR_RET_LN(add_handler("market.list", matchengine, CMD_MARKET_LIST));
-    ERR_RET_LN(add_handler("market.summary", matchengine, CMD_MARKET_SUMMARY));
+    ERR_RET_LN(add_shared_handler("market.list", matchengine, CMD_MARKET_LIST));
+    ERR_RET_LN(add_shared_handler("market.summary", matchengine, CMD_MARKET_SUMMARY));
 
     return 0;
 }
@@ -305,10 +698,27 @@ int init_server(void)
     nw_state_type st;
     memset(&st, 0, sizeof(st));
     st.on_timeout = on_state_timeout;
+    st.on_release = on_state_release;
     state = nw_state_create(&st, sizeof(struct state_info));
     if (state == NULL)
         return -__LINE__;
 
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = sds_dict_hash_func;
+    dt.key_compare = sds_dict_key_compare;
+    dt.key_dup = sds_dict_key_dup;
+    dt.key_destructor = sds_dict_key_free;
+    dt.val_destructor = flight_dict_val_free;
+    flights = dict_create(&dt, 64);
+    if (flights == NULL)
+        return -__LINE__;
+
+    dt.val_dup = cache_dict_val_dup;
+    dt.val_destructor = cache_dict_val_free;
+    result_cache = dict_create(&dt, 64);
+    if (result_cache == NULL)
+        return -__LINE__;
+
     rpc_clt_type ct;
     memset(&ct, 0, sizeof(ct));
     ct.on_connect = on_backend_connect;
@@ -336,7 +746,18 @@ int init_server(void)
         return -__LINE__;
 
     ERR_RET(init_methods_handler());
-    ERR_RET(init_listener_clt());
+    ERR_RET(init_coalesce());
+    if (settings.svr.reuse_port) {
+        if (http_svr_start(svr) < 0)
+            return -__LINE__;
+    } else {
+        ERR_RET(init_listener_clt());
+    }
+
+    nw_timer_set(&status_timer, 60, true, on_status_timer, NULL);
+    nw_timer_start(&status_timer);
+    nw_timer_set(&cache_timer, 60, true, on_cache_timer, NULL);
+    nw_timer_start(&cache_timer);
 
     return 0;
 }
@@ -68,9 +68,9 @@ static void on_backend_connect(nw_ses *ses, bool result)
     }
 }
 
-static int on_balance_query_reply(struct state_data *state, json_t *result)
+static int notify_update(uint32_t user_id, const char *asset, json_t *result)
 {
-    void *key = (void *)(uintptr_t)state->user_id;
+    void *key = (void *)(uintptr_t)user_id;
     dict_entry *entry = dict_find(dict_sub, key);
     if (entry == NULL)
         return 0 ;
@@ -83,7 +83,7 @@ static int on_balance_query_reply(struct state_data *state, json_t *result)
     list_node *node;
     while ((node = list_next(iter)) != NULL) {
         struct sub_unit *unit = node->value;
-        if (strcmp(unit->asset, state->asset) == 0) {
+        if (strcmp(unit->asset, asset) == 0) {
             send_notify(unit->ses, "asset.update", params);
         }
     }
@@ -93,9 +93,14 @@ static int on_balance_query_reply(struct state_data *state, json_t *result)
     return 0;
 }
 
+static int on_balance_query_reply(struct state_data *state, json_t *result)
+{
+    return notify_update(state->user_id, state->asset, result);
+}
+
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -105,7 +110,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_decode(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -234,7 +239,7 @@ int asset_unsubscribe(uint32_t user_id, nw_ses *ses)
     return 0;
 }
 
-int asset_on_update(uint32_t user_id, const char *asset)
+int asset_on_update(uint32_t user_id, const char *asset, json_t *balance)
 {
     void *key = (void *)(uintptr_t)user_id;
     dict_entry *entry = dict_find(dict_sub, key);
@@ -256,6 +261,15 @@ int asset_on_update(uint32_t user_id, const char *asset)
     if (!notify)
         return 0;
 
+    /* carried by the message, no need to query matchengine */
+    if (balance) {
+        json_t *result = json_object();
+        json_object_set(result, asset, balance);
+        int ret = notify_update(user_id, asset, result);
+        json_decref(result);
+        return ret;
+    }
+
     json_t *trade_params = json_array();
     json_array_append_new(trade_params, json_integer(user_id));
     json_array_append_new(trade_params, json_string(asset));
@@ -270,12 +284,11 @@ int asset_on_update(uint32_t user_id, const char *asset)
     pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
     pkg.command   = CMD_BALANCE_QUERY;
     pkg.sequence  = state_entry->id;
-    pkg.body      = json_dumps(trade_params, 0);
-    pkg.body_size = strlen(pkg.body);
+    rpc_params_encode(&pkg, trade_params, rpc_clt_encoding(matchengine));
 
     rpc_clt_send(matchengine, &pkg);
-    log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, (char *)pkg.body);
+    log_trace("send request to %s, cmd: %u, sequence: %u, encoding: %d, body size: %u",
+            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, rpc_pkg_encoding(&pkg), pkg.body_size);
     free(pkg.body);
     json_decref(trade_params);
 
@@ -10,7 +10,9 @@ int init_asset(void);
 
 int asset_subscribe(uint32_t user_id, nw_ses *ses, const char *asset);
 int asset_unsubscribe(uint32_t user_id, nw_ses *ses);
-int asset_on_update(uint32_t user_id, const char *asset);
+/* balance is the {"available", "freeze"} carried by the kafka message,
+ * NULL to query it from matchengine */
+int asset_on_update(uint32_t user_id, const char *asset, json_t *balance);
 
 # endif
 
@@ -0,0 +1,292 @@
+/*
+ * Description: market data fetched once per host, shared by the workers
+ *     History: agent, 2026/10/18, create
+ */
+
+# include "aw_config.h"
+# include "aw_cache.h"
+# include "ut_shm_cache.h"
+
+/* keys no worker read for this long are no longer fetched */
+# define WANT_TIMEOUT   10.0
+/* and after this long their slots go to new keys */
+# define EXPIRE_TIMEOUT 60.0
+# define FETCH_TICK     0.1
+
+static shm_cache *cache;
+
+static nw_timer timer;
+static rpc_clt *matchengine;
+static rpc_clt *marketprice;
+static nw_state *state_context;
+/* per slot, fetcher only */
+static double *fetch_time;
+static bool *fetching;
+
+struct state_data {
+    int index;
+};
+
+struct fetch_type {
+    uint32_t    command;
+    rpc_clt     **backend;
+    double      *interval;
+};
+
+static struct fetch_type fetch_types[] = {
+    { CMD_MARKET_LAST,          &marketprice,   &settings.price_interval },
+    { CMD_MARKET_STATUS,        &marketprice,   &settings.state_interval },
+    { CMD_MARKET_STATUS_TODAY,  &marketprice,   &settings.today_interval },
+    { CMD_MARKET_DEALS,         &marketprice,   &settings.deals_interval },
+    { CMD_MARKET_KLINE,         &marketprice,   &settings.kline_interval },
+    { CMD_ORDER_BOOK_DEPTH,     &matchengine,   &settings.depth_interval },
+};
+
+static struct fetch_type *get_fetch_type(uint32_t command)
+{
+    for (size_t i = 0; i < sizeof(fetch_types) / sizeof(fetch_types[0]); ++i) {
+        if (fetch_types[i].command == command)
+            return &fetch_types[i];
+    }
+    return NULL;
+}
+
+int init_cache(void)
+{
+    if (settings.market_cache_slots <= 0)
+        return 0;
+    cache = shm_cache_create(settings.market_cache_slots, settings.market_cache_slot_size);
+    if (cache == NULL)
+        return -__LINE__;
+
+    return 0;
+}
+
+int cache_get(uint32_t command, json_t *params, uint64_t *version, json_t **result)
+{
+    *result = NULL;
+    if (cache == NULL)
+        return 0;
+    struct fetch_type *type = get_fetch_type(command);
+    if (type == NULL)
+        return 0;
+
+    /* the key is the request itself */
+    char *params_str = json_dumps(params, 0);
+    if (params_str == NULL)
+        return 0;
+    char key[SHM_CACHE_KEY_MAX];
+    int len = snprintf(key, sizeof(key), "%u %s", command, params_str);
+    free(params_str);
+    if (len >= (int)sizeof(key))
+        return 0;
+    int index = shm_cache_find(cache, key, true);
+    if (index < 0)
+        return 0;
+    shm_cache_want(cache, index);
+
+    /* the fetcher is gone or the backend fails for this key */
+    if (current_timestamp() - shm_cache_update_time(cache, index) > *type->interval * 2 + settings.backend_timeout)
+        return 0;
+
+    sds data = NULL;
+    int ret = shm_cache_read(cache, index, version, &data);
+    if (ret < 0)
+        return 0;
+    if (ret == 0)
+        return 1;
+    *result = json_loadb(data, sdslen(data), 0, NULL);
+    sdsfree(data);
+
+    return 1;
+}
+
+static void on_backend_connect(nw_ses *ses, bool result)
+{
+    rpc_clt *clt = ses->privdata;
+    if (result) {
+        log_info("connect %s:%s success", clt->name, nw_sock_human_addr(&ses->peer_addr));
+    } else {
+        log_info("connect %s:%s fail", clt->name, nw_sock_human_addr(&ses->peer_addr));
+    }
+}
+
+static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
+{
+    sds reply_str = rpc_body_str(pkg);
+    log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
+            nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
+    nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
+    if (entry == NULL) {
+        sdsfree(reply_str);
+        return;
+    }
+    struct state_data *state = entry->data;
+    fetching[state->index] = false;
+
+    json_t *reply = rpc_body_decode(pkg);
+    if (reply == NULL) {
+        sds hex = hexdump(pkg->body, pkg->body_size);
+        log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
+        sdsfree(hex);
+        sdsfree(reply_str);
+        nw_state_del(state_context, pkg->sequence);
+        return;
+    }
+
+    /* on error nothing is stored, the workers fall back to the backend
+     * once the key is behind and handle the error themselves */
+    json_t *error = json_object_get(reply, "error");
+    json_t *result = json_object_get(reply, "result");
+    if (error == NULL || !json_is_null(error) || result == NULL) {
+        log_error("error reply from: %s, cmd: %u, reply: %s", nw_sock_human_addr(&ses->peer_addr), pkg->command, reply_str);
+        sdsfree(reply_str);
+        json_decref(reply);
+        nw_state_del(state_context, pkg->sequence);
+        return;
+    }
+
+    char *data = json_dumps(result, JSON_SORT_KEYS);
+    if (data) {
+        int ret = shm_cache_write(cache, state->index, data, strlen(data));
+        if (ret < 0) {
+            log_error("shm_cache_write key: %s, size: %zu fail: %d", shm_cache_key(cache, state->index), strlen(data), ret);
+        }
+        free(data);
+    }
+
+    sdsfree(reply_str);
+    json_decref(reply);
+    nw_state_del(state_context, pkg->sequence);
+}
+
+static void on_timeout(nw_state_entry *entry)
+{
+    struct state_data *state = entry->data;
+    fetching[state->index] = false;
+    log_error("fetch timeout, key: %s", shm_cache_key(cache, state->index));
+}
+
+/* kline asks for the candles since the last poll, the time range is
+ * filled in here so the key stays the same */
+static json_t *get_fetch_params(uint32_t command, json_t *params)
+{
+    if (command != CMD_MARKET_KLINE) {
+        json_incref(params);
+        return params;
+    }
+
+    time_t now = time(NULL);
+    json_t *kline_params = json_array();
+    json_array_append(kline_params, json_array_get(params, 0));
+    json_array_append_new(kline_params, json_integer(now - (int)(settings.kline_interval + 1)));
+    json_array_append_new(kline_params, json_integer(now));
+    json_array_append(kline_params, json_array_get(params, 1));
+    return kline_params;
+}
+
+static int fetch(int index, uint32_t command, rpc_clt *backend, const char *params_str)
+{
+    json_t *params = json_loads(params_str, 0, NULL);
+    if (params == NULL)
+        return -__LINE__;
+    json_t *fetch_params = get_fetch_params(command, params);
+    json_decref(params);
+
+    nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
+    struct state_data *state = state_entry->data;
+    state->index = index;
+
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
+    pkg.command   = command;
+    pkg.sequence  = state_entry->id;
+    rpc_params_encode(&pkg, fetch_params, rpc_clt_encoding(backend));
+
+    rpc_clt_send(backend, &pkg);
+    log_trace("send request to %s, cmd: %u, sequence: %u, encoding: %d, body size: %u",
+            nw_sock_human_addr(rpc_clt_peer_addr(backend)), pkg.command, pkg.sequence, rpc_pkg_encoding(&pkg), pkg.body_size);
+    free(pkg.body);
+    json_decref(fetch_params);
+
+    return 0;
+}
+
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    double now = current_timestamp();
+    for (uint32_t i = 0; i < cache->slot_count; ++i) {
+        const char *key = shm_cache_key(cache, i);
+        if (key == NULL || fetching[i])
+            continue;
+        double want_time = shm_cache_want_time(cache, i);
+        if (now - want_time > EXPIRE_TIMEOUT) {
+            /* the key is another one's once the slot is expired */
+            log_info("expire key: %s", key);
+            shm_cache_expire(cache, i);
+            fetch_time[i] = 0;
+            continue;
+        }
+        if (now - want_time > WANT_TIMEOUT)
+            continue;
+
+        char *params_str;
+        uint32_t command = strtoul(key, &params_str, 10);
+        struct fetch_type *type = get_fetch_type(command);
+        if (type == NULL || *params_str != ' ')
+            continue;
+        if (now - fetch_time[i] < *type->interval)
+            continue;
+        if (!rpc_clt_connected(*type->backend))
+            continue;
+
+        int ret = fetch(i, command, *type->backend, params_str + 1);
+        if (ret < 0) {
+            log_error("fetch key: %s fail: %d", key, ret);
+            continue;
+        }
+        fetch_time[i] = now;
+        fetching[i] = true;
+    }
+}
+
+int init_fetcher(void)
+{
+    if (cache == NULL)
+        return -__LINE__;
+    fetch_time = calloc(cache->slot_count, sizeof(double));
+    fetching = calloc(cache->slot_count, sizeof(bool));
+    if (fetch_time == NULL || fetching == NULL)
+        return -__LINE__;
+
+    rpc_clt_type ct;
+    memset(&ct, 0, sizeof(ct));
+    ct.on_connect = on_backend_connect;
+    ct.on_recv_pkg = on_backend_recv_pkg;
+
+    matchengine = rpc_clt_create(&settings.matchengine, &ct);
+    if (matchengine == NULL)
+        return -__LINE__;
+    if (rpc_clt_start(matchengine) < 0)
+        return -__LINE__;
+
+    marketprice = rpc_clt_create(&settings.marketprice, &ct);
+    if (marketprice == NULL)
+        return -__LINE__;
+    if (rpc_clt_start(marketprice) < 0)
+        return -__LINE__;
+
+    nw_state_type st;
+    memset(&st, 0, sizeof(st));
+    st.on_timeout = on_timeout;
+
+    state_context = nw_state_create(&st, sizeof(struct state_data));
+    if (state_context == NULL)
+        return -__LINE__;
+
+    nw_timer_set(&timer, FETCH_TICK, true, on_timer, NULL);
+    nw_timer_start(&timer);
+
+    return 0;
+}
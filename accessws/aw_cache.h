@@ -0,0 +1,23 @@
+/*
+ * Description: market data fetched once per host, shared by the workers
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _AW_CACHE_H_
+# define _AW_CACHE_H_
+
+/* map the shared cache, before the workers are forked */
+int init_cache(void);
+/* the fetcher process, polls the backends for the keys workers read */
+int init_fetcher(void);
+
+/*
+ * the latest result of command with params as the fetcher stored it.
+ * 1 if the cache serves the request, *result is set when it is newer
+ * than *version and is NULL otherwise. 0 if the cache is off, full or
+ * behind, the caller queries the backend itself.
+ */
+int cache_get(uint32_t command, json_t *params, uint64_t *version, json_t **result);
+
+# endif
+
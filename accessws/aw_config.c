@@ -96,12 +96,21 @@ static int read_config_from_json(json_t *root)
         printf("load kafka balances config fail: %d\n", ret);
         return -__LINE__;
     }
+    if (json_object_get(root, "depth")) {
+        ret = load_cfg_kafka_consumer(root, "depth", &settings.depth);
+        if (ret < 0) {
+            printf("load kafka depth config fail: %d\n", ret);
+            return -__LINE__;
+        }
+    }
 
     ERR_RET(read_cfg_int(root, "worker_num", &settings.worker_num, false, 1));
     ERR_RET(read_cfg_str(root, "auth_url", &settings.auth_url, NULL));
     ERR_RET(read_cfg_str(root, "sign_url", &settings.sign_url, NULL));
     ERR_RET(read_cfg_real(root, "backend_timeout", &settings.backend_timeout, false, 1.0));
     ERR_RET(read_cfg_real(root, "cache_timeout", &settings.cache_timeout, false, 0.5));
+    ERR_RET(read_cfg_int(root, "market_cache_slots", &settings.market_cache_slots, false, 1024));
+    ERR_RET(read_cfg_int(root, "market_cache_slot_size", &settings.market_cache_slot_size, false, 65536));
 
     ERR_RET(read_cfg_real(root, "deals_interval", &settings.deals_interval, false, 0.5));
     ERR_RET(read_cfg_real(root, "price_interval", &settings.price_interval, false, 0.5));
@@ -112,6 +121,7 @@ static int read_config_from_json(json_t *root)
 
     ERR_RET(read_depth_limit_cfg(root, "depth_limit"));
     ERR_RET(read_depth_merge_cfg(root, "depth_merge"));
+    ERR_RET(read_cfg_int(root, "depth_levels", &settings.depth_levels, false, 1000));
 
     return 0;
 }
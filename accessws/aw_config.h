@@ -28,6 +28,7 @@
 # include "ut_cli.h"
 # include "ut_misc.h"
 # include "ut_list.h"
+# include "ut_skiplist.h"
 # include "ut_kafka.h"
 # include "ut_signal.h"
 # include "ut_config.h"
@@ -36,6 +37,7 @@
 # include "ut_rpc_svr.h"
 # include "ut_rpc_cmd.h"
 # include "ut_ws_svr.h"
+# include "ut_market_bin.h"
 
 # define ASSET_NAME_MAX_LEN     16
 # define MARKET_NAME_MAX_LEN    16
@@ -65,12 +67,15 @@ struct settings {
     rpc_clt_cfg         readhistory;
     kafka_consumer_cfg  orders;
     kafka_consumer_cfg  balances;
+    kafka_consumer_cfg  depth;
 
     int                 worker_num;
     char                *auth_url;
     char                *sign_url;
     double              backend_timeout;
     double              cache_timeout;
+    int                 market_cache_slots;
+    int                 market_cache_slot_size;
 
     double              deals_interval;
     double              price_interval;
@@ -81,6 +86,7 @@ struct settings {
 
     depth_limit_cfg     depth_limit;
     depth_merge_cfg     depth_merge;
+    int                 depth_levels;
 };
 
 extern struct settings settings;
@@ -6,6 +6,7 @@
 # include "aw_config.h"
 # include "aw_deals.h"
 # include "aw_server.h"
+# include "aw_cache.h"
 
 static nw_timer timer;
 static dict_t *dict_market;
@@ -20,6 +21,7 @@ struct market_val {
     dict_t *sessions;
     list_t *deals;
     uint64_t last_id;
+    uint64_t cache_version;
 };
 
 # define DEALS_QUERY_LIMIT 100
@@ -117,19 +119,26 @@ static int on_order_deals_reply(struct state_data *state, json_t *result)
     json_array_append_new(params, json_string(state->market));
     json_array_append(params, result);
 
+    notify_message *notify = notify_message_create("deals.update", params);
+    json_decref(params);
+    if (notify == NULL)
+        return -__LINE__;
+
     dict_iterator *iter = dict_get_iterator(obj->sessions);
     while ((entry = dict_next(iter)) != NULL) {
-        send_notify(entry->key, "deals.update", params);
+        ws_message *message = notify_message_get(notify, entry->key);
+        if (message)
+            ws_send_message(entry->key, message);
     }
     dict_release_iterator(iter);
-    json_decref(params);
+    notify_message_release(notify);
 
     return 0;
 }
 
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -139,7 +148,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_decode(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -185,18 +194,62 @@ static void on_timeout(nw_state_entry *entry)
     log_fatal("query deals timeout, state id: %u", entry->id);
 }
 
+/* the shared cache holds the latest deals, keep those after last_id */
+static json_t *get_new_deals(json_t *deals, uint64_t last_id)
+{
+    json_t *result = json_array();
+    for (size_t i = 0; i < json_array_size(deals); ++i) {
+        json_t *deal = json_array_get(deals, i);
+        uint64_t id = json_integer_value(json_object_get(deal, "id"));
+        if (id <= last_id)
+            break;
+        json_array_append(result, deal);
+    }
+    return result;
+}
+
+static int update_from_cache(const char *market, struct market_val *obj)
+{
+    json_t *params = json_array();
+    json_array_append_new(params, json_string(market));
+    json_array_append_new(params, json_integer(DEALS_QUERY_LIMIT));
+    json_array_append_new(params, json_integer(0));
+
+    json_t *result;
+    int cached = cache_get(CMD_MARKET_DEALS, params, &obj->cache_version, &result);
+    json_decref(params);
+    if (cached <= 0 || result == NULL)
+        return cached;
+
+    struct state_data state;
+    memset(&state, 0, sizeof(state));
+    strncpy(state.market, market, MARKET_NAME_MAX_LEN - 1);
+    json_t *deals = get_new_deals(result, obj->last_id);
+    int ret = on_order_deals_reply(&state, deals);
+    if (ret < 0) {
+        log_error("on_order_deals_reply fail: %d", ret);
+    }
+    json_decref(deals);
+    json_decref(result);
+
+    return 1;
+}
+
 static void on_timer(nw_timer *timer, void *privdata)
 {
     dict_iterator *iter = dict_get_iterator(dict_market);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        const struct market_val *obj = entry->val;
+        struct market_val *obj = entry->val;
         if (dict_size(obj->sessions) == 0) {
             dict_delete(dict_market, entry->key);
             continue;
         }
 
         const char *market = entry->key;
+        if (update_from_cache(market, obj) > 0)
+            continue;
+
         json_t *params = json_array();
         json_array_append_new(params, json_string(market));
         json_array_append_new(params, json_integer(DEALS_QUERY_LIMIT));
@@ -211,12 +264,11 @@ static void on_timer(nw_timer *timer, void *privdata)
         pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
         pkg.command   = CMD_MARKET_DEALS;
         pkg.sequence  = state_entry->id;
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
+        rpc_params_encode(&pkg, params, rpc_clt_encoding(marketprice));
 
         rpc_clt_send(marketprice, &pkg);
-        log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, (char *)pkg.body);
+        log_trace("send request to %s, cmd: %u, sequence: %u, encoding: %d, body size: %u",
+                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, rpc_pkg_encoding(&pkg), pkg.body_size);
         free(pkg.body);
         json_decref(params);
     }
@@ -5,14 +5,17 @@
 
 # include "aw_config.h"
 # include "aw_server.h"
+# include "aw_cache.h"
 # include "aw_depth.h"
 
 static nw_timer timer;
 static dict_t *dict_depth;
+static dict_t *dict_book;
 static rpc_clt *matchengine;
 static nw_state *state_context;
 
 # define CLEAN_INTERVAL 60
+# define PENDING_MAX    1000
 
 struct depth_key {
     char market[MARKET_NAME_MAX_LEN];
@@ -24,12 +27,45 @@ struct depth_val {
     dict_t *sessions;
     json_t *last;
     time_t  last_clean;
+    uint64_t cache_version;
+    /* the view reached the edge of the local book, it is asked from
+     * matchengine until the book fills it again */
+    bool    cut;
 };
 
 struct state_data {
+    uint32_t command;
     struct depth_key key;
 };
 
+struct depth_level {
+    mpd_t *price;
+    mpd_t *amount;
+};
+
+/*
+ * the price levels of a market, from an order.levels snapshot and then the
+ * depth feed. a snapshot cut at depth_levels leaves the levels past its last
+ * price unknown, updates past that edge are dropped, a view that reaches
+ * the edge is answered by order.depth instead.
+ */
+struct depth_book {
+    skiplist_t *asks;
+    skiplist_t *bids;
+    mpd_t      *asks_edge;
+    mpd_t      *bids_edge;
+    uint64_t    seq;
+    bool        ready;
+    bool        syncing;
+    bool        reset;
+    bool        used;
+    /* updates received while the snapshot is on its way */
+    list_t     *pending;
+    /* the best changed price on each side since the last tick */
+    mpd_t      *asks_change;
+    mpd_t      *bids_change;
+};
+
 static uint32_t dict_ses_hash_func(const void *key)
 {
     return dict_generic_hash_function(key, sizeof(void *));
@@ -78,6 +114,74 @@ static void dict_depth_val_free(void *val)
     free(obj);
 }
 
+static uint32_t dict_book_hash_func(const void *key)
+{
+    return dict_generic_hash_function(key, strlen(key));
+}
+
+static int dict_book_key_compare(const void *key1, const void *key2)
+{
+    return strcmp(key1, key2);
+}
+
+static void *dict_book_key_dup(const void *key)
+{
+    return strdup(key);
+}
+
+static void dict_book_key_free(void *key)
+{
+    free(key);
+}
+
+static int level_ask_compare(const void *value1, const void *value2)
+{
+    const struct depth_level *level1 = value1;
+    const struct depth_level *level2 = value2;
+    return mpd_cmp(level1->price, level2->price, &mpd_ctx);
+}
+
+static int level_bid_compare(const void *value1, const void *value2)
+{
+    const struct depth_level *level1 = value1;
+    const struct depth_level *level2 = value2;
+    return mpd_cmp(level2->price, level1->price, &mpd_ctx);
+}
+
+static void level_free(void *value)
+{
+    struct depth_level *level = value;
+    mpd_del(level->price);
+    mpd_del(level->amount);
+    free(level);
+}
+
+static void pending_free(void *value)
+{
+    json_decref(value);
+}
+
+static void clear_decimal(mpd_t **val)
+{
+    if (*val) {
+        mpd_del(*val);
+        *val = NULL;
+    }
+}
+
+static void dict_book_val_free(void *val)
+{
+    struct depth_book *book = val;
+    skiplist_release(book->asks);
+    skiplist_release(book->bids);
+    list_release(book->pending);
+    clear_decimal(&book->asks_edge);
+    clear_decimal(&book->bids_edge);
+    clear_decimal(&book->asks_change);
+    clear_decimal(&book->bids_change);
+    free(book);
+}
+
 static void on_backend_connect(nw_ses *ses, bool result)
 {
     rpc_clt *clt = ses->privdata;
@@ -205,36 +309,59 @@ static json_t *get_depth_diff(json_t *first, json_t *second, uint32_t limit)
     return diff;
 }
 
-static int broadcast_update(const char *market, dict_t *sessions, bool clean, json_t *result)
+static notify_message *create_depth_notify(const char *market, bool clean, json_t *result)
 {
     json_t *params = json_array();
     json_array_append_new(params, json_boolean(clean));
     json_array_append(params, result);
     json_array_append_new(params, json_string(market));
 
+    notify_message *notify = notify_message_create("depth.update", params);
+    json_decref(params);
+    return notify;
+}
+
+/* a diff cannot replace one held for a slow session, the full depth is
+ * built on first need and replaces it instead */
+static int broadcast_update(const char *market, dict_t *sessions, bool clean, json_t *result, json_t *full)
+{
+    notify_message *notify = create_depth_notify(market, clean, result);
+    if (notify == NULL)
+        return -__LINE__;
+    notify_message *full_notify = clean ? notify : NULL;
+
     dict_iterator *iter = dict_get_iterator(sessions);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        send_notify(entry->key, "depth.update", params);
+        ws_message *message = notify_message_get(notify, entry->key);
+        if (message == NULL)
+            continue;
+        ws_message *replace = NULL;
+        if (clean) {
+            replace = message;
+        } else if (ws_ses_held(entry->key, "depth")) {
+            if (full_notify == NULL)
+                full_notify = create_depth_notify(market, true, full);
+            if (full_notify)
+                replace = notify_message_get(full_notify, entry->key);
+        }
+        ws_send_message_latest(entry->key, "depth", message, replace);
     }
     dict_release_iterator(iter);
-    json_decref(params);
+    if (full_notify && full_notify != notify)
+        notify_message_release(full_notify);
+    notify_message_release(notify);
 
     return 0;
 }
 
-static int on_market_depth_reply(struct state_data *state, json_t *result)
+static int update_depth(struct depth_key *key, struct depth_val *val, json_t *result)
 {
-    dict_entry *entry = dict_find(dict_depth, &state->key);
-    if (entry == NULL)
-        return -__LINE__;
-    struct depth_key *key = entry->key;
-    struct depth_val *val = entry->val;
     if (val->last == NULL) {
         val->last = result;
         val->last_clean = time(NULL);
         json_incref(result);
-        return broadcast_update(state->key.market, val->sessions, true, result);
+        return broadcast_update(key->market, val->sessions, true, result, result);
     }
 
     json_t *diff = get_depth_diff(val->last, result, key->limit);
@@ -249,18 +376,243 @@ static int on_market_depth_reply(struct state_data *state, json_t *result)
     time_t now = time(NULL);
     if (now - val->last_clean >= CLEAN_INTERVAL) {
         val->last_clean = now;
-        broadcast_update(state->key.market, val->sessions, true, result);
+        broadcast_update(key->market, val->sessions, true, result, result);
     } else {
-        broadcast_update(state->key.market, val->sessions, false, diff);
+        broadcast_update(key->market, val->sessions, false, diff, result);
     }
     json_decref(diff);
 
     return 0;
 }
 
+static int on_market_depth_reply(struct state_data *state, json_t *result)
+{
+    dict_entry *entry = dict_find(dict_depth, &state->key);
+    if (entry == NULL)
+        return -__LINE__;
+    struct depth_val *val = entry->val;
+    /* the local book answers this view again, the reply is older */
+    if (settings.depth.topic && !val->cut)
+        return 0;
+    return update_depth(entry->key, val, result);
+}
+
+static void send_request(uint32_t command, struct depth_key *key, json_t *params)
+{
+    nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
+    struct state_data *state = state_entry->data;
+    state->command = command;
+    memcpy(&state->key, key, sizeof(struct depth_key));
+
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
+    pkg.command   = command;
+    pkg.sequence  = state_entry->id;
+    rpc_params_encode(&pkg, params, rpc_clt_encoding(matchengine));
+
+    rpc_clt_send(matchengine, &pkg);
+    log_trace("send request to %s, cmd: %u, sequence: %u, encoding: %d, body size: %u",
+            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, rpc_pkg_encoding(&pkg), pkg.body_size);
+    free(pkg.body);
+}
+
+static int book_clear(struct depth_book *book)
+{
+    skiplist_t *lists[] = { book->asks, book->bids };
+    for (int i = 0; i < 2; ++i) {
+        skiplist_node *node;
+        skiplist_iter *iter = skiplist_get_iterator(lists[i]);
+        if (iter == NULL)
+            return -__LINE__;
+        while ((node = skiplist_next(iter)) != NULL) {
+            skiplist_delete(lists[i], node);
+        }
+        skiplist_release_iterator(iter);
+    }
+    clear_decimal(&book->asks_edge);
+    clear_decimal(&book->bids_edge);
+
+    return 0;
+}
+
+static void book_set_level(struct depth_book *book, int side, mpd_t *price, mpd_t *amount)
+{
+    skiplist_t *list = side > 0 ? book->asks : book->bids;
+    mpd_t *edge = side > 0 ? book->asks_edge : book->bids_edge;
+    if (edge && mpd_cmp(price, edge, &mpd_ctx) * side > 0)
+        return;
+
+    struct depth_level probe = { .price = price };
+    skiplist_node *node = skiplist_find(list, &probe);
+    if (mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0) {
+        if (node)
+            skiplist_delete(list, node);
+    } else if (node) {
+        struct depth_level *level = node->value;
+        mpd_copy(level->amount, amount, &mpd_ctx);
+    } else {
+        struct depth_level *level = malloc(sizeof(struct depth_level));
+        level->price  = mpd_qncopy(price);
+        level->amount = mpd_qncopy(amount);
+        if (skiplist_insert(list, level) == NULL)
+            level_free(level);
+    }
+
+    mpd_t **change = side > 0 ? &book->asks_change : &book->bids_change;
+    if (*change == NULL) {
+        *change = mpd_qncopy(price);
+    } else if (mpd_cmp(price, *change, &mpd_ctx) * side < 0) {
+        mpd_copy(*change, price, &mpd_ctx);
+    }
+}
+
+/* [[price, amount], ...], amount 0 removes the level */
+static int book_apply(struct depth_book *book, int side, json_t *list)
+{
+    if (list == NULL)
+        return 0;
+    if (!json_is_array(list))
+        return -__LINE__;
+
+    for (size_t i = 0; i < json_array_size(list); ++i) {
+        json_t *unit = json_array_get(list, i);
+        const char *price_str  = json_string_value(json_array_get(unit, 0));
+        const char *amount_str = json_string_value(json_array_get(unit, 1));
+        if (price_str == NULL || amount_str == NULL)
+            return -__LINE__;
+        mpd_t *price  = decimal(price_str, 0);
+        mpd_t *amount = decimal(amount_str, 0);
+        if (price == NULL || amount == NULL) {
+            if (price)
+                mpd_del(price);
+            if (amount)
+                mpd_del(amount);
+            return -__LINE__;
+        }
+        book_set_level(book, side, price, amount);
+        mpd_del(price);
+        mpd_del(amount);
+    }
+
+    return 0;
+}
+
+/* an update older than the book is already in it, a newer one must follow it */
+static int book_apply_update(struct depth_book *book, json_t *msg)
+{
+    uint64_t seq = json_integer_value(json_object_get(msg, "seq"));
+    if (seq <= book->seq)
+        return 0;
+    if (seq != book->seq + 1)
+        return -__LINE__;
+    book->seq = seq;
+
+    int ret = book_apply(book, 1, json_object_get(msg, "asks"));
+    if (ret < 0)
+        return ret;
+    ret = book_apply(book, -1, json_object_get(msg, "bids"));
+    if (ret < 0)
+        return ret;
+
+    return 0;
+}
+
+static void book_sync(const char *market, struct depth_book *book)
+{
+    if (book->syncing)
+        return;
+    book->syncing = true;
+    list_clear(book->pending);
+
+    struct depth_key key;
+    memset(&key, 0, sizeof(key));
+    strncpy(key.market, market, MARKET_NAME_MAX_LEN - 1);
+
+    json_t *params = json_array();
+    json_array_append_new(params, json_string(market));
+    json_array_append_new(params, json_integer(settings.depth_levels));
+    send_request(CMD_ORDER_BOOK_LEVELS, &key, params);
+    json_decref(params);
+}
+
+static mpd_t *get_edge(json_t *list)
+{
+    if (json_array_size(list) < (size_t)settings.depth_levels)
+        return NULL;
+    json_t *unit = json_array_get(list, json_array_size(list) - 1);
+    const char *price = json_string_value(json_array_get(unit, 0));
+    if (price == NULL)
+        return NULL;
+    return decimal(price, 0);
+}
+
+static int on_book_levels_reply(struct state_data *state, json_t *result)
+{
+    dict_entry *entry = dict_find(dict_book, state->key.market);
+    if (entry == NULL)
+        return 0;
+    struct depth_book *book = entry->val;
+    book->syncing = false;
+
+    json_t *asks = json_object_get(result, "asks");
+    json_t *bids = json_object_get(result, "bids");
+    json_t *seq  = json_object_get(result, "seq");
+    if (!json_is_array(asks) || !json_is_array(bids) || !json_is_integer(seq))
+        return -__LINE__;
+
+    book->ready = false;
+    int ret = book_clear(book);
+    if (ret < 0)
+        return ret;
+    ret = book_apply(book, 1, asks);
+    if (ret < 0)
+        return ret;
+    ret = book_apply(book, -1, bids);
+    if (ret < 0)
+        return ret;
+    book->asks_edge = get_edge(asks);
+    book->bids_edge = get_edge(bids);
+    book->seq = json_integer_value(seq);
+    book->ready = true;
+    book->reset = true;
+
+    list_node *node;
+    list_iter *iter = list_get_iterator(book->pending, LIST_START_HEAD);
+    while ((node = list_next(iter)) != NULL) {
+        if (book_apply_update(book, node->value) < 0) {
+            book->ready = false;
+            break;
+        }
+    }
+    list_release_iterator(iter);
+    list_clear(book->pending);
+
+    if (!book->ready) {
+        log_error("market: %s depth update missing after snapshot seq: %"PRIu64", sync again", state->key.market, book->seq);
+        book_sync(state->key.market, book);
+    }
+
+    return 0;
+}
+
+static void delete_market(const char *market)
+{
+    dict_iterator *iter = dict_get_iterator(dict_depth);
+    dict_entry *entry;
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_key *key = entry->key;
+        if (strcmp(key->market, market) == 0) {
+            dict_delete(dict_depth, entry->key);
+        }
+    }
+    dict_release_iterator(iter);
+    dict_delete(dict_book, market);
+}
+
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -270,7 +622,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_decode(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -282,7 +634,11 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
     json_t *error = json_object_get(reply, "error");
     if (error && !json_is_null(error)) {
-        dict_delete(dict_depth, &state->key);
+        if (pkg->command == CMD_ORDER_BOOK_LEVELS) {
+            delete_market(state->key.market);
+        } else {
+            dict_delete(dict_depth, &state->key);
+        }
     }
     json_t *result = json_object_get(reply, "result");
     if (error == NULL || !json_is_null(error) || result == NULL) {
@@ -301,6 +657,12 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
             log_error("on_market_depth_reply: %d, reply: %s", ret, reply_str);
         }
         break;
+    case CMD_ORDER_BOOK_LEVELS:
+        ret = on_book_levels_reply(state, result);
+        if (ret < 0) {
+            log_error("on_book_levels_reply: %d, reply: %s", ret, reply_str);
+        }
+        break;
     default:
         log_error("recv unknown command: %u from: %s", pkg->command, nw_sock_human_addr(&ses->peer_addr));
         break;
@@ -314,46 +676,280 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 static void on_timeout(nw_state_entry *entry)
 {
     log_fatal("query depth timeout, state id: %u", entry->id);
+    struct state_data *state = entry->data;
+    if (state->command == CMD_ORDER_BOOK_LEVELS) {
+        dict_entry *result = dict_find(dict_book, state->key.market);
+        if (result) {
+            struct depth_book *book = result->val;
+            book->syncing = false;
+        }
+    }
 }
 
-static void on_timer(nw_timer *timer, void *privdata)
+static void query_depth(struct depth_key *key, struct depth_val *val)
+{
+    json_t *params = json_array();
+    json_array_append_new(params, json_string(key->market));
+    json_array_append_new(params, json_integer(key->limit));
+    json_array_append_new(params, json_string(key->interval));
+
+    json_t *result;
+    if (cache_get(CMD_ORDER_BOOK_DEPTH, params, &val->cache_version, &result) > 0) {
+        if (result) {
+            struct state_data state;
+            memset(&state, 0, sizeof(state));
+            state.command = CMD_ORDER_BOOK_DEPTH;
+            memcpy(&state.key, key, sizeof(struct depth_key));
+            int ret = on_market_depth_reply(&state, result);
+            if (ret < 0) {
+                log_error("on_market_depth_reply: %d", ret);
+            }
+            json_decref(result);
+        }
+        json_decref(params);
+        return;
+    }
+
+    send_request(CMD_ORDER_BOOK_DEPTH, key, params);
+    json_decref(params);
+}
+
+static void poll_depth(void)
 {
     dict_iterator *iter = dict_get_iterator(dict_depth);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        const struct depth_val *obj = entry->val;
+        struct depth_val *obj = entry->val;
         if (dict_size(obj->sessions) == 0) {
             dict_delete(dict_depth, entry->key);
             continue;
         }
+        query_depth(entry->key, obj);
+    }
+    dict_release_iterator(iter);
+}
+
+static struct depth_book *get_book(const char *market)
+{
+    dict_entry *entry = dict_find(dict_book, market);
+    if (entry)
+        return entry->val;
+
+    struct depth_book *book = malloc(sizeof(struct depth_book));
+    memset(book, 0, sizeof(struct depth_book));
+
+    skiplist_type st;
+    memset(&st, 0, sizeof(st));
+    st.free = level_free;
+    st.compare = level_ask_compare;
+    book->asks = skiplist_create(&st);
+    st.compare = level_bid_compare;
+    book->bids = skiplist_create(&st);
+
+    list_type lt;
+    memset(&lt, 0, sizeof(lt));
+    lt.free = pending_free;
+    book->pending = list_create(&lt);
+    if (book->asks == NULL || book->bids == NULL || book->pending == NULL)
+        return NULL;
+
+    if (dict_add(dict_book, (void *)market, book) == NULL) {
+        dict_book_val_free(book);
+        return NULL;
+    }
+    book_sync(market, book);
+
+    return book;
+}
+
+/*
+ * the same as matchengine order.depth, from the local levels. cut is set
+ * when levels past the edge could be in the view: the side ran out before
+ * limit, or the last merged level holds prices past the edge.
+ */
+static json_t *get_book_side(skiplist_t *list, int side, uint32_t limit, mpd_t *interval, mpd_t *edge, bool *cut)
+{
+    bool merge = mpd_cmp(interval, mpd_zero, &mpd_ctx) != 0;
+    mpd_t *q = mpd_new(&mpd_ctx);
+    mpd_t *r = mpd_new(&mpd_ctx);
+    mpd_t *price = mpd_new(&mpd_ctx);
+    mpd_t *amount = mpd_new(&mpd_ctx);
+
+    json_t *result = json_array();
+    skiplist_iter *iter = skiplist_get_iterator(list);
+    skiplist_node *node = skiplist_next(iter);
+    size_t index = 0;
+    while (node && index < limit) {
+        index++;
+        struct depth_level *level = node->value;
+        if (merge) {
+            mpd_divmod(q, r, level->price, interval, &mpd_ctx);
+            mpd_mul(price, q, interval, &mpd_ctx);
+            if (side > 0 && mpd_cmp(r, mpd_zero, &mpd_ctx) != 0) {
+                mpd_add(price, price, interval, &mpd_ctx);
+            }
+        } else {
+            mpd_copy(price, level->price, &mpd_ctx);
+        }
+        mpd_copy(amount, level->amount, &mpd_ctx);
+        while ((node = skiplist_next(iter)) != NULL) {
+            level = node->value;
+            if (!merge || mpd_cmp(price, level->price, &mpd_ctx) * side < 0)
+                break;
+            mpd_add(amount, amount, level->amount, &mpd_ctx);
+        }
+        json_t *info = json_array();
+        json_array_append_new_mpd(info, price);
+        json_array_append_new_mpd(info, amount);
+        json_array_append_new(result, info);
+    }
+    skiplist_release_iterator(iter);
+
+    if (edge) {
+        if (index < limit)
+            *cut = true;
+        else if (mpd_cmp(price, edge, &mpd_ctx) * side > 0)
+            *cut = true;
+    }
+
+    mpd_del(q);
+    mpd_del(r);
+    mpd_del(price);
+    mpd_del(amount);
+
+    return result;
+}
+
+static json_t *get_book_depth(struct depth_book *book, uint32_t limit, const char *interval, bool *cut)
+{
+    mpd_t *merge = decimal(interval, 0);
+    if (merge == NULL)
+        return NULL;
+    *cut = false;
+    json_t *result = json_object();
+    json_object_set_new(result, "asks", get_book_side(book->asks, 1, limit, merge, book->asks_edge, cut));
+    json_object_set_new(result, "bids", get_book_side(book->bids, -1, limit, merge, book->bids_edge, cut));
+    mpd_del(merge);
+
+    return result;
+}
+
+/*
+ * a full side only changes when a changed price is at or better than its
+ * last level, merged levels included: an ask level p holds the prices up to
+ * p, a bid level p the prices from p.
+ */
+static bool is_side_changed(json_t *list, mpd_t *change, uint32_t limit, int side)
+{
+    if (change == NULL)
+        return false;
+    size_t size = json_array_size(list);
+    if (size < limit)
+        return true;
+    const char *last = json_string_value(json_array_get(json_array_get(list, size - 1), 0));
+    mpd_t *price = last ? decimal(last, 0) : NULL;
+    if (price == NULL)
+        return true;
+    bool changed = mpd_cmp(change, price, &mpd_ctx) * side <= 0;
+    mpd_del(price);
+
+    return changed;
+}
+
+static bool is_view_changed(struct depth_book *book, json_t *last, uint32_t limit)
+{
+    if (book->reset || last == NULL)
+        return true;
+    if (is_side_changed(json_object_get(last, "asks"), book->asks_change, limit, 1))
+        return true;
+    if (is_side_changed(json_object_get(last, "bids"), book->bids_change, limit, -1))
+        return true;
+    return false;
+}
+
+static void update_books(void)
+{
+    dict_iterator *iter = dict_get_iterator(dict_book);
+    dict_entry *entry;
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_book *book = entry->val;
+        book->used = false;
+    }
+    dict_release_iterator(iter);
+
+    iter = dict_get_iterator(dict_depth);
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_val *val = entry->val;
+        if (dict_size(val->sessions) == 0) {
+            dict_delete(dict_depth, entry->key);
+            continue;
+        }
 
         struct depth_key *key = entry->key;
-        json_t *params = json_array();
-        json_array_append_new(params, json_string(key->market));
-        json_array_append_new(params, json_integer(key->limit));
-        json_array_append_new(params, json_string(key->interval));
-
-        nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
-        struct state_data *state = state_entry->data;
-        memcpy(&state->key, key, sizeof(struct depth_key));
-
-        rpc_pkg pkg;
-        memset(&pkg, 0, sizeof(pkg));
-        pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
-        pkg.command   = CMD_ORDER_BOOK_DEPTH;
-        pkg.sequence  = state_entry->id;
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
-
-        rpc_clt_send(matchengine, &pkg);
-        log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-                nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, (char *)pkg.body);
-        free(pkg.body);
-        json_decref(params);
+        struct depth_book *book = get_book(key->market);
+        if (book == NULL)
+            continue;
+        book->used = true;
+        if (!book->ready)
+            continue;
+        if (val->cut) {
+            /* changes past the edge are not seen, ask every tick */
+            if (!book->reset && !book->asks_change && !book->bids_change) {
+                query_depth(key, val);
+                continue;
+            }
+        } else if (!is_view_changed(book, val->last, key->limit)) {
+            continue;
+        }
+
+        bool cut;
+        json_t *result = get_book_depth(book, key->limit, key->interval, &cut);
+        if (result == NULL)
+            continue;
+        val->cut = cut;
+        if (cut) {
+            json_decref(result);
+            query_depth(key, val);
+            continue;
+        }
+        int ret = update_depth(key, val, result);
+        if (ret < 0) {
+            log_error("update_depth: %s fail: %d", key->market, ret);
+        }
+        json_decref(result);
+    }
+    dict_release_iterator(iter);
+
+    iter = dict_get_iterator(dict_book);
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_book *book = entry->val;
+        if (!book->used) {
+            dict_delete(dict_book, entry->key);
+            continue;
+        }
+        book->reset = false;
+        clear_decimal(&book->asks_change);
+        clear_decimal(&book->bids_change);
+
+        /* a cut side eaten below half is fetched again */
+        bool short_asks = book->asks_edge && skiplist_len(book->asks) < (unsigned long)settings.depth_levels / 2;
+        bool short_bids = book->bids_edge && skiplist_len(book->bids) < (unsigned long)settings.depth_levels / 2;
+        if (!book->ready || short_asks || short_bids) {
+            book_sync(entry->key, book);
+        }
     }
     dict_release_iterator(iter);
 }
 
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    if (settings.depth.topic) {
+        update_books();
+    } else {
+        poll_depth();
+    }
+}
+
 int init_depth(void)
 {
     dict_types dt;
@@ -369,6 +965,17 @@ int init_depth(void)
     if (dict_depth == NULL)
         return -__LINE__;
 
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function = dict_book_hash_func;
+    dt.key_compare = dict_book_key_compare;
+    dt.key_dup = dict_book_key_dup;
+    dt.key_destructor = dict_book_key_free;
+    dt.val_destructor = dict_book_val_free;
+
+    dict_book = dict_create(&dt, 64);
+    if (dict_book == NULL)
+        return -__LINE__;
+
     rpc_clt_type ct;
     memset(&ct, 0, sizeof(ct));
     ct.on_connect = on_backend_connect;
@@ -489,11 +1096,41 @@ int depth_send_clean(nw_ses *ses, const char *market, uint32_t limit, const char
         json_t *params = json_array();
         json_array_append_new(params, json_boolean(true));
         json_array_append(params, obj->last);
-        json_array_append(params, json_string(market));
-        send_notify(ses, "depth.update", params);
+        json_array_append_new(params, json_string(market));
+        send_notify_latest(ses, "depth", "depth.update", params);
         json_decref(params);
     }
 
     return 0;
 }
 
+int depth_on_update(json_t *msg)
+{
+    const char *market = json_string_value(json_object_get(msg, "market"));
+    if (market == NULL || !json_is_integer(json_object_get(msg, "seq")))
+        return -__LINE__;
+    dict_entry *entry = dict_find(dict_book, market);
+    if (entry == NULL)
+        return 0;
+
+    struct depth_book *book = entry->val;
+    if (book->syncing) {
+        if (book->pending->len < PENDING_MAX) {
+            json_incref(msg);
+            list_add_node_tail(book->pending, msg);
+        }
+        return 0;
+    }
+    if (!book->ready)
+        return 0;
+
+    int ret = book_apply_update(book, msg);
+    if (ret < 0) {
+        log_error("market: %s depth update after seq: %"PRIu64" fail: %d, sync again", market, book->seq, ret);
+        book->ready = false;
+        book_sync(market, book);
+    }
+
+    return 0;
+}
+
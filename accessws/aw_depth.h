@@ -12,5 +12,8 @@ int depth_subscribe(nw_ses *ses, const char *market, uint32_t limit, const char
 int depth_send_clean(nw_ses *ses, const char *market, uint32_t limit, const char *interval);
 int depth_unsubscribe(nw_ses *ses);
 
+/* a message of the matchengine depth feed */
+int depth_on_update(json_t *msg);
+
 # endif
 
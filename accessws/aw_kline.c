@@ -6,6 +6,7 @@
 # include "aw_config.h"
 # include "aw_kline.h"
 # include "aw_server.h"
+# include "aw_cache.h"
 
 static nw_timer timer;
 static dict_t *dict_kline;
@@ -20,6 +21,7 @@ struct kline_key {
 struct kline_val {
     dict_t *sessions;
     json_t *last;
+    uint64_t cache_version;
 };
 
 struct state_data {
@@ -86,12 +88,19 @@ static void on_backend_connect(nw_ses *ses, bool result)
 
 static int broadcast_update(dict_t *sessions, json_t *result)
 {
+    notify_message *notify = notify_message_create("kline.update", result);
+    if (notify == NULL)
+        return -__LINE__;
+
     dict_iterator *iter = dict_get_iterator(sessions);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        send_notify(entry->key, "kline.update", result);
+        ws_message *message = notify_message_get(notify, entry->key);
+        if (message)
+            ws_send_message_latest(entry->key, "kline", message, message);
     }
     dict_release_iterator(iter);
+    notify_message_release(notify);
 
     return 0;
 }
@@ -132,7 +141,7 @@ static int on_market_kline_reply(struct state_data *state, json_t *result)
 
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -142,7 +151,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_decode(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -188,18 +197,45 @@ static void on_timeout(nw_state_entry *entry)
     log_fatal("query kline timeout, state id: %u", entry->id);
 }
 
+/* the fetcher adds the time range, the cache key is market and interval */
+static int update_from_cache(const struct kline_key *key, struct kline_val *obj)
+{
+    json_t *params = json_array();
+    json_array_append_new(params, json_string(key->market));
+    json_array_append_new(params, json_integer(key->interval));
+
+    json_t *result;
+    int cached = cache_get(CMD_MARKET_KLINE, params, &obj->cache_version, &result);
+    json_decref(params);
+    if (cached <= 0 || result == NULL)
+        return cached;
+
+    struct state_data state;
+    memcpy(&state.key, key, sizeof(struct kline_key));
+    int ret = on_market_kline_reply(&state, result);
+    if (ret < 0) {
+        log_error("on_market_kline_reply: %d", ret);
+    }
+    json_decref(result);
+
+    return 1;
+}
+
 static void on_timer(nw_timer *timer, void *privdata)
 {
     dict_iterator *iter = dict_get_iterator(dict_kline);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        const struct kline_val *obj = entry->val;
+        struct kline_val *obj = entry->val;
         if (dict_size(obj->sessions) == 0) {
             dict_delete(dict_kline, entry->key);
             continue;
         }
 
         const struct kline_key *key = entry->key;
+        if (update_from_cache(key, obj) > 0)
+            continue;
+
         time_t now = time(NULL);
         json_t *params = json_array();
         json_array_append_new(params, json_string(key->market));
@@ -216,12 +252,11 @@ static void on_timer(nw_timer *timer, void *privdata)
         pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
         pkg.command   = CMD_MARKET_KLINE;
         pkg.sequence  = state_entry->id;
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
+        rpc_params_encode(&pkg, params, rpc_clt_encoding(marketprice));
 
         rpc_clt_send(marketprice, &pkg);
-        log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, (char *)pkg.body);
+        log_trace("send request to %s, cmd: %u, sequence: %u, encoding: %d, body size: %u",
+                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, rpc_pkg_encoding(&pkg), pkg.body_size);
         free(pkg.body);
         json_decref(params);
     }
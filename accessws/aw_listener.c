@@ -55,8 +55,17 @@ static int init_listener_svr(void)
     type.on_recv_pkg = listener_on_recv_pkg;
     type.on_error_msg = listener_on_error_msg;
 
-    nw_svr_cfg *cfg = (nw_svr_cfg *)&settings.svr;
-    listener_svr = nw_svr_create(cfg, &type, NULL);
+    nw_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bind_count = settings.svr.bind_count;
+    cfg.bind_arr = settings.svr.bind_arr;
+    cfg.max_pkg_size = settings.svr.max_pkg_size;
+    cfg.buf_limit = settings.svr.buf_limit;
+    cfg.read_mem = settings.svr.read_mem;
+    cfg.write_mem = settings.svr.write_mem;
+    cfg.cork = settings.svr.cork;
+    cfg.reuse_port = settings.svr.reuse_port;
+    listener_svr = nw_svr_create(&cfg, &type, NULL);
     if (listener_svr == NULL)
         return -__LINE__;
     if (nw_svr_start(listener_svr) < 0)
@@ -132,12 +141,15 @@ static int init_monitor_svr(void)
 int init_listener(void)
 {
     int ret;
-    ret = init_listener_svr();
-    if (ret < 0)
-        return ret;
-    ret = init_worker_svr();
-    if (ret < 0)
-        return ret;
+    /* with reuse_port every worker accepts on its own socket */
+    if (!settings.svr.reuse_port) {
+        ret = init_listener_svr();
+        if (ret < 0)
+            return ret;
+        ret = init_worker_svr();
+        if (ret < 0)
+            return ret;
+    }
     ret = init_monitor_svr();
     if (ret < 0)
         return ret;
@@ -16,6 +16,7 @@
 # include "aw_deals.h"
 # include "aw_order.h"
 # include "aw_asset.h"
+# include "aw_cache.h"
 # include "aw_message.h"
 # include "aw_listener.h"
 
@@ -93,6 +94,11 @@ int main(int argc, char *argv[])
         error(EXIT_FAILURE, errno, "init log fail: %d", ret);
     }
 
+    ret = init_cache();
+    if (ret < 0) {
+        error(EXIT_FAILURE, errno, "init cache fail: %d", ret);
+    }
+
     for (int i = 0; i < settings.worker_num; ++i) {
         int pid = fork();
         if (pid < 0) {
@@ -105,6 +111,16 @@ int main(int argc, char *argv[])
             goto server;
         }
     }
+    if (settings.market_cache_slots > 0) {
+        int pid = fork();
+        if (pid < 0) {
+            error(EXIT_FAILURE, errno, "fork error");
+        } else if (pid == 0) {
+            process_title_set("%s_fetcher", __process__);
+            dlog_set_no_shift(default_dlog);
+            goto fetcher;
+        }
+    }
 
     process_title_set("%s_listener", __process__);
     daemon(1, 1);
@@ -117,6 +133,16 @@ int main(int argc, char *argv[])
     }
     goto run;
 
+fetcher:
+    daemon(1, 1);
+    process_keepalive();
+
+    ret = init_fetcher();
+    if (ret < 0) {
+        error(EXIT_FAILURE, errno, "init fetcher fail: %d", ret);
+    }
+    goto run;
+
 server:
     daemon(1, 1);
     process_keepalive();
@@ -7,9 +7,11 @@
 # include "aw_message.h"
 # include "aw_asset.h"
 # include "aw_order.h"
+# include "aw_depth.h"
 
 static kafka_consumer_t *kafka_orders;
 static kafka_consumer_t *kafka_balances;
+static kafka_consumer_t *kafka_depth;
 
 static int process_orders_message(json_t *msg)
 {
@@ -25,8 +27,9 @@ static int process_orders_message(json_t *msg)
     if (user_id == 0 || stock == NULL || money == NULL)
         return -__LINE__;
 
-    asset_on_update(user_id, stock);
-    asset_on_update(user_id, money);
+    json_t *balances = json_object_get(msg, "balances");
+    asset_on_update(user_id, stock, balances ? json_object_get(balances, stock) : NULL);
+    asset_on_update(user_id, money, balances ? json_object_get(balances, money) : NULL);
     order_on_update(user_id, event, order);
 
     return 0;
@@ -57,7 +60,7 @@ static int process_balances_message(json_t *msg)
         return -__LINE__;
     }
 
-    asset_on_update(user_id, asset);
+    asset_on_update(user_id, asset, json_array_get(msg, 5));
 
     return 0;
 }
@@ -79,6 +82,23 @@ static void on_balances_message(sds message, int64_t offset)
     json_decref(msg);
 }
 
+static void on_depth_message(sds message, int64_t offset)
+{
+    log_trace("depth message: %s", message);
+    json_t *msg = json_loads(message, 0, NULL);
+    if (!msg) {
+        log_error("invalid depth message: %s", message);
+        return;
+    }
+
+    int ret = depth_on_update(msg);
+    if (ret < 0) {
+        log_error("depth_on_update: %s fail: %d", message, ret);
+    }
+
+    json_decref(msg);
+}
+
 int init_message(void)
 {
     settings.orders.offset = RD_KAFKA_OFFSET_END;
@@ -93,6 +113,14 @@ int init_message(void)
         return -__LINE__;
     }
 
+    if (settings.depth.topic) {
+        settings.depth.offset = RD_KAFKA_OFFSET_END;
+        kafka_depth = kafka_consumer_create(&settings.depth, on_depth_message);
+        if (kafka_depth == NULL) {
+            return -__LINE__;
+        }
+    }
+
     return 0;
 }
 
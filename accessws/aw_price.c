@@ -6,6 +6,7 @@
 # include "aw_config.h"
 # include "aw_price.h"
 # include "aw_server.h"
+# include "aw_cache.h"
 
 static nw_timer timer;
 static dict_t *dict_market;
@@ -19,6 +20,7 @@ struct state_data {
 struct market_val {
     dict_t *sessions;
     mpd_t  *last;
+    uint64_t cache_version;
 };
 
 static uint32_t dict_ses_hash_func(const void *key)
@@ -96,13 +98,21 @@ static int on_market_last_reply(struct state_data *state, json_t *result)
         json_array_append_new(params, json_string(state->market));
         json_array_append(params, result);
 
-        dict_iterator *iter = dict_get_iterator(obj->sessions);
-        dict_entry *entry;
-        while ((entry = dict_next(iter)) != NULL) {
-            send_notify(entry->key, "price.update", params);
-        }
-        dict_release_iterator(iter);
+        notify_message *notify = notify_message_create("price.update", params);
         json_decref(params);
+        if (notify) {
+            char channel[MARKET_NAME_MAX_LEN + 10];
+            snprintf(channel, sizeof(channel), "price.%s", state->market);
+            dict_iterator *iter = dict_get_iterator(obj->sessions);
+            dict_entry *entry;
+            while ((entry = dict_next(iter)) != NULL) {
+                ws_message *message = notify_message_get(notify, entry->key);
+                if (message)
+                    ws_send_message_latest(entry->key, channel, message, message);
+            }
+            dict_release_iterator(iter);
+            notify_message_release(notify);
+        }
     }
 
     mpd_del(last);
@@ -111,7 +121,7 @@ static int on_market_last_reply(struct state_data *state, json_t *result)
 
 static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    sds reply_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds reply_str = rpc_body_str(pkg);
     log_trace("recv pkg from: %s, cmd: %u, sequence: %u, reply: %s",
             nw_sock_human_addr(&ses->peer_addr), pkg->command, pkg->sequence, reply_str);
     nw_state_entry *entry = nw_state_get(state_context, pkg->sequence);
@@ -121,7 +131,7 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
     struct state_data *state = entry->data;
 
-    json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *reply = rpc_body_decode(pkg);
     if (reply == NULL) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_fatal("invalid reply from: %s, cmd: %u, reply: \n%s", nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
@@ -172,7 +182,7 @@ static void on_timer(nw_timer *timer, void *privdata)
     dict_iterator *iter = dict_get_iterator(dict_market);
     dict_entry *entry;
     while ((entry = dict_next(iter)) != NULL) {
-        const struct market_val *obj = entry->val;
+        struct market_val *obj = entry->val;
         if (dict_size(obj->sessions) == 0) {
             dict_delete(dict_market, entry->key);
             continue;
@@ -182,6 +192,22 @@ static void on_timer(nw_timer *timer, void *privdata)
         json_t *params = json_array();
         json_array_append_new(params, json_string(market));
 
+        json_t *result;
+        if (cache_get(CMD_MARKET_LAST, params, &obj->cache_version, &result) > 0) {
+            if (result) {
+                struct state_data state;
+                memset(&state, 0, sizeof(state));
+                strncpy(state.market, market, MARKET_NAME_MAX_LEN - 1);
+                int ret = on_market_last_reply(&state, result);
+                if (ret < 0) {
+                    log_error("on_market_last_reply: %d", ret);
+                }
+                json_decref(result);
+            }
+            json_decref(params);
+            continue;
+        }
+
         nw_state_entry *state_entry = nw_state_add(state_context, settings.backend_timeout, 0);
         struct state_data *state = state_entry->data;
         strncpy(state->market, market, MARKET_NAME_MAX_LEN - 1);
@@ -191,12 +217,11 @@ static void on_timer(nw_timer *timer, void *privdata)
         pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
         pkg.command   = CMD_MARKET_LAST;
         pkg.sequence  = state_entry->id;
-        pkg.body      = json_dumps(params, 0);
-        pkg.body_size = strlen(pkg.body);
+        rpc_params_encode(&pkg, params, rpc_clt_encoding(marketprice));
 
         rpc_clt_send(marketprice, &pkg);
-        log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
-                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, (char *)pkg.body);
+        log_trace("send request to %s, cmd: %u, sequence: %u, encoding: %d, body size: %u",
+                nw_sock_human_addr(rpc_clt_peer_addr(marketprice)), pkg.command, pkg.sequence, rpc_pkg_encoding(&pkg), pkg.body_size);
         free(pkg.body);
         json_decref(params);
     }
@@ -297,7 +322,9 @@ int price_send_last(nw_ses *ses, const char *market)
     json_t *params = json_array();
     json_array_append_new(params, json_string(market));
     json_array_append_new_mpd(params, obj->last);
-    send_notify(ses, "price.update", params);
+    char channel[MARKET_NAME_MAX_LEN + 10];
+    snprintf(channel, sizeof(channel), "price.%s", market);
+    send_notify_latest(ses, channel, "price.update", params);
     json_decref(params);
 
     return 0;
@@ -23,6 +23,7 @@ static rpc_clt *listener;
 static nw_state *state_context;
 static nw_cache *privdata_cache;
 static nw_timer cache_timer;
+static nw_timer status_timer;
 
 static rpc_clt *matchengine;
 static rpc_clt *marketprice;
@@ -35,9 +36,10 @@ struct state_data {
     sds         cache_key;
 };
 
+/* the reply up to the id, compressed once for every hit */
 struct cache_val {
     double      time;
-    json_t      *result;
+    deflate_head *head;
 };
 
 typedef int (*on_request_method)(nw_ses *ses, uint64_t id, struct clt_info *info, json_t *params);
@@ -124,8 +126,25 @@ int send_success(nw_ses *ses, uint64_t id)
     return ret;
 }
 
+/* market data with a binary form goes binary to sessions asking for it */
+static int send_notify_binary(nw_ses *ses, const char *method, json_t *params)
+{
+    size_t size;
+    char *data = market_bin_encode(method, params, &size);
+    if (data == NULL)
+        return -__LINE__;
+    log_trace("send to: %"PRIu64", size: %zu, binary: %s", ses->id, size, method);
+    int ret = ws_send_binary(ses, data, size);
+    free(data);
+    return ret;
+}
+
 int send_notify(nw_ses *ses, const char *method, json_t *params)
 {
+    struct clt_info *info = ws_ses_privdata(ses);
+    if (info->binary && send_notify_binary(ses, method, params) == 0)
+        return 0;
+
     json_t *notify = json_object();
     json_object_set_new(notify, "method", json_string(method));
     json_object_set    (notify, "params", params);
@@ -137,6 +156,86 @@ int send_notify(nw_ses *ses, const char *method, json_t *params)
     return ret;
 }
 
+ws_message *create_notify_message(const char *method, json_t *params)
+{
+    json_t *notify = json_object();
+    json_object_set_new(notify, "method", json_string(method));
+    json_object_set    (notify, "params", params);
+    json_object_set_new(notify, "id", json_null());
+
+    char *data = json_dumps(notify, 0);
+    json_decref(notify);
+    if (data == NULL)
+        return NULL;
+    ws_message *message = ws_message_create(data, strlen(data), false);
+    free(data);
+
+    return message;
+}
+
+int send_notify_latest(nw_ses *ses, const char *channel, const char *method, json_t *params)
+{
+    notify_message *notify = notify_message_create(method, params);
+    if (notify == NULL)
+        return -__LINE__;
+    ws_message *message = notify_message_get(notify, ses);
+    int ret = message ? ws_send_message_latest(ses, channel, message, message) : -__LINE__;
+    notify_message_release(notify);
+
+    return ret;
+}
+
+notify_message *notify_message_create(const char *method, json_t *params)
+{
+    notify_message *notify = malloc(sizeof(notify_message));
+    if (notify == NULL)
+        return NULL;
+    memset(notify, 0, sizeof(notify_message));
+    notify->method = strdup(method);
+    if (notify->method == NULL) {
+        free(notify);
+        return NULL;
+    }
+    notify->params = json_incref(params);
+
+    return notify;
+}
+
+/* json text if the binary form fails, a value it can not carry */
+ws_message *notify_message_get(notify_message *notify, nw_ses *ses)
+{
+    struct clt_info *info = ws_ses_privdata(ses);
+    if (info->binary && !notify->binary_fail) {
+        if (notify->binary == NULL) {
+            size_t size;
+            char *data = market_bin_encode(notify->method, notify->params, &size);
+            if (data) {
+                notify->binary = ws_message_create(data, size, true);
+                free(data);
+            }
+            if (notify->binary == NULL)
+                notify->binary_fail = true;
+        }
+        if (notify->binary)
+            return notify->binary;
+    }
+
+    if (notify->text == NULL)
+        notify->text = create_notify_message(notify->method, notify->params);
+    return notify->text;
+}
+
+void notify_message_release(notify_message *notify)
+{
+    if (notify->text)
+        ws_message_release(notify->text);
+    if (notify->binary)
+        ws_message_release(notify->binary);
+    json_decref(notify->params);
+    free(notify->method);
+    free(notify);
+}
+
 static int on_method_server_ping(nw_ses *ses, uint64_t id, struct clt_info *info, json_t *params)
 {
     json_t *result = json_string("pong");
@@ -176,7 +275,9 @@ static int process_cache(nw_ses *ses, uint64_t id, sds key)
         return 0;
     }
 
-    send_result(ses, id, cache->result);
+    char tail[64];
+    int tail_len = snprintf(tail, sizeof(tail), ", \"id\": %"PRIu64"}", id);
+    ws_send_text_head(ses, cache->head, tail, tail_len);
     return 1;
 }
 
@@ -621,6 +722,52 @@ static int on_method_order_query(nw_ses *ses, uint64_t id, struct clt_info *info
     return 0;
 }
 
+static int on_method_order_query_all(nw_ses *ses, uint64_t id, struct clt_info *info, json_t *params)
+{
+    if (!rpc_clt_connected(matchengine))
+        return send_error_internal_error(ses, id);
+
+    if (!info->auth)
+        return send_error_require_auth(ses, id);
+    if (json_array_size(params) != 2)
+        return send_error_invalid_argument(ses, id);
+
+    if (!json_is_integer(json_array_get(params, 0)))
+        return send_error_invalid_argument(ses, id);
+    int offset = json_integer_value(json_array_get(params, 0));
+    if (!json_is_integer(json_array_get(params, 1)))
+        return send_error_invalid_argument(ses, id);
+    int limit = json_integer_value(json_array_get(params, 1));
+
+    json_t *trade_params = json_array();
+    json_array_append_new(trade_params, json_integer(info->user_id));
+    json_array_append_new(trade_params, json_integer(offset));
+    json_array_append_new(trade_params, json_integer(limit));
+
+    nw_state_entry *entry = nw_state_add(state_context, settings.backend_timeout, 0);
+    struct state_data *state = entry->data;
+    state->ses = ses;
+    state->ses_id = ses->id;
+    state->request_id = id;
+
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.pkg_type  = RPC_PKG_TYPE_REQUEST;
+    pkg.command   = CMD_ORDER_QUERY_ALL;
+    pkg.sequence  = entry->id;
+    pkg.req_id    = id;
+    pkg.body      = json_dumps(trade_params, 0);
+    pkg.body_size = strlen(pkg.body);
+
+    rpc_clt_send(matchengine, &pkg);
+    log_trace("send request to %s, cmd: %u, sequence: %u, params: %s",
+            nw_sock_human_addr(rpc_clt_peer_addr(matchengine)), pkg.command, pkg.sequence, (char *)pkg.body);
+    free(pkg.body);
+    json_decref(trade_params);
+
+    return 0;
+}
+
 static int on_method_order_history(nw_ses *ses, uint64_t id, struct clt_info *info, json_t *params)
 {
     if (!rpc_clt_connected(readhistory))
@@ -844,6 +991,9 @@ static void on_upgrade(nw_ses *ses, const char *remote)
     log_trace("remote: %"PRIu64":%s upgrade to websocket", ses->id, remote);
     struct clt_info *info = ws_ses_privdata(ses);
     memset(info, 0, sizeof(struct clt_info));
+    const char *protocol = ws_ses_protocol(ses);
+    if (protocol && strcmp(protocol, BINARY_PROTOCOL) == 0)
+        info->binary = true;
 }
 
 static void on_close(nw_ses *ses, const char *remote)
@@ -919,6 +1069,13 @@ static void on_release(nw_state_entry *entry)
         sdsfree(state->cache_key);
 }
 
+static void on_status_timer(nw_timer *timer, void *privdata)
+{
+    nw_buf_pool *pool = svr->raw_svr->buf_pool;
+    log_info("connections: %u, buf mem total: %"PRIu64", used: %"PRIu64", peak: %"PRIu64,
+            svr->raw_svr->clt_count, pool->mem_total, pool->mem_used, pool->mem_peak);
+}
+
 static int init_svr(void)
 {
     ws_svr_type type;
@@ -987,6 +1144,7 @@ static int init_svr(void)
     ERR_RET_LN(add_handler("deals.unsubscribe", on_method_deals_unsubscribe));
 
     ERR_RET_LN(add_handler("order.query",       on_method_order_query));
+    ERR_RET_LN(add_handler("order.query_all",   on_method_order_query_all));
     ERR_RET_LN(add_handler("order.history",     on_method_order_history));
     ERR_RET_LN(add_handler("order.subscribe",   on_method_order_subscribe));
     ERR_RET_LN(add_handler("order.unsubscribe", on_method_order_unsubscribe));
@@ -996,6 +1154,9 @@ static int init_svr(void)
     ERR_RET_LN(add_handler("asset.subscribe",   on_method_asset_subscribe));
     ERR_RET_LN(add_handler("asset.unsubscribe", on_method_asset_unsubscribe));
 
+    nw_timer_set(&status_timer, 60, true, on_status_timer, NULL);
+    nw_timer_start(&status_timer);
+
     return 0;
 }
 
@@ -1028,12 +1189,15 @@ static void on_backend_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
         json_t *reply = json_loadb(pkg->body, pkg->body_size, 0, NULL);
         if (reply && json_is_object(reply)) {
             json_t *result = json_object_get(reply, "result");
-            if (result && !json_is_null(result)) {
+            char *result_str = result && !json_is_null(result) ? json_dumps(result, JSON_ENCODE_ANY) : NULL;
+            if (result_str) {
+                sds plain = sdscatprintf(sdsempty(), "{\"error\": null, \"result\": %s", result_str);
                 struct cache_val val;
                 val.time = current_timestamp();
-                val.result = result;
-                json_incref(result);
+                val.head = deflate_head_create(plain, sdslen(plain), settings.svr.deflate_level);
                 dict_replace(backend_cache, state->cache_key, &val);
+                sdsfree(plain);
+                free(result_str);
             }
         }
         if (reply) {
@@ -1073,7 +1237,7 @@ static void *cache_dict_val_dup(const void *val)
 static void cache_dict_val_free(void *val)
 {
     struct cache_val *obj = val;
-    json_decref(obj->result);
+    deflate_head_release(obj->head);
     free(val);
 }
 
@@ -1179,7 +1343,12 @@ int init_server(void)
 {
     ERR_RET(init_svr());
     ERR_RET(init_backend());
-    ERR_RET(init_listener_clt());
+    if (settings.svr.reuse_port) {
+        if (ws_svr_start(svr) < 0)
+            return -__LINE__;
+    } else {
+        ERR_RET(init_listener_clt());
+    }
 
     return 0;
 }
@@ -8,12 +8,27 @@
 
 # include "aw_config.h"
 
+/* subprotocol for depth, deals, kline and price updates in binary frames,
+ * see ut_market_bin.h. everything else stays json text */
+# define BINARY_PROTOCOL "market.bin"
+
 struct clt_info {
     bool        auth;
+    bool        binary;
     uint32_t    user_id;
     char        *source;
 };
 
+/* a broadcast notify, the json text and the binary frame are each made
+ * once, on first use by a session that takes them */
+typedef struct notify_message {
+    char        *method;
+    json_t      *params;
+    ws_message  *text;
+    ws_message  *binary;
+    bool        binary_fail;
+} notify_message;
+
 int init_server(void);
 
 int send_error(nw_ses *ses, uint64_t id, int code, const char *message);
@@ -25,6 +40,16 @@ int send_error_service_timeout(nw_ses *ses, uint64_t id);
 int send_result(nw_ses *ses, uint64_t id, json_t *result);
 int send_success(nw_ses *ses, uint64_t id);
 int send_notify(nw_ses *ses, const char *method, json_t *params);
+/* a notify encoded and framed once, broadcasts send it with ws_send_message */
+ws_message *create_notify_message(const char *method, json_t *params);
+/* a notify that replaces one of the same channel still queued for a slow
+ * session, for market data where only the latest matters */
+int send_notify_latest(nw_ses *ses, const char *channel, const char *method, json_t *params);
+
+notify_message *notify_message_create(const char *method, json_t *params);
+/* the frame for ses, NULL if it can not be made */
+ws_message *notify_message_get(notify_message *notify, nw_ses *ses);
+void notify_message_release(notify_message *notify);
 
 # endif
 
@@ -31,11 +31,14 @@
 # include "ut_signal.h"
 # include "ut_config.h"
 # include "ut_define.h"
+# include "ut_params.h"
 # include "ut_decimal.h"
 # include "ut_rpc_clt.h"
 # include "ut_rpc_svr.h"
 # include "ut_rpc_cmd.h"
 
+# define MARKET_NAME_MAX_LEN    31
+
 struct settings {
     bool                debug;
     process_cfg         process;
@@ -18,23 +18,18 @@ struct cache_val {
 
 static int reply_json(nw_ses *ses, rpc_pkg *pkg, const json_t *json)
 {
-    char *message_data;
-    if (settings.debug) {
-        message_data = json_dumps(json, JSON_INDENT(4));
-    } else {
-        message_data = json_dumps(json, 0);
-    }
-    if (message_data == NULL)
-        return -__LINE__;
-    log_trace("connection: %s send: %s", nw_sock_human_addr(&ses->peer_addr), message_data);
-
     rpc_pkg reply;
     memcpy(&reply, pkg, sizeof(reply));
     reply.pkg_type = RPC_PKG_TYPE_REPLY;
-    reply.body = message_data;
-    reply.body_size = strlen(message_data);
+    if (rpc_body_encode(&reply, json, rpc_pkg_encoding(pkg), settings.debug ? JSON_INDENT(4) : 0) < 0)
+        return -__LINE__;
+    if (reply.ext_size == 0) {
+        log_trace("connection: %s send: %.*s", nw_sock_human_addr(&ses->peer_addr), (int)reply.body_size, (char *)reply.body);
+    } else {
+        log_trace("connection: %s send: (binary %u bytes)", nw_sock_human_addr(&ses->peer_addr), reply.body_size);
+    }
     rpc_send(ses, &reply);
-    free(message_data);
+    free(reply.body);
 
     return 0;
 }
@@ -114,18 +109,20 @@ static int add_cache(sds cache_key, json_t *result)
     return 0;
 }
 
-static int on_cmd_market_status(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_market_status(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 2)
+    if (params_size(params) != 2)
         return reply_error_invalid_argument(ses, pkg);
 
-    const char *market = json_string_value(json_array_get(params, 0));
-    if (!market)
+    char market[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market, sizeof(market)) < 0)
         return reply_error_invalid_argument(ses, pkg);
     if (!market_exist(market))
         return reply_error_invalid_argument(ses, pkg);
 
-    int period = json_integer_value(json_array_get(params, 1));
+    int64_t period;
+    if (params_get_int(params, 1, &period) < 0)
+        return reply_error_invalid_argument(ses, pkg);
     if (period <= 0 || period > settings.sec_max)
         return reply_error_invalid_argument(ses, pkg);
 
@@ -147,29 +144,35 @@ static int on_cmd_market_status(nw_ses *ses, rpc_pkg *pkg, json_t *params)
     return ret;
 }
 
-static int on_cmd_market_kline(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_market_kline(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 4)
+    if (params_size(params) != 4)
         return reply_error_invalid_argument(ses, pkg);
 
-    const char *market = json_string_value(json_array_get(params, 0));
-    if (!market)
+    char market[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market, sizeof(market)) < 0)
         return reply_error_invalid_argument(ses, pkg);
     if (!market_exist(market))
         return reply_error_invalid_argument(ses, pkg);
 
-    time_t start = json_integer_value(json_array_get(params, 1));
+    int64_t start;
+    if (params_get_int(params, 1, &start) < 0)
+        return reply_error_invalid_argument(ses, pkg);
     if (start <= 0)
         return reply_error_invalid_argument(ses, pkg);
 
-    time_t end = json_integer_value(json_array_get(params, 2));
+    int64_t end;
+    if (params_get_int(params, 2, &end) < 0)
+        return reply_error_invalid_argument(ses, pkg);
     time_t now = time(NULL);
     if (end > now)
         end = now;
     if (end <= 0 || start > end)
         return reply_error_invalid_argument(ses, pkg);
 
-    int interval = json_integer_value(json_array_get(params, 3));
+    int64_t interval;
+    if (params_get_int(params, 3, &interval) < 0)
+        return reply_error_invalid_argument(ses, pkg);
     if (interval <= 0)
         return reply_error_invalid_argument(ses, pkg);
 
@@ -224,24 +227,26 @@ static int on_cmd_market_kline(nw_ses *ses, rpc_pkg *pkg, json_t *params)
     return ret;
 }
 
-static int on_cmd_market_deals(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_market_deals(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 3)
+    if (params_size(params) != 3)
         return reply_error_invalid_argument(ses, pkg);
 
-    const char *market = json_string_value(json_array_get(params, 0));
-    if (!market)
+    char market[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market, sizeof(market)) < 0)
         return reply_error_invalid_argument(ses, pkg);
     if (!market_exist(market))
         return reply_error_invalid_argument(ses, pkg);
 
-    int limit = json_integer_value(json_array_get(params, 1));
+    int64_t limit;
+    if (params_get_int(params, 1, &limit) < 0)
+        return reply_error_invalid_argument(ses, pkg);
     if (limit <= 0 || limit > MARKET_DEALS_MAX)
         return reply_error_invalid_argument(ses, pkg);
 
-    if (!json_is_integer(json_array_get(params, 2)))
+    int64_t last_id;
+    if (params_get_int(params, 2, &last_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint64_t last_id = json_integer_value(json_array_get(params, 2));
 
     json_t *result = get_market_deals(market, limit, last_id);
     if (result == NULL)
@@ -252,13 +257,13 @@ static int on_cmd_market_deals(nw_ses *ses, rpc_pkg *pkg, json_t *params)
     return ret;
 }
 
-static int on_cmd_market_last(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_market_last(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 1)
+    if (params_size(params) != 1)
         return reply_error_invalid_argument(ses, pkg);
 
-    const char *market = json_string_value(json_array_get(params, 0));
-    if (!market)
+    char market[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market, sizeof(market)) < 0)
         return reply_error_invalid_argument(ses, pkg);
     if (!market_exist(market))
         return reply_error_invalid_argument(ses, pkg);
@@ -276,13 +281,13 @@ static int on_cmd_market_last(nw_ses *ses, rpc_pkg *pkg, json_t *params)
     return ret;
 }
 
-static int on_cmd_market_status_today(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_market_status_today(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 1)
+    if (params_size(params) != 1)
         return reply_error_invalid_argument(ses, pkg);
 
-    const char *market = json_string_value(json_array_get(params, 0));
-    if (!market)
+    char market[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market, sizeof(market)) < 0)
         return reply_error_invalid_argument(ses, pkg);
     if (!market_exist(market))
         return reply_error_invalid_argument(ses, pkg);
@@ -307,45 +312,51 @@ static int on_cmd_market_status_today(nw_ses *ses, rpc_pkg *pkg, json_t *params)
 
 static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    json_t *params = json_loadb(pkg->body, pkg->body_size, 0, NULL);
-    if (params == NULL || !json_is_array(params)) {
-        goto decode_error;
+    /* json bodies are parsed in place, binary ones by the field table */
+    params_t args;
+    if (rpc_params_decode(&args, pkg) < 0) {
+        sds hex = hexdump(pkg->body, pkg->body_size);
+        log_error("connection: %s, cmd: %u decode params fail, params data: \n%s", \
+                nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
+        sdsfree(hex);
+        rpc_svr_close_clt(svr, ses);
+        return;
     }
-    sds params_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds params_str = rpc_body_str(pkg);
 
     int ret;
     switch (pkg->command) {
     case CMD_MARKET_STATUS:
         log_debug("from: %s cmd market status, squence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_market_status(ses, pkg, params);
+        ret = on_cmd_market_status(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_market_status %s fail: %d", params_str, ret);
         }
         break;
     case CMD_MARKET_KLINE:
         log_debug("from: %s cmd market kline, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_market_kline(ses, pkg, params);
+        ret = on_cmd_market_kline(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_market_kline %s fail: %d", params_str, ret);
         }
         break;
     case CMD_MARKET_DEALS:
         log_debug("from: %s cmd market deals, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_market_deals(ses, pkg, params);
+        ret = on_cmd_market_deals(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_market_deals %s fail: %d", params_str, ret);
         }
         break;
     case CMD_MARKET_LAST:
         log_debug("from: %s cmd market last, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_market_last(ses, pkg, params);
+        ret = on_cmd_market_last(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_market_last %s fail: %d", params_str, ret);
         }
         break;
     case CMD_MARKET_STATUS_TODAY:
         log_debug("from: %s cmd market today status, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_market_status_today(ses, pkg, params);
+        ret = on_cmd_market_status_today(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_market_status_today %s fail: %d", params_str, ret);
         }
@@ -356,19 +367,6 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     }
 
     sdsfree(params_str);
-    json_decref(params);
-    return;
-
-decode_error:
-    if (params) {
-        json_decref(params);
-    }
-    sds hex = hexdump(pkg->body, pkg->body_size);
-    log_error("connection: %s, cmd: %u decode params fail, params data: \n%s", \
-            nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
-    sdsfree(hex);
-    rpc_svr_close_clt(svr, ses);
-
     return;
 }
 
@@ -567,6 +567,58 @@ mpd_t *balance_total(uint32_t user_id, const char *asset)
     return balance;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: json_t *balance_get_info(uint32_t user_id, const char *asset, mpd_t *unfreeze)
+
+PURPOSE: 
+    读取用户单个币种的可用与冻结余额，按显示精度格式化
+
+PARAMETERS:
+    user_id  - 
+    asset    - coin name
+    unfreeze - 尚未执行的解冻数量，负数为尚未执行的冻结，NULL表示没有
+
+RETURN VALUE: 
+    {"available": "...", "freeze": "..."}
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    balance.query的返回与orders/balances消息中携带的余额都由此生成
+    委单挂入或结束时消息先于冻结/解冻发出，通过unfreeze给出变动后的余额
+---------------------------------------------------------------------------*/
+json_t *balance_get_info(uint32_t user_id, const char *asset, mpd_t *unfreeze)
+{
+    mpd_t *available = mpd_new(&mpd_ctx);
+    mpd_t *freeze = mpd_new(&mpd_ctx);
+    mpd_t *value = balance_get(user_id, BALANCE_TYPE_AVAILABLE, asset);
+    mpd_copy(available, value ? value : mpd_zero, &mpd_ctx);
+    value = balance_get(user_id, BALANCE_TYPE_FREEZE, asset);
+    mpd_copy(freeze, value ? value : mpd_zero, &mpd_ctx);
+    if (unfreeze) {
+        mpd_add(available, available, unfreeze, &mpd_ctx);
+        mpd_sub(freeze, freeze, unfreeze, &mpd_ctx);
+    }
+
+    int prec_show = asset_prec_show(asset);
+    if (prec_show != asset_prec(asset)) {
+        mpd_rescale(available, available, -prec_show, &mpd_ctx);
+        mpd_rescale(freeze, freeze, -prec_show, &mpd_ctx);
+    }
+
+    json_t *info = json_object();
+    json_object_set_new_mpd(info, "available", available);
+    json_object_set_new_mpd(info, "freeze", freeze);
+    mpd_del(available);
+    mpd_del(freeze);
+
+    return info;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int balance_status(const char *asset, mpd_t *total, size_t *available_count, mpd_t *available, size_t *freeze_count, mpd_t *freeze)
 
@@ -34,6 +34,7 @@ mpd_t *balance_freeze(uint32_t user_id, const char *asset, mpd_t *amount);
 mpd_t *balance_unfreeze(uint32_t user_id, const char *asset, mpd_t *amount);
 
 mpd_t *balance_total(uint32_t user_id, const char *asset);
+json_t *balance_get_info(uint32_t user_id, const char *asset, mpd_t *unfreeze);
 int balance_status(const char *asset, mpd_t *total, size_t *available_count, mpd_t *available, size_t *freeze_count, mpd_t *freeze);
 
 # endif
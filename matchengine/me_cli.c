@@ -10,6 +10,8 @@
 # include "me_trade.h"
 # include "me_persist.h"
 # include "me_operlog.h"
+# include "me_expire.h"
+# include "me_stats.h"
 # include "me_history.h"
 # include "me_message.h"
 
@@ -52,6 +54,7 @@ static sds on_cmd_status(const char *cmd, int argc, sds *argv)
     reply = operlog_status(reply);
     reply = history_status(reply);
     reply = message_status(reply);
+    reply = expire_status(reply);
     return reply;
 }
 
@@ -361,6 +364,38 @@ static sds on_cmd_makeslice(const char *cmd, int argc, sds *argv)
     return sdsnew("OK\n");
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static sds on_cmd_stats(const char *cmd, int argc, sds *argv)
+
+PURPOSE: 
+    查询计数器和每个rpc命令的排队、处理、响应延迟分位数
+
+PARAMETERS:
+    cmd  - 
+    argc - 
+    argv - 
+
+RETURN VALUE: 
+    统计信息
+
+EXCEPTION: 
+    None
+
+EXAMPLE CALL:
+    
+REMARKS: 
+    stats        查询
+    stats reset  查询后重新开始统计
+---------------------------------------------------------------------------*/
+static sds on_cmd_stats(const char *cmd, int argc, sds *argv)
+{
+    sds reply = stats_status(sdsempty());
+    if (argc == 1 && strcmp(argv[0], "reset") == 0) {
+        stats_reset();
+    }
+    return reply;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int init_cli(void)
 
@@ -398,6 +433,7 @@ int init_cli(void)
     cli_svr_add_cmd(svr, "balance", on_cmd_balance);
     cli_svr_add_cmd(svr, "market",  on_cmd_market);
     cli_svr_add_cmd(svr, "makeslice", on_cmd_makeslice);
+    cli_svr_add_cmd(svr, "stats", on_cmd_stats);
 
     return 0;
 }
@@ -220,6 +220,7 @@ static int read_config_from_json(json_t *root)
     }
 
     ERR_RET_LN(read_cfg_real(root, "cache_timeout", &settings.cache_timeout, false, 0.45));
+    ERR_RET_LN(read_cfg_int(root, "stats_interval", &settings.stats_interval, false, 60));
 
     return 0;
 }
@@ -31,6 +31,7 @@
 # include "ut_signal.h"
 # include "ut_define.h"
 # include "ut_config.h"
+# include "ut_params.h"
 # include "ut_decimal.h"
 # include "ut_rpc_clt.h"
 # include "ut_rpc_svr.h"
@@ -38,10 +39,12 @@
 # include "ut_skiplist.h"
 
 # define ASSET_NAME_MAX_LEN     15
+# define MARKET_NAME_MAX_LEN    31
 # define BUSINESS_NAME_MAX_LEN  31
 # define SOURCE_MAX_LEN         31
 
 # define ORDER_BOOK_MAX_LEN     101
+# define ORDER_LEVELS_MAX_LEN   10000
 # define ORDER_LIST_MAX_LEN     101
 
 # define MAX_PENDING_OPERLOG    100
@@ -85,6 +88,7 @@ struct settings {
     int                 slice_keeptime;
     int                 history_thread;
     double              cache_timeout;
+    int                 stats_interval;
 };
 
 extern struct settings settings;
@@ -83,7 +83,7 @@ static int dump_orders_list(MYSQL *conn, const char *table, skiplist_t *list)
         order_t *order = node->value;
         if (index == 0) {
             sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `t`, `side`, `create_time`, `update_time`, `user_id`, `market`, "
-                    "`price`, `amount`, `taker_fee`, `maker_fee`, `left`, `freeze`, `deal_stock`, `deal_money`, `deal_fee`) VALUES ", table);
+                    "`price`, `amount`, `taker_fee`, `maker_fee`, `left`, `freeze`, `deal_stock`, `deal_money`, `deal_fee`, `expire_time`) VALUES ", table);
         } else {
             sql = sdscatprintf(sql, ", ");
         }
@@ -98,8 +98,8 @@ static int dump_orders_list(MYSQL *conn, const char *table, skiplist_t *list)
         sql = sql_append_mpd(sql, order->freeze, true);
         sql = sql_append_mpd(sql, order->deal_stock, true);
         sql = sql_append_mpd(sql, order->deal_money, true);
-        sql = sql_append_mpd(sql, order->deal_fee, false);
-        sql = sdscatprintf(sql, ")");
+        sql = sql_append_mpd(sql, order->deal_fee, true);
+        sql = sdscatprintf(sql, "%f)", order->expire_time);
 
         index += 1;
         if (index == insert_limit) {
@@ -158,6 +158,7 @@ EXAMPLE CALL:
 
 REMARKS: 
     把未成交的深度委单列表，写入数据库做持久化存储。
+    slice_order_example没有expire_time列时(未执行sql/upgrade_trade_log.sql)，给快照表加上该列
     注意，这里并没有与撮合过程做互斥，get_market()得到的market也没有做保护，存在冲突问题
 ---------------------------------------------------------------------------*/
 int dump_orders(MYSQL *conn, const char *table)
@@ -181,6 +182,20 @@ int dump_orders(MYSQL *conn, const char *table)
         sdsfree(sql);
         return -__LINE__;
     }
+    sdsclear(sql);
+
+    /* slice_order_example of a trade_log not yet upgraded, see sql/upgrade_trade_log.sql */
+    if (!is_column_exists(conn, table, "expire_time")) {
+        log_error("table: %s has no expire_time, add it", table);
+        sql = sdscatprintf(sql, "ALTER TABLE `%s` ADD COLUMN `expire_time` DOUBLE NOT NULL DEFAULT 0", table);
+        log_trace("exec sql: %s", sql);
+        ret = mysql_real_query(conn, sql, sdslen(sql));
+        if (ret != 0) {
+            log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+            sdsfree(sql);
+            return -__LINE__;
+        }
+    }
     sdsfree(sql);
 
     for (int i = 0; i < settings.market_num; ++i) {
@@ -204,6 +219,223 @@ int dump_orders(MYSQL *conn, const char *table)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static int dump_stops_list(MYSQL *conn, const char *table, skiplist_t *list)
+
+PURPOSE: 
+    输出止损单到mysql.trade_log.slice_stop_${time}
+
+PARAMETERS:
+    conn – MySQL数据链接
+    table - 表名，slice_stop_$timestamp 后缀时间戳参数
+    list - 止损单列表，当前货币对的stop_asks/stop_bids列表
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    同dump_orders_list()
+---------------------------------------------------------------------------*/
+static int dump_stops_list(MYSQL *conn, const char *table, skiplist_t *list)
+{
+    sds sql = sdsempty();
+
+    size_t insert_limit = 1000;
+    size_t index = 0;
+    skiplist_iter *iter = skiplist_get_iterator(list);
+    skiplist_node *node;
+    while ((node = skiplist_next(iter)) != NULL) {
+        stop_t *stop = node->value;
+        if (index == 0) {
+            sql = sdscatprintf(sql, "INSERT INTO `%s` (`id`, `t`, `side`, `create_time`, `user_id`, `market`, `source`, "
+                    "`stop_price`, `price`, `amount`, `taker_fee`, `maker_fee`) VALUES ", table);
+        } else {
+            sql = sdscatprintf(sql, ", ");
+        }
+
+        sql = sdscatprintf(sql, "(%"PRIu64", %u, %u, %f, %u, '%s', '%s', ",
+                stop->id, stop->type, stop->side, stop->create_time, stop->user_id, stop->market, stop->source);
+        sql = sql_append_mpd(sql, stop->stop_price, true);
+        sql = sql_append_mpd(sql, stop->price, true);
+        sql = sql_append_mpd(sql, stop->amount, true);
+        sql = sql_append_mpd(sql, stop->taker_fee, true);
+        sql = sql_append_mpd(sql, stop->maker_fee, false);
+        sql = sdscatprintf(sql, ")");
+
+        index += 1;
+        if (index == insert_limit) {
+            log_trace("exec sql: %s", sql);
+            int ret = mysql_real_query(conn, sql, sdslen(sql));
+            if (ret < 0) {
+                log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+                skiplist_release_iterator(iter);
+                sdsfree(sql);
+                return -__LINE__;
+            }
+            sdsclear(sql);
+            index = 0;
+        }
+    }
+    skiplist_release_iterator(iter);
+
+    if (index > 0) {
+        log_trace("exec sql: %s", sql);
+        int ret = mysql_real_query(conn, sql, sdslen(sql));
+        if (ret < 0) {
+            log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+            sdsfree(sql);
+            return -__LINE__;
+        }
+    }
+
+    sdsfree(sql);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int dump_stops(MYSQL *conn, const char *table)
+
+PURPOSE: 
+    执行止损单快照
+    创建快照数据表mysql.trade_log.slice_stop_${time}，并调用输出止损单接口
+
+PARAMETERS:
+    conn – MySQL数据链接
+    table - 表名，slice_stop_$timestamp 后缀时间戳参数
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    同dump_orders()
+---------------------------------------------------------------------------*/
+int dump_stops(MYSQL *conn, const char *table)
+{
+    sds sql = sdsempty();
+    sql = sdscatprintf(sql, "DROP TABLE IF EXISTS `%s`", table);
+    log_trace("exec sql: %s", sql);
+    int ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        sdsfree(sql);
+        return -__LINE__;
+    }
+    sdsclear(sql);
+
+    sql = sdscatprintf(sql, "CREATE TABLE IF NOT EXISTS `%s` LIKE `slice_stop_example`", table);
+    log_trace("exec sql: %s", sql);
+    ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        sdsfree(sql);
+        return -__LINE__;
+    }
+    sdsfree(sql);
+
+    for (int i = 0; i < settings.market_num; ++i) {
+        market_t *market = get_market(settings.markets[i].name);
+        if (market == NULL) {
+            return -__LINE__;
+        }
+        int ret;
+        ret = dump_stops_list(conn, table, market->stop_asks);
+        if (ret < 0) {
+            log_error("dump market: %s stop asks list fail: %d", market->name, ret);
+            return -__LINE__;
+        }
+        ret = dump_stops_list(conn, table, market->stop_bids);
+        if (ret < 0) {
+            log_error("dump market: %s stop bids list fail: %d", market->name, ret);
+            return -__LINE__;
+        }
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int dump_markets(MYSQL *conn, const char *table)
+
+PURPOSE: 
+    执行market快照
+    创建快照数据表mysql.trade_log.slice_market_${time}，保存各market的最新成交价
+
+PARAMETERS:
+    conn – MySQL数据链接
+    table - 表名，slice_market_$timestamp 后缀时间戳参数
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    重启之后止损单按恢复的最新成交价检查触发价，而不是0
+---------------------------------------------------------------------------*/
+int dump_markets(MYSQL *conn, const char *table)
+{
+    sds sql = sdsempty();
+    sql = sdscatprintf(sql, "DROP TABLE IF EXISTS `%s`", table);
+    log_trace("exec sql: %s", sql);
+    int ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        sdsfree(sql);
+        return -__LINE__;
+    }
+    sdsclear(sql);
+
+    sql = sdscatprintf(sql, "CREATE TABLE IF NOT EXISTS `%s` LIKE `slice_market_example`", table);
+    log_trace("exec sql: %s", sql);
+    ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        sdsfree(sql);
+        return -__LINE__;
+    }
+    sdsclear(sql);
+
+    sql = sdscatprintf(sql, "INSERT INTO `%s` (`market`, `last`) VALUES ", table);
+    for (int i = 0; i < settings.market_num; ++i) {
+        market_t *market = get_market(settings.markets[i].name);
+        if (market == NULL) {
+            sdsfree(sql);
+            return -__LINE__;
+        }
+        sql = sdscatprintf(sql, "%s('%s', ", i ? ", " : "", market->name);
+        sql = sql_append_mpd(sql, market->last, false);
+        sql = sdscatprintf(sql, ")");
+    }
+    if (settings.market_num > 0) {
+        log_trace("exec sql: %s", sql);
+        ret = mysql_real_query(conn, sql, sdslen(sql));
+        if (ret != 0) {
+            log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+            sdsfree(sql);
+            return -__LINE__;
+        }
+    }
+    sdsfree(sql);
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static int dump_balance_dict(MYSQL *conn, const char *table, dict_t *dict)
 
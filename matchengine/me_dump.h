@@ -9,6 +9,7 @@
 # include "ut_mysql.h"
 
 int dump_orders(MYSQL *conn, const char *table);
+int dump_stops(MYSQL *conn, const char *table);
 int dump_markets(MYSQL *conn, const char *table);
 int dump_balance(MYSQL *conn, const char *table);
 
@@ -0,0 +1,381 @@
+/*
+ * Description: 
+ *     History: agent, 2026/10/18, create
+ */
+
+# include "me_config.h"
+# include "me_expire.h"
+# include "me_market.h"
+# include "me_trade.h"
+# include "me_operlog.h"
+# include "me_history.h"
+# include "me_message.h"
+
+# define WHEEL_ROOT_BITS    8
+# define WHEEL_LEVEL_BITS   6
+# define WHEEL_LEVEL_NUM    3
+# define WHEEL_ROOT_SIZE    (1 << WHEEL_ROOT_BITS)
+# define WHEEL_LEVEL_SIZE   (1 << WHEEL_LEVEL_BITS)
+# define WHEEL_ROOT_MASK    (WHEEL_ROOT_SIZE - 1)
+# define WHEEL_LEVEL_MASK   (WHEEL_LEVEL_SIZE - 1)
+# define WHEEL_MAX_TICKS    (1ULL << (WHEEL_ROOT_BITS + WHEEL_LEVEL_NUM * WHEEL_LEVEL_BITS))
+
+/*---------------------------------------------------------------------------
+VARIABLE: static order_t *wheel_root[WHEEL_ROOT_SIZE];
+
+PURPOSE: 
+    时间轮第0层，每个槽位对应1秒，存放256秒内到期的委单
+
+REMARKS: 
+    每个槽位是以order_t->expire_prev/expire_next串联的双向链表
+---------------------------------------------------------------------------*/
+static order_t *wheel_root[WHEEL_ROOT_SIZE];
+
+/*---------------------------------------------------------------------------
+VARIABLE: static order_t *wheel_level[WHEEL_LEVEL_NUM][WHEEL_LEVEL_SIZE];
+
+PURPOSE: 
+    时间轮第1~3层，第n层每个槽位对应256*64^(n-1)秒
+
+REMARKS: 
+    低一层转完一圈时，把高一层当前槽位的委单重新分配到低层（cascade），
+    总共可以覆盖2^26秒（约2年），更远的到期时间先放在最高层，轮到时再重新分配
+---------------------------------------------------------------------------*/
+static order_t *wheel_level[WHEEL_LEVEL_NUM][WHEEL_LEVEL_SIZE];
+
+/*---------------------------------------------------------------------------
+VARIABLE: static uint64_t wheel_time;
+
+PURPOSE: 
+    时间轮下一个要处理的时刻（秒）
+
+REMARKS: 
+    第一次添加委单或启动定时器时，初始化为当前时间
+---------------------------------------------------------------------------*/
+static uint64_t wheel_time;
+
+static order_t *expired;
+static size_t expire_count;
+static uint64_t expire_total;
+static nw_timer timer;
+
+static void slot_add(order_t **slot, order_t *order)
+{
+    order->expire_slot = slot;
+    order->expire_prev = NULL;
+    order->expire_next = *slot;
+    if (*slot) {
+        (*slot)->expire_prev = order;
+    }
+    *slot = order;
+}
+
+static void wheel_add(order_t *order)
+{
+    uint64_t expires = (uint64_t)ceil(order->expire_time);
+    if (expires < wheel_time) {
+        expires = wheel_time;
+    }
+    uint64_t idx = expires - wheel_time;
+    if (idx >= WHEEL_MAX_TICKS) {
+        expires = wheel_time + WHEEL_MAX_TICKS - 1;
+        idx = WHEEL_MAX_TICKS - 1;
+    }
+
+    if (idx < WHEEL_ROOT_SIZE) {
+        slot_add(&wheel_root[expires & WHEEL_ROOT_MASK], order);
+        return;
+    }
+    for (int i = 0; i < WHEEL_LEVEL_NUM; ++i) {
+        int shift = WHEEL_ROOT_BITS + (i + 1) * WHEEL_LEVEL_BITS;
+        if (i == WHEEL_LEVEL_NUM - 1 || idx < (1ULL << shift)) {
+            shift -= WHEEL_LEVEL_BITS;
+            slot_add(&wheel_level[i][(expires >> shift) & WHEEL_LEVEL_MASK], order);
+            return;
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int wheel_cascade(int level, int index)
+
+PURPOSE: 
+    把高层槽位中的委单按到期时间重新分配到低层
+
+PARAMETERS:
+    level - 层号，0对应wheel_level[0]
+    index - 槽位
+
+RETURN VALUE: 
+    槽位index，为0时需要继续处理更高一层
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+---------------------------------------------------------------------------*/
+static int wheel_cascade(int level, int index)
+{
+    order_t *order = wheel_level[level][index];
+    wheel_level[level][index] = NULL;
+    while (order) {
+        order_t *next = order->expire_next;
+        wheel_add(order);
+        order = next;
+    }
+
+    return index;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static void wheel_run(uint64_t now)
+
+PURPOSE: 
+    推进时间轮到now，把到期的委单移动到expired链表
+
+PARAMETERS:
+    now - 当前时间（秒）
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    每次调用的代价为O(到期委单数 + 经过的秒数)，cascade的代价分摊到每个委单
+---------------------------------------------------------------------------*/
+static void wheel_run(uint64_t now)
+{
+    while (wheel_time <= now) {
+        int index = wheel_time & WHEEL_ROOT_MASK;
+        if (index == 0) {
+            for (int i = 0; i < WHEEL_LEVEL_NUM; ++i) {
+                int shift = WHEEL_ROOT_BITS + i * WHEEL_LEVEL_BITS;
+                if (wheel_cascade(i, (wheel_time >> shift) & WHEEL_LEVEL_MASK) != 0)
+                    break;
+            }
+        }
+
+        order_t *order = wheel_root[index];
+        wheel_root[index] = NULL;
+        while (order) {
+            order_t *next = order->expire_next;
+            slot_add(&expired, order);
+            order = next;
+        }
+
+        wheel_time++;
+    }
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: void expire_add(order_t *order)
+
+PURPOSE: 
+    把设置了到期时间的委单加入时间轮
+
+PARAMETERS:
+    order - 委单
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    order_put()中调用，包括从快照、operlog恢复的委单
+---------------------------------------------------------------------------*/
+void expire_add(order_t *order)
+{
+    if (order->expire_time <= 0)
+        return;
+    if (wheel_time == 0) {
+        wheel_time = time(NULL);
+    }
+
+    wheel_add(order);
+    expire_count += 1;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: void expire_del(order_t *order)
+
+PURPOSE: 
+    从时间轮中删除委单
+
+PARAMETERS:
+    order - 委单
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    order_finish()中调用，O(1)
+---------------------------------------------------------------------------*/
+void expire_del(order_t *order)
+{
+    if (order->expire_slot == NULL)
+        return;
+
+    if (order->expire_prev) {
+        order->expire_prev->expire_next = order->expire_next;
+    } else {
+        *order->expire_slot = order->expire_next;
+    }
+    if (order->expire_next) {
+        order->expire_next->expire_prev = order->expire_prev;
+    }
+    order->expire_slot = NULL;
+    order->expire_prev = NULL;
+    order->expire_next = NULL;
+    expire_count -= 1;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static void on_timer(nw_timer *timer, void *privdata)
+
+PURPOSE: 
+    到期委单定时器，批量撤销到期的委单
+
+PARAMETERS:
+    [in]timer - 
+    [in]privdata - 
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    每秒执行一次，本次到期的委单只写入一条operlog：
+    {"method": "expire_orders", "params": [[user_id, market, order_id], ...]}
+    history和kafka消息本身就是先缓存再批量写入的
+    operlog/history/message阻塞时跳过本次检查，到期委单留到下次处理
+---------------------------------------------------------------------------*/
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    if (is_operlog_block() || is_history_block() || is_message_block()) {
+        return;
+    }
+
+    wheel_run(time(NULL));
+    if (expired == NULL)
+        return;
+
+    json_t *params = json_array();
+    while (expired) {
+        order_t *order = expired;
+        market_t *market = get_market(order->market);
+        if (market == NULL) {
+            expire_del(order);
+            continue;
+        }
+
+        json_t *item = json_array();
+        json_array_append_new(item, json_integer(order->user_id));
+        json_array_append_new(item, json_string(order->market));
+        json_array_append_new(item, json_integer(order->id));
+        json_array_append_new(params, item);
+
+        json_t *result = NULL;
+        int ret = market_cancel_order(true, &result, market, order);
+        if (ret < 0) {
+            log_fatal("expire order: %"PRIu64" fail: %d", order->id, ret);
+            expire_del(order);
+        }
+        if (result) {
+            json_decref(result);
+        }
+    }
+
+    size_t count = json_array_size(params);
+    if (count > 0) {
+        log_info("expire %zu orders", count);
+        expire_total += count;
+        append_operlog("expire_orders", params);
+    }
+    json_decref(params);
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int init_expire(void)
+
+PURPOSE: 
+    启动到期委单定时器
+
+PARAMETERS:
+    None
+
+RETURN VALUE: 
+    0
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    需要在init_from_db()、init_operlog()之后调用
+---------------------------------------------------------------------------*/
+int init_expire(void)
+{
+    if (wheel_time == 0) {
+        wheel_time = time(NULL);
+    }
+
+    nw_timer_set(&timer, 1.0, true, on_timer, NULL);
+    nw_timer_start(&timer);
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: sds expire_status(sds reply)
+
+PURPOSE: 
+    查询时间轮中的委单数量、累计到期撤销的委单数量
+
+PARAMETERS:
+    reply - 查询结果附加到该字符串尾部
+
+RETURN VALUE: 
+    拼接之后的字符串
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    cli 收到命令 status 时调用
+---------------------------------------------------------------------------*/
+sds expire_status(sds reply)
+{
+    reply = sdscatprintf(reply, "expire pending: %zu\n", expire_count);
+    reply = sdscatprintf(reply, "expire total: %"PRIu64"\n", expire_total);
+    return reply;
+}
+
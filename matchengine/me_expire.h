@@ -0,0 +1,20 @@
+/*
+ * Description: 
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _ME_EXPIRE_H_
+# define _ME_EXPIRE_H_
+
+# include "me_config.h"
+# include "me_market.h"
+
+int init_expire(void);
+
+void expire_add(order_t *order);
+void expire_del(order_t *order);
+
+sds expire_status(sds reply);
+
+# endif
+
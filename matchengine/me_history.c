@@ -62,6 +62,7 @@ enum {
     HISTORY_USER_DEAL,
     HISTORY_ORDER_DETAIL,
     HISTORY_ORDER_DEAL,
+    HISTORY_USER_STOP,
 };
 
 struct dict_sql_key {
@@ -838,6 +839,60 @@ int append_order_history(order_t *order)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: int append_stop_history(stop_t *stop, double finish_time, int status)
+
+PURPOSE: 
+    生成止损单历史sql，调用接口，添加到dict_sql，等待定时器调用写入stop_history_$i
+
+PARAMETERS:
+    stop        - 止损单结构指针
+    finish_time - 触发或撤销的时间
+    status      - MARKET_STOP_STATUS_ACTIVE/MARKET_STOP_STATUS_FAIL/MARKET_STOP_STATUS_CANCEL
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    止损单关闭（触发或撤销）时调用，写入stop_history_$(user_id)
+    触发后下达委单失败的止损单status为MARKET_STOP_STATUS_FAIL
+---------------------------------------------------------------------------*/
+int append_stop_history(stop_t *stop, double finish_time, int status)
+{
+    struct dict_sql_key key;
+    key.hash = stop->user_id % HISTORY_HASH_NUM;
+    key.type = HISTORY_USER_STOP;
+    sds sql = get_sql(&key);
+    if (sql == NULL)
+        return -__LINE__;
+
+    if (sdslen(sql) == 0) {
+        sql = sdscatprintf(sql, "INSERT INTO `stop_history_%u` (`id`, `create_time`, `finish_time`, `user_id`, "
+                "`market`, `source`, `t`, `side`, `stop_price`, `price`, `amount`, `taker_fee`, `maker_fee`, `status`) VALUES ", key.hash);
+    } else {
+        sql = sdscatprintf(sql, ", ");
+    }
+
+    sql = sdscatprintf(sql, "(%"PRIu64", %f, %f, %u, '%s', '%s', %u, %u, ", stop->id,
+        stop->create_time, finish_time, stop->user_id, stop->market, stop->source, stop->type, stop->side);
+    sql = sql_append_mpd(sql, stop->stop_price, true);
+    sql = sql_append_mpd(sql, stop->price, true);
+    sql = sql_append_mpd(sql, stop->amount, true);
+    sql = sql_append_mpd(sql, stop->taker_fee, true);
+    sql = sql_append_mpd(sql, stop->maker_fee, true);
+    sql = sdscatprintf(sql, "%d)", status);
+
+    set_sql(&key, sql);
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int append_order_deal_history(double t, uint64_t deal_id, order_t *ask, 
         int ask_role, order_t *bid, int bid_role, mpd_t *price, mpd_t *amount, 
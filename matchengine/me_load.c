@@ -30,16 +30,18 @@ EXAMPLE CALL:
 
 REMARKS: 
     me_persist中load_slice_from_db()调用，从最近的快照恢复market的买卖队列
+    升级前的快照表没有expire_time列，此时订单不过期(expire_time为0)
 ---------------------------------------------------------------------------*/
 int load_orders(MYSQL *conn, const char *table)
 {
     size_t query_limit = 1000;
     uint64_t last_id = 0;
+    bool has_expire_time = is_column_exists(conn, table, "expire_time");
     while (true) {
         sds sql = sdsempty();
         sql = sdscatprintf(sql, "SELECT `id`, `t`, `side`, `create_time`, `update_time`, `user_id`, `market`, "
-                "`price`, `amount`, `taker_fee`, `maker_fee`, `left`, `freeze`, `deal_stock`, `deal_money`, `deal_fee` FROM `%s` "
-                "WHERE `id` > %"PRIu64" ORDER BY `id` LIMIT %zu", table, last_id, query_limit);
+                "`price`, `amount`, `taker_fee`, `maker_fee`, `left`, `freeze`, `deal_stock`, `deal_money`, `deal_fee`%s FROM `%s` "
+                "WHERE `id` > %"PRIu64" ORDER BY `id` LIMIT %zu", has_expire_time ? ", `expire_time`" : "", table, last_id, query_limit);
         log_trace("exec sql: %s", sql);
         int ret = mysql_real_query(conn, sql, sdslen(sql));
         if (ret != 0) {
@@ -76,6 +78,8 @@ int load_orders(MYSQL *conn, const char *table)
             order->deal_stock = decimal(row[13], 0);
             order->deal_money = decimal(row[14], 0);
             order->deal_fee = decimal(row[15], 0);
+            if (has_expire_time)
+                order->expire_time = strtod(row[16], NULL);
 
             if (!order->market || !order->price || !order->amount || !order->taker_fee || !order->maker_fee || !order->left ||
                     !order->freeze || !order->deal_stock || !order->deal_money || !order->deal_fee) {
@@ -95,6 +99,149 @@ int load_orders(MYSQL *conn, const char *table)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: int load_stops(MYSQL *conn, const char *table)
+
+PURPOSE: 
+    加载快照表slice_stop_${time}到内存
+
+PARAMETERS:
+    conn – MySQL.trade_log的链接
+    table - 数据表名
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    me_persist中load_slice_from_db()调用，从最近的快照恢复market的止损单触发队列
+---------------------------------------------------------------------------*/
+int load_stops(MYSQL *conn, const char *table)
+{
+    size_t query_limit = 1000;
+    uint64_t last_id = 0;
+    while (true) {
+        sds sql = sdsempty();
+        sql = sdscatprintf(sql, "SELECT `id`, `t`, `side`, `create_time`, `user_id`, `market`, `source`, "
+                "`stop_price`, `price`, `amount`, `taker_fee`, `maker_fee` FROM `%s` "
+                "WHERE `id` > %"PRIu64" ORDER BY `id` LIMIT %zu", table, last_id, query_limit);
+        log_trace("exec sql: %s", sql);
+        int ret = mysql_real_query(conn, sql, sdslen(sql));
+        if (ret != 0) {
+            log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+            sdsfree(sql);
+            return -__LINE__;
+        }
+        sdsfree(sql);
+
+        MYSQL_RES *result = mysql_store_result(conn);
+        size_t num_rows = mysql_num_rows(result);
+        for (size_t i = 0; i < num_rows; ++i) {
+            MYSQL_ROW row = mysql_fetch_row(result);
+            last_id = strtoull(row[0], NULL, 0);
+            market_t *market = get_market(row[5]);
+            if (market == NULL)
+                continue;
+
+            stop_t *stop = malloc(sizeof(stop_t));
+            memset(stop, 0, sizeof(stop_t));
+            stop->id = strtoull(row[0], NULL, 0);
+            stop->type = strtoul(row[1], NULL, 0);
+            stop->side = strtoul(row[2], NULL, 0);
+            stop->create_time = strtod(row[3], NULL);
+            stop->user_id = strtoul(row[4], NULL, 0);
+            stop->market = strdup(row[5]);
+            stop->source = strdup(row[6]);
+            stop->stop_price = decimal(row[7], market->money_prec);
+            stop->price = decimal(row[8], market->money_prec);
+            stop->amount = decimal(row[9], 0);
+            stop->taker_fee = decimal(row[10], market->fee_prec);
+            stop->maker_fee = decimal(row[11], market->fee_prec);
+
+            if (!stop->market || !stop->source || !stop->stop_price || !stop->price || !stop->amount ||
+                    !stop->taker_fee || !stop->maker_fee) {
+                log_error("get stop detail of stop id: %"PRIu64" fail", stop->id);
+                mysql_free_result(result);
+                return -__LINE__;
+            }
+
+            ret = market_put_stop(market, stop);
+            if (ret < 0) {
+                log_error("put stop: %"PRIu64" fail: %d", stop->id, ret);
+                mysql_free_result(result);
+                return -__LINE__;
+            }
+        }
+        mysql_free_result(result);
+
+        if (num_rows < query_limit)
+            break;
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int load_markets(MYSQL *conn, const char *table)
+
+PURPOSE: 
+    加载快照表slice_market_${time}到内存
+
+PARAMETERS:
+    conn – MySQL.trade_log的链接
+    table - 数据表名
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    me_persist中load_slice_from_db()调用，恢复各market的最新成交价，止损单按它检查触发价
+---------------------------------------------------------------------------*/
+int load_markets(MYSQL *conn, const char *table)
+{
+    sds sql = sdsempty();
+    sql = sdscatprintf(sql, "SELECT `market`, `last` FROM `%s`", table);
+    log_trace("exec sql: %s", sql);
+    int ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        sdsfree(sql);
+        return -__LINE__;
+    }
+    sdsfree(sql);
+
+    MYSQL_RES *result = mysql_store_result(conn);
+    size_t num_rows = mysql_num_rows(result);
+    for (size_t i = 0; i < num_rows; ++i) {
+        MYSQL_ROW row = mysql_fetch_row(result);
+        market_t *market = get_market(row[0]);
+        if (market == NULL)
+            continue;
+        mpd_t *last = decimal(row[1], market->money_prec);
+        if (last == NULL) {
+            log_error("get last price of market: %s fail", row[0]);
+            mysql_free_result(result);
+            return -__LINE__;
+        }
+        mpd_copy(market->last, last, &mpd_ctx);
+        mpd_del(last);
+    }
+    mysql_free_result(result);
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int load_balance(MYSQL *conn, const char *table)
 
@@ -251,7 +398,7 @@ REMARKS:
 ---------------------------------------------------------------------------*/
 static int load_limit_order(json_t *params)
 {
-    if (json_array_size(params) != 8)
+    if (json_array_size(params) != 8 && json_array_size(params) != 9)
         return -__LINE__;
 
     // user_id
@@ -322,7 +469,15 @@ static int load_limit_order(json_t *params)
     if (strlen(source) > SOURCE_MAX_LEN)
         goto error;
 
-    int ret = market_put_limit_order(false, NULL, market, user_id, side, amount, price, taker_fee, maker_fee, source);
+    // expire time
+    double expire_time = 0;
+    if (json_array_size(params) == 9) {
+        if (!json_is_number(json_array_get(params, 8)))
+            goto error;
+        expire_time = json_number_value(json_array_get(params, 8));
+    }
+
+    int ret = market_put_limit_order(false, NULL, market, user_id, side, amount, price, taker_fee, maker_fee, source, expire_time);
 
     mpd_del(amount);
     mpd_del(price);
@@ -490,6 +645,328 @@ static int load_cancel_order(json_t *params)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static int load_expire_orders(json_t *params)
+
+PURPOSE: 
+    恢复expire_orders类型的操作，到内存数据结构
+
+PARAMETERS:
+    params - 记录的命令参数，[[user_id, market, order_id], ...]
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    同一秒内到期的委单合并为一条operlog，逐个按cancel_order恢复
+---------------------------------------------------------------------------*/
+static int load_expire_orders(json_t *params)
+{
+    for (size_t i = 0; i < json_array_size(params); ++i) {
+        json_t *item = json_array_get(params, i);
+        if (!json_is_array(item))
+            return -__LINE__;
+        int ret = load_cancel_order(item);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int load_stop_limit_order(json_t *params)
+
+PURPOSE: 
+    恢复stop_limit_order类型的操作，到内存数据结构
+
+PARAMETERS:
+    params - 记录的命令参数
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+---------------------------------------------------------------------------*/
+static int load_stop_limit_order(json_t *params)
+{
+    if (json_array_size(params) != 9)
+        return -__LINE__;
+
+    // user_id
+    if (!json_is_integer(json_array_get(params, 0)))
+        return -__LINE__;
+    uint32_t user_id = json_integer_value(json_array_get(params, 0));
+
+    // market
+    if (!json_is_string(json_array_get(params, 1)))
+        return -__LINE__;
+    const char *market_name = json_string_value(json_array_get(params, 1));
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return 0;
+
+    // side
+    if (!json_is_integer(json_array_get(params, 2)))
+        return -__LINE__;
+    uint32_t side = json_integer_value(json_array_get(params, 2));
+    if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
+        return -__LINE__;
+
+    mpd_t *amount     = NULL;
+    mpd_t *stop_price = NULL;
+    mpd_t *price      = NULL;
+    mpd_t *taker_fee  = NULL;
+    mpd_t *maker_fee  = NULL;
+
+    // amount
+    if (!json_is_string(json_array_get(params, 3)))
+        goto error;
+    amount = decimal(json_string_value(json_array_get(params, 3)), market->stock_prec);
+    if (amount == NULL)
+        goto error;
+    if (mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0)
+        goto error;
+
+    // stop price
+    if (!json_is_string(json_array_get(params, 4)))
+        goto error;
+    stop_price = decimal(json_string_value(json_array_get(params, 4)), market->money_prec);
+    if (stop_price == NULL)
+        goto error;
+    if (mpd_cmp(stop_price, mpd_zero, &mpd_ctx) <= 0)
+        goto error;
+
+    // price
+    if (!json_is_string(json_array_get(params, 5)))
+        goto error;
+    price = decimal(json_string_value(json_array_get(params, 5)), market->money_prec);
+    if (price == NULL)
+        goto error;
+    if (mpd_cmp(price, mpd_zero, &mpd_ctx) <= 0)
+        goto error;
+
+    // taker fee
+    if (!json_is_string(json_array_get(params, 6)))
+        goto error;
+    taker_fee = decimal(json_string_value(json_array_get(params, 6)), market->fee_prec);
+    if (taker_fee == NULL)
+        goto error;
+    if (mpd_cmp(taker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(taker_fee, mpd_one, &mpd_ctx) >= 0)
+        goto error;
+
+    // maker fee
+    if (!json_is_string(json_array_get(params, 7)))
+        goto error;
+    maker_fee = decimal(json_string_value(json_array_get(params, 7)), market->fee_prec);
+    if (maker_fee == NULL)
+        goto error;
+    if (mpd_cmp(maker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(maker_fee, mpd_one, &mpd_ctx) >= 0)
+        goto error;
+
+    // source
+    if (!json_is_string(json_array_get(params, 8)))
+        goto error;
+    const char *source = json_string_value(json_array_get(params, 8));
+    if (strlen(source) > SOURCE_MAX_LEN)
+        goto error;
+
+    int ret = market_put_stop_limit(false, NULL, market, user_id, side, amount, stop_price, price, taker_fee, maker_fee, source);
+
+    mpd_del(amount);
+    mpd_del(stop_price);
+    mpd_del(price);
+    mpd_del(taker_fee);
+    mpd_del(maker_fee);
+
+    return ret;
+
+error:
+    if (amount)
+        mpd_del(amount);
+    if (stop_price)
+        mpd_del(stop_price);
+    if (price)
+        mpd_del(price);
+    if (taker_fee)
+        mpd_del(taker_fee);
+    if (maker_fee)
+        mpd_del(maker_fee);
+
+    return -__LINE__;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int load_stop_market_order(json_t *params)
+
+PURPOSE: 
+    恢复stop_market_order类型的操作，到内存数据结构
+
+PARAMETERS:
+    params - 记录的命令参数
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+---------------------------------------------------------------------------*/
+static int load_stop_market_order(json_t *params)
+{
+    if (json_array_size(params) != 7)
+        return -__LINE__;
+
+    // user_id
+    if (!json_is_integer(json_array_get(params, 0)))
+        return -__LINE__;
+    uint32_t user_id = json_integer_value(json_array_get(params, 0));
+
+    // market
+    if (!json_is_string(json_array_get(params, 1)))
+        return -__LINE__;
+    const char *market_name = json_string_value(json_array_get(params, 1));
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return 0;
+
+    // side
+    if (!json_is_integer(json_array_get(params, 2)))
+        return -__LINE__;
+    uint32_t side = json_integer_value(json_array_get(params, 2));
+    if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
+        return -__LINE__;
+
+    mpd_t *amount = NULL;
+    mpd_t *stop_price = NULL;
+    mpd_t *taker_fee = NULL;
+
+    // amount
+    if (!json_is_string(json_array_get(params, 3)))
+        goto error;
+    amount = decimal(json_string_value(json_array_get(params, 3)), market->stock_prec);
+    if (amount == NULL)
+        goto error;
+    if (mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0)
+        goto error;
+
+    // stop price
+    if (!json_is_string(json_array_get(params, 4)))
+        goto error;
+    stop_price = decimal(json_string_value(json_array_get(params, 4)), market->money_prec);
+    if (stop_price == NULL)
+        goto error;
+    if (mpd_cmp(stop_price, mpd_zero, &mpd_ctx) <= 0)
+        goto error;
+
+    // taker fee
+    if (!json_is_string(json_array_get(params, 5)))
+        goto error;
+    taker_fee = decimal(json_string_value(json_array_get(params, 5)), market->fee_prec);
+    if (taker_fee == NULL)
+        goto error;
+    if (mpd_cmp(taker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(taker_fee, mpd_one, &mpd_ctx) >= 0)
+        goto error;
+
+    // source
+    if (!json_is_string(json_array_get(params, 6)))
+        goto error;
+    const char *source = json_string_value(json_array_get(params, 6));
+    if (strlen(source) > SOURCE_MAX_LEN)
+        goto error;
+
+    int ret = market_put_stop_market(false, NULL, market, user_id, side, amount, stop_price, taker_fee, source);
+
+    mpd_del(amount);
+    mpd_del(stop_price);
+    mpd_del(taker_fee);
+
+    return ret;
+
+error:
+    if (amount)
+        mpd_del(amount);
+    if (stop_price)
+        mpd_del(stop_price);
+    if (taker_fee)
+        mpd_del(taker_fee);
+
+    return -__LINE__;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int load_cancel_stop(json_t *params)
+
+PURPOSE: 
+    恢复cancel_stop类型的操作，到内存数据结构
+
+PARAMETERS:
+    params - 记录的命令参数
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+---------------------------------------------------------------------------*/
+static int load_cancel_stop(json_t *params)
+{
+    if (json_array_size(params) != 3)
+        return -__LINE__;
+
+    // user_id
+    if (!json_is_integer(json_array_get(params, 0)))
+        return -__LINE__;
+    uint32_t user_id = json_integer_value(json_array_get(params, 0));
+
+    // market
+    if (!json_is_string(json_array_get(params, 1)))
+        return -__LINE__;
+    const char *market_name = json_string_value(json_array_get(params, 1));
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return 0;
+
+    // stop_id
+    if (!json_is_integer(json_array_get(params, 2)))
+        return -__LINE__;
+    uint64_t stop_id = json_integer_value(json_array_get(params, 2));
+
+    stop_t *stop = market_get_stop(market, stop_id);
+    if (stop == NULL) {
+        return -__LINE__;
+    }
+
+    int ret = market_cancel_stop(false, NULL, market, stop);
+    if (ret < 0) {
+        log_error("market_cancel_stop id: %"PRIu64", user id: %u, market: %s", stop_id, user_id, market_name);
+        return -__LINE__;
+    }
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static int load_oper(json_t *detail)
 
@@ -514,6 +991,10 @@ REMARKS:
     limit_order
     market_order
     cancel_order
+    expire_orders
+    stop_limit_order
+    stop_market_order
+    cancel_stop
 ---------------------------------------------------------------------------*/
 static int load_oper(json_t *detail)
 {
@@ -533,6 +1014,14 @@ static int load_oper(json_t *detail)
         ret = load_market_order(params);
     } else if (strcmp(method, "cancel_order") == 0) {
         ret = load_cancel_order(params);
+    } else if (strcmp(method, "expire_orders") == 0) {
+        ret = load_expire_orders(params);
+    } else if (strcmp(method, "stop_limit_order") == 0) {
+        ret = load_stop_limit_order(params);
+    } else if (strcmp(method, "stop_market_order") == 0) {
+        ret = load_stop_market_order(params);
+    } else if (strcmp(method, "cancel_stop") == 0) {
+        ret = load_cancel_stop(params);
     } else {
         return -__LINE__;
     }
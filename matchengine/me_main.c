@@ -12,6 +12,8 @@
 # include "me_persist.h"
 # include "me_history.h"
 # include "me_message.h"
+# include "me_expire.h"
+# include "me_stats.h"
 # include "me_cli.h"
 # include "me_server.h"
 
@@ -242,6 +244,14 @@ int main(int argc, char *argv[])
     if (ret < 0) {
         error(EXIT_FAILURE, errno, "init persist fail: %d", ret);
     }
+    ret = init_expire();
+    if (ret < 0) {
+        error(EXIT_FAILURE, errno, "init expire fail: %d", ret);
+    }
+    ret = init_stats();
+    if (ret < 0) {
+        error(EXIT_FAILURE, errno, "init stats fail: %d", ret);
+    }
     ret = init_cli();
     if (ret < 0) {
         error(EXIT_FAILURE, errno, "init cli fail: %d", ret);
@@ -8,6 +8,8 @@
 # include "me_balance.h"
 # include "me_history.h"
 # include "me_message.h"
+# include "me_expire.h"
+# include "me_stats.h"
 
 /*---------------------------------------------------------------------------
 VARIABLE: uint64_t order_id_start;
@@ -31,6 +33,18 @@ REMARKS:
 ---------------------------------------------------------------------------*/
 uint64_t deals_id_start;
 
+/*---------------------------------------------------------------------------
+VARIABLE: static dict_t *dict_user_orders;
+
+PURPOSE: 
+    所有market的挂单按user_id索引，key为dict_user_key，value为user_orders_t
+
+REMARKS: 
+    委单通过order_t->user_prev/user_next串联，order_put()/order_finish()中维护，O(1)
+    用户没有挂单时删除对应的entry，第一次创建market时创建
+---------------------------------------------------------------------------*/
+static dict_t *dict_user_orders;
+
 struct dict_user_key {
     uint32_t    user_id;
 };
@@ -72,6 +86,11 @@ static void dict_user_val_free(void *key)
     skiplist_release(key);
 }
 
+static void dict_user_orders_free(void *val)
+{
+    free(val);
+}
+
 static uint32_t dict_order_hash_function(const void *key)
 {
     return dict_generic_hash_function(key, sizeof(struct dict_order_key));
@@ -159,6 +178,99 @@ static int order_id_compare(const void *value1, const void *value2)
     return order1->id > order2->id ? -1 : 1;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static int stop_ask_compare(const void *value1, const void *value2)
+
+PURPOSE: 
+    比较两个止损卖单的触发次序
+
+PARAMETERS:
+    value1 - 止损单1的对象指针
+    value2 - 止损单2的对象指针
+
+RETURN VALUE: 
+    >0，value1比value2后触发
+    <0，value1比value2先触发
+    =0，value1与value2是同一止损单
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    成交价下跌到触发价时触发卖单，所以触发价高的排在前面，触发价相同时按id先后
+---------------------------------------------------------------------------*/
+static int stop_ask_compare(const void *value1, const void *value2)
+{
+    const stop_t *stop1 = value1;
+    const stop_t *stop2 = value2;
+
+    if (stop1->id == stop2->id) {
+        return 0;
+    }
+
+    int cmp = mpd_cmp(stop2->stop_price, stop1->stop_price, &mpd_ctx);
+    if (cmp != 0) {
+        return cmp;
+    }
+
+    return stop1->id > stop2->id ? 1 : -1;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int stop_bid_compare(const void *value1, const void *value2)
+
+PURPOSE: 
+    比较两个止损买单的触发次序
+
+PARAMETERS:
+    value1 - 止损单1的对象指针
+    value2 - 止损单2的对象指针
+
+RETURN VALUE: 
+    >0，value1比value2后触发
+    <0，value1比value2先触发
+    =0，value1与value2是同一止损单
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    成交价上涨到触发价时触发买单，所以触发价低的排在前面，触发价相同时按id先后
+---------------------------------------------------------------------------*/
+static int stop_bid_compare(const void *value1, const void *value2)
+{
+    const stop_t *stop1 = value1;
+    const stop_t *stop2 = value2;
+
+    if (stop1->id == stop2->id) {
+        return 0;
+    }
+
+    int cmp = mpd_cmp(stop1->stop_price, stop2->stop_price, &mpd_ctx);
+    if (cmp != 0) {
+        return cmp;
+    }
+
+    return stop1->id > stop2->id ? 1 : -1;
+}
+
+static int stop_id_compare(const void *value1, const void *value2)
+{
+    const stop_t *stop1 = value1;
+    const stop_t *stop2 = value2;
+    if (stop1->id == stop2->id) {
+        return 0;
+    }
+
+    return stop1->id > stop2->id ? -1 : 1;
+}
+
 static void order_free(order_t *order)
 {
     mpd_del(order->price);
@@ -175,6 +287,18 @@ static void order_free(order_t *order)
     free(order);
 }
 
+static void stop_free(stop_t *stop)
+{
+    mpd_del(stop->stop_price);
+    mpd_del(stop->price);
+    mpd_del(stop->amount);
+    mpd_del(stop->taker_fee);
+    mpd_del(stop->maker_fee);
+    free(stop->market);
+    free(stop->source);
+    free(stop);
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: json_t *get_order_info(order_t *order)
 
@@ -207,6 +331,7 @@ json_t *get_order_info(order_t *order)
     json_object_set_new(info, "user", json_integer(order->user_id));
     json_object_set_new(info, "ctime", json_real(order->create_time));
     json_object_set_new(info, "mtime", json_real(order->update_time));
+    json_object_set_new(info, "expire_time", json_real(order->expire_time));
 
     json_object_set_new_mpd(info, "price", order->price);
     json_object_set_new_mpd(info, "amount", order->amount);
@@ -220,6 +345,47 @@ json_t *get_order_info(order_t *order)
     return info;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: json_t *get_stop_info(stop_t *stop)
+
+PURPOSE: 
+    将stop_t转换为json_t
+
+PARAMETERS:
+    stop - 止损单
+
+RETURN VALUE: 
+    止损单的json对象
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    type为触发后下达的委单类型：1限价单，2市价单
+---------------------------------------------------------------------------*/
+json_t *get_stop_info(stop_t *stop)
+{
+    json_t *info = json_object();
+    json_object_set_new(info, "id", json_integer(stop->id));
+    json_object_set_new(info, "market", json_string(stop->market));
+    json_object_set_new(info, "source", json_string(stop->source));
+    json_object_set_new(info, "type", json_integer(stop->type));
+    json_object_set_new(info, "side", json_integer(stop->side));
+    json_object_set_new(info, "user", json_integer(stop->user_id));
+    json_object_set_new(info, "ctime", json_real(stop->create_time));
+
+    json_object_set_new_mpd(info, "stop_price", stop->stop_price);
+    json_object_set_new_mpd(info, "price", stop->price);
+    json_object_set_new_mpd(info, "amount", stop->amount);
+    json_object_set_new_mpd(info, "taker_fee", stop->taker_fee);
+    json_object_set_new_mpd(info, "maker_fee", stop->maker_fee);
+
+    return info;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static int order_put(market_t *m, order_t *order)
 
@@ -288,6 +454,31 @@ static int order_put(market_t *m, order_t *order)
         mpd_del(result);
     }
 
+    entry = dict_find(dict_user_orders, &user_key);
+    if (entry == NULL) {
+        user_orders_t *list = malloc(sizeof(user_orders_t));
+        if (list == NULL)
+            return -__LINE__;
+        memset(list, 0, sizeof(user_orders_t));
+        entry = dict_add(dict_user_orders, &user_key, list);
+        if (entry == NULL) {
+            free(list);
+            return -__LINE__;
+        }
+    }
+    user_orders_t *list = entry->val;
+    order->user_prev = NULL;
+    order->user_next = list->head;
+    if (list->head) {
+        list->head->user_prev = order;
+    }
+    list->head = order;
+    list->count += 1;
+
+    if (order->expire_time > 0) {
+        expire_add(order);
+    }
+
     return 0;
 }
 
@@ -316,6 +507,10 @@ REMARKS:
 ---------------------------------------------------------------------------*/
 static int order_finish(bool real, market_t *m, order_t *order)
 {
+    if (order->expire_slot) {
+        expire_del(order);
+    }
+
     if (order->side == MARKET_ORDER_SIDE_ASK) {
         skiplist_node *node = skiplist_find(m->asks, order);
         if (node) {
@@ -351,6 +546,25 @@ static int order_finish(bool real, market_t *m, order_t *order)
         }
     }
 
+    entry = dict_find(dict_user_orders, &user_key);
+    if (entry) {
+        user_orders_t *list = entry->val;
+        if (order->user_prev) {
+            order->user_prev->user_next = order->user_next;
+        } else {
+            list->head = order->user_next;
+        }
+        if (order->user_next) {
+            order->user_next->user_prev = order->user_prev;
+        }
+        order->user_prev = NULL;
+        order->user_next = NULL;
+        list->count -= 1;
+        if (list->count == 0) {
+            dict_delete(dict_user_orders, &user_key);
+        }
+    }
+
     if (real) {
         if (mpd_cmp(order->deal_stock, mpd_zero, &mpd_ctx) > 0) {
             int ret = append_order_history(order);
@@ -364,6 +578,111 @@ static int order_finish(bool real, market_t *m, order_t *order)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static int stop_put(market_t *m, stop_t *stop)
+
+PURPOSE: 
+    把止损单插入market的触发队列
+
+PARAMETERS:
+    m    - 货币对
+    stop - 止损单
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    止损单触发之前不冻结资产，触发时按普通委单检查余额
+---------------------------------------------------------------------------*/
+static int stop_put(market_t *m, stop_t *stop)
+{
+    struct dict_order_key order_key = { .order_id = stop->id };
+    if (dict_add(m->stops, &order_key, stop) == NULL)
+        return -__LINE__;
+
+    struct dict_user_key user_key = { .user_id = stop->user_id };
+    dict_entry *entry = dict_find(m->stop_users, &user_key);
+    if (entry) {
+        skiplist_t *stop_list = entry->val;
+        if (skiplist_insert(stop_list, stop) == NULL)
+            return -__LINE__;
+    } else {
+        skiplist_type type;
+        memset(&type, 0, sizeof(type));
+        type.compare = stop_id_compare;
+        skiplist_t *stop_list = skiplist_create(&type);
+        if (stop_list == NULL)
+            return -__LINE__;
+        if (skiplist_insert(stop_list, stop) == NULL)
+            return -__LINE__;
+        if (dict_add(m->stop_users, &user_key, stop_list) == NULL)
+            return -__LINE__;
+    }
+
+    if (stop->side == MARKET_ORDER_SIDE_ASK) {
+        if (skiplist_insert(m->stop_asks, stop) == NULL)
+            return -__LINE__;
+    } else {
+        if (skiplist_insert(m->stop_bids, stop) == NULL)
+            return -__LINE__;
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static void stop_remove(market_t *m, stop_t *stop)
+
+PURPOSE: 
+    从market的触发队列、止损单表中删除止损单，不释放内存
+
+PARAMETERS:
+    m    - 货币对
+    stop - 止损单
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    撤销或触发止损单时调用，用户在该market没有止损单时删除stop_users中的条目
+---------------------------------------------------------------------------*/
+static void stop_remove(market_t *m, stop_t *stop)
+{
+    skiplist_t *list = stop->side == MARKET_ORDER_SIDE_ASK ? m->stop_asks : m->stop_bids;
+    skiplist_node *node = skiplist_find(list, stop);
+    if (node) {
+        skiplist_delete(list, node);
+    }
+
+    struct dict_order_key order_key = { .order_id = stop->id };
+    dict_delete(m->stops, &order_key);
+
+    struct dict_user_key user_key = { .user_id = stop->user_id };
+    dict_entry *entry = dict_find(m->stop_users, &user_key);
+    if (entry) {
+        skiplist_t *stop_list = entry->val;
+        skiplist_node *node = skiplist_find(stop_list, stop);
+        if (node) {
+            skiplist_delete(stop_list, node);
+        }
+        if (skiplist_len(stop_list) == 0) {
+            dict_delete(m->stop_users, &user_key);
+        }
+    }
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: market_t *market_create(struct market *conf)
 
@@ -447,6 +766,28 @@ market_t *market_create(struct market *conf)
     if (m->orders == NULL)
         return NULL;
 
+    m->stops = dict_create(&dt, 1024);
+    if (m->stops == NULL)
+        return NULL;
+
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function    = dict_user_hash_function;
+    dt.key_compare      = dict_user_key_compare;
+    dt.key_dup          = dict_user_key_dup;
+    dt.key_destructor   = dict_user_key_free;
+    dt.val_destructor   = dict_user_val_free;
+
+    m->stop_users = dict_create(&dt, 1024);
+    if (m->stop_users == NULL)
+        return NULL;
+
+    if (dict_user_orders == NULL) {
+        dt.val_destructor = dict_user_orders_free;
+        dict_user_orders = dict_create(&dt, 1024);
+        if (dict_user_orders == NULL)
+            return NULL;
+    }
+
     skiplist_type lt;
     memset(&lt, 0, sizeof(lt));
     lt.compare          = order_match_compare;
@@ -456,6 +797,17 @@ market_t *market_create(struct market *conf)
     if (m->asks == NULL || m->bids == NULL)
         return NULL;
 
+    memset(&lt, 0, sizeof(lt));
+    lt.compare          = stop_ask_compare;
+    m->stop_asks = skiplist_create(&lt);
+    lt.compare          = stop_bid_compare;
+    m->stop_bids = skiplist_create(&lt);
+    if (m->stop_asks == NULL || m->stop_bids == NULL)
+        return NULL;
+
+    m->last = mpd_new(&mpd_ctx);
+    mpd_copy(m->last, mpd_zero, &mpd_ctx);
+
     return m;
 }
 
@@ -659,6 +1011,7 @@ static int execute_limit_ask_order(bool real, market_t *m, order_t *taker)
         mpd_mul(ask_fee, deal, taker->taker_fee, &mpd_ctx);
         mpd_mul(bid_fee, amount, maker->maker_fee, &mpd_ctx);
 
+        mpd_copy(m->last, price, &mpd_ctx);
         taker->update_time = maker->update_time = current_timestamp();
         uint64_t deal_id = ++deals_id_start;
         if (real) {
@@ -799,6 +1152,7 @@ static int execute_limit_bid_order(bool real, market_t *m, order_t *taker)
         mpd_mul(ask_fee, deal, maker->maker_fee, &mpd_ctx);
         mpd_mul(bid_fee, amount, taker->taker_fee, &mpd_ctx);
 
+        mpd_copy(m->last, price, &mpd_ctx);
         taker->update_time = maker->update_time = current_timestamp();
         uint64_t deal_id = ++deals_id_start;
         if (real) {
@@ -871,82 +1225,196 @@ static int execute_limit_bid_order(bool real, market_t *m, order_t *taker)
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: int market_put_limit_order(bool real, json_t **result, market_t *m, 
-    uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price, 
-    mpd_t *taker_fee, mpd_t *maker_fee, const char *source)
+FUNCTION: static int execute_stop_order(bool real, market_t *m, stop_t *stop)
 
 PURPOSE: 
-    根据传参生成限价单，并执行撮合
-    如果完全成交，保存order/balance/deal历史，并发送orders到kafka
-    如果未完全成交，添加到买卖队列，保存balance/deal历史，并发送orders/deals到kafka
+    止损单触发后，按其参数下达限价单或市价单，作为taker参与撮合
 
 PARAMETERS:
-    real      - 是否真实操作，默认为true
-    result    - 处理完成的order的json结构
-    m         - 货币对market
-    user_id   - 
-    side      - 买卖方向
-    amount    - 委单金额
-    price     - 委单价格
-    taker_fee - 吃单手续费
-    maker_fee - 做市商手续费
-    source    - 来源字符串
-    
+    real - 是否真实操作
+    m    - 货币对
+    stop - 已触发的止损单
+
 RETURN VALUE: 
-    >=0，成功下达委单
-    =-1，可用余额不足
-    =-2，下单数量太少
-    <-2，发生错误的行号
+    同market_put_limit_order()/market_put_market_order()
 
 EXCEPTION: 
     <Exception that may be thrown by the function>
 
 EXAMPLE CALL:
-    json_t *result = NULL;
-    int ret = market_put_limit_order(true, &result, market, user_id, side, amount, price, taker_fee, maker_fee, source);
-
-    if (ret == -1) {
-        return reply_error(ses, pkg, 10, "balance not enough");
-    } else if (ret == -2) {
-        return reply_error(ses, pkg, 11, "amount too small");
-    } else if (ret < 0) {
-        log_fatal("market_put_limit_order fail: %d", ret);
-        return reply_error_internal_error(ses, pkg);
-    }
+    <Example call of the function>
 
 REMARKS: 
-    收到order.putlimit命令之后，调用该函数执行委单
+    委单使用新的委单id，余额不足、没有对手盘时委单失败，止损单同样关闭，
+    由check_stop_orders()写入MARKET_STOP_STATUS_FAIL的历史并推送STOP_EVENT_FAIL
 ---------------------------------------------------------------------------*/
-int market_put_limit_order(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source)
+static int execute_stop_order(bool real, market_t *m, stop_t *stop)
 {
-    if (side == MARKET_ORDER_SIDE_ASK) {
-        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->stock);
-        if (!balance || mpd_cmp(balance, amount, &mpd_ctx) < 0) {
-            return -1;
-        }
+    json_t *result = NULL;
+    int ret;
+    if (stop->type == MARKET_ORDER_TYPE_LIMIT) {
+        ret = market_put_limit_order(real, &result, m, stop->user_id, stop->side, stop->amount, stop->price, stop->taker_fee, stop->maker_fee, stop->source, 0);
     } else {
-        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->money);
-        mpd_t *require = mpd_new(&mpd_ctx);
-        mpd_mul(require, amount, price, &mpd_ctx);
-        if (!balance || mpd_cmp(balance, require, &mpd_ctx) < 0) {
-            mpd_del(require);
-            return -1;
-        }
-        mpd_del(require);
+        ret = market_put_market_order(real, &result, m, stop->user_id, stop->side, stop->amount, stop->taker_fee, stop->source);
     }
-
-    if (mpd_cmp(amount, m->min_amount, &mpd_ctx) < 0) {
-        return -2;
+    if (result) {
+        json_decref(result);
     }
 
-    order_t *order = malloc(sizeof(order_t));
-    if (order == NULL) {
-        return -__LINE__;
-    }
+    return ret;
+}
 
-    order->id           = ++order_id_start;
-    order->type         = MARKET_ORDER_TYPE_LIMIT;
-    order->side         = side;
+/*---------------------------------------------------------------------------
+FUNCTION: static void check_stop_orders(bool real, market_t *m)
+
+PURPOSE: 
+    用最新成交价检查触发队列，依次取出所有被穿越的止损单并下达委单
+
+PARAMETERS:
+    real - 是否真实操作
+    m    - 货币对
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    stop_asks按触发价从高到低排列，stop_bids按触发价从低到高排列，
+    只需要检查队首，每触发一个止损单的代价是O(log n)
+    触发的委单又会产生新的成交价，所以循环到没有可触发的止损单为止。
+    触发的委单本身会再次调用该函数，用checking标记避免递归，由最外层的循环处理
+---------------------------------------------------------------------------*/
+static void check_stop_orders(bool real, market_t *m)
+{
+    static bool checking = false;
+    if (checking)
+        return;
+    checking = true;
+
+    while (true) {
+        stop_t *stop = NULL;
+        skiplist_node *node;
+        skiplist_iter *iter = skiplist_get_iterator(m->stop_asks);
+        node = skiplist_next(iter);
+        skiplist_release_iterator(iter);
+        if (node && mpd_cmp(m->last, ((stop_t *)node->value)->stop_price, &mpd_ctx) <= 0) {
+            stop = node->value;
+        } else {
+            iter = skiplist_get_iterator(m->stop_bids);
+            node = skiplist_next(iter);
+            skiplist_release_iterator(iter);
+            if (node && mpd_cmp(m->last, ((stop_t *)node->value)->stop_price, &mpd_ctx) >= 0) {
+                stop = node->value;
+            }
+        }
+        if (stop == NULL)
+            break;
+
+        stop_remove(m, stop);
+        int ret = execute_stop_order(real, m, stop);
+        if (ret < 0) {
+            log_error("execute stop: %"PRIu64" fail: %d", stop->id, ret);
+        }
+        if (real) {
+            int status = ret < 0 ? MARKET_STOP_STATUS_FAIL : MARKET_STOP_STATUS_ACTIVE;
+            ret = append_stop_history(stop, current_timestamp(), status);
+            if (ret < 0) {
+                log_fatal("append_stop_history fail: %d, stop: %"PRIu64"", ret, stop->id);
+            }
+            push_stop_message(status == MARKET_STOP_STATUS_FAIL ? STOP_EVENT_FAIL : STOP_EVENT_ACTIVE, stop, m);
+        }
+        stop_free(stop);
+    }
+
+    checking = false;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int market_put_limit_order(bool real, json_t **result, market_t *m, 
+    uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price, 
+    mpd_t *taker_fee, mpd_t *maker_fee, const char *source, double expire_time)
+
+PURPOSE: 
+    根据传参生成限价单，并执行撮合
+    如果完全成交，保存order/balance/deal历史，并发送orders到kafka
+    如果未完全成交，添加到买卖队列，保存balance/deal历史，并发送orders/deals到kafka
+
+PARAMETERS:
+    real      - 是否真实操作，默认为true
+    result    - 处理完成的order的json结构
+    m         - 货币对market
+    user_id   - 
+    side      - 买卖方向
+    amount    - 委单金额
+    price     - 委单价格
+    taker_fee - 吃单手续费
+    maker_fee - 做市商手续费
+    source    - 来源字符串
+    expire_time - 到期时间，未完全成交的部分到期后自动撤销，0表示一直有效
+    
+RETURN VALUE: 
+    >=0，成功下达委单
+    =-1，可用余额不足
+    =-2，下单数量太少
+    <-2，发生错误的行号
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    json_t *result = NULL;
+    int ret = market_put_limit_order(true, &result, market, user_id, side, amount, price, taker_fee, maker_fee, source, expire_time);
+
+    if (ret == -1) {
+        return reply_error(ses, pkg, 10, "balance not enough");
+    } else if (ret == -2) {
+        return reply_error(ses, pkg, 11, "amount too small");
+    } else if (ret < 0) {
+        log_fatal("market_put_limit_order fail: %d", ret);
+        return reply_error_internal_error(ses, pkg);
+    }
+
+REMARKS: 
+    收到order.putlimit命令之后，调用该函数执行委单
+    有成交时，用最新成交价检查并触发止损单
+---------------------------------------------------------------------------*/
+int market_put_limit_order(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source, double expire_time)
+{
+    uint64_t last_deals_id = deals_id_start;
+
+    if (side == MARKET_ORDER_SIDE_ASK) {
+        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->stock);
+        if (!balance || mpd_cmp(balance, amount, &mpd_ctx) < 0) {
+            return -1;
+        }
+    } else {
+        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->money);
+        mpd_t *require = mpd_new(&mpd_ctx);
+        mpd_mul(require, amount, price, &mpd_ctx);
+        if (!balance || mpd_cmp(balance, require, &mpd_ctx) < 0) {
+            mpd_del(require);
+            return -1;
+        }
+        mpd_del(require);
+    }
+
+    if (mpd_cmp(amount, m->min_amount, &mpd_ctx) < 0) {
+        return -2;
+    }
+
+    order_t *order = malloc(sizeof(order_t));
+    if (order == NULL) {
+        return -__LINE__;
+    }
+
+    order->id           = ++order_id_start;
+    order->type         = MARKET_ORDER_TYPE_LIMIT;
+    order->side         = side;
     order->create_time  = current_timestamp();
     order->update_time  = order->create_time;
     order->market       = strdup(m->name);
@@ -961,6 +1429,12 @@ int market_put_limit_order(bool real, json_t **result, market_t *m, uint32_t use
     order->deal_stock   = mpd_new(&mpd_ctx);
     order->deal_money   = mpd_new(&mpd_ctx);
     order->deal_fee     = mpd_new(&mpd_ctx);
+    order->expire_time  = expire_time;
+    order->expire_prev  = NULL;
+    order->expire_next  = NULL;
+    order->expire_slot  = NULL;
+    order->user_prev    = NULL;
+    order->user_next    = NULL;
 
     mpd_copy(order->price, price, &mpd_ctx);
     mpd_copy(order->amount, amount, &mpd_ctx);
@@ -1005,6 +1479,14 @@ int market_put_limit_order(bool real, json_t **result, market_t *m, uint32_t use
         }
     }
 
+    if (real) {
+        stats_inc(STATS_ORDERS_PUT);
+        stats_counters[STATS_DEALS] += deals_id_start - last_deals_id;
+    }
+    if (deals_id_start != last_deals_id) {
+        check_stop_orders(real, m);
+    }
+
     return 0;
 }
 
@@ -1073,6 +1555,7 @@ static int execute_market_ask_order(bool real, market_t *m, order_t *taker)
         mpd_mul(ask_fee, deal, taker->taker_fee, &mpd_ctx);
         mpd_mul(bid_fee, amount, maker->maker_fee, &mpd_ctx);
 
+        mpd_copy(m->last, price, &mpd_ctx);
         taker->update_time = maker->update_time = current_timestamp();
         uint64_t deal_id = ++deals_id_start;
         if (real) {
@@ -1224,6 +1707,7 @@ static int execute_market_bid_order(bool real, market_t *m, order_t *taker)
         mpd_mul(ask_fee, deal, maker->maker_fee, &mpd_ctx);
         mpd_mul(bid_fee, amount, taker->taker_fee, &mpd_ctx);
 
+        mpd_copy(m->last, price, &mpd_ctx);
         taker->update_time = maker->update_time = current_timestamp();
         uint64_t deal_id = ++deals_id_start;
         if (real) {
@@ -1341,9 +1825,12 @@ EXAMPLE CALL:
 REMARKS: 
     收到order.putmarket命令之后，调用该函数执行委单
     如果吃光对手盘，那么市价单也不会添加到买卖队列，而是以成交数量关闭委单
+    有成交时，用最新成交价检查并触发止损单
 ---------------------------------------------------------------------------*/
 int market_put_market_order(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *taker_fee, const char *source)
 {
+    uint64_t last_deals_id = deals_id_start;
+
     if (side == MARKET_ORDER_SIDE_ASK) {
         mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->stock);
         if (!balance || mpd_cmp(balance, amount, &mpd_ctx) < 0) {
@@ -1407,6 +1894,12 @@ int market_put_market_order(bool real, json_t **result, market_t *m, uint32_t us
     order->deal_stock   = mpd_new(&mpd_ctx);
     order->deal_money   = mpd_new(&mpd_ctx);
     order->deal_fee     = mpd_new(&mpd_ctx);
+    order->expire_time  = 0;
+    order->expire_prev  = NULL;
+    order->expire_next  = NULL;
+    order->expire_slot  = NULL;
+    order->user_prev    = NULL;
+    order->user_next    = NULL;
 
     mpd_copy(order->price, mpd_zero, &mpd_ctx);
     mpd_copy(order->amount, amount, &mpd_ctx);
@@ -1440,6 +1933,15 @@ int market_put_market_order(bool real, json_t **result, market_t *m, uint32_t us
     }
 
     order_free(order);
+
+    if (real) {
+        stats_inc(STATS_ORDERS_PUT);
+        stats_counters[STATS_DEALS] += deals_id_start - last_deals_id;
+    }
+    if (deals_id_start != last_deals_id) {
+        check_stop_orders(real, m);
+    }
+
     return 0;
 }
 
@@ -1474,11 +1976,276 @@ int market_cancel_order(bool real, json_t **result, market_t *m, order_t *order)
     if (real) {
         push_order_message(ORDER_EVENT_FINISH, order, m);
         *result = get_order_info(order);
+        stats_inc(STATS_ORDERS_CANCEL);
     }
     order_finish(real, m, order);
     return 0;
 }
 
+static stop_t *stop_create(market_t *m, uint32_t type, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source)
+{
+    stop_t *stop = malloc(sizeof(stop_t));
+    if (stop == NULL) {
+        return NULL;
+    }
+
+    stop->id            = ++order_id_start;
+    stop->type          = type;
+    stop->side          = side;
+    stop->create_time   = current_timestamp();
+    stop->market        = strdup(m->name);
+    stop->source        = strdup(source);
+    stop->user_id       = user_id;
+    stop->stop_price    = mpd_new(&mpd_ctx);
+    stop->price         = mpd_new(&mpd_ctx);
+    stop->amount        = mpd_new(&mpd_ctx);
+    stop->taker_fee     = mpd_new(&mpd_ctx);
+    stop->maker_fee     = mpd_new(&mpd_ctx);
+
+    mpd_copy(stop->stop_price, stop_price, &mpd_ctx);
+    mpd_copy(stop->price, price, &mpd_ctx);
+    mpd_copy(stop->amount, amount, &mpd_ctx);
+    mpd_copy(stop->taker_fee, taker_fee, &mpd_ctx);
+    mpd_copy(stop->maker_fee, maker_fee, &mpd_ctx);
+
+    return stop;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static bool is_stop_price_valid(market_t *m, uint32_t side, mpd_t *stop_price)
+
+PURPOSE: 
+    检查触发价是否还没有被最新成交价穿越
+
+PARAMETERS:
+    m          - 货币对
+    side       - 买卖方向
+    stop_price - 触发价格
+
+RETURN VALUE: 
+    true，卖单stop_price低于最新成交价，买单stop_price高于最新成交价，或者还没有成交
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    已被穿越的止损单会在下一笔成交时触发，不论成交价是多少，所以下单时拒绝
+    m->last随快照保存，重做operlog时结果一致
+---------------------------------------------------------------------------*/
+static bool is_stop_price_valid(market_t *m, uint32_t side, mpd_t *stop_price)
+{
+    if (mpd_cmp(m->last, mpd_zero, &mpd_ctx) == 0)
+        return true;
+    if (side == MARKET_ORDER_SIDE_ASK)
+        return mpd_cmp(m->last, stop_price, &mpd_ctx) > 0;
+    return mpd_cmp(m->last, stop_price, &mpd_ctx) < 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int market_put_stop_limit(bool real, json_t **result, market_t *m, 
+    uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, mpd_t *price, 
+    mpd_t *taker_fee, mpd_t *maker_fee, const char *source)
+
+PURPOSE: 
+    根据传参生成止损限价单，加入触发队列
+
+PARAMETERS:
+    real       - 是否真实操作，默认为true
+    result     - 止损单的json结构
+    m          - 货币对market
+    user_id    - 
+    side       - 买卖方向
+    amount     - 委单数量
+    stop_price - 触发价格
+    price      - 触发后限价单的价格
+    taker_fee  - 吃单手续费
+    maker_fee  - 做市商手续费
+    source     - 来源字符串
+    
+RETURN VALUE: 
+    >=0，成功下达止损单
+    =-1，可用余额不足
+    =-2，下单数量太少
+    =-3，触发价已被最新成交价穿越
+    <-3，发生错误的行号
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    json_t *result = NULL;
+    int ret = market_put_stop_limit(true, &result, market, user_id, side, amount, stop_price, price, taker_fee, maker_fee, source);
+
+REMARKS: 
+    收到order.put_stop_limit命令之后调用
+    卖单在成交价<=stop_price时触发，买单在成交价>=stop_price时触发，
+    只在下单之后发生的成交时检查，不冻结资产，触发时再检查余额
+---------------------------------------------------------------------------*/
+int market_put_stop_limit(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source)
+{
+    if (side == MARKET_ORDER_SIDE_ASK) {
+        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->stock);
+        if (!balance || mpd_cmp(balance, amount, &mpd_ctx) < 0) {
+            return -1;
+        }
+    } else {
+        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->money);
+        mpd_t *require = mpd_new(&mpd_ctx);
+        mpd_mul(require, amount, price, &mpd_ctx);
+        if (!balance || mpd_cmp(balance, require, &mpd_ctx) < 0) {
+            mpd_del(require);
+            return -1;
+        }
+        mpd_del(require);
+    }
+
+    if (mpd_cmp(amount, m->min_amount, &mpd_ctx) < 0) {
+        return -2;
+    }
+
+    if (!is_stop_price_valid(m, side, stop_price)) {
+        return -3;
+    }
+
+    stop_t *stop = stop_create(m, MARKET_ORDER_TYPE_LIMIT, user_id, side, amount, stop_price, price, taker_fee, maker_fee, source);
+    if (stop == NULL) {
+        return -__LINE__;
+    }
+
+    int ret = stop_put(m, stop);
+    if (ret < 0) {
+        log_fatal("stop_put fail: %d, stop: %"PRIu64"", ret, stop->id);
+        stop_remove(m, stop);
+        stop_free(stop);
+        return -__LINE__;
+    }
+    if (real) {
+        push_stop_message(STOP_EVENT_PUT, stop, m);
+        *result = get_stop_info(stop);
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int market_put_stop_market(bool real, json_t **result, market_t *m, 
+    uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, 
+    mpd_t *taker_fee, const char *source)
+
+PURPOSE: 
+    根据传参生成止损市价单，加入触发队列
+
+PARAMETERS:
+    real       - 是否真实操作，默认为true
+    result     - 止损单的json结构
+    m          - 货币对market
+    user_id    - 
+    side       - 买卖方向
+    amount     - 委单数量，卖单为stock数量，买单为money数量
+    stop_price - 触发价格
+    taker_fee  - 吃单手续费
+    source     - 来源字符串
+    
+RETURN VALUE: 
+    >=0，成功下达止损单
+    =-1，可用余额不足
+    =-2，下单数量太少
+    =-3，触发价已被最新成交价穿越
+    <-3，发生错误的行号
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    json_t *result = NULL;
+    int ret = market_put_stop_market(true, &result, market, user_id, side, amount, stop_price, taker_fee, source);
+
+REMARKS: 
+    收到order.put_stop_market命令之后调用，触发规则同market_put_stop_limit()
+---------------------------------------------------------------------------*/
+int market_put_stop_market(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, mpd_t *taker_fee, const char *source)
+{
+    if (side == MARKET_ORDER_SIDE_ASK) {
+        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->stock);
+        if (!balance || mpd_cmp(balance, amount, &mpd_ctx) < 0) {
+            return -1;
+        }
+        if (mpd_cmp(amount, m->min_amount, &mpd_ctx) < 0) {
+            return -2;
+        }
+    } else {
+        mpd_t *balance = balance_get(user_id, BALANCE_TYPE_AVAILABLE, m->money);
+        if (!balance || mpd_cmp(balance, amount, &mpd_ctx) < 0) {
+            return -1;
+        }
+    }
+
+    if (!is_stop_price_valid(m, side, stop_price)) {
+        return -3;
+    }
+
+    stop_t *stop = stop_create(m, MARKET_ORDER_TYPE_MARKET, user_id, side, amount, stop_price, mpd_zero, taker_fee, mpd_zero, source);
+    if (stop == NULL) {
+        return -__LINE__;
+    }
+
+    int ret = stop_put(m, stop);
+    if (ret < 0) {
+        log_fatal("stop_put fail: %d, stop: %"PRIu64"", ret, stop->id);
+        stop_remove(m, stop);
+        stop_free(stop);
+        return -__LINE__;
+    }
+    if (real) {
+        push_stop_message(STOP_EVENT_PUT, stop, m);
+        *result = get_stop_info(stop);
+    }
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int market_cancel_stop(bool real, json_t **result, market_t *m, stop_t *stop)
+
+PURPOSE: 
+    撤销止损单
+    
+PARAMETERS:
+    real   - 是否执行
+    result - 止损单转换的json
+    m      - 货币对
+    stop   - 止损单
+    
+RETURN VALUE: 
+    0
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    收到order.cancel_stop命令时调用
+---------------------------------------------------------------------------*/
+int market_cancel_stop(bool real, json_t **result, market_t *m, stop_t *stop)
+{
+    if (real) {
+        int ret = append_stop_history(stop, current_timestamp(), MARKET_STOP_STATUS_CANCEL);
+        if (ret < 0) {
+            log_fatal("append_stop_history fail: %d, stop: %"PRIu64"", ret, stop->id);
+        }
+        push_stop_message(STOP_EVENT_CANCEL, stop, m);
+        *result = get_stop_info(stop);
+    }
+    stop_remove(m, stop);
+    stop_free(stop);
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static int market_put_order(market_t *m, order_t *order)
 
@@ -1508,6 +2275,33 @@ int market_put_order(market_t *m, order_t *order)
     return order_put(m, order);
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: int market_put_stop(market_t *m, stop_t *stop)
+
+PURPOSE: 
+    把止损单插入market的触发队列
+
+PARAMETERS:
+    m    - 货币对
+    stop - 止损单
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    启动时，从slice_stop_{time}恢复时调用该函数。
+---------------------------------------------------------------------------*/
+int market_put_stop(market_t *m, stop_t *stop)
+{
+    return stop_put(m, stop);
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: order_t *market_get_order(market_t *m, uint64_t order_id)
 
@@ -1579,6 +2373,108 @@ skiplist_t *market_get_order_list(market_t *m, uint32_t user_id)
     return NULL;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: user_orders_t *market_get_user_orders(uint32_t user_id)
+
+PURPOSE: 
+    查找该用户在所有market中的挂单
+    
+PARAMETERS:
+    user_id - 查找的user id
+    
+RETURN VALUE: 
+    如果用户有挂单，返回挂单列表，否则返回 NULL
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    user_orders_t *list = market_get_user_orders(user_id);
+    for (order_t *order = list ? list->head : NULL; order; order = order->user_next) {
+        ...
+    }
+
+REMARKS: 
+    收到order.pending_all命令后调用
+    列表按委单id从大到小排列
+---------------------------------------------------------------------------*/
+user_orders_t *market_get_user_orders(uint32_t user_id)
+{
+    struct dict_user_key key = { .user_id = user_id };
+    dict_entry *entry = dict_find(dict_user_orders, &key);
+    if (entry) {
+        return entry->val;
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: stop_t *market_get_stop(market_t *m, uint64_t stop_id)
+
+PURPOSE: 
+    从market的止损单表中查找止损单
+    
+PARAMETERS:
+    m - 货币对
+    stop_id - 查找的止损单id
+    
+RETURN VALUE: 
+    如果查找成功，返回止损单对象指针，否则返回 NULL
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    stop_t *stop = market_get_stop(market, stop_id);
+    if (stop == NULL) {
+        return reply_error(ses, pkg, 10, "order not found");
+    }
+
+REMARKS: 
+    从market_t->stops中查找，该结构存储未触发的止损单
+---------------------------------------------------------------------------*/
+stop_t *market_get_stop(market_t *m, uint64_t stop_id)
+{
+    struct dict_order_key key = { .order_id = stop_id };
+    dict_entry *entry = dict_find(m->stops, &key);
+    if (entry) {
+        return entry->val;
+    }
+    return NULL;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: skiplist_t *market_get_stop_list(market_t *m, uint32_t user_id)
+
+PURPOSE: 
+    查找该用户在market中所有未触发的止损单
+    
+PARAMETERS:
+    m - 货币对市场
+    user_id - 查找的user id
+    
+RETURN VALUE: 
+    如果查找成功，返回止损单列表指针，否则返回 NULL
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    收到order.pending_stop命令后调用
+---------------------------------------------------------------------------*/
+skiplist_t *market_get_stop_list(market_t *m, uint32_t user_id)
+{
+    struct dict_user_key key = { .user_id = user_id };
+    dict_entry *entry = dict_find(m->stop_users, &key);
+    if (entry) {
+        return entry->val;
+    }
+    return NULL;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int market_get_status(market_t *m, size_t *ask_count, mpd_t *ask_amount, 
             size_t *bid_count, mpd_t *bid_amount)
@@ -1629,6 +2525,52 @@ int market_get_status(market_t *m, size_t *ask_count, mpd_t *ask_amount, size_t
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: int market_get_level(market_t *m, uint32_t side, mpd_t *price, mpd_t *amount)
+
+PURPOSE: 
+    统计某一价位上所有挂单的剩余数量
+    
+PARAMETERS:
+    m      - 货币对
+    side   - 买卖方向
+    price  - 价位
+    amount - [out]该价位剩余数量，没有挂单时为0
+    
+RETURN VALUE: 
+    0
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    以id为0的委单在队列中定位该价位的第一个挂单，O(logN)
+    生成depth增量消息时调用
+---------------------------------------------------------------------------*/
+int market_get_level(market_t *m, uint32_t side, mpd_t *price, mpd_t *amount)
+{
+    order_t probe;
+    memset(&probe, 0, sizeof(probe));
+    probe.type  = MARKET_ORDER_TYPE_LIMIT;
+    probe.side  = side;
+    probe.price = price;
+
+    mpd_copy(amount, mpd_zero, &mpd_ctx);
+    skiplist_t *list = side == MARKET_ORDER_SIDE_ASK ? m->asks : m->bids;
+    skiplist_node *node = skiplist_lower_bound(list, &probe);
+    for (; node; node = node->forward[0]) {
+        order_t *order = node->value;
+        if (mpd_cmp(order->price, price, &mpd_ctx) != 0)
+            break;
+        mpd_add(amount, amount, order->left, &mpd_ctx);
+    }
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: sds market_status(sds reply)
 
@@ -29,8 +29,34 @@ typedef struct order_t {
     mpd_t           *deal_stock;
     mpd_t           *deal_money;
     mpd_t           *deal_fee;
+    double          expire_time;
+    struct order_t  *expire_prev;
+    struct order_t  *expire_next;
+    struct order_t  **expire_slot;
+    struct order_t  *user_prev;
+    struct order_t  *user_next;
 } order_t;
 
+typedef struct user_orders_t {
+    order_t         *head;
+    size_t          count;
+} user_orders_t;
+
+typedef struct stop_t {
+    uint64_t        id;
+    uint32_t        type;
+    uint32_t        side;
+    double          create_time;
+    uint32_t        user_id;
+    char            *market;
+    char            *source;
+    mpd_t           *stop_price;
+    mpd_t           *price;
+    mpd_t           *amount;
+    mpd_t           *taker_fee;
+    mpd_t           *maker_fee;
+} stop_t;
+
 typedef struct market_t {
     char            *name;
     char            *stock;
@@ -46,20 +72,39 @@ typedef struct market_t {
 
     skiplist_t      *asks;
     skiplist_t      *bids;
+
+    dict_t          *stops;
+    dict_t          *stop_users;
+
+    skiplist_t      *stop_asks;
+    skiplist_t      *stop_bids;
+
+    mpd_t           *last;
 } market_t;
 
 market_t *market_create(struct market *conf);
 int market_get_status(market_t *m, size_t *ask_count, mpd_t *ask_amount, size_t *bid_count, mpd_t *bid_amount);
+int market_get_level(market_t *m, uint32_t side, mpd_t *price, mpd_t *amount);
 
-int market_put_limit_order(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source);
+int market_put_limit_order(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source, double expire_time);
 int market_put_market_order(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *taker_fee, const char *source);
 int market_cancel_order(bool real, json_t **result, market_t *m, order_t *order);
 
+int market_put_stop_limit(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, mpd_t *price, mpd_t *taker_fee, mpd_t *maker_fee, const char *source);
+int market_put_stop_market(bool real, json_t **result, market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *stop_price, mpd_t *taker_fee, const char *source);
+int market_cancel_stop(bool real, json_t **result, market_t *m, stop_t *stop);
+
 int market_put_order(market_t *m, order_t *order);
+int market_put_stop(market_t *m, stop_t *stop);
 
 json_t *get_order_info(order_t *order);
 order_t *market_get_order(market_t *m, uint64_t id);
 skiplist_t *market_get_order_list(market_t *m, uint32_t user_id);
+user_orders_t *market_get_user_orders(uint32_t user_id);
+
+json_t *get_stop_info(stop_t *stop);
+stop_t *market_get_stop(market_t *m, uint64_t id);
+skiplist_t *market_get_stop_list(market_t *m, uint32_t user_id);
 
 sds market_status(sds reply);
 
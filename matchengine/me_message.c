@@ -5,6 +5,8 @@
 
 # include "me_config.h"
 # include "me_message.h"
+# include "me_trade.h"
+# include "me_balance.h"
 
 # include <librdkafka/rdkafka.h>
 
@@ -26,11 +28,13 @@ PURPOSE:
     kafka 消息类型 deals
 
 REMARKS: 
-    rkt_orders 对应 orders， rkt_balances 对应 balances
+    rkt_orders 对应 orders， rkt_balances 对应 balances， rkt_stops 对应 stops
 ---------------------------------------------------------------------------*/
 static rd_kafka_topic_t *rkt_deals;
 static rd_kafka_topic_t *rkt_orders;
+static rd_kafka_topic_t *rkt_stops;
 static rd_kafka_topic_t *rkt_balances;
+static rd_kafka_topic_t *rkt_depth;
 
 /*---------------------------------------------------------------------------
 VARIABLE: static list_t *list_deals;
@@ -39,11 +43,37 @@ PURPOSE:
     将要发送给 kafka 的 deals 消息缓存列表
 
 REMARKS: 
-    list_orders 对应 orders 缓存， list_balances 对应 balances 缓存
+    list_orders 对应 orders 缓存， list_balances 对应 balances 缓存， list_stops 对应 stops 缓存
 ---------------------------------------------------------------------------*/
 static list_t *list_deals;
 static list_t *list_orders;
+static list_t *list_stops;
 static list_t *list_balances;
+static list_t *list_depth;
+
+/*---------------------------------------------------------------------------
+VARIABLE: static dict_t *dict_depth;
+
+PURPOSE: 
+    各货币对的depth增量状态，key为货币对名称，value为struct depth_val
+
+REMARKS: 
+    委单消息产生时记录变化的价位，定时器中按价位统计最新数量，
+    每个货币对生成一条depth消息，seq逐条递增
+---------------------------------------------------------------------------*/
+static dict_t *dict_depth;
+
+/*
+ * seq从启动时间*1000开始，每个货币对每0.1s最多一条消息，重启后seq仍然递增，
+ * 订阅方会看到不连续的seq并重新获取快照
+ */
+static uint64_t depth_seq_start;
+
+struct depth_val {
+    uint64_t    seq;
+    dict_t      *asks;
+    dict_t      *bids;
+};
 
 /*---------------------------------------------------------------------------
 VARIABLE: static nw_timer timer;
@@ -165,6 +195,8 @@ static void produce_list(list_t *list, rd_kafka_topic_t *topic)
     list_release_iterator(iter);
 }
 
+static void flush_depth(void);
+
 /*---------------------------------------------------------------------------
 FUNCTION: static void on_timer(nw_timer *t, void *privdata)
 
@@ -190,12 +222,19 @@ REMARKS:
 ---------------------------------------------------------------------------*/
 static void on_timer(nw_timer *t, void *privdata)
 {
+    flush_depth();
+    if (list_depth->len) {
+        produce_list(list_depth, rkt_depth);
+    }
     if (list_balances->len) {
         produce_list(list_balances, rkt_balances);
     }
     if (list_orders->len) {
         produce_list(list_orders, rkt_orders);
     }
+    if (list_stops->len) {
+        produce_list(list_stops, rkt_stops);
+    }
     if (list_deals->len) {
         produce_list(list_deals, rkt_deals);
     }
@@ -208,6 +247,34 @@ static void on_list_free(void *value)
     free(value);
 }
 
+static uint32_t dict_str_hash_function(const void *key)
+{
+    return dict_generic_hash_function(key, strlen(key));
+}
+
+static int dict_str_key_compare(const void *key1, const void *key2)
+{
+    return strcmp(key1, key2);
+}
+
+static void *dict_str_key_dup(const void *key)
+{
+    return strdup(key);
+}
+
+static void dict_str_key_free(void *key)
+{
+    free(key);
+}
+
+static void dict_depth_val_free(void *val)
+{
+    struct depth_val *obj = val;
+    dict_release(obj->asks);
+    dict_release(obj->bids);
+    free(obj);
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int init_message(void)
 
@@ -261,11 +328,21 @@ int init_message(void)
         log_stderr("Failed to create topic object: %s", rd_kafka_err2str(rd_kafka_last_error()));
         return -__LINE__;
     }
+    rkt_stops = rd_kafka_topic_new(rk, "stops", NULL);
+    if (rkt_stops == NULL) {
+        log_stderr("Failed to create topic object: %s", rd_kafka_err2str(rd_kafka_last_error()));
+        return -__LINE__;
+    }
     rkt_deals = rd_kafka_topic_new(rk, "deals", NULL);
     if (rkt_deals == NULL) {
         log_stderr("Failed to create topic object: %s", rd_kafka_err2str(rd_kafka_last_error()));
         return -__LINE__;
     }
+    rkt_depth = rd_kafka_topic_new(rk, "depth", NULL);
+    if (rkt_depth == NULL) {
+        log_stderr("Failed to create topic object: %s", rd_kafka_err2str(rd_kafka_last_error()));
+        return -__LINE__;
+    }
 
     list_type lt;
     memset(&lt, 0, sizeof(lt));
@@ -277,9 +354,27 @@ int init_message(void)
     list_orders = list_create(&lt);
     if (list_orders == NULL)
         return -__LINE__;
+    list_stops = list_create(&lt);
+    if (list_stops == NULL)
+        return -__LINE__;
     list_balances = list_create(&lt);
     if (list_balances == NULL)
         return -__LINE__;
+    list_depth = list_create(&lt);
+    if (list_depth == NULL)
+        return -__LINE__;
+
+    dict_types dt;
+    memset(&dt, 0, sizeof(dt));
+    dt.hash_function    = dict_str_hash_function;
+    dt.key_compare      = dict_str_key_compare;
+    dt.key_dup          = dict_str_key_dup;
+    dt.key_destructor   = dict_str_key_free;
+    dt.val_destructor   = dict_depth_val_free;
+    dict_depth = dict_create(&dt, 64);
+    if (dict_depth == NULL)
+        return -__LINE__;
+    depth_seq_start = (uint64_t)time(NULL) * 1000;
 
     nw_timer_set(&timer, 0.1, true, on_timer, NULL);
     nw_timer_start(&timer);
@@ -294,7 +389,9 @@ int fini_message(void)
     rd_kafka_flush(rk, 1000);
     rd_kafka_topic_destroy(rkt_balances);
     rd_kafka_topic_destroy(rkt_orders);
+    rd_kafka_topic_destroy(rkt_stops);
     rd_kafka_topic_destroy(rkt_deals);
+    rd_kafka_topic_destroy(rkt_depth);
     rd_kafka_destroy(rk);
 
     return 0;
@@ -356,6 +453,171 @@ static int push_message(char *message, rd_kafka_topic_t *topic, list_t *list)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static void depth_touch(const char *market, uint32_t side, mpd_t *price)
+
+PURPOSE: 
+    记录货币对某一价位的数量发生了变化
+    
+PARAMETERS:
+    market - 货币对
+    side   - 买卖方向
+    price  - 价位
+    
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    挂单、成交、撤单都会产生委单消息，在push_order_message中调用
+    同一价位在一个定时周期内只记录一次
+---------------------------------------------------------------------------*/
+static void depth_touch(const char *market, uint32_t side, mpd_t *price)
+{
+    dict_entry *entry = dict_find(dict_depth, market);
+    if (entry == NULL) {
+        struct depth_val *val = malloc(sizeof(struct depth_val));
+        memset(val, 0, sizeof(struct depth_val));
+        val->seq = depth_seq_start;
+
+        dict_types dt;
+        memset(&dt, 0, sizeof(dt));
+        dt.hash_function    = dict_str_hash_function;
+        dt.key_compare      = dict_str_key_compare;
+        dt.key_dup          = dict_str_key_dup;
+        dt.key_destructor   = dict_str_key_free;
+        val->asks = dict_create(&dt, 64);
+        val->bids = dict_create(&dt, 64);
+        if (val->asks == NULL || val->bids == NULL) {
+            log_fatal("create depth dict fail");
+            return;
+        }
+
+        entry = dict_add(dict_depth, (void *)market, val);
+        if (entry == NULL) {
+            dict_depth_val_free(val);
+            return;
+        }
+    }
+
+    struct depth_val *val = entry->val;
+    dict_t *levels = side == MARKET_ORDER_SIDE_ASK ? val->asks : val->bids;
+    char *str = rstripzero(mpd_to_sci(price, 0));
+    if (dict_find(levels, str) == NULL) {
+        dict_add(levels, str, NULL);
+    }
+    free(str);
+}
+
+static json_t *get_depth_levels(market_t *m, uint32_t side, dict_t *levels)
+{
+    json_t *list = json_array();
+    mpd_t *amount = mpd_new(&mpd_ctx);
+    dict_entry *entry;
+    dict_iterator *iter = dict_get_iterator(levels);
+    while ((entry = dict_next(iter)) != NULL) {
+        mpd_t *price = decimal(entry->key, 0);
+        if (price == NULL)
+            continue;
+        market_get_level(m, side, price, amount);
+        json_t *unit = json_array();
+        json_array_append_new_mpd(unit, price);
+        json_array_append_new_mpd(unit, amount);
+        json_array_append_new(list, unit);
+        mpd_del(price);
+    }
+    dict_release_iterator(iter);
+    mpd_del(amount);
+    dict_clear(levels);
+
+    return list;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static void flush_depth(void)
+
+PURPOSE: 
+    为有变化的货币对生成depth增量消息
+    
+PARAMETERS:
+    None
+    
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    消息格式: {"market": "BTCCNY", "seq": 1, "asks": [[price, amount], ...], "bids": [...]}
+    amount为该价位的最新数量，为0表示该价位已没有挂单
+    数量取自发送时的盘口，订阅方可以用order.levels的快照加上seq更大的消息重建盘口
+---------------------------------------------------------------------------*/
+static void flush_depth(void)
+{
+    dict_entry *entry;
+    dict_iterator *iter = dict_get_iterator(dict_depth);
+    while ((entry = dict_next(iter)) != NULL) {
+        struct depth_val *val = entry->val;
+        if (dict_size(val->asks) == 0 && dict_size(val->bids) == 0)
+            continue;
+        market_t *m = get_market(entry->key);
+        if (m == NULL) {
+            dict_clear(val->asks);
+            dict_clear(val->bids);
+            continue;
+        }
+
+        json_t *message = json_object();
+        json_object_set_new(message, "market", json_string(m->name));
+        json_object_set_new(message, "seq", json_integer(++val->seq));
+        json_object_set_new(message, "asks", get_depth_levels(m, MARKET_ORDER_SIDE_ASK, val->asks));
+        json_object_set_new(message, "bids", get_depth_levels(m, MARKET_ORDER_SIDE_BID, val->bids));
+
+        push_message(json_dumps(message, 0), rkt_depth, list_depth);
+        json_decref(message);
+    }
+    dict_release_iterator(iter);
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: uint64_t depth_message_seq(const char *market)
+
+PURPOSE: 
+    返回货币对最后一条depth消息的seq
+    
+PARAMETERS:
+    market - 货币对
+    
+RETURN VALUE: 
+    seq，没有发送过消息时为depth_seq_start
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    order.levels 返回快照时调用，快照已包含seq及之前所有消息的变化
+---------------------------------------------------------------------------*/
+uint64_t depth_message_seq(const char *market)
+{
+    dict_entry *entry = dict_find(dict_depth, market);
+    if (entry == NULL)
+        return depth_seq_start;
+    struct depth_val *val = entry->val;
+    return val->seq;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int push_balance_message(double t, uint32_t user_id, const char *asset,
             const char *business, mpd_t *change)
@@ -382,6 +644,7 @@ EXAMPLE CALL:
 REMARKS: 
     收到balance.update时调用
     trade类型变动不发送消息
+    末尾附带变动后的余额{"available","freeze"}，accessws据此直接推送，无需回查
 ---------------------------------------------------------------------------*/
 int push_balance_message(double t, uint32_t user_id, const char *asset, const char *business, mpd_t *change)
 {
@@ -391,6 +654,7 @@ int push_balance_message(double t, uint32_t user_id, const char *asset, const ch
     json_array_append_new(message, json_string(asset));
     json_array_append_new(message, json_string(business));
     json_array_append_mpd(message, change);
+    json_array_append_new(message, balance_get_info(user_id, asset, NULL));
 
     push_message(json_dumps(message, 0), rkt_balances, list_balances);
     json_decref(message);
@@ -398,6 +662,57 @@ int push_balance_message(double t, uint32_t user_id, const char *asset, const ch
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static json_t *get_order_balances(uint32_t event, order_t *order, market_t *market)
+
+PURPOSE: 
+    生成委单消息中的余额{stock: {...}, money: {...}}
+
+PARAMETERS:
+    event  - 委单状态类型
+    order  - 委单结构
+    market - 货币对
+    
+RETURN VALUE: 
+    余额json对象
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    ORDER_EVENT_PUT消息在order_put冻结之前发出，ORDER_EVENT_FINISH在order_finish解冻之前发出，
+    这里把尚未执行的冻结/解冻计入，使消息中的余额与处理完该委单后一致
+---------------------------------------------------------------------------*/
+static json_t *get_order_balances(uint32_t event, order_t *order, market_t *market)
+{
+    const char *frozen_asset = order->side == MARKET_ORDER_SIDE_ASK ? market->stock : market->money;
+    mpd_t *unfreeze = NULL;
+    if (event == ORDER_EVENT_PUT) {
+        unfreeze = mpd_new(&mpd_ctx);
+        if (order->side == MARKET_ORDER_SIDE_ASK) {
+            mpd_minus(unfreeze, order->left, &mpd_ctx);
+        } else {
+            mpd_mul(unfreeze, order->price, order->left, &mpd_ctx);
+            mpd_minus(unfreeze, unfreeze, &mpd_ctx);
+        }
+    } else if (event == ORDER_EVENT_FINISH && mpd_cmp(order->freeze, mpd_zero, &mpd_ctx) > 0) {
+        unfreeze = mpd_qncopy(order->freeze);
+    }
+
+    json_t *balances = json_object();
+    json_object_set_new(balances, market->stock, balance_get_info(order->user_id, market->stock,
+                frozen_asset == market->stock ? unfreeze : NULL));
+    json_object_set_new(balances, market->money, balance_get_info(order->user_id, market->money,
+                frozen_asset == market->money ? unfreeze : NULL));
+    if (unfreeze)
+        mpd_del(unfreeze);
+
+    return balances;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int push_order_message(uint32_t event, order_t *order, market_t *market)
 
@@ -421,14 +736,20 @@ EXAMPLE CALL:
 REMARKS: 
     收到委单命令后，会生成委单消息
     order.put_limit/order.put_market/order.cancel
+    附带委单用户stock与money两个币种的余额，见get_order_balances
 ---------------------------------------------------------------------------*/
 int push_order_message(uint32_t event, order_t *order, market_t *market)
 {
+    if (order->type == MARKET_ORDER_TYPE_LIMIT) {
+        depth_touch(market->name, order->side, order->price);
+    }
+
     json_t *message = json_object();
     json_object_set_new(message, "event", json_integer(event));
     json_object_set_new(message, "order", get_order_info(order));
     json_object_set_new(message, "stock", json_string(market->stock));
     json_object_set_new(message, "money", json_string(market->money));
+    json_object_set_new(message, "balances", get_order_balances(event, order, market));
 
     push_message(json_dumps(message, 0), rkt_orders, list_orders);
     json_decref(message);
@@ -436,6 +757,44 @@ int push_order_message(uint32_t event, order_t *order, market_t *market)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: int push_stop_message(uint32_t event, stop_t *stop, market_t *market)
+
+PURPOSE: 
+    推送止损单消息stops到kafka
+    
+PARAMETERS:
+    event  - 止损单状态类型(STOP_EVENT_PUT/STOP_EVENT_ACTIVE/STOP_EVENT_CANCEL/STOP_EVENT_FAIL)
+    stop   - 止损单结构
+    market - 货币对
+    
+RETURN VALUE: 
+    0
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    下单、撤销、触发时生成，触发后下达委单失败时为STOP_EVENT_FAIL
+    触发成功下达的委单另有orders消息
+---------------------------------------------------------------------------*/
+int push_stop_message(uint32_t event, stop_t *stop, market_t *market)
+{
+    json_t *message = json_object();
+    json_object_set_new(message, "event", json_integer(event));
+    json_object_set_new(message, "stop", get_stop_info(stop));
+    json_object_set_new(message, "stock", json_string(market->stock));
+    json_object_set_new(message, "money", json_string(market->money));
+
+    push_message(json_dumps(message, 0), rkt_stops, list_stops);
+    json_decref(message);
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: int push_deal_message(double t, const char *market, order_t *ask, order_t *bid, mpd_t *price, mpd_t *amount,
         mpd_t *ask_fee, mpd_t *bid_fee, int side, uint64_t id, const char *stock, const char *money)
@@ -522,6 +881,8 @@ bool is_message_block(void)
         return true;
     if (list_orders->len >= MAX_PENDING_MESSAGE)
         return true;
+    if (list_stops->len >= MAX_PENDING_MESSAGE)
+        return true;
     if (list_balances->len >= MAX_PENDING_MESSAGE)
         return true;
 
@@ -553,7 +914,9 @@ sds message_status(sds reply)
 {
     reply = sdscatprintf(reply, "message deals pending: %lu\n", list_deals->len);
     reply = sdscatprintf(reply, "message orders pending: %lu\n", list_orders->len);
+    reply = sdscatprintf(reply, "message stops pending: %lu\n", list_stops->len);
     reply = sdscatprintf(reply, "message balances pending: %lu\n", list_balances->len);
+    reply = sdscatprintf(reply, "message depth pending: %lu\n", list_depth->len);
     return reply;
 }
 
@@ -18,10 +18,19 @@ enum {
     ORDER_EVENT_FINISH  = 3,
 };
 
+enum {
+    STOP_EVENT_PUT      = 1,
+    STOP_EVENT_ACTIVE   = 2,
+    STOP_EVENT_CANCEL   = 3,
+    STOP_EVENT_FAIL     = 4,
+};
+
 int push_balance_message(double t, uint32_t user_id, const char *asset, const char *business, mpd_t *change);
 int push_order_message(uint32_t event, order_t *order, market_t *market);
+int push_stop_message(uint32_t event, stop_t *stop, market_t *market);
 int push_deal_message(double t, const char *market, order_t *ask, order_t *bid, mpd_t *price, mpd_t *amount,
         mpd_t *ask_fee, mpd_t *bid_fee, int side, uint64_t id, const char *stock, const char *money);
+uint64_t depth_message_seq(const char *market);
 
 bool is_message_block(void);
 sds message_status(sds reply);
@@ -339,6 +339,43 @@ int append_operlog(const char *method, json_t *params)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: int append_operlog_raw(const char *method, const char *params, size_t len)
+
+PURPOSE: 
+    操作日志写到缓存，参数为已校验过的json数组文本
+
+PARAMETERS:
+    method - 操作类型
+    params - 请求中的参数文本，如[1,"BTCBCH",1]
+    len    - 参数文本长度
+
+RETURN VALUE: 
+    0
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:     
+    由params_parse解析的命令使用，直接拼接原始文本，省去构造json再序列化
+---------------------------------------------------------------------------*/
+int append_operlog_raw(const char *method, const char *params, size_t len)
+{
+    struct operlog *log = malloc(sizeof(struct operlog));
+    log->id = ++operlog_id_start;
+    log->create_time = current_timestamp();
+    size_t size = strlen(method) + len + 32;
+    log->detail = malloc(size);
+    snprintf(log->detail, size, "{\"method\": \"%s\", \"params\": %.*s}", method, (int)len, params);
+    list_add_node_tail(list, log);
+    log_debug("add log: %s", log->detail);
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: bool is_operlog_block(void)
 
@@ -14,6 +14,7 @@ int init_operlog(void);
 int fini_operlog(void);
 
 int append_operlog(const char *method, json_t *params);
+int append_operlog_raw(const char *method, const char *params, size_t len);
 
 bool is_operlog_block(void);
 sds operlog_status(sds reply);
@@ -126,7 +126,7 @@ static int get_last_slice(MYSQL *conn, time_t *timestamp, uint64_t *last_oper_id
 FUNCTION: static int load_slice_from_db(MYSQL *conn, time_t timestamp)
 
 PURPOSE: 
-    恢复最近一次快照的挂单、余额到内存数据结构
+    恢复最近一次快照的挂单、止损单、余额到内存数据结构
 
 PARAMETERS:
     [in]conn - mysql.trade_log数据连接
@@ -158,6 +158,32 @@ static int load_slice_from_db(MYSQL *conn, time_t timestamp)
         return -__LINE__;
     }
 
+    sdsclear(table);
+    table = sdscatprintf(table, "slice_stop_%ld", timestamp);
+    if (is_table_exists(conn, table)) {
+        log_stderr("load stops from: %s", table);
+        ret = load_stops(conn, table);
+        if (ret < 0) {
+            log_error("load_stops from %s fail: %d", table, ret);
+            log_stderr("load_stops from %s fail: %d", table, ret);
+            sdsfree(table);
+            return -__LINE__;
+        }
+    }
+
+    sdsclear(table);
+    table = sdscatprintf(table, "slice_market_%ld", timestamp);
+    if (is_table_exists(conn, table)) {
+        log_stderr("load markets from: %s", table);
+        ret = load_markets(conn, table);
+        if (ret < 0) {
+            log_error("load_markets from %s fail: %d", table, ret);
+            log_stderr("load_markets from %s fail: %d", table, ret);
+            sdsfree(table);
+            return -__LINE__;
+        }
+    }
+
     sdsclear(table);
     table = sdscatprintf(table, "slice_balance_%ld", timestamp);
     log_stderr("load balance from: %s", table);
@@ -341,6 +367,80 @@ static int dump_order_to_db(MYSQL *conn, time_t end)
     return 0;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static int dump_stop_to_db(MYSQL *conn, time_t end)
+
+PURPOSE: 
+    输出止损单触发队列到数据库trade_log.slice_stop_{time}
+
+PARAMETERS:
+    [in]conn - mysql.trade_log数据链接
+    [in]end  - 快照时间戳，用于创建表名 
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+---------------------------------------------------------------------------*/
+static int dump_stop_to_db(MYSQL *conn, time_t end)
+{
+    sds table = sdsempty();
+    table = sdscatprintf(table, "slice_stop_%ld", end);
+    log_info("dump stop to: %s", table);
+    int ret = dump_stops(conn, table);
+    if (ret < 0) {
+        log_error("dump_stops to %s fail: %d", table, ret);
+        sdsfree(table);
+        return -__LINE__;
+    }
+    sdsfree(table);
+
+    return 0;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int dump_market_to_db(MYSQL *conn, time_t end)
+
+PURPOSE: 
+    输出各market最新成交价到数据库trade_log.slice_market_{time}
+
+PARAMETERS:
+    [in]conn - mysql.trade_log数据链接
+    [in]end  - 快照时间戳，用于创建表名 
+
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+---------------------------------------------------------------------------*/
+static int dump_market_to_db(MYSQL *conn, time_t end)
+{
+    sds table = sdsempty();
+    table = sdscatprintf(table, "slice_market_%ld", end);
+    log_info("dump market to: %s", table);
+    int ret = dump_markets(conn, table);
+    if (ret < 0) {
+        log_error("dump_markets to %s fail: %d", table, ret);
+        sdsfree(table);
+        return -__LINE__;
+    }
+    sdsfree(table);
+
+    return 0;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static int dump_balance_to_db(MYSQL *conn, time_t end)
 
@@ -456,6 +556,16 @@ int dump_to_db(time_t timestamp)
         goto cleanup;
     }
 
+    ret = dump_stop_to_db(conn, timestamp);
+    if (ret < 0) {
+        goto cleanup;
+    }
+
+    ret = dump_market_to_db(conn, timestamp);
+    if (ret < 0) {
+        goto cleanup;
+    }
+
     ret = dump_balance_to_db(conn, timestamp);
     if (ret < 0) {
         goto cleanup;
@@ -562,6 +672,24 @@ static int delete_slice(MYSQL *conn, uint64_t id, time_t timestamp)
     }
     sdsclear(sql);
 
+    sql = sdscatprintf(sql, "DROP TABLE IF EXISTS `slice_stop_%ld`", timestamp);
+    log_trace("exec sql: %s", sql);
+    ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        return -__LINE__;
+    }
+    sdsclear(sql);
+
+    sql = sdscatprintf(sql, "DROP TABLE IF EXISTS `slice_market_%ld`", timestamp);
+    log_trace("exec sql: %s", sql);
+    ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        return -__LINE__;
+    }
+    sdsclear(sql);
+
     sql = sdscatprintf(sql, "DROP TABLE `slice_balance_%ld`", timestamp);
     log_trace("exec sql: %s", sql);
     ret = mysql_real_query(conn, sql, sdslen(sql));
@@ -12,6 +12,7 @@
 # include "me_operlog.h"
 # include "me_history.h"
 # include "me_message.h"
+# include "me_stats.h"
 
 /*---------------------------------------------------------------------------
 VARIABLE: static rpc_svr *svr;
@@ -93,23 +94,20 @@ REMARKS:
 ---------------------------------------------------------------------------*/
 static int reply_json(nw_ses *ses, rpc_pkg *pkg, const json_t *json)
 {
-    char *message_data;
-    if (settings.debug) {
-        message_data = json_dumps(json, JSON_INDENT(4));
-    } else {
-        message_data = json_dumps(json, 0);
-    }
-    if (message_data == NULL)
-        return -__LINE__;
-    log_trace("connection: %s send: %s", nw_sock_human_addr(&ses->peer_addr), message_data);
-
+    uint64_t start = stats_now();
     rpc_pkg reply;
     memcpy(&reply, pkg, sizeof(reply));
     reply.pkg_type = RPC_PKG_TYPE_REPLY;
-    reply.body = message_data;
-    reply.body_size = strlen(message_data);
+    if (rpc_body_encode(&reply, json, rpc_pkg_encoding(pkg), settings.debug ? JSON_INDENT(4) : 0) < 0)
+        return -__LINE__;
+    if (reply.ext_size == 0) {
+        log_trace("connection: %s send: %.*s", nw_sock_human_addr(&ses->peer_addr), (int)reply.body_size, (char *)reply.body);
+    } else {
+        log_trace("connection: %s send: (binary %u bytes)", nw_sock_human_addr(&ses->peer_addr), reply.body_size);
+    }
     rpc_send(ses, &reply);
-    free(message_data);
+    free(reply.body);
+    stats_reply(stats_now() - start);
 
     return 0;
 }
@@ -253,6 +251,42 @@ static int reply_success(nw_ses *ses, rpc_pkg *pkg)
     return ret;
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static int append_operlog_params(const char *method, params_t *params)
+
+PURPOSE: 
+    写入操作日志，参数来自params_parse时直接使用原始文本
+    二进制请求体的参数转成json数组后写入
+
+PARAMETERS:
+    [in]method - 操作类型
+    [in]params - 命令参数
+    
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+---------------------------------------------------------------------------*/
+static int append_operlog_params(const char *method, params_t *params)
+{
+    size_t len;
+    const char *raw = params_raw(params, &len);
+    if (raw)
+        return append_operlog_raw(method, raw, len);
+    json_t *json = params_to_json(params);
+    if (json == NULL)
+        return -__LINE__;
+    int ret = append_operlog(method, json);
+    json_decref(json);
+    return ret;
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static bool process_cache(nw_ses *ses, rpc_pkg *pkg, sds *cache_key)
 
@@ -283,6 +317,7 @@ static bool process_cache(nw_ses *ses, rpc_pkg *pkg, sds *cache_key)
     key = sdscatlen(key, pkg->body, pkg->body_size);
     dict_entry *entry = dict_find(dict_cache, key);
     if (entry == NULL) {
+        stats_inc(STATS_CACHE_MISS);
         *cache_key = key;
         return false;
     }
@@ -290,11 +325,13 @@ static bool process_cache(nw_ses *ses, rpc_pkg *pkg, sds *cache_key)
     struct cache_val *cache = entry->val;
     double now = current_timestamp();
     if ((now - cache->time) > settings.cache_timeout) {
+        stats_inc(STATS_CACHE_MISS);
         dict_delete(dict_cache, key);
         *cache_key = key;
         return false;
     }
 
+    stats_inc(STATS_CACHE_HIT);
     reply_result(ses, pkg, cache->result);
     sdsfree(key);
     return true;
@@ -334,7 +371,7 @@ static int add_cache(sds cache_key, json_t *result)
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_balance_query(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_balance_query(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理balance.query命令
@@ -358,96 +395,32 @@ REMARKS:
     "params": [1, "BTC"]  // [user_id, asset] asset不存在则返回所有资产
     "result": {"BTC": {"available": "1.10000000","freeze": "9.90000000"}}
 ---------------------------------------------------------------------------*/
-static int on_cmd_balance_query(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_balance_query(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    size_t request_size = json_array_size(params);
+    size_t request_size = params_size(params);
     if (request_size == 0)
         return reply_error_invalid_argument(ses, pkg);
 
-    if (!json_is_integer(json_array_get(params, 0)))
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t user_id = json_integer_value(json_array_get(params, 0));
-    if (user_id == 0)
+    if ((uint32_t)user_id == 0)
         return reply_error_invalid_argument(ses, pkg);
 
     json_t *result = json_object();
     if (request_size == 1) {
         for (size_t i = 0; i < settings.asset_num; ++i) {
             const char *asset = settings.assets[i].name;
-            json_t *unit = json_object();
-            int prec_save = asset_prec(asset);
-            int prec_show = asset_prec_show(asset);
-
-            mpd_t *available = balance_get(user_id, BALANCE_TYPE_AVAILABLE, asset);
-            if (available) {
-                if (prec_save != prec_show) {
-                    mpd_t *show = mpd_qncopy(available);
-                    mpd_rescale(show, show, -prec_show, &mpd_ctx);
-                    json_object_set_new_mpd(unit, "available", show);
-                    mpd_del(show);
-                } else {
-                    json_object_set_new_mpd(unit, "available", available);
-                }
-            } else {
-                json_object_set_new(unit, "available", json_string("0"));
-            }
-
-            mpd_t *freeze = balance_get(user_id, BALANCE_TYPE_FREEZE, asset);
-            if (freeze) {
-                if (prec_save != prec_show) {
-                    mpd_t *show = mpd_qncopy(freeze);
-                    mpd_rescale(show, show, -prec_show, &mpd_ctx);
-                    json_object_set_new_mpd(unit, "freeze", show);
-                    mpd_del(show);
-                } else {
-                    json_object_set_new_mpd(unit, "freeze", freeze);
-                }
-            } else {
-                json_object_set_new(unit, "freeze", json_string("0"));
-            }
-
-            json_object_set_new(result, asset, unit);
+            json_object_set_new(result, asset, balance_get_info(user_id, asset, NULL));
         }
     } else {
         for (size_t i = 1; i < request_size; ++i) {
-            const char *asset = json_string_value(json_array_get(params, i));
-            if (!asset || !asset_exist(asset)) {
+            char asset[ASSET_NAME_MAX_LEN + 1];
+            if (params_get_str(params, i, asset, sizeof(asset)) < 0 || !asset_exist(asset)) {
                 json_decref(result);
                 return reply_error_invalid_argument(ses, pkg);
             }
-            json_t *unit = json_object();
-            int prec_save = asset_prec(asset);
-            int prec_show = asset_prec_show(asset);
-
-            mpd_t *available = balance_get(user_id, BALANCE_TYPE_AVAILABLE, asset);
-            if (available) {
-                if (prec_save != prec_show) {
-                    mpd_t *show = mpd_qncopy(available);
-                    mpd_rescale(show, show, -prec_show, &mpd_ctx);
-                    json_object_set_new_mpd(unit, "available", show);
-                    mpd_del(show);
-                } else {
-                    json_object_set_new_mpd(unit, "available", available);
-                }
-            } else {
-                json_object_set_new(unit, "available", json_string("0"));
-            }
-
-            mpd_t *freeze = balance_get(user_id, BALANCE_TYPE_FREEZE, asset);
-            if (freeze) {
-                if (prec_save != prec_show) {
-                    mpd_t *show = mpd_qncopy(freeze);
-                    mpd_rescale(show, show, -prec_show, &mpd_ctx);
-                    json_object_set_new_mpd(unit, "freeze", show);
-                    mpd_del(show);
-                } else {
-                    json_object_set_new_mpd(unit, "freeze", freeze);
-                }
-            } else {
-                json_object_set_new(unit, "freeze", json_string("0"));
-            }
-
-            json_object_set_new(result, asset, unit);
+            json_object_set_new(result, asset, balance_get_info(user_id, asset, NULL));
         }
     }
 
@@ -687,7 +660,7 @@ invalid_argument:
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理order.put_limit命令，返回币种余额统计
@@ -716,7 +689,8 @@ REMARKS:
     写入operlog
 
     order.put_limit命令格式
-    parmams:[user_id,market,side,amount,price,taker_fee_rate,maker_fee_rate,source]
+    parmams:[user_id,market,side,amount,price,taker_fee_rate,maker_fee_rate,source,expire_time]
+    expire_time可选，为到期时间戳，到期后未成交部分自动撤销，0或不传表示一直有效
     示例
     {"method": "order.put_limit", "params": [1,"BTCBCH",1,"1","10000","0.002","0.001","api"], "id": 1516681174}
     {
@@ -742,28 +716,28 @@ REMARKS:
         "id": 1516681174
     }
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 8)
+    if (params_size(params) != 8 && params_size(params) != 9)
         return reply_error_invalid_argument(ses, pkg);
 
     // user_id
-    if (!json_is_integer(json_array_get(params, 0)))
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t user_id = json_integer_value(json_array_get(params, 0));
 
     // market
-    if (!json_is_string(json_array_get(params, 1)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 1));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // side
-    if (!json_is_integer(json_array_get(params, 2)))
+    int64_t side;
+    if (params_get_int(params, 2, &side) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t side = json_integer_value(json_array_get(params, 2));
     if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
         return reply_error_invalid_argument(ses, pkg);
 
@@ -773,42 +747,41 @@ static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, json_t *params)
     mpd_t *maker_fee = NULL;
 
     // amount
-    if (!json_is_string(json_array_get(params, 3)))
-        goto invalid_argument;
-    amount = decimal(json_string_value(json_array_get(params, 3)), market->stock_prec);
+    amount = params_get_decimal(params, 3, market->stock_prec);
     if (amount == NULL || mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0)
         goto invalid_argument;
 
     // price 
-    if (!json_is_string(json_array_get(params, 4)))
-        goto invalid_argument;
-    price = decimal(json_string_value(json_array_get(params, 4)), market->money_prec);
+    price = params_get_decimal(params, 4, market->money_prec);
     if (price == NULL || mpd_cmp(price, mpd_zero, &mpd_ctx) <= 0)
         goto invalid_argument;
 
     // taker fee
-    if (!json_is_string(json_array_get(params, 5)))
-        goto invalid_argument;
-    taker_fee = decimal(json_string_value(json_array_get(params, 5)), market->fee_prec);
+    taker_fee = params_get_decimal(params, 5, market->fee_prec);
     if (taker_fee == NULL || mpd_cmp(taker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(taker_fee, mpd_one, &mpd_ctx) >= 0)
         goto invalid_argument;
 
     // maker fee
-    if (!json_is_string(json_array_get(params, 6)))
-        goto invalid_argument;
-    maker_fee = decimal(json_string_value(json_array_get(params, 6)), market->fee_prec);
+    maker_fee = params_get_decimal(params, 6, market->fee_prec);
     if (maker_fee == NULL || mpd_cmp(maker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(maker_fee, mpd_one, &mpd_ctx) >= 0)
         goto invalid_argument;
 
     // source
-    if (!json_is_string(json_array_get(params, 7)))
-        goto invalid_argument;
-    const char *source = json_string_value(json_array_get(params, 7));
-    if (strlen(source) >= SOURCE_MAX_LEN)
+    char source[SOURCE_MAX_LEN];
+    if (params_get_str(params, 7, source, sizeof(source)) < 0)
         goto invalid_argument;
 
+    // expire time, optional
+    double expire_time = 0;
+    if (params_size(params) == 9) {
+        if (params_get_number(params, 8, &expire_time) < 0)
+            goto invalid_argument;
+        if (expire_time != 0 && expire_time <= current_timestamp())
+            goto invalid_argument;
+    }
+
     json_t *result = NULL;
-    int ret = market_put_limit_order(true, &result, market, user_id, side, amount, price, taker_fee, maker_fee, source);
+    int ret = market_put_limit_order(true, &result, market, user_id, side, amount, price, taker_fee, maker_fee, source, expire_time);
 
     mpd_del(amount);
     mpd_del(price);
@@ -824,7 +797,7 @@ static int on_cmd_order_put_limit(nw_ses *ses, rpc_pkg *pkg, json_t *params)
         return reply_error_internal_error(ses, pkg);
     }
 
-    append_operlog("limit_order", params);
+    append_operlog_params("limit_order", params);
     ret = reply_result(ses, pkg, result);
     json_decref(result);
     return ret;
@@ -843,7 +816,7 @@ invalid_argument:
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理order.put_market命令，返回币种余额统计
@@ -898,28 +871,28 @@ REMARKS:
         "id": 1516681174
     }
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 6)
+    if (params_size(params) != 6)
         return reply_error_invalid_argument(ses, pkg);
 
     // user_id
-    if (!json_is_integer(json_array_get(params, 0)))
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t user_id = json_integer_value(json_array_get(params, 0));
 
     // market
-    if (!json_is_string(json_array_get(params, 1)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 1));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // side
-    if (!json_is_integer(json_array_get(params, 2)))
+    int64_t side;
+    if (params_get_int(params, 2, &side) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t side = json_integer_value(json_array_get(params, 2));
     if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
         return reply_error_invalid_argument(ses, pkg);
 
@@ -927,24 +900,18 @@ static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, json_t *params)
     mpd_t *taker_fee = NULL;
 
     // amount
-    if (!json_is_string(json_array_get(params, 3)))
-        goto invalid_argument;
-    amount = decimal(json_string_value(json_array_get(params, 3)), market->stock_prec);
+    amount = params_get_decimal(params, 3, market->stock_prec);
     if (amount == NULL || mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0)
         goto invalid_argument;
 
     // taker fee
-    if (!json_is_string(json_array_get(params, 4)))
-        goto invalid_argument;
-    taker_fee = decimal(json_string_value(json_array_get(params, 4)), market->fee_prec);
+    taker_fee = params_get_decimal(params, 4, market->fee_prec);
     if (taker_fee == NULL || mpd_cmp(taker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(taker_fee, mpd_one, &mpd_ctx) >= 0)
         goto invalid_argument;
 
     // source
-    if (!json_is_string(json_array_get(params, 5)))
-        goto invalid_argument;
-    const char *source = json_string_value(json_array_get(params, 5));
-    if (strlen(source) >= SOURCE_MAX_LEN)
+    char source[SOURCE_MAX_LEN];
+    if (params_get_str(params, 5, source, sizeof(source)) < 0)
         goto invalid_argument;
 
     json_t *result = NULL;
@@ -964,7 +931,7 @@ static int on_cmd_order_put_market(nw_ses *ses, rpc_pkg *pkg, json_t *params)
         return reply_error_internal_error(ses, pkg);
     }
 
-    append_operlog("market_order", params);
+    append_operlog_params("market_order", params);
     ret = reply_result(ses, pkg, result);
     json_decref(result);
     return ret;
@@ -979,7 +946,7 @@ invalid_argument:
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_query(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_query(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理 order.pending 命令，返回用户的挂单
@@ -1028,34 +995,34 @@ REMARKS:
         ]
     }
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_query(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_query(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 4)
+    if (params_size(params) != 4)
         return reply_error_invalid_argument(ses, pkg);
 
     // user_id
-    if (!json_is_integer(json_array_get(params, 0)))
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t user_id = json_integer_value(json_array_get(params, 0));
 
     // market
-    if (!json_is_string(json_array_get(params, 1)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 1));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // offset
-    if (!json_is_integer(json_array_get(params, 2)))
+    int64_t offset;
+    if (params_get_int(params, 2, &offset) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    size_t offset = json_integer_value(json_array_get(params, 2));
 
     // limit
-    if (!json_is_integer(json_array_get(params, 3)))
+    int64_t limit;
+    if (params_get_int(params, 3, &limit) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    size_t limit = json_integer_value(json_array_get(params, 3));
-    if (limit > ORDER_LIST_MAX_LEN)
+    if ((uint64_t)limit > ORDER_LIST_MAX_LEN)
         return reply_error_invalid_argument(ses, pkg);
 
     json_t *result = json_object();
@@ -1092,7 +1059,7 @@ static int on_cmd_order_query(nw_ses *ses, rpc_pkg *pkg, json_t *params)
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_cancel(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_cancel(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理 order.cancel 命令，返回用户的委单信息
@@ -1120,34 +1087,34 @@ REMARKS:
     order.cancel 命令格式
     parmams:[user_id,market,order_id]
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_cancel(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_cancel(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 3)
+    if (params_size(params) != 3)
         return reply_error_invalid_argument(ses, pkg);
 
     // user_id
-    if (!json_is_integer(json_array_get(params, 0)))
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t user_id = json_integer_value(json_array_get(params, 0));
 
     // market
-    if (!json_is_string(json_array_get(params, 1)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 1));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // order_id
-    if (!json_is_integer(json_array_get(params, 2)))
+    int64_t order_id;
+    if (params_get_int(params, 2, &order_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint64_t order_id = json_integer_value(json_array_get(params, 2));
 
     order_t *order = market_get_order(market, order_id);
     if (order == NULL) {
         return reply_error(ses, pkg, 10, "order not found");
     }
-    if (order->user_id != user_id) {
+    if (order->user_id != (uint32_t)user_id) {
         return reply_error(ses, pkg, 11, "user not match");
     }
 
@@ -1158,17 +1125,17 @@ static int on_cmd_order_cancel(nw_ses *ses, rpc_pkg *pkg, json_t *params)
         return reply_error_internal_error(ses, pkg);
     }
 
-    append_operlog("cancel_order", params);
+    append_operlog_params("cancel_order", params);
     ret = reply_result(ses, pkg, result);
     json_decref(result);
     return ret;
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_put_stop_limit(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
-    处理 order.book 命令，返回市场的订单信息
+    处理order.put_stop_limit命令，下达止损限价单
 
 PARAMETERS:
     [in]ses  - 命令请求session
@@ -1185,91 +1152,129 @@ EXAMPLE CALL:
     <Example call of the function>
 
 REMARKS:
-    order.book 命令格式
-    parmams:[market,side,offset,limit]
+    order.put_stop_limit属于写操作，需要检查是否server接收写操作
+    止损单加入触发队列，成交价穿越stop_price时以price下达限价单
+    写入operlog
+
+    order.put_stop_limit命令格式
+    parmams:[user_id,market,side,amount,stop_price,price,taker_fee_rate,maker_fee_rate,source]
+    示例
+    {"method": "order.put_stop_limit", "params": [1,"BTCBCH",1,"1","9000","8990","0.002","0.001","api"], "id": 1516681174}
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_put_stop_limit(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 4)
+    if (params_size(params) != 9)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // user_id
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
 
     // market
-    if (!json_is_string(json_array_get(params, 0)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 0));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // side
-    if (!json_is_integer(json_array_get(params, 1)))
+    int64_t side;
+    if (params_get_int(params, 2, &side) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint32_t side = json_integer_value(json_array_get(params, 1));
     if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
         return reply_error_invalid_argument(ses, pkg);
 
-    // offset
-    if (!json_is_integer(json_array_get(params, 2)))
-        return reply_error_invalid_argument(ses, pkg);
-    size_t offset = json_integer_value(json_array_get(params, 2));
+    mpd_t *amount     = NULL;
+    mpd_t *stop_price = NULL;
+    mpd_t *price      = NULL;
+    mpd_t *taker_fee  = NULL;
+    mpd_t *maker_fee  = NULL;
 
-    // limit
-    if (!json_is_integer(json_array_get(params, 3)))
-        return reply_error_invalid_argument(ses, pkg);
-    size_t limit = json_integer_value(json_array_get(params, 3));
-    if (limit > ORDER_BOOK_MAX_LEN)
-        return reply_error_invalid_argument(ses, pkg);
+    // amount
+    amount = params_get_decimal(params, 3, market->stock_prec);
+    if (amount == NULL || mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0)
+        goto invalid_argument;
 
-    json_t *result = json_object();
-    json_object_set_new(result, "offset", json_integer(offset));
-    json_object_set_new(result, "limit", json_integer(limit));
+    // stop price
+    stop_price = params_get_decimal(params, 4, market->money_prec);
+    if (stop_price == NULL || mpd_cmp(stop_price, mpd_zero, &mpd_ctx) <= 0)
+        goto invalid_argument;
 
-    uint64_t total;
-    skiplist_iter *iter;
-    if (side == MARKET_ORDER_SIDE_ASK) {
-        iter = skiplist_get_iterator(market->asks);
-        total = market->asks->len;
-        json_object_set_new(result, "total", json_integer(total));
-    } else {
-        iter = skiplist_get_iterator(market->bids);
-        total = market->bids->len;
-        json_object_set_new(result, "total", json_integer(total));
-    }
+    // price 
+    price = params_get_decimal(params, 5, market->money_prec);
+    if (price == NULL || mpd_cmp(price, mpd_zero, &mpd_ctx) <= 0)
+        goto invalid_argument;
 
-    json_t *orders = json_array();
-    if (offset < total) {
-        for (size_t i = 0; i < offset; i++) {
-            if (skiplist_next(iter) == NULL)
-                break;
-        }
-        size_t index = 0;
-        skiplist_node *node;
-        while ((node = skiplist_next(iter)) != NULL && index < limit) {
-            index++;
-            order_t *order = node->value;
-            json_array_append_new(orders, get_order_info(order));
-        }
+    // taker fee
+    taker_fee = params_get_decimal(params, 6, market->fee_prec);
+    if (taker_fee == NULL || mpd_cmp(taker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(taker_fee, mpd_one, &mpd_ctx) >= 0)
+        goto invalid_argument;
+
+    // maker fee
+    maker_fee = params_get_decimal(params, 7, market->fee_prec);
+    if (maker_fee == NULL || mpd_cmp(maker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(maker_fee, mpd_one, &mpd_ctx) >= 0)
+        goto invalid_argument;
+
+    // source
+    char source[SOURCE_MAX_LEN];
+    if (params_get_str(params, 8, source, sizeof(source)) < 0)
+        goto invalid_argument;
+
+    json_t *result = NULL;
+    int ret = market_put_stop_limit(true, &result, market, user_id, side, amount, stop_price, price, taker_fee, maker_fee, source);
+
+    mpd_del(amount);
+    mpd_del(stop_price);
+    mpd_del(price);
+    mpd_del(taker_fee);
+    mpd_del(maker_fee);
+
+    if (ret == -1) {
+        return reply_error(ses, pkg, 10, "balance not enough");
+    } else if (ret == -2) {
+        return reply_error(ses, pkg, 11, "amount too small");
+    } else if (ret == -3) {
+        return reply_error(ses, pkg, 12, "stop price crossed");
+    } else if (ret < 0) {
+        log_fatal("market_put_stop_limit fail: %d", ret);
+        return reply_error_internal_error(ses, pkg);
     }
-    skiplist_release_iterator(iter);
 
-    json_object_set_new(result, "orders", orders);
-    int ret = reply_result(ses, pkg, result);
+    append_operlog_params("stop_limit_order", params);
+    ret = reply_result(ses, pkg, result);
     json_decref(result);
     return ret;
+
+invalid_argument:
+    if (amount)
+        mpd_del(amount);
+    if (stop_price)
+        mpd_del(stop_price);
+    if (price)
+        mpd_del(price);
+    if (taker_fee)
+        mpd_del(taker_fee);
+    if (maker_fee)
+        mpd_del(maker_fee);
+
+    return reply_error_invalid_argument(ses, pkg);
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static json_t *get_depth(market_t *market, size_t limit)
+FUNCTION: static int on_cmd_order_put_stop_market(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
-    返回市场的深度信息
+    处理order.put_stop_market命令，下达止损市价单
 
 PARAMETERS:
-    [in]market - 货币对市场
-    [in]limit  - 接收到的数据报文
+    [in]ses  - 命令请求session
+    [in]pkg  - 接收到的数据报文
+    [in]params - 命令参数
     
 RETURN VALUE: 
-    买卖队列的json结构
+    Zero, if success. <0, the error line number.
 
 EXCEPTION: 
     <Exception that may be thrown by the function>
@@ -1278,78 +1283,516 @@ EXAMPLE CALL:
     <Example call of the function>
 
 REMARKS:
+    order.put_stop_market属于写操作，需要检查是否server接收写操作
+    止损单加入触发队列，成交价穿越stop_price时下达市价单
+    写入operlog
+
+    order.put_stop_market命令格式
+    parmams:[user_id,market,side,amount,stop_price,taker_fee_rate,source]
+    示例
+    {"method": "order.put_stop_market", "params": [2,"BTCBCH",2,"100","11000","0.002","test"], "id": 1516681174}
 ---------------------------------------------------------------------------*/
-static json_t *get_depth(market_t *market, size_t limit)
+static int on_cmd_order_put_stop_market(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    mpd_t *price = mpd_new(&mpd_ctx);
-    mpd_t *amount = mpd_new(&mpd_ctx);
+    if (params_size(params) != 7)
+        return reply_error_invalid_argument(ses, pkg);
 
-    json_t *asks = json_array();
-    skiplist_iter *iter = skiplist_get_iterator(market->asks);
-    skiplist_node *node = skiplist_next(iter);
-    size_t index = 0;
-    while (node && index < limit) {
-        index++;
-        order_t *order = node->value;
-        mpd_copy(price, order->price, &mpd_ctx);
-        mpd_copy(amount, order->left, &mpd_ctx);
-        while ((node = skiplist_next(iter)) != NULL) {
-            order = node->value;
-            if (mpd_cmp(price, order->price, &mpd_ctx) == 0) {
-                mpd_add(amount, amount, order->left, &mpd_ctx);
-            } else {
-                break;
-            }
-        }
-        json_t *info = json_array();
-        json_array_append_new_mpd(info, price);
-        json_array_append_new_mpd(info, amount);
-        json_array_append_new(asks, info);
-    }
-    skiplist_release_iterator(iter);
+    // user_id
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
+        return reply_error_invalid_argument(ses, pkg);
 
-    json_t *bids = json_array();
-    iter = skiplist_get_iterator(market->bids);
-    node = skiplist_next(iter);
-    index = 0;
-    while (node && index < limit) {
-        index++;
-        order_t *order = node->value;
-        mpd_copy(price, order->price, &mpd_ctx);
-        mpd_copy(amount, order->left, &mpd_ctx);
-        while ((node = skiplist_next(iter)) != NULL) {
-            order = node->value;
-            if (mpd_cmp(price, order->price, &mpd_ctx) == 0) {
-                mpd_add(amount, amount, order->left, &mpd_ctx);
-            } else {
-                break;
-            }
-        }
-        json_t *info = json_array();
-        json_array_append_new_mpd(info, price);
-        json_array_append_new_mpd(info, amount);
-        json_array_append_new(bids, info);
-    }
-    skiplist_release_iterator(iter);
+    // market
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return reply_error_invalid_argument(ses, pkg);
 
-    mpd_del(price);
-    mpd_del(amount);
+    // side
+    int64_t side;
+    if (params_get_int(params, 2, &side) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
+        return reply_error_invalid_argument(ses, pkg);
 
-    json_t *result = json_object();
-    json_object_set_new(result, "asks", asks);
-    json_object_set_new(result, "bids", bids);
+    mpd_t *amount = NULL;
+    mpd_t *stop_price = NULL;
+    mpd_t *taker_fee = NULL;
 
-    return result;
-}
+    // amount
+    amount = params_get_decimal(params, 3, market->stock_prec);
+    if (amount == NULL || mpd_cmp(amount, mpd_zero, &mpd_ctx) <= 0)
+        goto invalid_argument;
 
-/*---------------------------------------------------------------------------
-FUNCTION: static json_t *get_depth_merge(market_t* market, size_t limit, mpd_t *interval)
+    // stop price
+    stop_price = params_get_decimal(params, 4, market->money_prec);
+    if (stop_price == NULL || mpd_cmp(stop_price, mpd_zero, &mpd_ctx) <= 0)
+        goto invalid_argument;
 
-PURPOSE: 
-    返回合并精度后的市场的深度信息
+    // taker fee
+    taker_fee = params_get_decimal(params, 5, market->fee_prec);
+    if (taker_fee == NULL || mpd_cmp(taker_fee, mpd_zero, &mpd_ctx) < 0 || mpd_cmp(taker_fee, mpd_one, &mpd_ctx) >= 0)
+        goto invalid_argument;
 
-PARAMETERS:
-    [in]market - 货币对市场
+    // source
+    char source[SOURCE_MAX_LEN];
+    if (params_get_str(params, 6, source, sizeof(source)) < 0)
+        goto invalid_argument;
+
+    json_t *result = NULL;
+    int ret = market_put_stop_market(true, &result, market, user_id, side, amount, stop_price, taker_fee, source);
+
+    mpd_del(amount);
+    mpd_del(stop_price);
+    mpd_del(taker_fee);
+
+    if (ret == -1) {
+        return reply_error(ses, pkg, 10, "balance not enough");
+    } else if (ret == -2) {
+        return reply_error(ses, pkg, 11, "amount too small");
+    } else if (ret == -3) {
+        return reply_error(ses, pkg, 12, "stop price crossed");
+    } else if (ret < 0) {
+        log_fatal("market_put_stop_market fail: %d", ret);
+        return reply_error_internal_error(ses, pkg);
+    }
+
+    append_operlog_params("stop_market_order", params);
+    ret = reply_result(ses, pkg, result);
+    json_decref(result);
+    return ret;
+
+invalid_argument:
+    if (amount)
+        mpd_del(amount);
+    if (stop_price)
+        mpd_del(stop_price);
+    if (taker_fee)
+        mpd_del(taker_fee);
+
+    return reply_error_invalid_argument(ses, pkg);
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int on_cmd_order_cancel_stop(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+
+PURPOSE: 
+    处理 order.cancel_stop 命令，撤销未触发的止损单
+
+PARAMETERS:
+    [in]ses  - 命令请求session
+    [in]pkg  - 接收到的数据报文
+    [in]params - 命令参数
+    
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+    order.cancel_stop 属于写操作，需要检查是否server接收写操作
+    写入operlog
+
+    order.cancel_stop 命令格式
+    parmams:[user_id,market,stop_id]
+---------------------------------------------------------------------------*/
+static int on_cmd_order_cancel_stop(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+{
+    if (params_size(params) != 3)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // user_id
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // market
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // stop_id
+    int64_t stop_id;
+    if (params_get_int(params, 2, &stop_id) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    stop_t *stop = market_get_stop(market, stop_id);
+    if (stop == NULL) {
+        return reply_error(ses, pkg, 10, "order not found");
+    }
+    if (stop->user_id != (uint32_t)user_id) {
+        return reply_error(ses, pkg, 11, "user not match");
+    }
+
+    json_t *result = NULL;
+    int ret = market_cancel_stop(true, &result, market, stop);
+    if (ret < 0) {
+        log_fatal("cancel stop: %"PRIu64" fail: %d", stop_id, ret);
+        return reply_error_internal_error(ses, pkg);
+    }
+
+    append_operlog_params("cancel_stop", params);
+    ret = reply_result(ses, pkg, result);
+    json_decref(result);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int on_cmd_order_query_stop(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+
+PURPOSE: 
+    处理 order.pending_stop 命令，返回用户未触发的止损单
+
+PARAMETERS:
+    [in]ses  - 命令请求session
+    [in]pkg  - 接收到的数据报文
+    [in]params - 命令参数
+    
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+    order.pending_stop 命令格式
+    parmams:[user_id,market,offset,limit]
+    返回格式同order.pending，records中为止损单
+---------------------------------------------------------------------------*/
+static int on_cmd_order_query_stop(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+{
+    if (params_size(params) != 4)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // user_id
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // market
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 1, market_name, sizeof(market_name)) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // offset
+    int64_t offset;
+    if (params_get_int(params, 2, &offset) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // limit
+    int64_t limit;
+    if (params_get_int(params, 3, &limit) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    if ((uint64_t)limit > ORDER_LIST_MAX_LEN)
+        return reply_error_invalid_argument(ses, pkg);
+
+    json_t *result = json_object();
+    json_object_set_new(result, "limit", json_integer(limit));
+    json_object_set_new(result, "offset", json_integer(offset));
+
+    json_t *stops = json_array();
+    skiplist_t *stop_list = market_get_stop_list(market, user_id);
+    if (stop_list == NULL) {
+        json_object_set_new(result, "total", json_integer(0));
+    } else {
+        json_object_set_new(result, "total", json_integer(stop_list->len));
+        if (offset < stop_list->len) {
+            skiplist_iter *iter = skiplist_get_iterator(stop_list);
+            skiplist_node *node;
+            for (size_t i = 0; i < offset; i++) {
+                if (skiplist_next(iter) == NULL)
+                    break;
+            }
+            size_t index = 0;
+            while ((node = skiplist_next(iter)) != NULL && index < limit) {
+                index++;
+                stop_t *stop = node->value;
+                json_array_append_new(stops, get_stop_info(stop));
+            }
+            skiplist_release_iterator(iter);
+        }
+    }
+
+    json_object_set_new(result, "records", stops);
+    int ret = reply_result(ses, pkg, result);
+    json_decref(result);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int on_cmd_order_query_all(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+
+PURPOSE: 
+    处理 order.pending_all 命令，返回用户在所有market的挂单
+
+PARAMETERS:
+    [in]ses  - 命令请求session
+    [in]pkg  - 接收到的数据报文
+    [in]params - 命令参数
+    
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+    order.pending_all 命令格式
+    parmams:[user_id,offset,limit]
+    返回格式同order.pending，records按委单id从大到小排列
+---------------------------------------------------------------------------*/
+static int on_cmd_order_query_all(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+{
+    if (params_size(params) != 3)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // user_id
+    int64_t user_id;
+    if (params_get_int(params, 0, &user_id) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // offset
+    int64_t offset;
+    if (params_get_int(params, 1, &offset) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // limit
+    int64_t limit;
+    if (params_get_int(params, 2, &limit) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    if ((uint64_t)limit > ORDER_LIST_MAX_LEN)
+        return reply_error_invalid_argument(ses, pkg);
+
+    json_t *result = json_object();
+    json_object_set_new(result, "limit", json_integer(limit));
+    json_object_set_new(result, "offset", json_integer(offset));
+
+    json_t *orders = json_array();
+    user_orders_t *list = market_get_user_orders(user_id);
+    if (list == NULL) {
+        json_object_set_new(result, "total", json_integer(0));
+    } else {
+        json_object_set_new(result, "total", json_integer(list->count));
+        order_t *order = list->head;
+        for (size_t i = 0; i < offset && order; i++) {
+            order = order->user_next;
+        }
+        for (size_t index = 0; index < limit && order; index++) {
+            json_array_append_new(orders, get_order_info(order));
+            order = order->user_next;
+        }
+    }
+
+    json_object_set_new(result, "records", orders);
+    int ret = reply_result(ses, pkg, result);
+    json_decref(result);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+
+PURPOSE: 
+    处理 order.book 命令，返回市场的订单信息
+
+PARAMETERS:
+    [in]ses  - 命令请求session
+    [in]pkg  - 接收到的数据报文
+    [in]params - 命令参数
+    
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+    order.book 命令格式
+    parmams:[market,side,offset,limit]
+---------------------------------------------------------------------------*/
+static int on_cmd_order_book(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+{
+    if (params_size(params) != 4)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // market
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market_name, sizeof(market_name)) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // side
+    int64_t side;
+    if (params_get_int(params, 1, &side) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    if (side != MARKET_ORDER_SIDE_ASK && side != MARKET_ORDER_SIDE_BID)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // offset
+    int64_t offset;
+    if (params_get_int(params, 2, &offset) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // limit
+    int64_t limit;
+    if (params_get_int(params, 3, &limit) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    if ((uint64_t)limit > ORDER_BOOK_MAX_LEN)
+        return reply_error_invalid_argument(ses, pkg);
+
+    json_t *result = json_object();
+    json_object_set_new(result, "offset", json_integer(offset));
+    json_object_set_new(result, "limit", json_integer(limit));
+
+    uint64_t total;
+    skiplist_iter *iter;
+    if (side == MARKET_ORDER_SIDE_ASK) {
+        iter = skiplist_get_iterator(market->asks);
+        total = market->asks->len;
+        json_object_set_new(result, "total", json_integer(total));
+    } else {
+        iter = skiplist_get_iterator(market->bids);
+        total = market->bids->len;
+        json_object_set_new(result, "total", json_integer(total));
+    }
+
+    json_t *orders = json_array();
+    if (offset < total) {
+        for (size_t i = 0; i < offset; i++) {
+            if (skiplist_next(iter) == NULL)
+                break;
+        }
+        size_t index = 0;
+        skiplist_node *node;
+        while ((node = skiplist_next(iter)) != NULL && index < limit) {
+            index++;
+            order_t *order = node->value;
+            json_array_append_new(orders, get_order_info(order));
+        }
+    }
+    skiplist_release_iterator(iter);
+
+    json_object_set_new(result, "orders", orders);
+    int ret = reply_result(ses, pkg, result);
+    json_decref(result);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static json_t *get_depth(market_t *market, size_t limit)
+
+PURPOSE: 
+    返回市场的深度信息
+
+PARAMETERS:
+    [in]market - 货币对市场
+    [in]limit  - 接收到的数据报文
+    
+RETURN VALUE: 
+    买卖队列的json结构
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+---------------------------------------------------------------------------*/
+static json_t *get_depth(market_t *market, size_t limit)
+{
+    mpd_t *price = mpd_new(&mpd_ctx);
+    mpd_t *amount = mpd_new(&mpd_ctx);
+
+    json_t *asks = json_array();
+    skiplist_iter *iter = skiplist_get_iterator(market->asks);
+    skiplist_node *node = skiplist_next(iter);
+    size_t index = 0;
+    while (node && index < limit) {
+        index++;
+        order_t *order = node->value;
+        mpd_copy(price, order->price, &mpd_ctx);
+        mpd_copy(amount, order->left, &mpd_ctx);
+        while ((node = skiplist_next(iter)) != NULL) {
+            order = node->value;
+            if (mpd_cmp(price, order->price, &mpd_ctx) == 0) {
+                mpd_add(amount, amount, order->left, &mpd_ctx);
+            } else {
+                break;
+            }
+        }
+        json_t *info = json_array();
+        json_array_append_new_mpd(info, price);
+        json_array_append_new_mpd(info, amount);
+        json_array_append_new(asks, info);
+    }
+    skiplist_release_iterator(iter);
+
+    json_t *bids = json_array();
+    iter = skiplist_get_iterator(market->bids);
+    node = skiplist_next(iter);
+    index = 0;
+    while (node && index < limit) {
+        index++;
+        order_t *order = node->value;
+        mpd_copy(price, order->price, &mpd_ctx);
+        mpd_copy(amount, order->left, &mpd_ctx);
+        while ((node = skiplist_next(iter)) != NULL) {
+            order = node->value;
+            if (mpd_cmp(price, order->price, &mpd_ctx) == 0) {
+                mpd_add(amount, amount, order->left, &mpd_ctx);
+            } else {
+                break;
+            }
+        }
+        json_t *info = json_array();
+        json_array_append_new_mpd(info, price);
+        json_array_append_new_mpd(info, amount);
+        json_array_append_new(bids, info);
+    }
+    skiplist_release_iterator(iter);
+
+    mpd_del(price);
+    mpd_del(amount);
+
+    json_t *result = json_object();
+    json_object_set_new(result, "asks", asks);
+    json_object_set_new(result, "bids", bids);
+
+    return result;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static json_t *get_depth_merge(market_t* market, size_t limit, mpd_t *interval)
+
+PURPOSE: 
+    返回合并精度后的市场的深度信息
+
+PARAMETERS:
+    [in]market - 货币对市场
     [in]limit  - 接收到的数据报文
     
 RETURN VALUE: 
@@ -1437,7 +1880,7 @@ static json_t *get_depth_merge(market_t* market, size_t limit, mpd_t *interval)
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_book_depth(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_book_depth(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理 order.depth 命令，返回市场的订单信息
@@ -1461,30 +1904,28 @@ REMARKS:
     order.depth 命令格式
     parmams:[market,limit,interval]
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_book_depth(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_book_depth(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 3)
+    if (params_size(params) != 3)
         return reply_error_invalid_argument(ses, pkg);
 
     // market
-    if (!json_is_string(json_array_get(params, 0)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 0));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // limit
-    if (!json_is_integer(json_array_get(params, 1)))
+    int64_t limit;
+    if (params_get_int(params, 1, &limit) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    size_t limit = json_integer_value(json_array_get(params, 1));
-    if (limit > ORDER_BOOK_MAX_LEN)
+    if ((uint64_t)limit > ORDER_BOOK_MAX_LEN)
         return reply_error_invalid_argument(ses, pkg);
 
     // interval
-    if (!json_is_string(json_array_get(params, 2)))
-        return reply_error_invalid_argument(ses, pkg);
-    mpd_t *interval = decimal(json_string_value(json_array_get(params, 2)), market->money_prec);
+    mpd_t *interval = params_get_decimal(params, 2, market->money_prec);
     if (!interval)
         return reply_error_invalid_argument(ses, pkg);
     if (mpd_cmp(interval, mpd_zero, &mpd_ctx) < 0) {
@@ -1520,7 +1961,63 @@ static int on_cmd_order_book_depth(nw_ses *ses, rpc_pkg *pkg, json_t *params)
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_book_levels(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+
+PURPOSE: 
+    处理 order.levels 命令，返回未合并的盘口快照及对应的depth消息seq
+
+PARAMETERS:
+    [in]ses  - 命令请求session
+    [in]pkg  - 接收到的数据报文
+    [in]params - 命令参数
+    
+RETURN VALUE: 
+    Zero, if success. <0, the error line number.
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+    accessws 以此快照加上kafka depth消息维护本地盘口，不使用缓存
+    order.levels 命令格式
+    parmams:[market,limit]
+    result: {"seq": 1, "asks": [[price, amount], ...], "bids": [...]}
+---------------------------------------------------------------------------*/
+static int on_cmd_order_book_levels(nw_ses *ses, rpc_pkg *pkg, params_t *params)
+{
+    if (params_size(params) != 2)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // market
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market_name, sizeof(market_name)) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    market_t *market = get_market(market_name);
+    if (market == NULL)
+        return reply_error_invalid_argument(ses, pkg);
+
+    // limit
+    int64_t limit;
+    if (params_get_int(params, 1, &limit) < 0)
+        return reply_error_invalid_argument(ses, pkg);
+    if (limit == 0 || (uint64_t)limit > ORDER_LEVELS_MAX_LEN)
+        return reply_error_invalid_argument(ses, pkg);
+
+    json_t *result = get_depth(market, limit);
+    if (result == NULL)
+        return reply_error_internal_error(ses, pkg);
+    json_object_set_new(result, "seq", json_integer(depth_message_seq(market->name)));
+
+    int ret = reply_result(ses, pkg, result);
+    json_decref(result);
+    return ret;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理 order.pending_detail 命令，查询挂单，返回订单信息
@@ -1544,23 +2041,23 @@ REMARKS:
     order.pending_detail 命令格式
     parmams:[market,order_id]
 ---------------------------------------------------------------------------*/
-static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 {
-    if (json_array_size(params) != 2)
+    if (params_size(params) != 2)
         return reply_error_invalid_argument(ses, pkg);
 
     // market
-    if (!json_is_string(json_array_get(params, 0)))
+    char market_name[MARKET_NAME_MAX_LEN + 1];
+    if (params_get_str(params, 0, market_name, sizeof(market_name)) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    const char *market_name = json_string_value(json_array_get(params, 0));
     market_t *market = get_market(market_name);
     if (market == NULL)
         return reply_error_invalid_argument(ses, pkg);
 
     // order_id
-    if (!json_is_integer(json_array_get(params, 1)))
+    int64_t order_id;
+    if (params_get_int(params, 1, &order_id) < 0)
         return reply_error_invalid_argument(ses, pkg);
-    uint64_t order_id = json_integer_value(json_array_get(params, 1));
 
     order_t *order = market_get_order(market, order_id);
     json_t *result = NULL;
@@ -1576,7 +2073,7 @@ static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, json_t *params)
 }
 
 /*---------------------------------------------------------------------------
-FUNCTION: static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, json_t *params)
+FUNCTION: static int on_cmd_order_detail(nw_ses *ses, rpc_pkg *pkg, params_t *params)
 
 PURPOSE: 
     处理 market.list 命令，返回所有货币对的基础信息
@@ -1712,6 +2209,52 @@ invalid_argument:
     return reply_error_invalid_argument(ses, pkg);
 }
 
+/*---------------------------------------------------------------------------
+FUNCTION: static bool is_params_command(uint32_t command)
+
+PURPOSE: 
+    命令处理函数是否已使用params_t
+
+PARAMETERS:
+    [in]command - 命令
+    
+RETURN VALUE: 
+    已迁移返回true，否则返回false
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS:
+    这些命令由rpc_params_decode解析，json请求体原地解析，二进制请求体
+    按命令字段表解码，都不构造jansson对象
+    其他命令仍转成jansson数组，迁移处理函数后在此添加
+---------------------------------------------------------------------------*/
+static bool is_params_command(uint32_t command)
+{
+    switch (command) {
+    case CMD_BALANCE_QUERY:
+    case CMD_ORDER_PUT_LIMIT:
+    case CMD_ORDER_PUT_MARKET:
+    case CMD_ORDER_QUERY:
+    case CMD_ORDER_CANCEL:
+    case CMD_ORDER_BOOK:
+    case CMD_ORDER_BOOK_DEPTH:
+    case CMD_ORDER_DETAIL:
+    case CMD_ORDER_PUT_STOP_LIMIT:
+    case CMD_ORDER_PUT_STOP_MARKET:
+    case CMD_ORDER_CANCEL_STOP:
+    case CMD_ORDER_QUERY_STOP:
+    case CMD_ORDER_QUERY_ALL:
+    case CMD_ORDER_BOOK_LEVELS:
+        return true;
+    default:
+        return false;
+    }
+}
+
 /*---------------------------------------------------------------------------
 FUNCTION: static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
@@ -1735,17 +2278,25 @@ REMARKS:
 ---------------------------------------------------------------------------*/
 static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    json_t *params = json_loadb(pkg->body, pkg->body_size, 0, NULL);
-    if (params == NULL || !json_is_array(params)) {
-        goto decode_error;
+    stats_cmd_begin(pkg->command, stats_now());
+    params_t args;
+    json_t *params = NULL;
+    /* jansson also takes params longer than params_t holds, like a
+     * balance.query for many assets */
+    if (!is_params_command(pkg->command) || rpc_params_decode(&args, pkg) < 0) {
+        params = rpc_params_json(pkg);
+        if (params == NULL || !json_is_array(params)) {
+            goto decode_error;
+        }
+        params_from_json(&args, params);
     }
-    sds params_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds params_str = rpc_body_str(pkg);
 
     int ret;
     switch (pkg->command) {
     case CMD_BALANCE_QUERY:
         log_trace("from: %s cmd balance query, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_balance_query(ses, pkg, params);
+        ret = on_cmd_balance_query(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_balance_query %s fail: %d", params_str, ret);
         }
@@ -1785,7 +2336,7 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
             goto cleanup;
         }
         log_trace("from: %s cmd order put limit, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_put_limit(ses, pkg, params);
+        ret = on_cmd_order_put_limit(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_put_limit %s fail: %d", params_str, ret);
         }
@@ -1798,14 +2349,14 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
             goto cleanup;
         }
         log_trace("from: %s cmd order put market, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_put_market(ses, pkg, params);
+        ret = on_cmd_order_put_market(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_put_market %s fail: %d", params_str, ret);
         }
         break;
     case CMD_ORDER_QUERY:
         log_trace("from: %s cmd order query, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_query(ses, pkg, params);
+        ret = on_cmd_order_query(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_query %s fail: %d", params_str, ret);
         }
@@ -1818,28 +2369,88 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
             goto cleanup;
         }
         log_trace("from: %s cmd order cancel, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_cancel(ses, pkg, params);
+        ret = on_cmd_order_cancel(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_cancel %s fail: %d", params_str, ret);
         }
         break;
+    case CMD_ORDER_PUT_STOP_LIMIT:
+        if (is_operlog_block() || is_history_block() || is_message_block()) {
+            log_fatal("service unavailable, operlog: %d, history: %d, message: %d",
+                    is_operlog_block(), is_history_block(), is_message_block());
+            reply_error_service_unavailable(ses, pkg);
+            goto cleanup;
+        }
+        log_trace("from: %s cmd order put stop limit, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+        ret = on_cmd_order_put_stop_limit(ses, pkg, &args);
+        if (ret < 0) {
+            log_error("on_cmd_order_put_stop_limit %s fail: %d", params_str, ret);
+        }
+        break;
+    case CMD_ORDER_PUT_STOP_MARKET:
+        if (is_operlog_block() || is_history_block() || is_message_block()) {
+            log_fatal("service unavailable, operlog: %d, history: %d, message: %d",
+                    is_operlog_block(), is_history_block(), is_message_block());
+            reply_error_service_unavailable(ses, pkg);
+            goto cleanup;
+        }
+        log_trace("from: %s cmd order put stop market, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+        ret = on_cmd_order_put_stop_market(ses, pkg, &args);
+        if (ret < 0) {
+            log_error("on_cmd_order_put_stop_market %s fail: %d", params_str, ret);
+        }
+        break;
+    case CMD_ORDER_CANCEL_STOP:
+        if (is_operlog_block() || is_history_block() || is_message_block()) {
+            log_fatal("service unavailable, operlog: %d, history: %d, message: %d",
+                    is_operlog_block(), is_history_block(), is_message_block());
+            reply_error_service_unavailable(ses, pkg);
+            goto cleanup;
+        }
+        log_trace("from: %s cmd order cancel stop, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+        ret = on_cmd_order_cancel_stop(ses, pkg, &args);
+        if (ret < 0) {
+            log_error("on_cmd_order_cancel_stop %s fail: %d", params_str, ret);
+        }
+        break;
+    case CMD_ORDER_QUERY_STOP:
+        log_trace("from: %s cmd order query stop, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+        ret = on_cmd_order_query_stop(ses, pkg, &args);
+        if (ret < 0) {
+            log_error("on_cmd_order_query_stop %s fail: %d", params_str, ret);
+        }
+        break;
+    case CMD_ORDER_QUERY_ALL:
+        log_trace("from: %s cmd order query all, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+        ret = on_cmd_order_query_all(ses, pkg, &args);
+        if (ret < 0) {
+            log_error("on_cmd_order_query_all %s fail: %d", params_str, ret);
+        }
+        break;
     case CMD_ORDER_BOOK:
         log_trace("from: %s cmd order book, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_book(ses, pkg, params);
+        ret = on_cmd_order_book(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_book %s fail: %d", params_str, ret);
         }
         break;
     case CMD_ORDER_BOOK_DEPTH:
         log_trace("from: %s cmd order book depth, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_book_depth(ses, pkg, params);
+        ret = on_cmd_order_book_depth(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_book_depth %s fail: %d", params_str, ret);
         }
         break;
+    case CMD_ORDER_BOOK_LEVELS:
+        log_trace("from: %s cmd order book levels, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
+        ret = on_cmd_order_book_levels(ses, pkg, &args);
+        if (ret < 0) {
+            log_error("on_cmd_order_book_levels %s fail: %d", params_str, ret);
+        }
+        break;
     case CMD_ORDER_DETAIL:
         log_trace("from: %s cmd order detail, sequence: %u params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->sequence, params_str);
-        ret = on_cmd_order_detail(ses, pkg, params);
+        ret = on_cmd_order_detail(ses, pkg, &args);
         if (ret < 0) {
             log_error("on_cmd_order_detail %s fail: %d", params_str, ret);
         }
@@ -1865,7 +2476,10 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 
 cleanup:
     sdsfree(params_str);
-    json_decref(params);
+    if (params) {
+        json_decref(params);
+    }
+    stats_cmd_end(stats_now());
     return;
 
 decode_error:
@@ -1877,6 +2491,7 @@ decode_error:
             nw_sock_human_addr(&ses->peer_addr), pkg->command, hex);
     sdsfree(hex);
     rpc_svr_close_clt(svr, ses);
+    stats_cmd_end(stats_now());
 
     return;
 }
@@ -0,0 +1,407 @@
+/*
+ * Description: 
+ *     History: agent, 2026/10/18, create
+ */
+
+# include "me_config.h"
+# include "me_stats.h"
+
+# define HIST_SUB_BITS      4
+# define HIST_SUB_COUNT     (1 << HIST_SUB_BITS)
+# define HIST_BUCKETS       (64 * HIST_SUB_COUNT)
+# define STATS_CMD_MAX      1024
+
+enum {
+    PHASE_QUEUE,
+    PHASE_HANDLER,
+    PHASE_REPLY,
+    PHASE_MAX,
+};
+
+static const char *phase_names[PHASE_MAX] = { "queue", "handler", "reply" };
+
+/*---------------------------------------------------------------------------
+STRUCT: struct histogram
+
+PURPOSE: 
+    对数分桶的延迟直方图，单位ns
+
+REMARKS: 
+    每个2的幂区间再分为16个桶，相对误差不超过1/16，最大值单独记录
+---------------------------------------------------------------------------*/
+struct histogram {
+    uint64_t    count;
+    uint64_t    total;
+    uint64_t    max;
+    uint64_t    buckets[HIST_BUCKETS];
+};
+
+struct cmd_stats {
+    struct histogram hist[PHASE_MAX];
+};
+
+/*---------------------------------------------------------------------------
+VARIABLE: static struct cmd_stats *cmds[STATS_CMD_MAX];
+
+PURPOSE: 
+    以命令号为下标的统计数据，第一次收到该命令时分配
+
+REMARKS: 
+    只在主线程的事件循环中读写，不需要加锁
+---------------------------------------------------------------------------*/
+static struct cmd_stats *cmds[STATS_CMD_MAX];
+
+uint64_t stats_counters[STATS_COUNTER_MAX];
+
+static const char *counter_names[STATS_COUNTER_MAX] = {
+    "orders put", "orders cancel", "deals", "cache hit", "cache miss",
+};
+
+static struct cmd_stats *current;
+static uint64_t current_begin;
+static uint64_t current_reply;
+static double reset_time;
+static nw_timer timer;
+static ev_check loop_watcher;
+static uint64_t loop_begin;
+
+static int hist_index(uint64_t value)
+{
+    if (value < HIST_SUB_COUNT)
+        return value;
+    int exp = 63 - __builtin_clzll(value);
+    return (exp - HIST_SUB_BITS + 1) * HIST_SUB_COUNT + ((value >> (exp - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+static uint64_t hist_value(int index)
+{
+    if (index < HIST_SUB_COUNT)
+        return index;
+    int exp = index / HIST_SUB_COUNT + HIST_SUB_BITS - 1;
+    uint64_t sub = index % HIST_SUB_COUNT;
+    return (HIST_SUB_COUNT + sub) << (exp - HIST_SUB_BITS);
+}
+
+static void hist_add(struct histogram *hist, uint64_t value)
+{
+    hist->count += 1;
+    hist->total += value;
+    if (value > hist->max)
+        hist->max = value;
+    hist->buckets[hist_index(value)] += 1;
+}
+
+static uint64_t hist_percentile(struct histogram *hist, double p)
+{
+    uint64_t rank = (uint64_t)(hist->count * p);
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += hist->buckets[i];
+        if (seen > rank) {
+            uint64_t upper = i + 1 < HIST_BUCKETS ? hist_value(i + 1) - 1 : hist->max;
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: uint64_t stats_now(void)
+
+PURPOSE: 
+    取统计用的时间戳，单位纳秒
+
+PARAMETERS:
+    None
+
+RETURN VALUE: 
+    单调时钟的纳秒数
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    使用CLOCK_MONOTONIC，系统时间被调整时耗时不会跳变，只能用于计算时间差
+---------------------------------------------------------------------------*/
+uint64_t stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static void on_loop_begin(struct ev_loop *loop, ev_check *watcher, int events)
+
+PURPOSE: 
+    记录本轮事件循环开始处理事件的时间
+
+PARAMETERS:
+    [in]loop - 
+    [in]watcher - 
+    [in]events - 
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    check在poll返回后、其他回调之前执行，替代ev_now()，
+    因为ev_now()是系统时间，与stats_now()不能相减
+---------------------------------------------------------------------------*/
+static void on_loop_begin(struct ev_loop *loop, ev_check *watcher, int events)
+{
+    loop_begin = stats_now();
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: void stats_cmd_begin(uint32_t command, uint64_t now)
+
+PURPOSE: 
+    开始统计一个rpc命令，记录排队时间
+
+PARAMETERS:
+    command - 命令号
+    now     - stats_now()
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    排队时间为本轮事件循环开始到命令开始处理的时间，
+    即同一轮中排在前面的命令的处理时间
+---------------------------------------------------------------------------*/
+void stats_cmd_begin(uint32_t command, uint64_t now)
+{
+    current = NULL;
+    if (command >= STATS_CMD_MAX)
+        return;
+    if (cmds[command] == NULL) {
+        cmds[command] = malloc(sizeof(struct cmd_stats));
+        if (cmds[command] == NULL)
+            return;
+        memset(cmds[command], 0, sizeof(struct cmd_stats));
+    }
+
+    current = cmds[command];
+    current_begin = now;
+    current_reply = 0;
+
+    hist_add(&current->hist[PHASE_QUEUE], now > loop_begin ? now - loop_begin : 0);
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: void stats_cmd_end(uint64_t now)
+
+PURPOSE: 
+    结束统计当前rpc命令，记录处理时间和响应序列化发送时间
+
+PARAMETERS:
+    now - stats_now()
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    处理时间不包含响应的序列化发送时间
+---------------------------------------------------------------------------*/
+void stats_cmd_end(uint64_t now)
+{
+    if (current == NULL)
+        return;
+
+    uint64_t elapsed = now > current_begin ? now - current_begin : 0;
+    if (elapsed > current_reply)
+        elapsed -= current_reply;
+    else
+        elapsed = 0;
+    hist_add(&current->hist[PHASE_HANDLER], elapsed);
+    hist_add(&current->hist[PHASE_REPLY], current_reply);
+    current = NULL;
+}
+
+void stats_reply(uint64_t elapsed)
+{
+    if (current)
+        current_reply += elapsed;
+}
+
+static const char *cmd_name(uint32_t command)
+{
+    switch (command) {
+    case CMD_BALANCE_QUERY:         return "balance.query";
+    case CMD_BALANCE_UPDATE:        return "balance.update";
+    case CMD_ASSET_LIST:            return "asset.list";
+    case CMD_ASSET_SUMMARY:         return "asset.summary";
+    case CMD_ORDER_PUT_LIMIT:       return "order.put_limit";
+    case CMD_ORDER_PUT_MARKET:      return "order.put_market";
+    case CMD_ORDER_QUERY:           return "order.pending";
+    case CMD_ORDER_CANCEL:          return "order.cancel";
+    case CMD_ORDER_BOOK:            return "order.book";
+    case CMD_ORDER_BOOK_DEPTH:      return "order.depth";
+    case CMD_ORDER_BOOK_LEVELS:     return "order.levels";
+    case CMD_ORDER_DETAIL:          return "order.pending_detail";
+    case CMD_ORDER_PUT_STOP_LIMIT:  return "order.put_stop_limit";
+    case CMD_ORDER_PUT_STOP_MARKET: return "order.put_stop_market";
+    case CMD_ORDER_CANCEL_STOP:     return "order.cancel_stop";
+    case CMD_ORDER_QUERY_STOP:      return "order.pending_stop";
+    case CMD_ORDER_QUERY_ALL:       return "order.pending_all";
+    case CMD_MARKET_LIST:           return "market.list";
+    case CMD_MARKET_SUMMARY:        return "market.summary";
+    default:                        return "unknown";
+    }
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: sds stats_status(sds reply)
+
+PURPOSE: 
+    输出计数器和每个命令的延迟分位数
+
+PARAMETERS:
+    reply - 结果附加到该字符串尾部
+
+RETURN VALUE: 
+    拼接之后的字符串
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    cli 收到命令 stats 时调用，单位us，统计区间从上次重置开始
+---------------------------------------------------------------------------*/
+sds stats_status(sds reply)
+{
+    double elapsed = current_timestamp() - reset_time;
+    reply = sdscatprintf(reply, "stats since: %.3f seconds ago\n", elapsed);
+    for (int i = 0; i < STATS_COUNTER_MAX; ++i) {
+        reply = sdscatprintf(reply, "%s: %"PRIu64"\n", counter_names[i], stats_counters[i]);
+    }
+
+    nw_ses_cork_stat cork;
+    nw_ses_get_cork_stat(&cork);
+    if (cork.send_count) {
+        reply = sdscatprintf(reply, "cork since start, send: %"PRIu64", write: %"PRIu64", flush: %"PRIu64", syscalls saved: %"PRIu64"\n",
+                cork.send_count, cork.write_count, cork.flush_count, cork.send_count - cork.write_count);
+    }
+
+    for (uint32_t command = 0; command < STATS_CMD_MAX; ++command) {
+        struct cmd_stats *stats = cmds[command];
+        if (stats == NULL || stats->hist[PHASE_HANDLER].count == 0)
+            continue;
+        reply = sdscatprintf(reply, "cmd %u %s count: %"PRIu64"\n", command, cmd_name(command), stats->hist[PHASE_HANDLER].count);
+        for (int i = 0; i < PHASE_MAX; ++i) {
+            struct histogram *hist = &stats->hist[i];
+            if (hist->count == 0)
+                continue;
+            reply = sdscatprintf(reply, "    %-8s avg: %.1f, p50: %.1f, p99: %.1f, p999: %.1f, max: %.1f\n", phase_names[i],
+                    hist->total / 1000.0 / hist->count,
+                    hist_percentile(hist, 0.5) / 1000.0,
+                    hist_percentile(hist, 0.99) / 1000.0,
+                    hist_percentile(hist, 0.999) / 1000.0,
+                    hist->max / 1000.0);
+        }
+    }
+
+    return reply;
+}
+
+void stats_reset(void)
+{
+    for (uint32_t command = 0; command < STATS_CMD_MAX; ++command) {
+        if (cmds[command]) {
+            memset(cmds[command], 0, sizeof(struct cmd_stats));
+        }
+    }
+    memset(stats_counters, 0, sizeof(stats_counters));
+    reset_time = current_timestamp();
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: static void on_timer(nw_timer *timer, void *privdata)
+
+PURPOSE: 
+    定时输出统计数据到日志，并重新开始统计
+
+PARAMETERS:
+    [in]timer - 
+    [in]privdata - 
+
+RETURN VALUE: 
+    None
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    间隔为config.json中的stats_interval
+---------------------------------------------------------------------------*/
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    sds reply = stats_status(sdsempty());
+    log_info("stats:\n%s", reply);
+    sdsfree(reply);
+    stats_reset();
+}
+
+/*---------------------------------------------------------------------------
+FUNCTION: int init_stats(void)
+
+PURPOSE: 
+    启动统计数据的定时日志
+
+PARAMETERS:
+    None
+
+RETURN VALUE: 
+    0
+
+EXCEPTION: 
+    <Exception that may be thrown by the function>
+
+EXAMPLE CALL:
+    <Example call of the function>
+
+REMARKS: 
+    stats_interval为0时不输出日志，统计数据只能通过cli stats查询和重置
+---------------------------------------------------------------------------*/
+int init_stats(void)
+{
+    reset_time = current_timestamp();
+    ev_check_init(&loop_watcher, on_loop_begin);
+    ev_set_priority(&loop_watcher, EV_MAXPRI);
+    ev_check_start(nw_default_loop, &loop_watcher);
+    if (settings.stats_interval > 0) {
+        nw_timer_set(&timer, settings.stats_interval, true, on_timer, NULL);
+        nw_timer_start(&timer);
+    }
+
+    return 0;
+}
+
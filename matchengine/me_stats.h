@@ -0,0 +1,35 @@
+/*
+ * Description: 
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _ME_STATS_H_
+# define _ME_STATS_H_
+
+# include "me_config.h"
+
+enum {
+    STATS_ORDERS_PUT,
+    STATS_ORDERS_CANCEL,
+    STATS_DEALS,
+    STATS_CACHE_HIT,
+    STATS_CACHE_MISS,
+    STATS_COUNTER_MAX,
+};
+
+extern uint64_t stats_counters[STATS_COUNTER_MAX];
+
+# define stats_inc(id) (stats_counters[id]++)
+
+int init_stats(void);
+
+uint64_t stats_now(void);
+void stats_cmd_begin(uint32_t command, uint64_t now);
+void stats_cmd_end(uint64_t now);
+void stats_reply(uint64_t elapsed);
+
+sds stats_status(sds reply);
+void stats_reset(void);
+
+# endif
+
@@ -9,6 +9,8 @@
 
 # define NW_BUF_POOL_INIT_SIZE 64
 # define NW_BUF_POOL_MAX_SIZE  65535
+# define NW_BUF_POOL_CACHE_MEM (32 * 1024 * 1024)
+# define NW_BUF_POOL_CACHE_MIN 4
 # define NW_CACHE_INIT_SIZE    64
 # define NW_CACHE_MAX_SIZE     65535
 
@@ -42,72 +44,134 @@ void nw_buf_shift(nw_buf *buf)
     }
 }
 
+static nw_buf_class *get_class(nw_buf_pool *pool, size_t size)
+{
+    for (uint32_t i = 0; i < pool->class_count; ++i) {
+        if (pool->classes[i].size >= size)
+            return &pool->classes[i];
+    }
+    return NULL;
+}
+
 nw_buf_pool *nw_buf_pool_create(uint32_t size)
 {
     nw_buf_pool *pool = malloc(sizeof(nw_buf_pool));
     if (pool == NULL)
         return NULL;
-
+    memset(pool, 0, sizeof(nw_buf_pool));
     pool->size = size;
-    pool->used = 0;
-    pool->free = 0;
-    pool->free_total = NW_BUF_POOL_INIT_SIZE;
-    pool->free_arr = malloc(pool->free_total * sizeof(nw_buf *));
-    if (pool->free_arr == NULL) {
-        free(pool);
-        return NULL;
+
+    uint32_t class_size = NW_BUF_MIN_SIZE;
+    while (pool->class_count < NW_BUF_CLASS_MAX) {
+        nw_buf_class *class = &pool->classes[pool->class_count++];
+        class->size = class_size < size && pool->class_count < NW_BUF_CLASS_MAX ? class_size : size;
+        class->free_total = NW_BUF_POOL_INIT_SIZE;
+        class->free_max = NW_BUF_POOL_CACHE_MEM / class->size;
+        if (class->free_max < NW_BUF_POOL_CACHE_MIN)
+            class->free_max = NW_BUF_POOL_CACHE_MIN;
+        if (class->free_max > NW_BUF_POOL_MAX_SIZE)
+            class->free_max = NW_BUF_POOL_MAX_SIZE;
+        class->free_arr = malloc(class->free_total * sizeof(nw_buf *));
+        if (class->free_arr == NULL) {
+            nw_buf_pool_release(pool);
+            return NULL;
+        }
+        if (class->size == size)
+            break;
+        class_size *= 2;
     }
 
     return pool;
 }
 
-nw_buf *nw_buf_alloc(nw_buf_pool *pool)
+static nw_buf *class_alloc(nw_buf_pool *pool, nw_buf_class *class)
 {
-    if (pool->free) {
-        nw_buf *buf = pool->free_arr[--pool->free];
-        buf->size = pool->size;
-        buf->rpos = 0;
-        buf->wpos = 0;
-        buf->next = NULL;
-        return buf;
+    nw_buf *buf;
+    if (class->free) {
+        buf = class->free_arr[--class->free];
+    } else {
+        buf = malloc(sizeof(nw_buf) + class->size);
+        if (buf == NULL)
+            return NULL;
+        pool->mem_total += class->size;
     }
-
-    nw_buf *buf = malloc(sizeof(nw_buf) + pool->size);
-    if (buf == NULL)
-        return NULL;
-    buf->size = pool->size;
+    buf->size = class->size;
     buf->rpos = 0;
     buf->wpos = 0;
     buf->next = NULL;
+    buf->shared = NULL;
+
+    class->used++;
+    pool->mem_used += class->size;
+    if (pool->mem_used > pool->mem_peak)
+        pool->mem_peak = pool->mem_used;
 
     return buf;
 }
 
+nw_buf *nw_buf_alloc(nw_buf_pool *pool)
+{
+    return class_alloc(pool, &pool->classes[pool->class_count - 1]);
+}
+
+nw_buf *nw_buf_alloc_size(nw_buf_pool *pool, size_t size)
+{
+    nw_buf_class *class = get_class(pool, size);
+    if (class == NULL)
+        return NULL;
+    return class_alloc(pool, class);
+}
+
+nw_buf *nw_buf_expand(nw_buf_pool *pool, nw_buf *buf)
+{
+    nw_buf *new_buf = nw_buf_alloc_size(pool, (size_t)buf->size + 1);
+    if (new_buf == NULL)
+        return NULL;
+    nw_buf_write(new_buf, buf->data + buf->rpos, nw_buf_size(buf));
+    nw_buf_free(pool, buf);
+    return new_buf;
+}
+
 void nw_buf_free(nw_buf_pool *pool, nw_buf *buf)
 {
-    if (pool->free < pool->free_total) {
-        pool->free_arr[pool->free++] = buf;
-    } else if (pool->free_total < NW_BUF_POOL_MAX_SIZE) {
-        uint32_t new_free_total = pool->free_total * 2;
-        void *new_arr = realloc(pool->free_arr, new_free_total * sizeof(nw_buf *));
+    if (buf->shared) {
+        nw_buf_shared_release(buf->shared);
+        free(buf);
+        return;
+    }
+
+    nw_buf_class *class = get_class(pool, buf->size);
+    class->used--;
+    pool->mem_used -= class->size;
+
+    if (class->free < class->free_total) {
+        class->free_arr[class->free++] = buf;
+        return;
+    } else if (class->free_total < class->free_max) {
+        uint32_t new_free_total = class->free_total * 2;
+        if (new_free_total > class->free_max)
+            new_free_total = class->free_max;
+        void *new_arr = realloc(class->free_arr, new_free_total * sizeof(nw_buf *));
         if (new_arr) {
-            pool->free_total = new_free_total;
-            pool->free_arr = new_arr;
-            pool->free_arr[pool->free++] = buf;
-        } else {
-            free(buf);
+            class->free_total = new_free_total;
+            class->free_arr = new_arr;
+            class->free_arr[class->free++] = buf;
+            return;
         }
-    } else {
-        free(buf);
     }
+    pool->mem_total -= class->size;
+    free(buf);
 }
 
 void nw_buf_pool_release(nw_buf_pool *pool)
 {
-    for (uint32_t i = 0; i < pool->free; ++i) {
-        free(pool->free_arr[i]);
+    for (uint32_t i = 0; i < pool->class_count; ++i) {
+        nw_buf_class *class = &pool->classes[i];
+        for (uint32_t j = 0; j < class->free; ++j) {
+            free(class->free_arr[j]);
+        }
+        free(class->free_arr);
     }
-    free(pool->free_arr);
     free(pool);
 }
 
@@ -139,7 +203,14 @@ size_t nw_buf_list_write(nw_buf_list *list, const void *data, size_t len)
     while (left) {
         if (list->limit && list->count >= list->limit)
             return len - left;
-        nw_buf *buf = nw_buf_alloc(list->pool);
+        /* at least double the tail, so a backlog of limit bufs still
+         * holds about as much as it did with max size bufs */
+        size_t want = left;
+        if (list->tail && want < (size_t)list->tail->size * 2)
+            want = (size_t)list->tail->size * 2;
+        if (want > list->pool->size)
+            want = list->pool->size;
+        nw_buf *buf = nw_buf_alloc_size(list->pool, want);
         if (buf == NULL)
             return len - left;
         if (list->head == NULL)
@@ -160,13 +231,9 @@ size_t nw_buf_list_append(nw_buf_list *list, const void *data, size_t len)
 {
     if (list->limit && list->count >= list->limit)
         return 0;
-    nw_buf *buf = nw_buf_alloc(list->pool);
+    nw_buf *buf = nw_buf_alloc_size(list->pool, len);
     if (buf == NULL)
         return 0;
-    if (len > buf->size) {
-        nw_buf_free(list->pool, buf);
-        return 0;
-    }
     nw_buf_write(buf, data, len);
     if (list->head == NULL)
         list->head = buf;
@@ -178,6 +245,31 @@ size_t nw_buf_list_append(nw_buf_list *list, const void *data, size_t len)
     return len;
 }
 
+size_t nw_buf_list_append_shared(nw_buf_list *list, nw_buf_shared *shared, size_t offset)
+{
+    if (list->limit && list->count >= list->limit)
+        return 0;
+    if (offset >= shared->size)
+        return 0;
+    nw_buf *buf = malloc(sizeof(nw_buf));
+    if (buf == NULL)
+        return 0;
+    /* full, so writes to the list go to a new buf after it */
+    buf->size = shared->size;
+    buf->rpos = offset;
+    buf->wpos = shared->size;
+    buf->next = NULL;
+    buf->shared = nw_buf_shared_hold(shared);
+    if (list->head == NULL)
+        list->head = buf;
+    if (list->tail != NULL)
+        list->tail->next = buf;
+    list->tail = buf;
+    list->count++;
+
+    return shared->size - offset;
+}
+
 void nw_buf_list_shift(nw_buf_list *list)
 {
     if (list->head) {
@@ -204,6 +296,29 @@ void nw_buf_list_release(nw_buf_list *list)
 }
 
 
+nw_buf_shared *nw_buf_shared_create(size_t size)
+{
+    nw_buf_shared *shared = malloc(sizeof(nw_buf_shared) + size);
+    if (shared == NULL)
+        return NULL;
+    shared->ref = 1;
+    shared->size = size;
+
+    return shared;
+}
+
+nw_buf_shared *nw_buf_shared_hold(nw_buf_shared *shared)
+{
+    shared->ref++;
+    return shared;
+}
+
+void nw_buf_shared_release(nw_buf_shared *shared)
+{
+    if (--shared->ref == 0)
+        free(shared);
+}
+
 nw_cache *nw_cache_create(uint32_t size)
 {
     nw_cache *cache = malloc(sizeof(nw_cache));
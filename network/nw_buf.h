@@ -11,22 +11,56 @@
 
 /* buf management */
 
+/* nw_buf_shared is data written once and sent to many sessions, write
+ * lists queue it by reference, it is freed with the last reference */
+typedef struct nw_buf_shared {
+    uint32_t ref;
+    uint32_t size;
+    char data[];
+} nw_buf_shared;
+
 /* nw_buf is the basic instance of buf, with limit size */
 typedef struct nw_buf {
     uint32_t size;
     uint32_t rpos;
     uint32_t wpos;
     struct nw_buf *next;
+    /* not NULL when the buf is a full reference to a shared buf */
+    nw_buf_shared *shared;
     char data[];
 } nw_buf;
 
-/* nw_buf_pool is a factory of nw_buf */
-typedef struct nw_buf_pool {
+/* start of the data, a shared buf points into its nw_buf_shared */
+static inline char *nw_buf_data(nw_buf *buf)
+{
+    return buf->shared ? buf->shared->data : buf->data;
+}
+
+/* smallest size class, classes double from here up to the pool size */
+# define NW_BUF_MIN_SIZE    256
+# define NW_BUF_CLASS_MAX   32
+
+typedef struct nw_buf_class {
     uint32_t size;
     uint32_t used;
     uint32_t free;
+    uint32_t free_max;
     uint32_t free_total;
     nw_buf **free_arr;
+} nw_buf_class;
+
+/* nw_buf_pool is a factory of nw_buf, size is the max buf size, smaller
+ * bufs are served from power of two size classes so idle or lightly
+ * used sessions do not pin a max size buf each */
+typedef struct nw_buf_pool {
+    uint32_t size;
+    uint32_t class_count;
+    nw_buf_class classes[NW_BUF_CLASS_MAX];
+    /* bytes held by the pool, in use plus cached */
+    uint64_t mem_total;
+    /* bytes held by allocated bufs and its high watermark */
+    uint64_t mem_used;
+    uint64_t mem_peak;
 } nw_buf_pool;
 
 /* nw_buf_list is a list of nw_buf, if limit is not 0, contain at most `limit` buf instance */
@@ -55,7 +89,12 @@ void nw_buf_shift(nw_buf *buf);
 
 /* nw_buf_pool operation */
 nw_buf_pool *nw_buf_pool_create(uint32_t size);
+/* alloc a max size buf */
 nw_buf *nw_buf_alloc(nw_buf_pool *pool);
+/* alloc the smallest buf that hold at least size bytes, NULL if size bigger than pool size */
+nw_buf *nw_buf_alloc_size(nw_buf_pool *pool, size_t size);
+/* move the data to a buf of the next size class, return NULL and keep the old buf on failure */
+nw_buf *nw_buf_expand(nw_buf_pool *pool, nw_buf *buf);
 void nw_buf_free(nw_buf_pool *pool, nw_buf *buf);
 void nw_buf_pool_release(nw_buf_pool *pool);
 
@@ -66,10 +105,17 @@ size_t nw_buf_list_write(nw_buf_list *list, const void *data, size_t len);
 /* append data to a new buf instance, will expand the list, len shoud not big than buf size
  * return the size actually write */
 size_t nw_buf_list_append(nw_buf_list *list, const void *data, size_t len);
+/* queue a reference to shared from offset on, no copy, return 0 if the list is full */
+size_t nw_buf_list_append_shared(nw_buf_list *list, nw_buf_shared *shared, size_t offset);
 /* remove the head buf if exist */
 void nw_buf_list_shift(nw_buf_list *list);
 void nw_buf_list_release(nw_buf_list *list);
 
+/* nw_buf_shared operation, created with one reference */
+nw_buf_shared *nw_buf_shared_create(size_t size);
+nw_buf_shared *nw_buf_shared_hold(nw_buf_shared *shared);
+void nw_buf_shared_release(nw_buf_shared *shared);
+
 /* nw_cache operation */
 nw_cache *nw_cache_create(uint32_t size);
 void *nw_cache_alloc(nw_cache *cache);
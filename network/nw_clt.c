@@ -9,6 +9,7 @@
 # include <sys/time.h>
 
 # include "nw_clt.h"
+# include "nw_shm.h"
 
 static int create_socket(int family, int sock_type)
 {
@@ -110,6 +111,12 @@ static void on_connect(nw_ses *ses, bool result)
         clt->connected = true;
         set_socket_option(clt, clt->ses.sockfd);
         nw_sock_host_addr(ses->sockfd, ses->host_addr);
+        if (clt->shm_size) {
+            ses->shm = nw_shm_connect(ses, clt->shm_size, clt->buf_pool->size);
+            if (ses->shm == NULL && clt->type.on_error_msg) {
+                clt->type.on_error_msg(ses, "shm connect fail, use the socket");
+            }
+        }
         if (clt->type.on_connect) {
             clt->type.on_connect(ses, result);
         }
@@ -193,6 +200,8 @@ nw_clt *nw_clt_create(nw_clt_cfg *cfg, nw_clt_type *type, void *privdata)
     }
     clt->read_mem = cfg->read_mem;
     clt->write_mem = cfg->write_mem;
+    if (cfg->sock_type == SOCK_SEQPACKET && cfg->addr.family == AF_UNIX)
+        clt->shm_size = cfg->shm_size;
 
     nw_addr_t *host_addr = malloc(sizeof(nw_addr_t));
     if (host_addr == NULL) {
@@ -275,6 +284,9 @@ int nw_clt_close(nw_clt *clt)
 
 void nw_clt_release(nw_clt *clt)
 {
+    if (nw_timer_active(&clt->timer)) {
+        nw_timer_stop(&clt->timer);
+    }
     nw_ses_release(&clt->ses);
     if (!clt->custom_buf_pool && clt->buf_pool) {
         nw_buf_pool_release(clt->buf_pool);
@@ -35,6 +35,9 @@ typedef struct nw_clt_cfg {
     double reconnect_timeout;
     /* buf factory, if set to NULL, nw_clt will create it */
     nw_buf_pool *buf_pool;
+    /* if not 0 and the addr is a unix seqpacket socket, offer the server
+     * shared memory rings of this size after connect, see nw_shm */
+    uint32_t shm_size;
 } nw_clt_cfg;
 
 typedef struct nw_clt_type {
@@ -82,6 +85,7 @@ typedef struct nw_clt {
     double reconnect_timeout;
     uint32_t read_mem;
     uint32_t write_mem;
+    uint32_t shm_size;
 } nw_clt;
 
 /* create a client instance, the privdata will assign to nw_clt privdata */
@@ -1,107 +1,244 @@
 /*
- * Description: 
+ * Description:
  *     History: yang@haipo.me, 2016/04/17, create
  */
 
 # include <stdlib.h>
 # include <unistd.h>
 # include <assert.h>
+# include <errno.h>
+# include <sys/eventfd.h>
 
 # include "nw_job.h"
 # include "nw_sock.h"
 
-struct thread_arg {
+# define CACHE_LINE_SIZE 64
+
+/* SPSC ring, for requests the main thread is the producer and the
+ * worker the consumer, for replies the other way round */
+struct nw_job_ring {
+    size_t mask;
+    nw_job_entry **entries;
+    size_t head __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t tail __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+struct nw_job_worker {
     nw_job *job;
+    struct nw_job_ring *requests;
+    struct nw_job_ring *replies;
     void *privdata;
+    sem_t sem;
+    /* set by the worker before it waits on sem, cleared by the waker */
+    int sleeping __attribute__((aligned(CACHE_LINE_SIZE)));
 };
 
-static void *thread_routine(void *data)
+static struct nw_job_ring *ring_create(size_t size)
+{
+    struct nw_job_ring *ring = NULL;
+    if (posix_memalign((void **)&ring, CACHE_LINE_SIZE, sizeof(struct nw_job_ring)) != 0)
+        return NULL;
+    memset(ring, 0, sizeof(struct nw_job_ring));
+    ring->mask = size - 1;
+    ring->entries = calloc(size, sizeof(nw_job_entry *));
+    if (ring->entries == NULL) {
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+static void ring_release(struct nw_job_ring *ring)
+{
+    free(ring->entries);
+    free(ring);
+}
+
+static int ring_push(struct nw_job_ring *ring, nw_job_entry *entry)
+{
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail - head > ring->mask)
+        return -1;
+    ring->entries[tail & ring->mask] = entry;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static nw_job_entry *ring_pop(struct nw_job_ring *ring)
 {
-    struct thread_arg *arg = data;
-    nw_job *job = arg->job;
-    void *privdata = arg->privdata;
-    free(data);
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return NULL;
+    nw_job_entry *entry = ring->entries[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return entry;
+}
 
+static struct nw_job_worker *worker_create(nw_job *job)
+{
+    struct nw_job_worker *worker = NULL;
+    if (posix_memalign((void **)&worker, CACHE_LINE_SIZE, sizeof(struct nw_job_worker)) != 0)
+        return NULL;
+    memset(worker, 0, sizeof(struct nw_job_worker));
+    worker->job = job;
+    if (sem_init(&worker->sem, 0, 0) != 0) {
+        free(worker);
+        return NULL;
+    }
+    worker->requests = ring_create(NW_JOB_QUEUE_SIZE);
+    worker->replies = ring_create(NW_JOB_QUEUE_SIZE);
+    if (worker->requests == NULL || worker->replies == NULL) {
+        if (worker->requests)
+            ring_release(worker->requests);
+        if (worker->replies)
+            ring_release(worker->replies);
+        sem_destroy(&worker->sem);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+static void worker_release(struct nw_job_worker *worker)
+{
+    ring_release(worker->requests);
+    ring_release(worker->replies);
+    sem_destroy(&worker->sem);
+    free(worker);
+}
+
+static void worker_wakeup(struct nw_job_worker *worker)
+{
+    if (__atomic_load_n(&worker->sleeping, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&worker->sleeping, 0, __ATOMIC_SEQ_CST)) {
+        sem_post(&worker->sem);
+    }
+}
+
+static void notify_main(nw_job *job)
+{
+    if (__atomic_exchange_n(&job->notified, 1, __ATOMIC_SEQ_CST) == 0) {
+        uint64_t value = 1;
+        while (write(job->eventfd, &value, sizeof(value)) < 0 && errno == EINTR);
+    }
+}
+
+/* take the next request, sleep only once the ring is empty. the flag is
+ * set before looking again, so a push that missed it is seen here */
+static nw_job_entry *worker_next(struct nw_job_worker *worker)
+{
+    nw_job *job = worker->job;
     for (;;) {
-        pthread_mutex_lock(&job->lock);
-        while ((job->request_count == 0) && (!job->shutdown)) {
-            pthread_cond_wait(&job->notify, &job->lock);
-        }
-        if (job->shutdown) {
-            break;
+        if (__atomic_load_n(&job->shutdown, __ATOMIC_ACQUIRE))
+            return NULL;
+        nw_job_entry *entry = ring_pop(worker->requests);
+        if (entry)
+            return entry;
+
+        __atomic_store_n(&worker->sleeping, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        entry = ring_pop(worker->requests);
+        if (entry) {
+            /* a waker that cleared the flag leaves one spare post, the
+             * next wait just returns and looks again */
+            __atomic_store_n(&worker->sleeping, 0, __ATOMIC_SEQ_CST);
+            return entry;
         }
-        assert(job->request_head != NULL);
-        nw_job_entry *entry = job->request_head;
-        job->request_head = entry->next;
-        if (job->request_head) {
-            job->request_head->prev = NULL;
-        } else {
-            job->request_tail = NULL;
+        if (__atomic_load_n(&job->shutdown, __ATOMIC_ACQUIRE))
+            return NULL;
+        while (sem_wait(&worker->sem) != 0 && errno == EINTR);
+    }
+}
+
+static void *thread_routine(void *data)
+{
+    struct nw_job_worker *worker = data;
+    nw_job *job = worker->job;
+
+    nw_job_entry *entry;
+    while ((entry = worker_next(worker)) != NULL) {
+        job->type.on_job(entry, worker->privdata);
+
+        while (ring_push(worker->replies, entry) < 0) {
+            notify_main(job);
+            usleep(100);
         }
-        job->request_count -= 1;
-        pthread_mutex_unlock(&job->lock);
-
-        job->type.on_job(entry, privdata);
-
-        pthread_mutex_lock(&job->lock);
-        if (job->reply_tail) {
-            entry->prev = job->reply_tail;
-            entry->next = NULL;
-            job->reply_tail->next = entry;
-            job->reply_tail = entry;
-        } else {
-            entry->prev = NULL;
-            entry->next = NULL;
-            job->reply_head = entry;
-            job->reply_tail = entry;
+        notify_main(job);
+    }
+
+    return worker->privdata;
+}
+
+/* round robin over the workers, skipping those with a full ring */
+static int dispatch(nw_job *job, nw_job_entry *entry)
+{
+    for (int i = 0; i < job->thread_start; ++i) {
+        struct nw_job_worker *worker = job->workers[job->next_worker];
+        job->next_worker = (job->next_worker + 1) % job->thread_start;
+        if (ring_push(worker->requests, entry) == 0) {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            worker_wakeup(worker);
+            return 0;
         }
-        job->reply_count += 1;
-        write(job->pipefd[1], " ", 1);
-        pthread_mutex_unlock(&job->lock);
     }
+    return -1;
+}
 
-    pthread_mutex_unlock(&job->lock);
-    return privdata;
+static void flush_pending(nw_job *job)
+{
+    while (job->pending_head) {
+        nw_job_entry *entry = job->pending_head;
+        if (dispatch(job, entry) < 0)
+            break;
+        job->pending_head = entry->next;
+        if (job->pending_head == NULL)
+            job->pending_tail = NULL;
+    }
 }
 
 static void on_can_read(struct ev_loop *loop, ev_io *watcher, int events)
 {
     nw_job *job = (nw_job *)watcher;
-    for (;;) {
-        char c;
-        int ret = read(job->pipefd[0], &c, 1);
-        if (ret < 0)
-            break;
-    }
+    uint64_t value;
+    while (read(job->eventfd, &value, sizeof(value)) < 0 && errno == EINTR);
 
-    for (;;) {
-        pthread_mutex_lock(&job->lock);
-        if (job->reply_count == 0) {
-            pthread_mutex_unlock(&job->lock);
-            break;
-        }
-        nw_job_entry *entry = job->reply_head;
-        job->reply_head = entry->next;
-        if (job->reply_head) {
-            job->reply_head->prev = NULL;
-        } else {
-            job->reply_tail = NULL;
-        }
-        job->reply_count -= 1;
-        pthread_mutex_unlock(&job->lock);
+    /* clear before draining, a reply pushed after this will notify again */
+    __atomic_store_n(&job->notified, 0, __ATOMIC_SEQ_CST);
 
-        if (job->type.on_finish)
-            job->type.on_finish(entry);
-        if (job->type.on_cleanup)
-            job->type.on_cleanup(entry);
-        nw_cache_free(job->cache, entry);
+    for (int i = 0; i < job->thread_start; ++i) {
+        struct nw_job_ring *ring = job->workers[i]->replies;
+        size_t head = ring->head;
+        size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            nw_job_entry *entry = ring->entries[head & ring->mask];
+            job->request_count -= 1;
+            if (job->type.on_finish)
+                job->type.on_finish(entry);
+            if (job->type.on_cleanup)
+                job->type.on_cleanup(entry);
+            nw_cache_free(job->cache, entry);
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
     }
+
+    flush_pending(job);
 }
 
 static void nw_job_free(nw_job *job)
 {
-    pthread_mutex_destroy(&job->lock);
-    pthread_cond_destroy(&job->notify);
+    if (job->workers) {
+        for (int i = 0; i < job->thread_count; ++i) {
+            if (job->workers[i])
+                worker_release(job->workers[i]);
+        }
+        free(job->workers);
+    }
+    if (job->cache)
+        nw_cache_release(job->cache);
+    if (job->eventfd >= 0)
+        close(job->eventfd);
     if (job->threads)
         free(job->threads);
     free(job);
@@ -121,15 +258,7 @@ nw_job *nw_job_create(nw_job_type *type, int thread_count)
     nw_loop_init();
     job->type = *type;
     job->loop = nw_default_loop;
-    if (pthread_mutex_init(&job->lock, NULL) != 0) {
-        free(job);
-        return NULL;
-    }
-    if (pthread_cond_init(&job->notify, NULL) != 0) {
-        pthread_mutex_destroy(&job->lock);
-        free(job);
-        return NULL;
-    }
+    job->eventfd = -1;
     job->thread_count = thread_count;
     job->threads = calloc(job->thread_count, sizeof(pthread_t));
     if (job->threads == NULL) {
@@ -141,31 +270,38 @@ nw_job *nw_job_create(nw_job_type *type, int thread_count)
         nw_job_free(job);
         return NULL;
     }
-    if (pipe(job->pipefd) != 0) {
+    job->workers = calloc(job->thread_count, sizeof(struct nw_job_worker *));
+    if (job->workers == NULL) {
         nw_job_free(job);
         return NULL;
     }
-    nw_sock_set_nonblock(job->pipefd[0]);
-    nw_sock_set_nonblock(job->pipefd[1]);
-    ev_io_init(&job->ev, on_can_read, job->pipefd[0], EV_READ);
-    ev_io_start(job->loop, &job->ev);
-
     for (int i = 0; i < job->thread_count; ++i) {
-        struct thread_arg *arg = malloc(sizeof(struct thread_arg));
-        if (arg == NULL) {
-            nw_job_release(job);
+        job->workers[i] = worker_create(job);
+        if (job->workers[i] == NULL) {
+            nw_job_free(job);
             return NULL;
         }
-        memset(arg, 0, sizeof(struct thread_arg));
-        arg->job = job;
+    }
+    job->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (job->eventfd < 0) {
+        nw_job_free(job);
+        return NULL;
+    }
+    ev_io_init(&job->ev, on_can_read, job->eventfd, EV_READ);
+    ev_io_start(job->loop, &job->ev);
+
+    for (int i = 0; i < job->thread_count; ++i) {
+        struct nw_job_worker *worker = job->workers[i];
         if (job->type.on_init) {
-            arg->privdata = job->type.on_init();
-            if (arg->privdata == NULL) {
+            worker->privdata = job->type.on_init();
+            if (worker->privdata == NULL) {
                 nw_job_release(job);
                 return NULL;
             }
         }
-        if (pthread_create(&job->threads[i], NULL, thread_routine, arg) != 0) {
+        if (pthread_create(&job->threads[i], NULL, thread_routine, worker) != 0) {
+            if (worker->privdata)
+                job->type.on_release(worker->privdata);
             nw_job_release(job);
             return NULL;
         }
@@ -183,36 +319,32 @@ int nw_job_add(nw_job *job, uint32_t id, void *request)
     memset(entry, 0, sizeof(nw_job_entry));
     entry->id = id;
     entry->request = request;
+    job->request_count += 1;
+
+    if (job->pending_head == NULL && dispatch(job, entry) == 0)
+        return 0;
 
-    pthread_mutex_lock(&job->lock);
-    if (job->request_tail) {
-        entry->prev = job->request_tail;
-        entry->next = NULL;
-        job->request_tail->next = entry;
-        job->request_tail = entry;
+    if (job->pending_tail) {
+        entry->prev = job->pending_tail;
+        job->pending_tail->next = entry;
+        job->pending_tail = entry;
     } else {
-        entry->prev = NULL;
-        entry->next = NULL;
-        job->request_head = entry;
-        job->request_tail = entry;
+        job->pending_head = entry;
+        job->pending_tail = entry;
     }
-    job->request_count += 1;
-    pthread_cond_signal(&job->notify);
-    pthread_mutex_unlock(&job->lock);
 
     return 0;
 }
 
 void nw_job_release(nw_job *job)
 {
-    pthread_mutex_lock(&job->lock);
     if (job->shutdown) {
-        pthread_mutex_unlock(&job->lock);
         return;
     }
-    job->shutdown = true;
-    pthread_cond_broadcast(&job->notify);
-    pthread_mutex_unlock(&job->lock);
+    __atomic_store_n(&job->shutdown, true, __ATOMIC_RELEASE);
+    for (int i = 0; i < job->thread_start; ++i) {
+        sem_post(&job->workers[i]->sem);
+    }
     for (int i = 0; i < job->thread_start; ++i) {
         void *privdata = NULL;
         if (pthread_join(job->threads[i], &privdata) != 0) {
@@ -223,8 +355,6 @@ void nw_job_release(nw_job *job)
         }
     }
     ev_io_stop(job->loop, &job->ev);
-    close(job->pipefd[0]);
-    close(job->pipefd[1]);
     nw_job_free(job);
 }
 
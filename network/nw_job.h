@@ -9,13 +9,27 @@
 # include <stdint.h>
 # include <stdbool.h>
 # include <pthread.h>
+# include <semaphore.h>
 
 # include "nw_evt.h"
 # include "nw_buf.h"
 
 /* nw_job is a thread pool object, all threads are workers.
  * it include an job queue, you can add job to the queue,
- * workers will get job from queue and do the job. */
+ * workers will get job from queue and do the job.
+ *
+ * every worker has its own SPSC request ring, filled round robin by
+ * the main thread, and its own SPSC reply ring. a worker drains its
+ * request ring without any syscall and only sleeps once it is empty,
+ * the main thread posts its semaphore only if it is asleep. the main
+ * thread is woken by one eventfd shared by all workers. nw_job_add and
+ * all callbacks except on_job are called in main thread. */
+
+/* capacity of every request and reply ring, power of 2. requests
+ * beyond it wait in a main thread list, not rejected */
+# define NW_JOB_QUEUE_SIZE 4096
+
+struct nw_job_worker;
 
 typedef struct nw_job_entry {
     uint32_t id;
@@ -57,20 +71,22 @@ typedef struct nw_job {
     ev_io ev;
     nw_job_type type;
     struct ev_loop *loop;
-    int pipefd[2];
-    pthread_mutex_t lock;
-    pthread_cond_t notify;
+    int eventfd;
+    /* set by the first worker to finish a job after the last drain */
+    int notified;
     nw_cache *cache;
     int thread_count;
     int thread_start;
     pthread_t *threads;
     bool shutdown;
-    nw_job_entry *request_head;
-    nw_job_entry *request_tail;
+    struct nw_job_worker **workers;
+    /* the worker the next request is tried on first */
+    int next_worker;
+    /* requests waiting for room in the request ring */
+    nw_job_entry *pending_head;
+    nw_job_entry *pending_tail;
+    /* jobs added and not finished yet */
     int request_count;
-    nw_job_entry *reply_head;
-    nw_job_entry *reply_tail;
-    int reply_count;
 } nw_job;
 
 nw_job *nw_job_create(nw_job_type *type, int thread_count);
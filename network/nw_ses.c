@@ -4,20 +4,37 @@
  */
 
 # include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
 # include <errno.h>
+# include <limits.h>
 # include <unistd.h>
+# include <sys/uio.h>
 
 # include "nw_ses.h"
+# include "nw_shm.h"
 
 static void libev_on_read_write_evt(struct ev_loop *loop, ev_io *watcher, int events);
 static void libev_on_accept_evt(struct ev_loop *loop, ev_io *watcher, int events);
 static void libev_on_connect_evt(struct ev_loop *loop, ev_io *watcher, int events);
+static void libev_on_cork_evt(struct ev_loop *loop, ev_prepare *watcher, int events);
+
+# define NW_WRITEV_MAX 64
+# ifndef IOV_MAX
+# define IOV_MAX 1024
+# endif
+
+/* all sessions run on nw_default_loop, so one pending list is enough */
+static ev_prepare cork_watcher;
+static nw_ses *cork_head;
+static nw_ses_cork_stat cork_stat;
 
 static void watch_stop(nw_ses *ses)
 {
     if (ev_is_active(&ses->ev)) {
         ev_io_stop(ses->loop, &ses->ev);
     }
+    ses->wait_write = false;
 }
 
 static void watch_read(nw_ses *ses)
@@ -27,6 +44,7 @@ static void watch_read(nw_ses *ses)
     }
     ev_io_init(&ses->ev, libev_on_read_write_evt, ses->sockfd, EV_READ);
     ev_io_start(ses->loop, &ses->ev);
+    ses->wait_write = false;
 }
 
 static void watch_read_write(nw_ses *ses)
@@ -36,6 +54,7 @@ static void watch_read_write(nw_ses *ses)
     }
     ev_io_init(&ses->ev, libev_on_read_write_evt, ses->sockfd, EV_READ | EV_WRITE);
     ev_io_start(ses->loop, &ses->ev);
+    ses->wait_write = true;
 }
 
 static void watch_accept(nw_ses *ses)
@@ -70,6 +89,92 @@ static int nw_write_stream(nw_ses *ses, const void *data, size_t size)
     return spos;
 }
 
+/* write the buffer chain with writev,
+ * return 0 when all written, 1 when the socket would block, -1 on error */
+static int nw_write_chain(nw_ses *ses)
+{
+    nw_buf_list *list = ses->write_buf;
+    while (list->count > 0) {
+        struct iovec iov[NW_WRITEV_MAX];
+        int iovcnt = 0;
+        for (nw_buf *buf = list->head; buf && iovcnt < NW_WRITEV_MAX; buf = buf->next) {
+            iov[iovcnt].iov_base = nw_buf_data(buf) + buf->rpos;
+            iov[iovcnt].iov_len = nw_buf_size(buf);
+            iovcnt++;
+        }
+
+        ssize_t ret = writev(ses->sockfd, iov, iovcnt);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 1;
+            }
+            return -1;
+        }
+        if (ses->cork) {
+            cork_stat.write_count++;
+        }
+
+        size_t nwrite = ret;
+        while (list->count > 0 && nw_buf_size(list->head) <= nwrite) {
+            nwrite -= nw_buf_size(list->head);
+            nw_buf_list_shift(list);
+        }
+        if (list->count > 0) {
+            list->head->rpos += nwrite;
+        }
+    }
+
+    return 0;
+}
+
+static void cork_add(nw_ses *ses)
+{
+    if (cork_head == NULL && !ev_is_active(&cork_watcher)) {
+        ev_prepare_init(&cork_watcher, libev_on_cork_evt);
+        ev_prepare_start(ses->loop, &cork_watcher);
+    }
+    ses->cork_pending = true;
+    ses->cork_prev = NULL;
+    ses->cork_next = cork_head;
+    if (cork_head) {
+        cork_head->cork_prev = ses;
+    }
+    cork_head = ses;
+}
+
+static void cork_del(nw_ses *ses)
+{
+    if (ses->cork_prev) {
+        ses->cork_prev->cork_next = ses->cork_next;
+    } else {
+        cork_head = ses->cork_next;
+    }
+    if (ses->cork_next) {
+        ses->cork_next->cork_prev = ses->cork_prev;
+    }
+    ses->cork_pending = false;
+    ses->cork_prev = NULL;
+    ses->cork_next = NULL;
+}
+
+static void cork_flush(nw_ses *ses)
+{
+    if (ses->sockfd < 0 || ses->write_buf->count == 0)
+        return;
+
+    cork_stat.flush_count++;
+    int ret = nw_write_chain(ses);
+    if (ret < 0) {
+        char errmsg[100];
+        snprintf(errmsg, sizeof(errmsg), "writev error: %s", strerror(errno));
+        ses->on_error(ses, errmsg);
+    } else if (ret > 0) {
+        watch_read_write(ses);
+    }
+}
+
 static int nw_write_packet(nw_ses *ses, const void *data, size_t size)
 {
     while (true) {
@@ -96,7 +201,13 @@ static void on_can_read(nw_ses *ses)
     if (ses->sockfd < 0)
         return;
     if (ses->read_buf == NULL) {
-        ses->read_buf = nw_buf_alloc(ses->pool);
+        /* stream reads start small and grow only when a pkg needs it,
+         * datagrams must be received in one go */
+        if (ses->sock_type == SOCK_STREAM) {
+            ses->read_buf = nw_buf_alloc_size(ses->pool, ses->read_hint ? ses->read_hint : NW_BUF_MIN_SIZE);
+        } else {
+            ses->read_buf = nw_buf_alloc(ses->pool);
+        }
         if (ses->read_buf == NULL) {
             ses->on_error(ses, "no recv buf");
             return;
@@ -106,8 +217,12 @@ static void on_can_read(nw_ses *ses)
     switch (ses->sock_type) {
     case SOCK_STREAM:
         {
+            bool filled = false;
             while (true) {
-                int ret = read(ses->sockfd, ses->read_buf->data + ses->read_buf->wpos, nw_buf_avail(ses->read_buf));
+                uint32_t buf_size = ses->read_buf->size;
+                size_t avail = nw_buf_avail(ses->read_buf);
+                bool full = false;
+                int ret = read(ses->sockfd, ses->read_buf->data + ses->read_buf->wpos, avail);
                 if (ret < 0) {
                     if (errno == EINTR) {
                         continue;
@@ -124,6 +239,8 @@ static void on_can_read(nw_ses *ses)
                     return;
                 } else {
                     ses->read_buf->wpos += ret;
+                    if ((size_t)ret == avail)
+                        full = true;
                 }
 
                 size_t size = 0;
@@ -142,14 +259,33 @@ static void on_can_read(nw_ses *ses)
                     } else {
                         nw_buf_shift(ses->read_buf);
                         if (ses->read_buf->wpos == ses->read_buf->size) {
-                            ses->on_error(ses, "decode msg error");
-                            return;
+                            nw_buf *buf = nw_buf_expand(ses->pool, ses->read_buf);
+                            if (buf == NULL) {
+                                ses->on_error(ses, "decode msg error");
+                                return;
+                            }
+                            ses->read_buf = buf;
                         }
                         break;
                     }
                 }
 
                 nw_buf_shift(ses->read_buf);
+                /* more data is likely waiting, read it in bigger chunks */
+                if (full) {
+                    filled = true;
+                    if (ses->read_buf->size == buf_size) {
+                        nw_buf *buf = nw_buf_expand(ses->pool, ses->read_buf);
+                        if (buf)
+                            ses->read_buf = buf;
+                    }
+                }
+            }
+            /* keep the size while reads fill the buf, halve it otherwise */
+            if (filled) {
+                ses->read_hint = ses->read_buf->size;
+            } else {
+                ses->read_hint = ses->read_buf->size / 2;
             }
             if (nw_buf_size(ses->read_buf) == 0) {
                 nw_buf_free(ses->pool, ses->read_buf);
@@ -227,6 +363,8 @@ static void on_can_read(nw_ses *ses)
                     if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type==SCM_RIGHTS) {
                         int fd = *(int *)CMSG_DATA(cmsg);
                         ses->on_recv_fd(ses, fd);
+                        if (!ses->read_buf)
+                            return;
                     }
                 } else {
                     int pkg_size = ret;
@@ -254,16 +392,25 @@ static void on_can_write(nw_ses *ses)
     if (ses->sockfd < 0)
         return;
 
-    while (ses->write_buf->count > 0) {
+    if (ses->sock_type == SOCK_STREAM) {
+        if (nw_write_chain(ses) < 0) {
+            char errmsg[100];
+            snprintf(errmsg, sizeof(errmsg), "writev error: %s", strerror(errno));
+            ses->on_error(ses, errmsg);
+            return;
+        }
+    }
+
+    while (ses->write_buf->count > 0 && ses->sock_type != SOCK_STREAM) {
         nw_buf *buf = ses->write_buf->head;
         size_t size = nw_buf_size(buf);
         int nwrite = 0;
         if (ses->sock_type == SOCK_STREAM) {
-            nwrite = nw_write_stream(ses, buf->data + buf->rpos, size);
+            nwrite = nw_write_stream(ses, nw_buf_data(buf) + buf->rpos, size);
         } else {
-            nwrite = nw_write_packet(ses, buf->data + buf->rpos, size);
+            nwrite = nw_write_packet(ses, nw_buf_data(buf) + buf->rpos, size);
         }
-        if (nwrite < size) {
+        if (nwrite < 0 || (size_t)nwrite < size) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 if (ses->sock_type == SOCK_STREAM) {
                     buf->rpos += nwrite;
@@ -284,6 +431,9 @@ static void on_can_write(nw_ses *ses)
 
     if (ses->write_buf->count == 0) {
         watch_read(ses);
+        if (ses->on_drain) {
+            ses->on_drain(ses);
+        }
     }
 }
 
@@ -340,6 +490,16 @@ static void libev_on_read_write_evt(struct ev_loop *loop, ev_io *watcher, int ev
         on_can_write(ses);
 }
 
+static void libev_on_cork_evt(struct ev_loop *loop, ev_prepare *watcher, int events)
+{
+    while (cork_head) {
+        nw_ses *ses = cork_head;
+        cork_del(ses);
+        cork_flush(ses);
+    }
+    ev_prepare_stop(loop, watcher);
+}
+
 static void libev_on_accept_evt(struct ev_loop *loop, ev_io *watcher, int events)
 {
     nw_ses *ses = (nw_ses *)watcher;
@@ -416,6 +576,21 @@ int nw_ses_send(nw_ses *ses, const void *data, size_t size)
     if (ses->sockfd < 0) {
         return -1;
     }
+    if (ses->shm && nw_shm_sending(ses->shm)) {
+        return nw_shm_send(ses->shm, data, size);
+    }
+
+    if (ses->cork && ses->sock_type == SOCK_STREAM) {
+        if (nw_buf_list_write(ses->write_buf, data, size) != size) {
+            ses->on_error(ses, "no send buf");
+            return -1;
+        }
+        cork_stat.send_count++;
+        if (!ses->cork_pending) {
+            cork_add(ses);
+        }
+        return 0;
+    }
 
     if (ses->write_buf->count > 0) {
         size_t nwrite;
@@ -487,6 +662,147 @@ int nw_ses_send(nw_ses *ses, const void *data, size_t size)
     return 0;
 }
 
+/* queue what is left of iov after skip bytes were written */
+static int queue_iov(nw_ses *ses, const struct iovec *iov, int iovcnt, size_t skip)
+{
+    for (int i = 0; i < iovcnt; ++i) {
+        size_t len = iov[i].iov_len;
+        if (skip >= len) {
+            skip -= len;
+            continue;
+        }
+        if (nw_buf_list_write(ses->write_buf, iov[i].iov_base + skip, len - skip) != len - skip) {
+            ses->on_error(ses, "no send buf");
+            return -1;
+        }
+        skip = 0;
+    }
+    return 0;
+}
+
+int nw_ses_sendv(nw_ses *ses, const struct iovec *iov, int iovcnt)
+{
+    if (ses->sockfd < 0 || iovcnt < 0) {
+        return -1;
+    }
+    if (iovcnt == 1) {
+        return nw_ses_send(ses, iov[0].iov_base, iov[0].iov_len);
+    }
+
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+        size += iov[i].iov_len;
+    }
+
+    /* message based transports keep one message per send */
+    if (ses->sock_type != SOCK_STREAM || (ses->shm && nw_shm_sending(ses->shm))) {
+        char *data = malloc(size);
+        if (data == NULL)
+            return -1;
+        size_t pos = 0;
+        for (int i = 0; i < iovcnt; ++i) {
+            memcpy(data + pos, iov[i].iov_base, iov[i].iov_len);
+            pos += iov[i].iov_len;
+        }
+        int ret = nw_ses_send(ses, data, size);
+        free(data);
+        return ret;
+    }
+
+    if (ses->cork) {
+        if (queue_iov(ses, iov, iovcnt, 0) < 0)
+            return -1;
+        cork_stat.send_count++;
+        if (!ses->cork_pending) {
+            cork_add(ses);
+        }
+        return 0;
+    }
+
+    if (ses->write_buf->count > 0) {
+        return queue_iov(ses, iov, iovcnt, 0);
+    }
+
+    ssize_t ret;
+    do {
+        ret = iovcnt <= IOV_MAX ? writev(ses->sockfd, iov, iovcnt) : 0;
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        char errmsg[100];
+        snprintf(errmsg, sizeof(errmsg), "writev error: %s", strerror(errno));
+        ses->on_error(ses, errmsg);
+        return -1;
+    }
+    /* queue the rest of a short write */
+    size_t nwrite = ret > 0 ? ret : 0;
+    if (nwrite < size) {
+        if (queue_iov(ses, iov, iovcnt, nwrite) < 0)
+            return -1;
+        watch_read_write(ses);
+    }
+
+    return 0;
+}
+
+/* small data that fits the tail buf is copied, a queue of references
+ * would use up buf_limit quicker than the copies did */
+static int queue_shared(nw_ses *ses, nw_buf_shared *shared, size_t offset)
+{
+    size_t size = shared->size - offset;
+    nw_buf *tail = ses->write_buf->tail;
+    if (tail && nw_buf_avail(tail) >= size) {
+        nw_buf_write(tail, shared->data + offset, size);
+        return 0;
+    }
+    if (nw_buf_list_append_shared(ses->write_buf, shared, offset) != size) {
+        ses->on_error(ses, "no send buf");
+        return -1;
+    }
+    return 0;
+}
+
+int nw_ses_send_shared(nw_ses *ses, nw_buf_shared *shared)
+{
+    if (ses->sockfd < 0) {
+        return -1;
+    }
+    if (ses->sock_type != SOCK_STREAM || (ses->shm && nw_shm_sending(ses->shm))) {
+        return nw_ses_send(ses, shared->data, shared->size);
+    }
+    if (shared->size == 0) {
+        return 0;
+    }
+
+    if (ses->cork) {
+        if (queue_shared(ses, shared, 0) < 0)
+            return -1;
+        cork_stat.send_count++;
+        if (!ses->cork_pending) {
+            cork_add(ses);
+        }
+        return 0;
+    }
+
+    if (ses->write_buf->count > 0) {
+        return queue_shared(ses, shared, 0);
+    }
+
+    size_t nwrite = nw_write_stream(ses, shared->data, shared->size);
+    if (nwrite < shared->size) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            char errmsg[100];
+            snprintf(errmsg, sizeof(errmsg), "write error: %s", strerror(errno));
+            ses->on_error(ses, errmsg);
+            return -1;
+        }
+        if (queue_shared(ses, shared, nwrite) < 0)
+            return -1;
+        watch_read_write(ses);
+    }
+
+    return 0;
+}
+
 int nw_ses_send_fd(nw_ses *ses, int fd)
 {
     if (ses->sockfd < 0 || ses->sock_type != SOCK_SEQPACKET) {
@@ -528,10 +844,27 @@ int nw_ses_init(nw_ses *ses, struct ev_loop *loop, nw_buf_pool *pool, uint32_t b
     return 0;
 }
 
+void nw_ses_get_cork_stat(nw_ses_cork_stat *stat)
+{
+    memcpy(stat, &cork_stat, sizeof(nw_ses_cork_stat));
+}
+
 int nw_ses_close(nw_ses *ses)
 {
+    if (ses->cork_pending) {
+        cork_del(ses);
+        /* a send followed by close used to write immediately, keep that */
+        if (ses->sockfd >= 0) {
+            nw_write_chain(ses);
+        }
+    }
     watch_stop(ses);
     ses->id = 0;
+    ses->peer_flags = 0;
+    if (ses->shm) {
+        nw_shm_release(ses->shm);
+        ses->shm = NULL;
+    }
     if (ses->sockfd >= 0) {
         close(ses->sockfd);
         ses->sockfd = -1;
@@ -7,6 +7,7 @@
 # define _NW_SES_H_
 
 # include <stdbool.h>
+# include <sys/uio.h>
 
 # include "nw_buf.h"
 # include "nw_evt.h"
@@ -18,6 +19,8 @@
  * should not use it directly
  */
 
+struct nw_shm;
+
 enum {
     NW_SES_TYPE_COMMON, /* stream connection */
     NW_SES_TYPE_CLIENT, /* clinet side */
@@ -41,6 +44,8 @@ typedef struct nw_ses {
     nw_buf *read_buf;
     nw_buf_list *write_buf;
     nw_buf_pool *pool;
+    /* size of the next stream read buf, follows how busy the connection is */
+    uint32_t read_hint;
     /* nw_svr will assign every connection a uniq id */
     uint64_t id;
     void *privdata;
@@ -49,6 +54,19 @@ typedef struct nw_ses {
     struct nw_ses *prev;
     struct nw_ses *next;
 
+    /* stream sends are queued and flushed with writev once per loop iteration */
+    bool cork;
+    bool cork_pending;
+    struct nw_ses *cork_prev;
+    struct nw_ses *cork_next;
+
+    /* shared memory rings of a unix seqpacket session, see nw_shm */
+    struct nw_shm *shm;
+    /* options the protocol above negotiated with the peer, cleared on close */
+    uint32_t peer_flags;
+    /* the socket would block, queued data waits for it to be writable */
+    bool wait_write;
+
     int  (*on_accept)(struct nw_ses *ses, int sockfd, nw_addr_t *peer_addr);
     int  (*decode_pkg)(struct nw_ses *ses, void *data, size_t max);
     void (*on_connect)(struct nw_ses *ses, bool result);
@@ -56,6 +74,8 @@ typedef struct nw_ses {
     void (*on_recv_fd)(struct nw_ses *ses, int fd);
     void (*on_error)(struct nw_ses *ses, const char *msg);
     void (*on_close)(struct nw_ses *ses);
+    /* the queued data of a waiting session is all written */
+    void (*on_drain)(struct nw_ses *ses);
 } nw_ses;
 
 int nw_ses_bind(nw_ses *ses, nw_addr_t *addr);
@@ -64,9 +84,24 @@ int nw_ses_connect(nw_ses *ses, nw_addr_t *addr);
 int nw_ses_start(nw_ses *ses);
 int nw_ses_stop(nw_ses *ses);
 int nw_ses_send(nw_ses *ses, const void *data, size_t size);
+/* same as nw_ses_send for the parts of iov one after another, a stream
+ * session writes them with a single writev */
+int nw_ses_sendv(nw_ses *ses, const struct iovec *iov, int iovcnt);
+/* send shared data, queued by reference when the socket is busy, the
+ * session holds a reference until it is written */
+int nw_ses_send_shared(nw_ses *ses, nw_buf_shared *shared);
 /* send a fd, only when the connection is SOCK_SEQPACKET type */
 int nw_ses_send_fd(nw_ses *ses, int fd);
 
+/* corked sessions counters, syscalls saved is send_count - write_count */
+typedef struct nw_ses_cork_stat {
+    uint64_t send_count;
+    uint64_t write_count;
+    uint64_t flush_count;
+} nw_ses_cork_stat;
+
+void nw_ses_get_cork_stat(nw_ses_cork_stat *stat);
+
 int nw_ses_init(nw_ses *ses, struct ev_loop *loop, nw_buf_pool *pool, uint32_t buf_limit, int ses_type);
 int nw_ses_close(nw_ses *ses);
 int nw_ses_release(nw_ses *ses);
@@ -0,0 +1,505 @@
+/*
+ * Description: shared memory transport for unix socket sessions
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+# endif
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <stddef.h>
+# include <string.h>
+# include <unistd.h>
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/eventfd.h>
+
+# include "nw_shm.h"
+
+# define RECORD_HEAD    8
+# define RECORD_WRAP    UINT32_MAX
+/* messages handled per wakeup before yielding to the other watchers */
+# define DRAIN_MAX      1024
+/* the mapping can not change size once mapped, a peer shrinking it would
+ * make the other side fault */
+# define SHM_SEALS      (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+struct record {
+    uint32_t size;
+    uint32_t reserved;
+};
+
+static uint64_t record_space(size_t size)
+{
+    return (RECORD_HEAD + size + 7) & ~7ULL;
+}
+
+static size_t message_max(nw_shm *shm)
+{
+    return shm->ring_size / 2 - RECORD_HEAD;
+}
+
+static size_t map_size_of(uint32_t ring_size)
+{
+    return sizeof(nw_shm_head) + (size_t)ring_size * 2;
+}
+
+static void wakeup(int efd)
+{
+    uint64_t value = 1;
+    while (write(efd, &value, sizeof(value)) < 0 && errno == EINTR);
+}
+
+static void notify(nw_shm *shm)
+{
+    if (__atomic_exchange_n(&shm->send->notified, 1, __ATOMIC_SEQ_CST) == 0) {
+        shm->wakeup_count++;
+        wakeup(shm->send_efd);
+    }
+}
+
+/* return the record at the write position, after a wrap marker if the
+ * message does not fit before the end, NULL if the ring is full */
+static struct record *ring_reserve(nw_shm *shm, size_t size, uint64_t *head_out)
+{
+    nw_shm_ring *ring = shm->send;
+    uint64_t need = record_space(size);
+    uint64_t head = ring->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t pos = head & (shm->ring_size - 1);
+    uint32_t to_end = shm->ring_size - pos;
+    uint64_t total = need > to_end ? to_end + need : need;
+    if (shm->ring_size - (head - tail) < total)
+        return NULL;
+
+    if (need > to_end) {
+        ((struct record *)(shm->send_data + pos))->size = RECORD_WRAP;
+        head += to_end;
+        pos = 0;
+    }
+    *head_out = head;
+    return (struct record *)(shm->send_data + pos);
+}
+
+/* ask the consumer for a wakeup when it frees space, then look again */
+static struct record *ring_reserve_wait(nw_shm *shm, size_t size, uint64_t *head_out)
+{
+    __atomic_store_n(&shm->send->writer_waiting, 1, __ATOMIC_SEQ_CST);
+    struct record *rec = ring_reserve(shm, size, head_out);
+    if (rec) {
+        __atomic_store_n(&shm->send->writer_waiting, 0, __ATOMIC_RELAXED);
+    }
+    return rec;
+}
+
+static void ring_publish(nw_shm *shm, struct record *rec, uint64_t head, size_t size)
+{
+    rec->size = size;
+    __atomic_store_n(&shm->send->head, head + record_space(size), __ATOMIC_RELEASE);
+    shm->send_count++;
+    notify(shm);
+}
+
+static void flush_pending(nw_shm *shm)
+{
+    while (shm->pending->count) {
+        nw_buf *buf = shm->pending->head;
+        size_t size = buf->wpos - buf->rpos;
+        uint64_t head;
+        struct record *rec = ring_reserve_wait(shm, size, &head);
+        if (rec == NULL)
+            return;
+        memcpy(rec + 1, buf->data + buf->rpos, size);
+        ring_publish(shm, rec, head, size);
+        nw_buf_list_shift(shm->pending);
+    }
+}
+
+static void shm_free(nw_shm *shm)
+{
+    for (int i = 0; i < shm->fd_count; ++i) {
+        if (shm->fds[i] >= 0)
+            close(shm->fds[i]);
+    }
+    if (shm->head)
+        munmap(shm->head, shm->map_size);
+    if (shm->pending)
+        nw_buf_list_release(shm->pending);
+    free(shm);
+}
+
+/* return < 0 if the shm is gone, the session closed while handling */
+static int drain(nw_shm *shm)
+{
+    nw_ses *ses = shm->ses;
+    nw_shm_ring *ring = shm->recv;
+    uint64_t tail = ring->tail;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    int count = 0;
+
+    while (tail != head) {
+        if (count++ == DRAIN_MAX) {
+            wakeup(shm->recv_efd);
+            break;
+        }
+        uint32_t pos = tail & (shm->ring_size - 1);
+        struct record *rec = (struct record *)(shm->recv_data + pos);
+        uint32_t size = rec->size;
+        if (size == RECORD_WRAP) {
+            tail += shm->ring_size - pos;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (size > message_max(shm) || head - tail < record_space(size) || record_space(size) > shm->ring_size - pos) {
+            ses->on_error(ses, "shm broken data");
+            return -1;
+        }
+
+        shm->reading = true;
+        int ret = ses->decode_pkg(ses, rec + 1, size);
+        if (ret < 0) {
+            char errmsg[100];
+            snprintf(errmsg, sizeof(errmsg), "decode msg error: %d", ret);
+            ses->on_error(ses, errmsg);
+        } else {
+            ses->on_recv_pkg(ses, rec + 1, ret);
+        }
+        shm->reading = false;
+        if (shm->closed) {
+            shm_free(shm);
+            return -1;
+        }
+
+        tail += record_space(size);
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        if (tail == head) {
+            head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->writer_waiting, __ATOMIC_RELAXED) &&
+            __atomic_exchange_n(&ring->writer_waiting, 0, __ATOMIC_SEQ_CST)) {
+        wakeup(shm->send_efd);
+    }
+    return 0;
+}
+
+/* the server refused the rings, the queued messages go to the socket */
+static void fallback(nw_shm *shm)
+{
+    nw_ses *ses = shm->ses;
+    ev_io_stop(ses->loop, &shm->ev);
+    ses->shm = NULL;
+    while (shm->pending->count && ses->sockfd >= 0) {
+        nw_buf *buf = shm->pending->head;
+        nw_ses_send(ses, buf->data + buf->rpos, buf->wpos - buf->rpos);
+        nw_buf_list_shift(shm->pending);
+    }
+    shm_free(shm);
+}
+
+static void on_wakeup(struct ev_loop *loop, ev_io *watcher, int events)
+{
+    nw_shm *shm = (nw_shm *)watcher;
+    uint64_t value;
+    while (read(shm->recv_efd, &value, sizeof(value)) < 0 && errno == EINTR);
+    __atomic_store_n(&shm->recv->notified, 0, __ATOMIC_SEQ_CST);
+
+    if (!shm->active) {
+        uint32_t ready = __atomic_load_n(&shm->head->ready, __ATOMIC_ACQUIRE);
+        if (ready == 0)
+            return;
+        if (ready != NW_SHM_READY) {
+            fallback(shm);
+            return;
+        }
+        shm->active = true;
+        /* what the server wrote on the socket before it switched comes
+         * before anything in the ring */
+        shm->busy = true;
+        ev_invoke(loop, &shm->ses->ev, EV_READ);
+        shm->busy = false;
+        if (shm->closed) {
+            shm_free(shm);
+            return;
+        }
+    }
+    flush_pending(shm);
+    drain(shm);
+}
+
+static nw_shm *shm_create(nw_ses *ses, bool server)
+{
+    nw_shm *shm = malloc(sizeof(nw_shm));
+    if (shm == NULL)
+        return NULL;
+    memset(shm, 0, sizeof(nw_shm));
+    shm->ses = ses;
+    shm->server = server;
+    for (int i = 0; i < 3; ++i) {
+        shm->fds[i] = -1;
+    }
+    shm->pending = nw_buf_list_create(ses->pool, ses->write_buf ? ses->write_buf->limit : 0);
+    if (shm->pending == NULL) {
+        free(shm);
+        return NULL;
+    }
+    return shm;
+}
+
+/* ring 0 and fds[1] carry client to server, ring 1 and fds[2] the reverse.
+ * ring_size is the checked one, the peer may rewrite the head any time */
+static void shm_setup(nw_shm *shm, uint32_t ring_size)
+{
+    char *data = (char *)shm->head + sizeof(nw_shm_head);
+    int recv = shm->server ? 0 : 1;
+    int send = shm->server ? 1 : 0;
+    shm->ring_size = ring_size;
+    shm->recv = &shm->head->ring[recv];
+    shm->send = &shm->head->ring[send];
+    shm->recv_data = data + (size_t)shm->ring_size * recv;
+    shm->send_data = data + (size_t)shm->ring_size * send;
+    shm->recv_efd = shm->fds[recv + 1];
+    shm->send_efd = shm->fds[send + 1];
+
+    ev_io_init(&shm->ev, on_wakeup, shm->recv_efd, EV_READ);
+    ev_io_start(shm->ses->loop, &shm->ev);
+}
+
+static uint32_t normalize_ring_size(uint32_t ring_size, uint32_t max_pkg_size)
+{
+    uint64_t need = ((uint64_t)max_pkg_size + RECORD_HEAD + 8) * 2;
+    if (need < ring_size)
+        need = ring_size;
+    if (need < NW_SHM_RING_SIZE_MIN)
+        need = NW_SHM_RING_SIZE_MIN;
+    uint64_t size = NW_SHM_RING_SIZE_MIN;
+    while (size < need)
+        size <<= 1;
+    if (size > NW_SHM_RING_SIZE_MAX)
+        return 0;
+    return size;
+}
+
+nw_shm *nw_shm_connect(nw_ses *ses, uint32_t ring_size, uint32_t max_pkg_size)
+{
+    if (ses->sock_type != SOCK_SEQPACKET || ses->peer_addr.family != AF_UNIX)
+        return NULL;
+    ring_size = normalize_ring_size(ring_size, max_pkg_size);
+    if (ring_size == 0)
+        return NULL;
+
+    nw_shm *shm = shm_create(ses, false);
+    if (shm == NULL)
+        return NULL;
+    shm->fd_count = 3;
+    shm->fds[0] = memfd_create("nw_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    shm->fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    shm->fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shm->fds[0] < 0 || shm->fds[1] < 0 || shm->fds[2] < 0)
+        goto error;
+
+    shm->map_size = map_size_of(ring_size);
+    if (ftruncate(shm->fds[0], shm->map_size) < 0)
+        goto error;
+    if (fcntl(shm->fds[0], F_ADD_SEALS, SHM_SEALS) < 0)
+        goto error;
+    void *addr = mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fds[0], 0);
+    if (addr == MAP_FAILED)
+        goto error;
+    shm->head = addr;
+    shm->head->magic = NW_SHM_MAGIC;
+    shm->head->version = NW_SHM_VERSION;
+    shm->head->ring_size = ring_size;
+
+    for (int i = 0; i < 3; ++i) {
+        if (nw_ses_send_fd(ses, shm->fds[i]) < 0)
+            goto error;
+    }
+    close(shm->fds[0]);
+    shm->fds[0] = -1;
+    shm_setup(shm, ring_size);
+
+    return shm;
+
+error:
+    shm_free(shm);
+    return NULL;
+}
+
+static bool is_shm_fd(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size < sizeof(nw_shm_head))
+        return false;
+    uint32_t head[2];
+    if (pread(fd, head, sizeof(head), 0) != sizeof(head))
+        return false;
+    return head[0] == NW_SHM_MAGIC && head[1] == NW_SHM_VERSION;
+}
+
+static int shm_attach(nw_shm *shm)
+{
+    /* sealed first, so the size checked below is the size mapped */
+    int seals = fcntl(shm->fds[0], F_GET_SEALS);
+    if (seals < 0 || (seals & SHM_SEALS) != SHM_SEALS)
+        return -__LINE__;
+    struct stat st;
+    if (fstat(shm->fds[0], &st) < 0)
+        return -__LINE__;
+    nw_shm_head head;
+    if (pread(shm->fds[0], &head, sizeof(head), 0) != sizeof(head))
+        return -__LINE__;
+    uint32_t ring_size = head.ring_size;
+    if (ring_size < NW_SHM_RING_SIZE_MIN || ring_size > NW_SHM_RING_SIZE_MAX || (ring_size & (ring_size - 1)))
+        return -__LINE__;
+    if ((size_t)st.st_size != map_size_of(ring_size))
+        return -__LINE__;
+    if (ring_size / 2 - RECORD_HEAD < shm->ses->pool->size)
+        return -__LINE__;
+    /* wakeups must never block the loop, whatever the peer passed */
+    for (int i = 1; i < 3; ++i) {
+        int flags = fcntl(shm->fds[i], F_GETFL);
+        if (flags < 0 || fcntl(shm->fds[i], F_SETFL, flags | O_NONBLOCK) < 0)
+            return -__LINE__;
+    }
+
+    shm->map_size = st.st_size;
+    void *addr = mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fds[0], 0);
+    if (addr == MAP_FAILED)
+        return -__LINE__;
+    shm->head = addr;
+    close(shm->fds[0]);
+    shm->fds[0] = -1;
+
+    shm_setup(shm, ring_size);
+    shm->active = true;
+    __atomic_store_n(&shm->head->ready, NW_SHM_READY, __ATOMIC_RELEASE);
+    wakeup(shm->send_efd);
+
+    return 0;
+}
+
+/* tell the client to stay on the socket, the fds are closed by the caller */
+static void shm_refuse(nw_shm *shm)
+{
+    uint32_t ready = NW_SHM_REFUSED;
+    if (pwrite(shm->fds[0], &ready, sizeof(ready), offsetof(nw_shm_head, ready)) != sizeof(ready))
+        return;
+    int flags = fcntl(shm->fds[2], F_GETFL);
+    if (flags < 0 || fcntl(shm->fds[2], F_SETFL, flags | O_NONBLOCK) < 0)
+        return;
+    wakeup(shm->fds[2]);
+}
+
+int nw_shm_accept_fd(nw_ses *ses, int fd, bool accept)
+{
+    nw_shm *shm = ses->shm;
+    if (shm && shm->fd_count == 3)
+        return 1;
+    if (shm == NULL) {
+        if (!is_shm_fd(fd))
+            return 1;
+        shm = shm_create(ses, true);
+        if (shm == NULL) {
+            close(fd);
+            return -__LINE__;
+        }
+        ses->shm = shm;
+    }
+
+    shm->fds[shm->fd_count++] = fd;
+    if (shm->fd_count < 3)
+        return 0;
+    /* replies queued on the socket would be overtaken by the ring */
+    if (!accept || ses->write_buf->count) {
+        shm_refuse(shm);
+        ses->shm = NULL;
+        shm_free(shm);
+        return 0;
+    }
+    int ret = shm_attach(shm);
+    if (ret < 0) {
+        ses->shm = NULL;
+        shm_free(shm);
+        return ret;
+    }
+
+    return 0;
+}
+
+bool nw_shm_active(nw_shm *shm)
+{
+    return shm->active;
+}
+
+bool nw_shm_sending(nw_shm *shm)
+{
+    return shm->active || !shm->server;
+}
+
+bool nw_shm_reading(nw_shm *shm)
+{
+    return shm->reading;
+}
+
+int nw_shm_send(nw_shm *shm, const void *data, size_t size)
+{
+    if (size > message_max(shm)) {
+        shm->ses->on_error(shm->ses, "shm message too big");
+        return -1;
+    }
+    if (shm->active && shm->pending->count == 0) {
+        uint64_t head;
+        struct record *rec = ring_reserve(shm, size, &head);
+        if (rec == NULL) {
+            rec = ring_reserve_wait(shm, size, &head);
+        }
+        if (rec) {
+            memcpy(rec + 1, data, size);
+            ring_publish(shm, rec, head, size);
+            return 0;
+        }
+    }
+    if (nw_buf_list_append(shm->pending, data, size) != size) {
+        shm->ses->on_error(shm->ses, "no send buf");
+        return -1;
+    }
+
+    return 0;
+}
+
+void *nw_shm_reserve(nw_shm *shm, size_t size)
+{
+    if (!shm->active || shm->pending->count || size > message_max(shm))
+        return NULL;
+    struct record *rec = ring_reserve(shm, size, &shm->reserve_head);
+    if (rec == NULL)
+        return NULL;
+    shm->reserve_rec = rec;
+    return rec + 1;
+}
+
+void nw_shm_commit(nw_shm *shm, size_t size)
+{
+    ring_publish(shm, shm->reserve_rec, shm->reserve_head, size);
+}
+
+void nw_shm_release(nw_shm *shm)
+{
+    if (ev_is_active(&shm->ev)) {
+        ev_io_stop(shm->ses->loop, &shm->ev);
+    }
+    /* drain or on_wakeup frees it once the callback returns */
+    if (shm->reading || shm->busy) {
+        shm->closed = true;
+        return;
+    }
+    shm_free(shm);
+}
+
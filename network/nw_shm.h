@@ -0,0 +1,123 @@
+/*
+ * Description: shared memory transport for unix socket sessions
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _NW_SHM_H_
+# define _NW_SHM_H_
+
+# include <stdint.h>
+# include <stdbool.h>
+
+# include "nw_buf.h"
+# include "nw_evt.h"
+# include "nw_ses.h"
+
+/*
+ * nw_shm moves the messages of a SOCK_SEQPACKET unix session through a
+ * pair of single producer single consumer rings in a memfd mapping, one
+ * ring per direction, with an eventfd per side for wakeups. The socket
+ * stays open to pass the fds and to detect the peer going away.
+ *
+ * handshake: after connect, the client sends the memfd, sealed against
+ * resizing, the eventfd the server waits on and the eventfd the client
+ * waits on, in that order. a memfd without the seals is refused.
+ * the server maps them, sets ready and wakes the client, from then on
+ * nw_ses_send on both sides goes into the ring. a server not accepting
+ * shm, or with replies still queued on the socket, sets refused instead
+ * and the client keeps using the socket.
+ *
+ * the client queues its sends from connect until the answer, so nothing
+ * it sent on the socket can be overtaken by the ring, and once ready it
+ * reads what the server wrote on the socket before draining the ring.
+ *
+ * messages keep their boundaries and are handed to decode_pkg and
+ * on_recv_pkg in place, the data is valid until on_recv_pkg returns.
+ */
+
+# define NW_SHM_MAGIC           0x6e77736d
+# define NW_SHM_VERSION         1
+# define NW_SHM_RING_SIZE_MIN   (64 * 1024)
+# define NW_SHM_RING_SIZE_MAX   (1U << 30)
+
+/* values of nw_shm_head ready */
+# define NW_SHM_READY           1
+# define NW_SHM_REFUSED         2
+
+typedef struct nw_shm_ring {
+    /* written by the producer */
+    uint64_t head;
+    char pad0[56];
+    /* written by the consumer */
+    uint64_t tail;
+    char pad1[56];
+    /* the consumer has a wakeup pending, the producer skips the eventfd */
+    uint32_t notified;
+    /* the producer has messages waiting for space */
+    uint32_t writer_waiting;
+    char pad2[56];
+} nw_shm_ring;
+
+/* head of the mapping, the two data areas follow it */
+typedef struct nw_shm_head {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint32_t ready;
+    char pad[48];
+    /* 0: client to server, 1: server to client */
+    nw_shm_ring ring[2];
+} nw_shm_head;
+
+typedef struct nw_shm {
+    ev_io ev;
+    nw_ses *ses;
+    bool server;
+    bool active;
+    bool reading;
+    /* a callback that may close the session is running */
+    bool busy;
+    bool closed;
+    int fds[3];
+    int fd_count;
+    int send_efd;
+    int recv_efd;
+    nw_shm_head *head;
+    size_t map_size;
+    uint32_t ring_size;
+    nw_shm_ring *send;
+    nw_shm_ring *recv;
+    char *send_data;
+    char *recv_data;
+    /* messages the send ring had no room for, or sent before the
+     * handshake was answered, in order */
+    nw_buf_list *pending;
+    uint64_t reserve_head;
+    void *reserve_rec;
+    uint64_t send_count;
+    uint64_t wakeup_count;
+} nw_shm;
+
+/* client side, create the rings and send the fds on ses, ring_size is
+ * rounded up to a power of two that holds two max_pkg_size messages */
+nw_shm *nw_shm_connect(nw_ses *ses, uint32_t ring_size, uint32_t max_pkg_size);
+/* server side, feed a fd received on ses. return 0 if it belongs to the
+ * shm handshake, 1 if it is not a shm fd, < 0 if the handshake fails,
+ * the fd is closed then. the handshake is refused if accept is false */
+int nw_shm_accept_fd(nw_ses *ses, int fd, bool accept);
+/* true once both sides mapped the rings */
+bool nw_shm_active(nw_shm *shm);
+/* true if nw_ses_send goes through nw_shm_send, on the client that is
+ * from connect on, the sends are queued until the server answers */
+bool nw_shm_sending(nw_shm *shm);
+/* true while a message from the ring is being decoded or handled */
+bool nw_shm_reading(nw_shm *shm);
+int nw_shm_send(nw_shm *shm, const void *data, size_t size);
+/* reserve room for a message of size in the send ring to build it in
+ * place, NULL if it does not fit now. nw_shm_commit publishes it */
+void *nw_shm_reserve(nw_shm *shm, size_t size);
+void nw_shm_commit(nw_shm *shm, size_t size);
+void nw_shm_release(nw_shm *shm);
+
+# endif
+
@@ -281,3 +281,11 @@ int nw_sock_set_reuse_addr(int sockfd)
     return 0;
 }
 
+int nw_sock_set_reuse_port(int sockfd)
+{
+    int val = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val)) != 0)
+        return -1;
+    return 0;
+}
+
@@ -87,5 +87,9 @@ int nw_sock_set_no_delay(int sockfd);
 /* set sockfd reuse addr */
 int nw_sock_set_reuse_addr(int sockfd);
 
+/* set sockfd reuse port, sockets of the same uid bound to the same addr
+ * share the incoming connections */
+int nw_sock_set_reuse_port(int sockfd);
+
 # endif
 
@@ -15,13 +15,15 @@ nw_state *nw_state_create(nw_state_type *type, uint32_t data_size)
     if (type->on_timeout == NULL)
         return NULL;
 
-    nw_loop_init();
+    nw_wheel *wheel = nw_wheel_default();
+    if (wheel == NULL)
+        return NULL;
     nw_state *context = malloc(sizeof(nw_state));
     if (context == NULL) {
         return NULL;
     }
     memset(context, 0, sizeof(nw_state));
-    context->loop = nw_default_loop;
+    context->wheel = wheel;
     context->type = *type;
     context->data_size = data_size;
     context->cache = nw_cache_create(sizeof(nw_state_entry) + data_size);
@@ -101,9 +103,9 @@ static void state_remove(nw_state *context, nw_state_entry *entry)
     }
 }
 
-static void on_timeout(struct ev_loop *loop, ev_timer *ev, int events)
+static void on_timeout(nw_wheel_timer *timer, void *privdata)
 {
-    nw_state_entry *entry = (nw_state_entry *)ev;
+    nw_state_entry *entry = privdata;
     nw_state *context = entry->context;
     context->type.on_timeout(entry);
     state_remove(context, entry);
@@ -137,8 +139,8 @@ nw_state_entry *nw_state_add(nw_state *context, double timeout, uint32_t id)
     } else {
         entry->id = get_available_id(context);
     }
-    ev_timer_init(&entry->ev, on_timeout, timeout, 0);
-    ev_timer_start(context->loop, &entry->ev);
+    nw_wheel_timer_init(&entry->timer, on_timeout, entry);
+    nw_wheel_add(context->wheel, &entry->timer, timeout);
     entry->context = context;
     entry->data = ((void *)entry + sizeof(nw_state_entry));
     memset(entry->data, 0, context->data_size);
@@ -170,9 +172,7 @@ int nw_state_mod(nw_state *context, uint32_t id, double timeout)
     nw_state_entry *entry = nw_state_get(context, id);
     if (entry == NULL)
         return -1;
-    ev_timer_stop(context->loop, &entry->ev);
-    ev_timer_set(&entry->ev, timeout, 0);
-    ev_timer_start(context->loop, &entry->ev);
+    nw_wheel_add(context->wheel, &entry->timer, timeout);
 
     return 0;
 }
@@ -182,7 +182,7 @@ int nw_state_del(nw_state *context, uint32_t id)
     nw_state_entry *entry = nw_state_get(context, id);
     if (entry == NULL)
         return -1;
-    ev_timer_stop(context->loop, &entry->ev);
+    nw_wheel_del(context->wheel, &entry->timer);
     state_remove(context, entry);
 
     return 0;
@@ -200,7 +200,7 @@ void nw_state_release(nw_state *context)
         nw_state_entry *next = NULL;
         while (entry) {
             next = entry->next;
-            ev_timer_stop(context->loop, &entry->ev);
+            nw_wheel_del(context->wheel, &entry->timer);
             state_release(context, entry);
             entry = next;
         }
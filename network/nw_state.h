@@ -11,11 +11,13 @@
 
 # include "nw_evt.h"
 # include "nw_buf.h"
+# include "nw_wheel.h"
 
-/* nw_state is a state machine with timeout */
+/* nw_state is a state machine with timeout, timeouts are kept in the
+ * shared nw_wheel */
 
 typedef struct nw_state_entry {
-    ev_timer ev;
+    nw_wheel_timer timer;
     /* state id */
     uint32_t id;
     /* state context, the nw_state instance */
@@ -37,7 +39,7 @@ typedef struct nw_state_type {
 } nw_state_type;
 
 typedef struct nw_state {
-    struct ev_loop *loop;
+    nw_wheel *wheel;
     nw_state_type type;
     uint32_t data_size;
     nw_cache *cache;
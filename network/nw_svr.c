@@ -8,6 +8,7 @@
 # include <unistd.h>
 
 # include "nw_svr.h"
+# include "nw_shm.h"
 
 static int create_socket(int family, int sock_type)
 {
@@ -74,6 +75,26 @@ static void on_recv_fd(nw_ses *ses, int fd)
     close(fd);
 }
 
+/* take the shm handshake fds, pass the others on */
+static void on_recv_shm_fd(nw_ses *ses, int fd)
+{
+    nw_svr *svr = (nw_svr *)ses->svr;
+    int ret = nw_shm_accept_fd(ses, fd, svr->shm);
+    if (ret == 0)
+        return;
+    if (ret < 0) {
+        char errmsg[100];
+        snprintf(errmsg, sizeof(errmsg), "shm handshake fail: %d", ret);
+        on_error(ses, errmsg);
+        return;
+    }
+    if (svr->type.on_recv_fd) {
+        svr->type.on_recv_fd(ses, fd);
+    } else {
+        close(fd);
+    }
+}
+
 static void nw_svr_free(nw_svr *svr)
 {
     if (svr->buf_pool)
@@ -126,6 +147,7 @@ static int nw_svr_add_clt(nw_ses *ses, int sockfd, nw_addr_t *peer_addr)
     clt->sock_type   = ses->sock_type;
     clt->privdata    = privdata;
     clt->svr         = svr;
+    clt->cork        = svr->cork;
 
     clt->id = svr->id_start++;
     if (clt->id == 0)
@@ -136,6 +158,12 @@ static int nw_svr_add_clt(nw_ses *ses, int sockfd, nw_addr_t *peer_addr)
     clt->on_recv_fd  = svr->type.on_recv_fd == NULL ? on_recv_fd : svr->type.on_recv_fd;
     clt->on_error    = on_error;
     clt->on_close    = on_close;
+    clt->on_drain    = svr->type.on_drain;
+    /* a server without shm still answers the handshake, so the client
+     * stops queueing and keeps the socket */
+    if (clt->sock_type == SOCK_SEQPACKET && clt->host_addr->family == AF_UNIX) {
+        clt->on_recv_fd = on_recv_shm_fd;
+    }
 
     if (svr->clt_list_tail) {
         clt->prev = svr->clt_list_tail;
@@ -224,6 +252,8 @@ nw_svr *nw_svr_create(nw_svr_cfg *cfg, nw_svr_type *type, void *privdata)
     svr->buf_limit = cfg->buf_limit;
     svr->read_mem = cfg->read_mem;
     svr->write_mem = cfg->write_mem;
+    svr->cork = cfg->cork;
+    svr->shm = cfg->shm;
     svr->privdata = privdata;
     memset(svr->svr_list, 0, sizeof(nw_ses) * svr->svr_count);
     for (uint32_t i = 0; i < svr->svr_count; ++i) {
@@ -233,6 +263,14 @@ nw_svr *nw_svr_create(nw_svr_cfg *cfg, nw_svr_type *type, void *privdata)
             nw_svr_free(svr);
             return NULL;
         }
+        if (cfg->reuse_port) {
+            /* binding a unix path again unlinks the previous one */
+            if (cfg->bind_arr[i].addr.family == AF_UNIX || nw_sock_set_reuse_port(sockfd) < 0) {
+                close(sockfd);
+                nw_svr_free(svr);
+                return NULL;
+            }
+        }
         nw_addr_t *host_addr = malloc(sizeof(nw_addr_t));
         if (host_addr == NULL) {
             nw_svr_free(svr);
@@ -310,7 +348,6 @@ void nw_svr_release(nw_svr *svr)
     for (uint32_t i = 0; i < svr->svr_count; ++i) {
         nw_ses_release(&svr->svr_list[i]);
     }
-    nw_cache_release(svr->clt_cache);
     nw_svr_free(svr);
 }
 
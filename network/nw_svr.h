@@ -7,6 +7,7 @@
 # define _NW_SVR_H_
 
 # include <stdint.h>
+# include <stdbool.h>
 
 # include "nw_buf.h"
 # include "nw_evt.h"
@@ -35,6 +36,16 @@ typedef struct nw_svr_cfg {
     uint32_t read_mem;
     /* will call nw_sock_set_send_buf if not 0 */
     uint32_t write_mem;
+    /* if true, replies of stream connection are coalesced and written
+     * once per loop iteration, see nw_ses cork */
+    bool cork;
+    /* if true, tcp binds set SO_REUSEPORT so every process binding the
+     * same addr gets its own accept queue and the kernel spreads
+     * connections across them, unix binds are refused */
+    bool reuse_port;
+    /* if true, unix seqpacket clients may switch to shared memory rings,
+     * see nw_shm */
+    bool shm;
 } nw_svr_cfg;
 
 typedef struct nw_svr_type {
@@ -74,6 +85,11 @@ typedef struct nw_svr_type {
      *
      * called when an error occur, msg is the detail of the error */
     void (*on_error_msg)(nw_ses *ses, const char *msg);
+    /* optional
+     *
+     * called when a connection that had to wait for the socket has written
+     * all its queued data, see nw_ses wait_write */
+    void (*on_drain)(nw_ses *ses);
     /* optional
      *
      * if set, the on_privdata_free also should be set.
@@ -98,6 +114,8 @@ typedef struct nw_svr {
     uint32_t buf_limit;
     uint32_t read_mem;
     uint32_t write_mem;
+    bool cork;
+    bool shm;
     uint64_t id_start;
     void *privdata;
 } nw_svr;
@@ -0,0 +1,220 @@
+/*
+ * Description: hierarchical timing wheel
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+# include <math.h>
+
+# include "nw_wheel.h"
+
+# define SLOT_BITS  8
+# define SLOT_MASK  (NW_WHEEL_SLOTS - 1)
+# define MAX_DELTA  ((1ULL << (SLOT_BITS * NW_WHEEL_LEVELS)) - 1)
+
+static nw_wheel *default_wheel;
+
+static void list_init(nw_wheel_timer *head)
+{
+    head->prev = head;
+    head->next = head;
+}
+
+static void list_add(nw_wheel_timer *head, nw_wheel_timer *timer)
+{
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void list_del(nw_wheel_timer *timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+/* move all timers of from to the empty list to */
+static void list_splice(nw_wheel_timer *from, nw_wheel_timer *to)
+{
+    if (from->next == from) {
+        list_init(to);
+        return;
+    }
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+    list_init(from);
+}
+
+static uint64_t now_tick(nw_wheel *wheel)
+{
+    return (uint64_t)((ev_now(wheel->loop) - wheel->start) / wheel->resolution);
+}
+
+static void place(nw_wheel *wheel, nw_wheel_timer *timer)
+{
+    uint64_t expire = timer->expire;
+    if (expire < wheel->current)
+        expire = wheel->current;
+    uint64_t delta = expire - wheel->current;
+    if (delta > MAX_DELTA) {
+        delta = MAX_DELTA;
+        expire = wheel->current + delta;
+        timer->expire = expire;
+    }
+
+    int level = 0;
+    while (level < NW_WHEEL_LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1))))
+        level++;
+    list_add(&wheel->slots[level][(expire >> (SLOT_BITS * level)) & SLOT_MASK], timer);
+}
+
+/* move the timers of a higher level slot down, return the slot index */
+static int cascade(nw_wheel *wheel, int level)
+{
+    int index = (wheel->current >> (SLOT_BITS * level)) & SLOT_MASK;
+    nw_wheel_timer list;
+    list_splice(&wheel->slots[level][index], &list);
+    while (list.next != &list) {
+        nw_wheel_timer *timer = list.next;
+        list_del(timer);
+        place(wheel, timer);
+    }
+    return index;
+}
+
+static void on_tick(struct ev_loop *loop, ev_timer *ev, int events)
+{
+    nw_wheel *wheel = (nw_wheel *)ev;
+    uint64_t target = now_tick(wheel);
+
+    while (wheel->count && wheel->current <= target) {
+        int index = wheel->current & SLOT_MASK;
+        if (index == 0) {
+            for (int level = 1; level < NW_WHEEL_LEVELS; ++level) {
+                if (cascade(wheel, level) != 0)
+                    break;
+            }
+        }
+        wheel->current++;
+
+        /* callbacks may add or delete any timer, including those in list */
+        nw_wheel_timer list;
+        list_splice(&wheel->slots[0][index], &list);
+        while (list.next != &list) {
+            nw_wheel_timer *timer = list.next;
+            list_del(timer);
+            wheel->count--;
+            timer->callback(timer, timer->privdata);
+        }
+    }
+
+    if (wheel->count == 0) {
+        ev_timer_stop(wheel->loop, &wheel->ev);
+    }
+}
+
+nw_wheel *nw_wheel_create(double resolution)
+{
+    if (resolution <= 0)
+        return NULL;
+    nw_loop_init();
+    nw_wheel *wheel = malloc(sizeof(nw_wheel));
+    if (wheel == NULL)
+        return NULL;
+    memset(wheel, 0, sizeof(nw_wheel));
+    wheel->loop = nw_default_loop;
+    wheel->resolution = resolution;
+    wheel->start = ev_now(wheel->loop);
+    for (int i = 0; i < NW_WHEEL_LEVELS; ++i) {
+        for (int j = 0; j < NW_WHEEL_SLOTS; ++j) {
+            list_init(&wheel->slots[i][j]);
+        }
+    }
+    ev_timer_init(&wheel->ev, on_tick, resolution, resolution);
+
+    return wheel;
+}
+
+nw_wheel *nw_wheel_default(void)
+{
+    if (default_wheel == NULL) {
+        default_wheel = nw_wheel_create(NW_WHEEL_DEFAULT_RESOLUTION);
+    }
+    return default_wheel;
+}
+
+void nw_wheel_release(nw_wheel *wheel)
+{
+    ev_timer_stop(wheel->loop, &wheel->ev);
+    for (int i = 0; i < NW_WHEEL_LEVELS; ++i) {
+        for (int j = 0; j < NW_WHEEL_SLOTS; ++j) {
+            nw_wheel_timer *head = &wheel->slots[i][j];
+            while (head->next != head) {
+                list_del(head->next);
+            }
+        }
+    }
+    if (wheel == default_wheel)
+        default_wheel = NULL;
+    free(wheel);
+}
+
+void nw_wheel_timer_init(nw_wheel_timer *timer, nw_wheel_callback callback, void *privdata)
+{
+    memset(timer, 0, sizeof(nw_wheel_timer));
+    timer->callback = callback;
+    timer->privdata = privdata;
+}
+
+void nw_wheel_add(nw_wheel *wheel, nw_wheel_timer *timer, double timeout)
+{
+    if (timer->next) {
+        list_del(timer);
+        wheel->count--;
+    }
+    if (timeout < 0)
+        timeout = 0;
+
+    if (wheel->count == 0) {
+        /* nothing pending, skip the idle ticks instead of walking them */
+        uint64_t tick = now_tick(wheel);
+        if (wheel->current < tick)
+            wheel->current = tick;
+    }
+    double expire = ceil((ev_now(wheel->loop) - wheel->start + timeout) / wheel->resolution);
+    timer->expire = expire > (double)UINT64_MAX / 2 ? UINT64_MAX / 2 : (uint64_t)expire;
+    place(wheel, timer);
+
+    wheel->count++;
+    if (!ev_is_active(&wheel->ev)) {
+        ev_timer_start(wheel->loop, &wheel->ev);
+    }
+}
+
+void nw_wheel_del(nw_wheel *wheel, nw_wheel_timer *timer)
+{
+    if (timer->next == NULL)
+        return;
+    list_del(timer);
+    wheel->count--;
+    if (wheel->count == 0) {
+        ev_timer_stop(wheel->loop, &wheel->ev);
+    }
+}
+
+bool nw_wheel_active(nw_wheel_timer *timer)
+{
+    return timer->next != NULL;
+}
+
+size_t nw_wheel_count(nw_wheel *wheel)
+{
+    return wheel->count;
+}
+
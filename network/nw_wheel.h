@@ -0,0 +1,65 @@
+/*
+ * Description: hierarchical timing wheel
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _NW_WHEEL_H_
+# define _NW_WHEEL_H_
+
+# include <stdint.h>
+# include <stdbool.h>
+# include <stddef.h>
+
+# include "nw_evt.h"
+
+/*
+ * nw_wheel keeps a large number of timers in four levels of 256 slots,
+ * add, del and expire are O(1) and the whole wheel is driven by a single
+ * ev_timer ticking at the wheel resolution. A timer never fires early,
+ * and fires at most one tick late.
+ *
+ * Timers are embedded in the caller's struct, like nw_timer, and must be
+ * deleted before the memory is released.
+ */
+
+# define NW_WHEEL_LEVELS            4
+# define NW_WHEEL_SLOTS             256
+# define NW_WHEEL_DEFAULT_RESOLUTION 0.01
+
+struct nw_wheel_timer;
+typedef void (*nw_wheel_callback)(struct nw_wheel_timer *timer, void *privdata);
+
+typedef struct nw_wheel_timer {
+    struct nw_wheel_timer *prev;
+    struct nw_wheel_timer *next;
+    uint64_t expire;
+    nw_wheel_callback callback;
+    void *privdata;
+} nw_wheel_timer;
+
+typedef struct nw_wheel {
+    ev_timer ev;
+    struct ev_loop *loop;
+    double resolution;
+    double start;
+    /* the next tick to process */
+    uint64_t current;
+    size_t count;
+    nw_wheel_timer slots[NW_WHEEL_LEVELS][NW_WHEEL_SLOTS];
+} nw_wheel;
+
+/* shared wheel with NW_WHEEL_DEFAULT_RESOLUTION, created on first use */
+nw_wheel *nw_wheel_default(void);
+nw_wheel *nw_wheel_create(double resolution);
+void nw_wheel_release(nw_wheel *wheel);
+
+void nw_wheel_timer_init(nw_wheel_timer *timer, nw_wheel_callback callback, void *privdata);
+/* call callback after timeout seconds, an active timer is rescheduled */
+void nw_wheel_add(nw_wheel *wheel, nw_wheel_timer *timer, double timeout);
+void nw_wheel_del(nw_wheel *wheel, nw_wheel_timer *timer);
+bool nw_wheel_active(nw_wheel_timer *timer);
+/* return the pending timer count */
+size_t nw_wheel_count(nw_wheel *wheel);
+
+# endif
+
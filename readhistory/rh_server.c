@@ -17,6 +17,7 @@ struct job_request {
     rpc_pkg  pkg;
     uint64_t ses_id;
     uint32_t command;
+    uint8_t  encoding;
     json_t   *params;
 };
 
@@ -28,23 +29,18 @@ struct job_reply {
 
 static int reply_json(nw_ses *ses, rpc_pkg *pkg, const json_t *json)
 {
-    char *message_data;
-    if (settings.debug) {
-        message_data = json_dumps(json, JSON_INDENT(4));
-    } else {
-        message_data = json_dumps(json, 0);
-    }
-    if (message_data == NULL)
-        return -__LINE__;
-    log_trace("connection: %s send: %s", nw_sock_human_addr(&ses->peer_addr), message_data);
-
     rpc_pkg reply;
     memcpy(&reply, pkg, sizeof(reply));
     reply.pkg_type = RPC_PKG_TYPE_REPLY;
-    reply.body = message_data;
-    reply.body_size = strlen(message_data);
+    if (rpc_body_encode(&reply, json, rpc_pkg_encoding(pkg), settings.debug ? JSON_INDENT(4) : 0) < 0)
+        return -__LINE__;
+    if (reply.ext_size == 0) {
+        log_trace("connection: %s send: %.*s", nw_sock_human_addr(&ses->peer_addr), (int)reply.body_size, (char *)reply.body);
+    } else {
+        log_trace("connection: %s send: (binary %u bytes)", nw_sock_human_addr(&ses->peer_addr), reply.body_size);
+    }
     rpc_send(ses, &reply);
-    free(message_data);
+    free(reply.body);
 
     return 0;
 }
@@ -370,7 +366,7 @@ static void on_job_release(void *privdata)
 
 static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
 {
-    json_t *params = json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    json_t *params = rpc_params_json(pkg);
     if (params == NULL || !json_is_array(params)) {
         sds hex = hexdump(pkg->body, pkg->body_size);
         log_error("connection: %s, cmd: %u decode params fail, params data: \n%s", \
@@ -380,7 +376,7 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
         return;
     }
 
-    sds params_str = sdsnewlen(pkg->body, pkg->body_size);
+    sds params_str = rpc_body_str(pkg);
     log_debug("from %s command: %u, params: %s", nw_sock_human_addr(&ses->peer_addr), pkg->command, params_str);
     sdsfree(params_str);
 
@@ -394,6 +390,12 @@ static void svr_on_recv_pkg(nw_ses *ses, rpc_pkg *pkg)
     struct job_request *req = malloc(sizeof(struct job_request));
     memset(req, 0, sizeof(struct job_request));
     memcpy(&req->pkg, pkg, sizeof(rpc_pkg));
+    /* body and ext point into the receive buffer, keep only the encoding */
+    req->encoding = rpc_pkg_encoding(pkg);
+    req->pkg.body = NULL;
+    req->pkg.body_size = 0;
+    req->pkg.ext = &req->encoding;
+    req->pkg.ext_size = 1;
     req->ses = ses;
     req->ses_id = ses->id;
     req->command = pkg->command;
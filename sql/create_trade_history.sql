@@ -86,3 +86,22 @@ CREATE TABLE `user_deal_history_example` (
     `deal_fee`      DECIMAL(30,16) NOT NULL,
     INDEX `idx_user_market` (`user_id`, `market`)
 ) ENGINE=InnoDB DEFAULT CHARSET=utf8;
+
+-- split by user_id
+CREATE TABLE `stop_history_example` (
+    `id`            BIGINT UNSIGNED NOT NULL PRIMARY KEY,
+    `create_time`   DOUBLE NOT NULL,
+    `finish_time`   DOUBLE NOT NULL,
+    `user_id`       INT UNSIGNED NOT NULL,
+    `market`        VARCHAR(30) NOT NULL,
+    `source`        VARCHAR(30) NOT NULL,
+    `t`             TINYINT UNSIGNED NOT NULL,
+    `side`          TINYINT UNSIGNED NOT NULL,
+    `stop_price`    DECIMAL(30,8) NOT NULL,
+    `price`         DECIMAL(30,8) NOT NULL,
+    `amount`        DECIMAL(30,8) NOT NULL,
+    `taker_fee`     DECIMAL(30,4) NOT NULL,
+    `maker_fee`     DECIMAL(30,4) NOT NULL,
+    `status`        TINYINT UNSIGNED NOT NULL,
+    INDEX `idx_user_market` (`user_id`, `market`)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8;
@@ -0,0 +1,24 @@
+-- upgrade a trade_log created by an older matchengine, run once before
+-- starting the new one. new deployments use create_trade_log.sql only
+
+ALTER TABLE `slice_order_example` ADD COLUMN `expire_time` DOUBLE NOT NULL DEFAULT 0;
+
+CREATE TABLE IF NOT EXISTS `slice_stop_example` (
+    `id`            BIGINT UNSIGNED NOT NULL PRIMARY KEY,
+    `t`             TINYINT UNSIGNED NOT NULL,
+    `side`          TINYINT UNSIGNED NOT NULL,
+    `create_time`   DOUBLE NOT NULL,
+    `user_id`       INT UNSIGNED NOT NULL,
+    `market`        VARCHAR(30) NOT NULL,
+    `source`        VARCHAR(30) NOT NULL,
+    `stop_price`    DECIMAL(30,8) NOT NULL,
+    `price`         DECIMAL(30,8) NOT NULL,
+    `amount`        DECIMAL(30,8) NOT NULL,
+    `taker_fee`     DECIMAL(30,4) NOT NULL,
+    `maker_fee`     DECIMAL(30,4) NOT NULL
+) ENGINE=InnoDB DEFAULT CHARSET=utf8;
+
+CREATE TABLE IF NOT EXISTS `slice_market_example` (
+    `market`        VARCHAR(30) NOT NULL PRIMARY KEY,
+    `last`          DECIMAL(30,16) NOT NULL
+) ENGINE=InnoDB DEFAULT CHARSET=utf8;
@@ -0,0 +1,534 @@
+/*
+ * Description: matching benchmark, drive the engine without mysql/kafka
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <error.h>
+# include <errno.h>
+# include <time.h>
+# include <math.h>
+# include <unistd.h>
+
+# include "me_config.h"
+# include "me_balance.h"
+# include "me_market.h"
+# include "me_trade.h"
+# include "me_history.h"
+# include "me_message.h"
+# include "me_operlog.h"
+
+/* allocation counting, interpose glibc malloc */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static bool alloc_counting;
+static uint64_t alloc_count;
+
+void *malloc(size_t size)
+{
+    if (alloc_counting)
+        alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (alloc_counting)
+        alloc_count++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (alloc_counting)
+        alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+/* in memory no-op sinks */
+
+int append_order_history(order_t *order)
+{
+    return 0;
+}
+
+int append_stop_history(stop_t *stop, double finish_time, int status)
+{
+    return 0;
+}
+
+int append_order_deal_history(double t, uint64_t deal_id, order_t *ask, int ask_role, order_t *bid, int bid_role, mpd_t *price, mpd_t *amount, mpd_t *deal, mpd_t *ask_fee, mpd_t *bid_fee)
+{
+    return 0;
+}
+
+int append_user_balance_history(double t, uint32_t user_id, const char *asset, const char *business, mpd_t *change, const char *detail)
+{
+    return 0;
+}
+
+bool is_history_block(void)
+{
+    return false;
+}
+
+int push_balance_message(double t, uint32_t user_id, const char *asset, const char *business, mpd_t *change)
+{
+    return 0;
+}
+
+int push_order_message(uint32_t event, order_t *order, market_t *market)
+{
+    return 0;
+}
+
+int push_stop_message(uint32_t event, stop_t *stop, market_t *market)
+{
+    return 0;
+}
+
+int push_deal_message(double t, const char *market, order_t *ask, order_t *bid, mpd_t *price, mpd_t *amount,
+        mpd_t *ask_fee, mpd_t *bid_fee, int side, uint64_t id, const char *stock, const char *money)
+{
+    return 0;
+}
+
+bool is_message_block(void)
+{
+    return false;
+}
+
+int append_operlog(const char *method, json_t *params)
+{
+    return 0;
+}
+
+bool is_operlog_block(void)
+{
+    return false;
+}
+
+/* benchmark */
+
+enum {
+    OP_LIMIT,
+    OP_MARKET,
+    OP_CANCEL,
+    OP_SKIP,
+    OP_MAX,
+};
+
+static const char *op_names[OP_MAX] = { "limit", "market", "cancel", "skip" };
+
+static struct {
+    const char  *config;
+    const char  *replay;
+    size_t      ops;
+    uint32_t    users;
+    double      mid;
+    double      width;
+    bool        uniform;
+    double      cancel_ratio;
+    double      market_ratio;
+    unsigned    seed;
+} opt = {
+    .ops            = 1000000,
+    .users          = 1000,
+    .mid            = 10000,
+    .width          = 50,
+    .cancel_ratio   = 0.3,
+    .market_ratio   = 0.05,
+    .seed           = 1,
+};
+
+static uint64_t *latency;
+static size_t latency_num;
+static size_t latency_cap;
+static size_t op_count[OP_MAX];
+static uint64_t run_ns;
+
+static uint64_t *live;
+static size_t live_num;
+static size_t live_cap;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t begin(void)
+{
+    alloc_counting = true;
+    return now_ns();
+}
+
+static void record(int op, uint64_t start)
+{
+    uint64_t end = now_ns();
+    alloc_counting = false;
+    if (latency_num == latency_cap) {
+        latency_cap = latency_cap ? latency_cap * 2 : 1024 * 1024;
+        latency = __libc_realloc(latency, latency_cap * sizeof(uint64_t));
+    }
+    latency[latency_num++] = end - start;
+    op_count[op] += 1;
+    run_ns += end - start;
+}
+
+static void live_add(uint64_t id)
+{
+    if (live_num == live_cap) {
+        live_cap = live_cap ? live_cap * 2 : 1024;
+        live = __libc_realloc(live, live_cap * sizeof(uint64_t));
+    }
+    live[live_num++] = id;
+}
+
+static double rand_unit(void)
+{
+    return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+static double rand_offset(void)
+{
+    if (opt.uniform)
+        return (rand_unit() * 2 - 1) * opt.width;
+    return sqrt(-2 * log(rand_unit())) * cos(2 * M_PI * rand_unit()) * opt.width;
+}
+
+static int init_default_settings(void)
+{
+    static struct asset assets[] = {
+        { "BTC", 20, 8 },
+        { "USD", 20, 8 },
+    };
+    static struct market markets[] = {
+        { "BTCUSD", "BTC", "USD", 4, 8, 2, NULL },
+    };
+    markets[0].min_amount = decimal("0.001", 0);
+
+    settings.asset_num  = sizeof(assets) / sizeof(assets[0]);
+    settings.assets     = assets;
+    settings.market_num = sizeof(markets) / sizeof(markets[0]);
+    settings.markets    = markets;
+
+    return 0;
+}
+
+static int put_limit(market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *price,
+        mpd_t *taker_fee, mpd_t *maker_fee, const char *source, double expire_time)
+{
+    json_t *result = NULL;
+    uint64_t start = begin();
+    int ret = market_put_limit_order(true, &result, m, user_id, side, amount, price, taker_fee, maker_fee, source, expire_time);
+    if (result)
+        json_decref(result);
+    record(OP_LIMIT, start);
+    return ret;
+}
+
+static int put_market(market_t *m, uint32_t user_id, uint32_t side, mpd_t *amount, mpd_t *taker_fee, const char *source)
+{
+    json_t *result = NULL;
+    uint64_t start = begin();
+    int ret = market_put_market_order(true, &result, m, user_id, side, amount, taker_fee, source);
+    if (result)
+        json_decref(result);
+    record(OP_MARKET, start);
+    return ret;
+}
+
+static int cancel(market_t *m, order_t *order)
+{
+    json_t *result = NULL;
+    uint64_t start = begin();
+    int ret = market_cancel_order(true, &result, m, order);
+    if (result)
+        json_decref(result);
+    record(OP_CANCEL, start);
+    return ret;
+}
+
+static int run_synthetic(void)
+{
+    market_t *m = get_market(settings.markets[0].name);
+    if (m == NULL)
+        return -__LINE__;
+
+    mpd_t *stock = decimal("100000000", 0);
+    mpd_t *money = decimal("1000000000000", 0);
+    for (uint32_t user_id = 1; user_id <= opt.users; ++user_id) {
+        balance_add(user_id, BALANCE_TYPE_AVAILABLE, m->stock, stock);
+        balance_add(user_id, BALANCE_TYPE_AVAILABLE, m->money, money);
+    }
+    mpd_del(stock);
+    mpd_del(money);
+
+    mpd_t *taker_fee = decimal("0.002", m->fee_prec);
+    mpd_t *maker_fee = decimal("0.001", m->fee_prec);
+    mpd_t *amount = mpd_new(&mpd_ctx);
+    mpd_t *price = mpd_new(&mpd_ctx);
+    char buf[64];
+
+    srand(opt.seed);
+    for (size_t i = 0; i < opt.ops; ++i) {
+        double r = rand_unit();
+        if (r < opt.cancel_ratio) {
+            order_t *order = NULL;
+            while (live_num && order == NULL) {
+                size_t idx = rand() % live_num;
+                uint64_t id = live[idx];
+                live[idx] = live[--live_num];
+                order = market_get_order(m, id);
+            }
+            if (order) {
+                cancel(m, order);
+                continue;
+            }
+        }
+
+        uint32_t user_id = rand() % opt.users + 1;
+        uint32_t side = rand() % 2 ? MARKET_ORDER_SIDE_ASK : MARKET_ORDER_SIDE_BID;
+        snprintf(buf, sizeof(buf), "%.3f", (rand() % 1000 + 1) / 1000.0);
+        mpd_set_string(amount, buf, &mpd_ctx);
+
+        if (r >= opt.cancel_ratio && r < opt.cancel_ratio + opt.market_ratio) {
+            put_market(m, user_id, side, amount, taker_fee, "bench");
+            continue;
+        }
+
+        double p = opt.mid + rand_offset();
+        if (p < 0.01)
+            p = 0.01;
+        snprintf(buf, sizeof(buf), "%.2f", p);
+        mpd_set_string(price, buf, &mpd_ctx);
+
+        uint64_t id = order_id_start + 1;
+        put_limit(m, user_id, side, amount, price, taker_fee, maker_fee, "bench", 0);
+        if (market_get_order(m, id))
+            live_add(id);
+    }
+
+    mpd_del(taker_fee);
+    mpd_del(maker_fee);
+    mpd_del(amount);
+    mpd_del(price);
+
+    return 0;
+}
+
+static mpd_t *get_decimal(json_t *params, size_t index, int prec)
+{
+    const char *str = json_string_value(json_array_get(params, index));
+    if (str == NULL)
+        return NULL;
+    return decimal(str, prec);
+}
+
+static int replay_cancel(json_t *params)
+{
+    market_t *m = get_market(json_string_value(json_array_get(params, 1)));
+    if (m == NULL)
+        return -__LINE__;
+    order_t *order = market_get_order(m, json_integer_value(json_array_get(params, 2)));
+    if (order == NULL)
+        return -__LINE__;
+    return cancel(m, order);
+}
+
+static int replay_oper(json_t *detail)
+{
+    const char *method = json_string_value(json_object_get(detail, "method"));
+    json_t *params = json_object_get(detail, "params");
+    if (method == NULL || !json_is_array(params))
+        return -__LINE__;
+
+    int ret = 0;
+    if (strcmp(method, "update_balance") == 0) {
+        const char *asset = json_string_value(json_array_get(params, 1));
+        if (asset == NULL || !asset_exist(asset))
+            return -__LINE__;
+        mpd_t *change = get_decimal(params, 4, asset_prec(asset));
+        if (change == NULL)
+            return -__LINE__;
+        uint32_t user_id = json_integer_value(json_array_get(params, 0));
+        if (mpd_cmp(change, mpd_zero, &mpd_ctx) >= 0) {
+            balance_add(user_id, BALANCE_TYPE_AVAILABLE, asset, change);
+        } else {
+            mpd_minus(change, change, &mpd_ctx);
+            balance_sub(user_id, BALANCE_TYPE_AVAILABLE, asset, change);
+        }
+        mpd_del(change);
+    } else if (strcmp(method, "limit_order") == 0 || strcmp(method, "market_order") == 0) {
+        bool limit = method[0] == 'l';
+        market_t *m = get_market(json_string_value(json_array_get(params, 1)));
+        if (m == NULL)
+            return -__LINE__;
+        uint32_t user_id = json_integer_value(json_array_get(params, 0));
+        uint32_t side = json_integer_value(json_array_get(params, 2));
+        mpd_t *amount = get_decimal(params, 3, m->stock_prec);
+        mpd_t *price = limit ? get_decimal(params, 4, m->money_prec) : NULL;
+        mpd_t *taker_fee = get_decimal(params, limit ? 5 : 4, m->fee_prec);
+        mpd_t *maker_fee = limit ? get_decimal(params, 6, m->fee_prec) : NULL;
+        const char *source = json_string_value(json_array_get(params, limit ? 7 : 5));
+        if (amount && taker_fee && source && (!limit || (price && maker_fee))) {
+            if (limit) {
+                double expire_time = json_number_value(json_array_get(params, 8));
+                ret = put_limit(m, user_id, side, amount, price, taker_fee, maker_fee, source, expire_time);
+            } else {
+                ret = put_market(m, user_id, side, amount, taker_fee, source);
+            }
+        } else {
+            ret = -__LINE__;
+        }
+        if (amount)
+            mpd_del(amount);
+        if (price)
+            mpd_del(price);
+        if (taker_fee)
+            mpd_del(taker_fee);
+        if (maker_fee)
+            mpd_del(maker_fee);
+    } else if (strcmp(method, "cancel_order") == 0) {
+        ret = replay_cancel(params);
+    } else if (strcmp(method, "expire_orders") == 0) {
+        for (size_t i = 0; i < json_array_size(params); ++i) {
+            replay_cancel(json_array_get(params, i));
+        }
+    } else {
+        op_count[OP_SKIP] += 1;
+    }
+
+    return ret;
+}
+
+static int run_replay(void)
+{
+    FILE *fp = fopen(opt.replay, "r");
+    if (fp == NULL)
+        return -__LINE__;
+
+    size_t errors = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    while ((len = getline(&line, &cap, fp)) > 0) {
+        json_t *detail = json_loadb(line, len, 0, NULL);
+        if (detail == NULL) {
+            errors++;
+            continue;
+        }
+        if (replay_oper(detail) < 0)
+            errors++;
+        json_decref(detail);
+    }
+    free(line);
+    fclose(fp);
+
+    if (errors)
+        printf("replay errors: %zu\n", errors);
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(double p)
+{
+    if (latency_num == 0)
+        return 0;
+    size_t idx = (size_t)(p * (latency_num - 1));
+    return latency[idx] / 1000.0;
+}
+
+static void report(void)
+{
+    qsort(latency, latency_num, sizeof(uint64_t), compare_u64);
+
+    printf("ops: %zu", latency_num);
+    for (int i = 0; i < OP_MAX; ++i) {
+        printf(", %s: %zu", op_names[i], op_count[i]);
+    }
+    printf("\n");
+    printf("deals: %"PRIu64"\n", deals_id_start);
+    printf("time: %.3f s, ops/s: %.0f\n", run_ns / 1e9, run_ns ? latency_num / (run_ns / 1e9) : 0);
+    printf("latency(us): p50: %.2f, p99: %.2f, p999: %.2f, max: %.2f\n",
+            percentile(0.5), percentile(0.99), percentile(0.999), percentile(1));
+    printf("allocs/op: %.2f\n", latency_num ? (double)alloc_count / latency_num : 0);
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options]\n"
+            "  -c config   matchengine config.json, for assets and markets\n"
+            "  -f file     replay operlog dump, one detail json per line\n"
+            "  -n ops      synthetic operations, default %zu\n"
+            "  -u users    synthetic users, default %u\n"
+            "  -p price    mid price, default %g\n"
+            "  -w width    price stddev (normal) or half width (uniform), default %g\n"
+            "  -U          uniform price distribution\n"
+            "  -x ratio    cancel ratio, default %g\n"
+            "  -m ratio    market order ratio, default %g\n"
+            "  -s seed     random seed, default %u\n",
+            name, opt.ops, opt.users, opt.mid, opt.width, opt.cancel_ratio, opt.market_ratio, opt.seed);
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "c:f:n:u:p:w:Ux:m:s:h")) != -1) {
+        switch (c) {
+        case 'c': opt.config = optarg; break;
+        case 'f': opt.replay = optarg; break;
+        case 'n': opt.ops = strtoull(optarg, NULL, 0); break;
+        case 'u': opt.users = strtoul(optarg, NULL, 0); break;
+        case 'p': opt.mid = strtod(optarg, NULL); break;
+        case 'w': opt.width = strtod(optarg, NULL); break;
+        case 'U': opt.uniform = true; break;
+        case 'x': opt.cancel_ratio = strtod(optarg, NULL); break;
+        case 'm': opt.market_ratio = strtod(optarg, NULL); break;
+        case 's': opt.seed = strtoul(optarg, NULL, 0); break;
+        default:
+            usage(argv[0]);
+            return 0;
+        }
+    }
+    if (opt.users == 0)
+        opt.users = 1;
+
+    if (init_mpd() < 0)
+        error(EXIT_FAILURE, errno, "init mpd fail");
+    if (opt.config) {
+        if (init_config(opt.config) < 0)
+            error(EXIT_FAILURE, errno, "load config fail");
+    } else {
+        init_default_settings();
+    }
+    if (init_balance() < 0)
+        error(EXIT_FAILURE, errno, "init balance fail");
+    if (init_trade() < 0)
+        error(EXIT_FAILURE, errno, "init trade fail");
+
+    if (opt.replay) {
+        if (run_replay() < 0)
+            error(EXIT_FAILURE, errno, "replay %s fail", opt.replay);
+    } else {
+        if (run_synthetic() < 0)
+            error(EXIT_FAILURE, errno, "run synthetic fail");
+    }
+
+    report();
+    return 0;
+}
+
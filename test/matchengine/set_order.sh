@@ -13,6 +13,16 @@
 ./cli.exe 127.0.0.1 7316 203 '[1, "BTCCNY", 0,10]'
 
 
+#sell 1 bitcoins at 8020 CNY, cancel automatically if not filled in 60 seconds
+./cli.exe 127.0.0.1 7316 201 "[1, \"BTCCNY\", 1, \"1\", \"8020\", \"0.002\", \"0.001\",\"api.v1\", $(( $(date +%s) + 60 ))]"
+
+#query my pending order list
+./cli.exe 127.0.0.1 7316 203 '[1, "BTCCNY", 0,10]'
+
+#query my pending order list of all markets
+./cli.exe 127.0.0.1 7316 215 '[1, 0,10]'
+
+
 #query all pending list on sell direction
 ./cli.exe 127.0.0.1 7316 205 '[ "BTCCNY", 1, 0,10]'
 
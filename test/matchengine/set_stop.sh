@@ -0,0 +1,13 @@
+#!/bin/bash
+
+#sell 1 bitcoin at 7900 CNY when the price falls to 7950 CNY
+./cli.exe 127.0.0.1 7316 211 '[1, "BTCCNY", 1, "1", "7950", "7900", "0.002", "0.001", "api.v1"]'
+
+#buy bitcoins with 8000 CNY when the price rises to 8100 CNY
+./cli.exe 127.0.0.1 7316 212 '[1, "BTCCNY", 2, "8000", "8100", "0.002", "api.v1"]'
+
+#query my pending stop list
+./cli.exe 127.0.0.1 7316 214 '[1, "BTCCNY", 0, 10]'
+
+#cancel stop
+./cli.exe 127.0.0.1 7316 213 '[1, "BTCCNY", stop_id]'
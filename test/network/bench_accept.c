@@ -0,0 +1,244 @@
+/*
+ * Description: accept throughput, fd passing listener vs SO_REUSEPORT workers
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <signal.h>
+# include <time.h>
+# include <sys/wait.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+
+# include "nw_svr.h"
+
+# define MAX_WORKER 64
+
+static int worker_num;
+static int worker_fds[MAX_WORKER];
+static nw_svr *svr;
+static ev_io fd_watcher;
+
+static int decode_pkg(nw_ses *ses, void *data, size_t max)
+{
+    return max;
+}
+
+static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
+{
+    nw_ses_send(ses, "ok", 2);
+}
+
+static void on_error_msg(nw_ses *ses, const char *msg)
+{
+}
+
+/* same choice as the accessws and accesshttp listener */
+static int listener_on_accept(nw_ses *ses, int sockfd, nw_addr_t *peer_addr)
+{
+    int fd = worker_fds[rand() % worker_num];
+    struct msghdr msg;
+    struct iovec io;
+    char control[CMSG_SPACE(sizeof(int))];
+    char c = 0;
+
+    memset(&msg, 0, sizeof(msg));
+    io.iov_base = &c;
+    io.iov_len = 1;
+    msg.msg_iov = &io;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    *((int *)CMSG_DATA(cmsg)) = sockfd;
+
+    sendmsg(fd, &msg, MSG_EOR);
+    close(sockfd);
+    return 0;
+}
+
+static void on_recv_fd(struct ev_loop *loop, ev_io *watcher, int events)
+{
+    while (true) {
+        struct msghdr msg;
+        struct iovec io;
+        char control[CMSG_SPACE(sizeof(int))];
+        char c;
+
+        memset(&msg, 0, sizeof(msg));
+        io.iov_base = &c;
+        io.iov_len = 1;
+        msg.msg_iov = &io;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(watcher->fd, &msg, MSG_DONTWAIT) <= 0)
+            break;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_type == SCM_RIGHTS) {
+            int fd = *(int *)CMSG_DATA(cmsg);
+            if (nw_svr_add_clt_fd(svr, fd) < 0)
+                close(fd);
+        }
+    }
+}
+
+static nw_svr *create_svr(const char *bind, bool reuse_port, bool listener)
+{
+    static nw_svr_bind bind_arr;
+    nw_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (nw_sock_cfg_parse(bind, &bind_arr.addr, &bind_arr.sock_type) < 0)
+        return NULL;
+    cfg.bind_count = 1;
+    cfg.bind_arr = &bind_arr;
+    cfg.max_pkg_size = 1024;
+    cfg.reuse_port = reuse_port;
+
+    nw_svr_type type;
+    memset(&type, 0, sizeof(type));
+    type.decode_pkg = decode_pkg;
+    type.on_recv_pkg = on_recv_pkg;
+    type.on_error_msg = on_error_msg;
+    if (listener)
+        type.on_accept = listener_on_accept;
+
+    return nw_svr_create(&cfg, &type, NULL);
+}
+
+static int connect_once(struct sockaddr_in *addr)
+{
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0)
+        return -1;
+    /* reset on close so the client does not run out of ports in TIME_WAIT */
+    struct linger linger = { 1, 0 };
+    setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    int ret = -1;
+    char buf[2];
+    if (connect(sockfd, (struct sockaddr *)addr, sizeof(*addr)) == 0 &&
+            write(sockfd, "x", 1) == 1 && read(sockfd, buf, sizeof(buf)) == 2) {
+        ret = 0;
+    }
+    close(sockfd);
+    return ret;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(bool reuse_port, int port, int clients, int count)
+{
+    char bind[100];
+    snprintf(bind, sizeof(bind), "tcp@127.0.0.1:%d", port);
+
+    pid_t pids[MAX_WORKER + 1];
+    int pid_count = 0;
+    fflush(stdout);
+    for (int i = 0; i < worker_num; ++i) {
+        int sv[2];
+        if (!reuse_port && socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+            return -1;
+        pid_t pid = fork();
+        if (pid == 0) {
+            svr = create_svr(bind, reuse_port, false);
+            if (svr == NULL)
+                exit(EXIT_FAILURE);
+            if (reuse_port) {
+                if (nw_svr_start(svr) < 0)
+                    exit(EXIT_FAILURE);
+            } else {
+                close(sv[0]);
+                ev_io_init(&fd_watcher, on_recv_fd, sv[1], EV_READ);
+                ev_io_start(nw_default_loop, &fd_watcher);
+            }
+            nw_loop_run();
+            exit(EXIT_SUCCESS);
+        }
+        pids[pid_count++] = pid;
+        if (!reuse_port) {
+            close(sv[1]);
+            worker_fds[i] = sv[0];
+        }
+    }
+    if (!reuse_port) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            svr = create_svr(bind, false, true);
+            if (svr == NULL || nw_svr_start(svr) < 0)
+                exit(EXIT_FAILURE);
+            nw_loop_run();
+            exit(EXIT_SUCCESS);
+        }
+        pids[pid_count++] = pid;
+        for (int i = 0; i < worker_num; ++i) {
+            close(worker_fds[i]);
+        }
+    }
+    usleep(200 * 1000);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    double start = now();
+    for (int i = 0; i < clients; ++i) {
+        if (fork() == 0) {
+            int fail = 0;
+            for (int j = 0; j < count / clients; ++j) {
+                if (connect_once(&addr) < 0)
+                    fail++;
+            }
+            if (fail)
+                printf("client %d: %d connections fail\n", i, fail);
+            fflush(stdout);
+            _exit(fail ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+    }
+    int error = 0;
+    for (int i = 0; i < clients; ++i) {
+        int status;
+        wait(&status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            error = 1;
+    }
+    double cost = now() - start;
+
+    for (int i = 0; i < pid_count; ++i) {
+        kill(pids[i], SIGKILL);
+        waitpid(pids[i], NULL, 0);
+    }
+
+    return error ? -1 : (count / clients * clients) / cost;
+}
+
+int main(int argc, char *argv[])
+{
+    worker_num = argc > 1 ? atoi(argv[1]) : 4;
+    int clients = argc > 2 ? atoi(argv[2]) : 4;
+    int count = argc > 3 ? atoi(argv[3]) : 20000;
+    if (worker_num < 1 || worker_num > MAX_WORKER || clients < 1)
+        return 1;
+    int port = 20000 + getpid() % 10000;
+
+    double pass = run(false, port, clients, count);
+    printf("fd passing listener, workers: %d, clients: %d, connections/s: %.0f\n", worker_num, clients, pass);
+    double reuse = run(true, port + 1, clients, count);
+    printf("SO_REUSEPORT,        workers: %d, clients: %d, connections/s: %.0f\n", worker_num, clients, reuse);
+
+    return pass < 0 || reuse < 0;
+}
+
@@ -0,0 +1,93 @@
+/*
+ * Description: nw_job throughput benchmark
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "nw_job.h"
+
+static nw_job *job;
+static int total;
+static int added;
+static int finished;
+static int window;
+static int work;
+
+static void on_job(nw_job_entry *entry, void *privdata)
+{
+    /* a little cpu work to stand in for a query */
+    volatile uint64_t x = entry->id;
+    for (int i = 0; i < work; ++i) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    entry->reply = (void *)(uintptr_t)x;
+}
+
+static void add_jobs(void)
+{
+    while (added < total && added - finished < window) {
+        nw_job_add(job, added, NULL);
+        added++;
+    }
+}
+
+static void on_finish(nw_job_entry *entry)
+{
+    finished++;
+    if (finished == total) {
+        nw_loop_break();
+        return;
+    }
+    if (added - finished < window / 2) {
+        add_jobs();
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(int workers)
+{
+    nw_job_type type;
+    memset(&type, 0, sizeof(type));
+    type.on_job = on_job;
+    type.on_finish = on_finish;
+
+    job = nw_job_create(&type, workers);
+    if (job == NULL) {
+        printf("nw_job_create fail\n");
+        exit(EXIT_FAILURE);
+    }
+
+    added = finished = 0;
+    double start = now();
+    add_jobs();
+    nw_loop_run();
+    double cost = now() - start;
+    nw_job_release(job);
+
+    return total / cost;
+}
+
+int main(int argc, char *argv[])
+{
+    total  = argc > 1 ? atoi(argv[1]) : 1000000;
+    window = argc > 2 ? atoi(argv[2]) : 10000;
+    work   = argc > 3 ? atoi(argv[3]) : 100;
+
+    printf("jobs: %d, window: %d, work: %d\n", total, window, work);
+    int workers[] = { 1, 4, 16 };
+    for (size_t i = 0; i < sizeof(workers) / sizeof(workers[0]); ++i) {
+        printf("workers: %2d, jobs/s: %.0f\n", workers[i], run(workers[i]));
+    }
+
+    return 0;
+}
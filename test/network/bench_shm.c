@@ -0,0 +1,222 @@
+/*
+ * Description: round trip latency and throughput, tcp and unix sockets vs nw_shm rings
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <signal.h>
+# include <time.h>
+# include <inttypes.h>
+# include <sys/wait.h>
+
+# include "nw_svr.h"
+# include "nw_clt.h"
+# include "nw_shm.h"
+# include "nw_timer.h"
+
+# define MAX_PKG_SIZE   10240
+# define MSG_SIZE       128
+# define WINDOW         64
+
+static int round_count;
+static int flood_count;
+
+static nw_clt *clt;
+static nw_timer timer;
+static char msg[MSG_SIZE];
+static bool flood;
+static int sent;
+static int received;
+static double send_time;
+static double *rtts;
+static double start;
+static double cost;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 4 bytes length then payload, so stream sockets keep the boundaries too */
+static int decode_pkg(nw_ses *ses, void *data, size_t max)
+{
+    if (max < sizeof(uint32_t))
+        return 0;
+    uint32_t size = *(uint32_t *)data;
+    if (size < sizeof(uint32_t) || size > MAX_PKG_SIZE)
+        return -1;
+    if (max < size)
+        return 0;
+    return size;
+}
+
+static void on_error_msg(nw_ses *ses, const char *msg)
+{
+    printf("error: %s\n", msg);
+}
+
+static void on_echo(nw_ses *ses, void *data, size_t size)
+{
+    nw_ses_send(ses, data, size);
+}
+
+static void run_server(const char *bind)
+{
+    static nw_svr_bind bind_arr;
+    nw_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (nw_sock_cfg_parse(bind, &bind_arr.addr, &bind_arr.sock_type) < 0)
+        exit(EXIT_FAILURE);
+    cfg.bind_count = 1;
+    cfg.bind_arr = &bind_arr;
+    cfg.max_pkg_size = MAX_PKG_SIZE;
+    cfg.shm = true;
+
+    nw_svr_type type;
+    memset(&type, 0, sizeof(type));
+    type.decode_pkg = decode_pkg;
+    type.on_recv_pkg = on_echo;
+    type.on_error_msg = on_error_msg;
+
+    nw_svr *svr = nw_svr_create(&cfg, &type, NULL);
+    if (svr == NULL || nw_svr_start(svr) < 0)
+        exit(EXIT_FAILURE);
+    nw_loop_run();
+    exit(EXIT_SUCCESS);
+}
+
+static void send_one(void)
+{
+    send_time = now();
+    nw_ses_send(&clt->ses, msg, sizeof(msg));
+    sent++;
+}
+
+static void on_reply(nw_ses *ses, void *data, size_t size)
+{
+    if (flood) {
+        received++;
+        if (received == flood_count) {
+            cost = now() - start;
+            nw_loop_break();
+        } else if (sent < flood_count) {
+            send_one();
+        }
+        return;
+    }
+
+    rtts[received++] = now() - send_time;
+    if (received == round_count) {
+        flood = true;
+        sent = received = 0;
+        start = now();
+        for (int i = 0; i < WINDOW && sent < flood_count; ++i) {
+            send_one();
+        }
+        return;
+    }
+    send_one();
+}
+
+static void on_start(nw_timer *timer, void *privdata)
+{
+    bool use_shm = *(bool *)privdata;
+    if (!nw_clt_connected(clt))
+        return;
+    if (use_shm && (clt->ses.shm == NULL || !nw_shm_active(clt->ses.shm)))
+        return;
+    nw_timer_stop(timer);
+    send_one();
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(double *)a, y = *(double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int run(const char *name, const char *addr, bool use_shm)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        run_server(addr);
+    }
+    usleep(200 * 1000);
+
+    nw_clt_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (nw_sock_cfg_parse(addr, &cfg.addr, &cfg.sock_type) < 0)
+        return -1;
+    cfg.max_pkg_size = MAX_PKG_SIZE;
+    cfg.shm_size = use_shm ? 1024 * 1024 : 0;
+
+    nw_clt_type type;
+    memset(&type, 0, sizeof(type));
+    type.decode_pkg = decode_pkg;
+    type.on_recv_pkg = on_reply;
+    type.on_error_msg = on_error_msg;
+
+    clt = nw_clt_create(&cfg, &type, NULL);
+    if (clt == NULL || nw_clt_start(clt) < 0)
+        return -1;
+
+    flood = false;
+    sent = received = 0;
+    nw_timer_set(&timer, 0.01, true, on_start, &use_shm);
+    nw_timer_start(&timer);
+    nw_loop_run();
+
+    qsort(rtts, round_count, sizeof(double), cmp_double);
+    double total = 0;
+    for (int i = 0; i < round_count; ++i) {
+        total += rtts[i];
+    }
+    printf("%-14s rtt avg: %6.2f us, p50: %6.2f us, p99: %6.2f us, pipelined: %8.0f msg/s\n", name,
+            total / round_count * 1e6, rtts[round_count / 2] * 1e6, rtts[round_count * 99 / 100] * 1e6,
+            flood_count / cost);
+    if (use_shm) {
+        printf("%-14s messages sent: %"PRIu64", eventfd wakeups: %"PRIu64"\n", "",
+                clt->ses.shm->send_count, clt->ses.shm->wakeup_count);
+    }
+
+    nw_clt_release(clt);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    round_count = argc > 1 ? atoi(argv[1]) : 20000;
+    flood_count = argc > 2 ? atoi(argv[2]) : 200000;
+    if (round_count < 1 || flood_count < 1)
+        return 1;
+    rtts = malloc(sizeof(double) * round_count);
+    memset(msg, 'x', sizeof(msg));
+    *(uint32_t *)msg = sizeof(msg);
+    signal(SIGPIPE, SIG_IGN);
+    nw_loop_init();
+
+    char addr[100];
+    int port = 20000 + getpid() % 10000;
+    snprintf(addr, sizeof(addr), "tcp@127.0.0.1:%d", port);
+    int error = run("tcp", addr, false);
+    unlink("/tmp/bench_shm_stream.sock");
+    error |= run("unix stream", "stream@/tmp/bench_shm_stream.sock", false);
+    unlink("/tmp/bench_shm_packet.sock");
+    error |= run("unix seqpacket", "seqpacket@/tmp/bench_shm_packet.sock", false);
+    unlink("/tmp/bench_shm.sock");
+    error |= run("shm", "seqpacket@/tmp/bench_shm.sock", true);
+
+    unlink("/tmp/bench_shm_stream.sock");
+    unlink("/tmp/bench_shm_packet.sock");
+    unlink("/tmp/bench_shm.sock");
+    free(rtts);
+    return error ? 1 : 0;
+}
+
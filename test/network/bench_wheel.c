@@ -0,0 +1,164 @@
+/*
+ * Description: nw_wheel vs libev timer heap, add, cancel, reschedule and expire
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "nw_wheel.h"
+
+struct wheel_item {
+    nw_wheel_timer timer;
+    double deadline;
+};
+
+struct heap_item {
+    ev_timer ev;
+    double deadline;
+};
+
+static int count;
+static int expected;
+static int fired;
+static int early;
+static double late_max;
+
+static double now(int clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double timeout_of(int i)
+{
+    return 0.05 + (i * 7919 % 1000) / 1000.0 * 0.95;
+}
+
+static void check_fire(double deadline)
+{
+    double diff = ev_now(nw_default_loop) - deadline;
+    if (diff < -1e-6)
+        early++;
+    if (diff > late_max)
+        late_max = diff;
+    if (++fired == expected)
+        nw_loop_break();
+}
+
+static void on_wheel_timer(nw_wheel_timer *timer, void *privdata)
+{
+    check_fire(((struct wheel_item *)privdata)->deadline);
+}
+
+static void on_heap_timer(struct ev_loop *loop, ev_timer *ev, int events)
+{
+    check_fire(((struct heap_item *)ev)->deadline);
+}
+
+static void report(const char *name, double add, double del, double mod, double run)
+{
+    printf("%-8s timers: %d, add: %.1f ns/op, cancel: %.1f ns/op, reschedule: %.1f ns/op, expire cpu: %.1f ns/op, "
+            "fired: %d, early: %d, max late: %.3fs\n", name, count,
+            add * 1e9 / count, del * 1e9 / (count / 2), mod * 1e9 / (count / 4), run * 1e9 / expected,
+            fired, early, late_max);
+}
+
+static int bench_wheel(void)
+{
+    nw_wheel *wheel = nw_wheel_default();
+    struct wheel_item *items = malloc(sizeof(struct wheel_item) * count);
+    ev_now_update(nw_default_loop);
+    double base = ev_now(nw_default_loop);
+
+    double start = now(CLOCK_MONOTONIC);
+    for (int i = 0; i < count; ++i) {
+        nw_wheel_timer_init(&items[i].timer, on_wheel_timer, &items[i]);
+        nw_wheel_add(wheel, &items[i].timer, timeout_of(i));
+        items[i].deadline = base + timeout_of(i);
+    }
+    double add = now(CLOCK_MONOTONIC) - start;
+
+    start = now(CLOCK_MONOTONIC);
+    for (int i = 0; i < count; i += 2) {
+        nw_wheel_del(wheel, &items[i].timer);
+    }
+    double del = now(CLOCK_MONOTONIC) - start;
+
+    start = now(CLOCK_MONOTONIC);
+    for (int i = 1; i < count; i += 4) {
+        nw_wheel_add(wheel, &items[i].timer, timeout_of(i + 1));
+        items[i].deadline = base + timeout_of(i + 1);
+    }
+    double mod = now(CLOCK_MONOTONIC) - start;
+
+    expected = nw_wheel_count(wheel);
+    fired = early = 0;
+    late_max = 0;
+    start = now(CLOCK_PROCESS_CPUTIME_ID);
+    nw_loop_run();
+    double run = now(CLOCK_PROCESS_CPUTIME_ID) - start;
+
+    report("nw_wheel", add, del, mod, run);
+    free(items);
+    return early || fired != count / 2;
+}
+
+static int bench_heap(void)
+{
+    struct ev_loop *loop = nw_default_loop;
+    struct heap_item *items = malloc(sizeof(struct heap_item) * count);
+    ev_now_update(loop);
+    double base = ev_now(loop);
+
+    double start = now(CLOCK_MONOTONIC);
+    for (int i = 0; i < count; ++i) {
+        ev_timer_init(&items[i].ev, on_heap_timer, timeout_of(i), 0);
+        ev_timer_start(loop, &items[i].ev);
+        items[i].deadline = base + timeout_of(i);
+    }
+    double add = now(CLOCK_MONOTONIC) - start;
+
+    start = now(CLOCK_MONOTONIC);
+    for (int i = 0; i < count; i += 2) {
+        ev_timer_stop(loop, &items[i].ev);
+    }
+    double del = now(CLOCK_MONOTONIC) - start;
+
+    /* the way nw_state_mod used to reschedule */
+    start = now(CLOCK_MONOTONIC);
+    for (int i = 1; i < count; i += 4) {
+        ev_timer_stop(loop, &items[i].ev);
+        ev_timer_set(&items[i].ev, timeout_of(i + 1), 0);
+        ev_timer_start(loop, &items[i].ev);
+        items[i].deadline = base + timeout_of(i + 1);
+    }
+    double mod = now(CLOCK_MONOTONIC) - start;
+
+    expected = count / 2;
+    fired = early = 0;
+    late_max = 0;
+    start = now(CLOCK_PROCESS_CPUTIME_ID);
+    nw_loop_run();
+    double run = now(CLOCK_PROCESS_CPUTIME_ID) - start;
+
+    report("ev_timer", add, del, mod, run);
+    free(items);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    count = argc > 1 ? atoi(argv[1]) : 1000000;
+    count -= count % 4;
+    nw_loop_init();
+
+    int error = bench_wheel();
+    bench_heap();
+
+    return error;
+}
+
@@ -0,0 +1,185 @@
+/*
+ * Description: nw_buf size class memory test
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <inttypes.h>
+# include <string.h>
+# include <stdbool.h>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/resource.h>
+
+# include "nw_svr.h"
+# include "nw_timer.h"
+
+# define MAX_PKG_SIZE   102400
+# define BIG_PKG_SIZE   90000
+
+static nw_svr *svr;
+static int recv_count;
+static size_t recv_max;
+
+static int decode_pkg(nw_ses *ses, void *data, size_t max)
+{
+    char *end = memchr(data, '\n', max);
+    if (end == NULL)
+        return 0;
+    return end - (char *)data + 1;
+}
+
+static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
+{
+    recv_count++;
+    if (size > recv_max)
+        recv_max = size;
+}
+
+static void on_error_msg(nw_ses *ses, const char *msg)
+{
+    printf("ses %"PRIu64" error: %s\n", ses->id, msg);
+}
+
+# define WAIT_INTERVAL  0.01
+# define WAIT_DEADLINE  10.0
+
+static int wait_count;
+static int64_t wait_mem;
+static int wait_ticks;
+
+/* a negative expectation matches anything */
+static bool wait_done(void)
+{
+    if (wait_count >= 0 && recv_count != wait_count)
+        return false;
+    if (wait_mem >= 0 && svr->buf_pool->mem_used != (uint64_t)wait_mem)
+        return false;
+    return true;
+}
+
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    wait_ticks++;
+    if (wait_done() || wait_ticks * WAIT_INTERVAL >= WAIT_DEADLINE)
+        nw_loop_break();
+}
+
+/* let the server drain what the clients wrote, until recv_count and
+ * mem_used reach the expected values or the deadline passes */
+static void run(int count, int64_t mem)
+{
+    wait_count = count;
+    wait_mem = mem;
+    wait_ticks = 0;
+    nw_timer timer;
+    nw_timer_set(&timer, WAIT_INTERVAL, true, on_timer, NULL);
+    nw_timer_start(&timer);
+    nw_loop_run();
+    nw_timer_stop(&timer);
+}
+
+static void report(const char *phase, int count)
+{
+    nw_buf_pool *pool = svr->buf_pool;
+    printf("%-8s connections: %d, buf mem used: %"PRIu64", total: %"PRIu64", peak: %"PRIu64", max size bufs: %"PRIu64"\n",
+            phase, count, pool->mem_used, pool->mem_total, pool->mem_peak, (uint64_t)count * MAX_PKG_SIZE);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 10000;
+    struct rlimit rlim;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && (rlim_t)count * 2 + 64 > rlim.rlim_cur) {
+        count = (rlim.rlim_cur - 64) / 2;
+    }
+
+    const char *path = "/tmp/test_buf.sock";
+    unlink(path);
+    char bind[100];
+    snprintf(bind, sizeof(bind), "stream@%s", path);
+
+    nw_svr_bind bind_arr;
+    nw_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (nw_sock_cfg_parse(bind, &bind_arr.addr, &bind_arr.sock_type) < 0)
+        return 1;
+    cfg.bind_count = 1;
+    cfg.bind_arr = &bind_arr;
+    cfg.max_pkg_size = MAX_PKG_SIZE;
+
+    nw_svr_type type;
+    memset(&type, 0, sizeof(type));
+    type.decode_pkg = decode_pkg;
+    type.on_recv_pkg = on_recv_pkg;
+    type.on_error_msg = on_error_msg;
+
+    svr = nw_svr_create(&cfg, &type, NULL);
+    if (svr == NULL || nw_svr_start(svr) < 0)
+        return 1;
+
+    int *fds = malloc(sizeof(int) * count);
+    for (int i = 0; i < count; ++i) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0 || nw_svr_add_clt_fd(svr, sv[1]) < 0) {
+            printf("add connection %d fail\n", i);
+            return 1;
+        }
+        fds[i] = sv[0];
+    }
+
+    int error = 0;
+
+    /* full messages are consumed at once, nothing stays allocated */
+    for (int i = 0; i < count; ++i) {
+        write(fds[i], "ping\n", 5);
+    }
+    run(count, 0);
+    report("ping", count);
+    if (recv_count != count || svr->buf_pool->mem_used != 0)
+        error = 1;
+
+    /* every session holds a partial message, the case max size bufs hurt */
+    for (int i = 0; i < count; ++i) {
+        write(fds[i], "{\"method\": \"server.ping\"", 24);
+    }
+    run(count, (int64_t)count * NW_BUF_MIN_SIZE);
+    report("partial", count);
+    if (svr->buf_pool->mem_used != (uint64_t)count * NW_BUF_MIN_SIZE)
+        error = 1;
+
+    /* a big message promotes the buf up to the size it needs */
+    recv_count = 0;
+    char *big = malloc(BIG_PKG_SIZE);
+    memset(big, 'x', BIG_PKG_SIZE - 1);
+    big[BIG_PKG_SIZE - 1] = '\n';
+    size_t offset = 0;
+    while (offset < BIG_PKG_SIZE) {
+        ssize_t ret = write(fds[0], big + offset, BIG_PKG_SIZE - offset);
+        if (ret > 0)
+            offset += ret;
+        run(-1, -1);
+    }
+    run(1, -1);
+    report("big", count);
+    if (recv_count != 1 || recv_max != BIG_PKG_SIZE + 24)
+        error = 1;
+
+    for (int i = 0; i < count; ++i) {
+        close(fds[i]);
+    }
+    run(-1, 0);
+    report("closed", 0);
+    if (svr->buf_pool->mem_used != 0)
+        error = 1;
+
+    nw_svr_release(svr);
+    unlink(path);
+    free(big);
+    free(fds);
+
+    printf("%s\n", error ? "FAIL" : "ok");
+    return error;
+}
+
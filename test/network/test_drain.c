@@ -0,0 +1,121 @@
+/*
+ * Description: wait_write set while a session's socket blocks, on_drain once it is all written
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <fcntl.h>
+# include <sys/socket.h>
+
+# include "nw_svr.h"
+# include "nw_timer.h"
+
+# define MSG_SIZE   (4 * 1024 * 1024)
+
+static int drain_count;
+
+static int decode_pkg(nw_ses *ses, void *data, size_t max)
+{
+    return max;
+}
+
+static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
+{
+}
+
+static void on_error_msg(nw_ses *ses, const char *msg)
+{
+    printf("error: %s\n", msg);
+}
+
+static void on_drain(nw_ses *ses)
+{
+    drain_count++;
+}
+
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    nw_loop_break();
+}
+
+static void run(void)
+{
+    nw_timer timer;
+    nw_timer_set(&timer, 0.01, false, on_timer, NULL);
+    nw_timer_start(&timer);
+    nw_loop_run();
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = "/tmp/test_drain.sock";
+    unlink(path);
+    char bind[100];
+    snprintf(bind, sizeof(bind), "stream@%s", path);
+
+    nw_svr_bind bind_arr;
+    nw_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (nw_sock_cfg_parse(bind, &bind_arr.addr, &bind_arr.sock_type) < 0)
+        return 1;
+    cfg.bind_count = 1;
+    cfg.bind_arr = &bind_arr;
+    cfg.max_pkg_size = 10240;
+
+    nw_svr_type type;
+    memset(&type, 0, sizeof(type));
+    type.decode_pkg = decode_pkg;
+    type.on_recv_pkg = on_recv_pkg;
+    type.on_error_msg = on_error_msg;
+    type.on_drain = on_drain;
+
+    nw_svr *svr = nw_svr_create(&cfg, &type, NULL);
+    if (svr == NULL || nw_svr_start(svr) < 0)
+        return 1;
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0 || nw_svr_add_clt_fd(svr, sv[1]) < 0)
+        return 1;
+    fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+    nw_ses *ses = svr->clt_list_head;
+    int error = 0;
+
+    /* a small message goes out at once */
+    nw_ses_send(ses, "ping", 4);
+    run();
+    printf("small: wait_write: %d, drain: %d\n", ses->wait_write, drain_count);
+    if (ses->wait_write || drain_count != 0)
+        error = 1;
+
+    /* more than the socket buffer, the rest waits */
+    char *msg = malloc(MSG_SIZE);
+    memset(msg, 'x', MSG_SIZE);
+    nw_ses_send(ses, msg, MSG_SIZE);
+    run();
+    printf("large: wait_write: %d, drain: %d\n", ses->wait_write, drain_count);
+    if (!ses->wait_write || drain_count != 0)
+        error = 1;
+
+    size_t got = 0;
+    while (got < MSG_SIZE + 4) {
+        ssize_t ret = read(sv[0], msg, MSG_SIZE);
+        if (ret > 0)
+            got += ret;
+        run();
+    }
+    printf("drained: wait_write: %d, drain: %d\n", ses->wait_write, drain_count);
+    if (ses->wait_write || drain_count != 1)
+        error = 1;
+
+    close(sv[0]);
+    run();
+    nw_svr_release(svr);
+    unlink(path);
+    free(msg);
+
+    printf("%s\n", error ? "FAIL" : "ok");
+    return error;
+}
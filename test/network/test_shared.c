@@ -0,0 +1,170 @@
+/*
+ * Description: nw_buf_shared queued by reference to many slow sessions, vs copies
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <inttypes.h>
+# include <string.h>
+# include <unistd.h>
+# include <fcntl.h>
+# include <time.h>
+# include <sys/socket.h>
+# include <sys/resource.h>
+
+# include "nw_svr.h"
+# include "nw_timer.h"
+
+# define MSG_SIZE   (256 * 1024)
+
+static nw_svr *svr;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int decode_pkg(nw_ses *ses, void *data, size_t max)
+{
+    return max;
+}
+
+static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
+{
+}
+
+static void on_error_msg(nw_ses *ses, const char *msg)
+{
+    printf("ses %"PRIu64" error: %s\n", ses->id, msg);
+}
+
+static void on_timer(nw_timer *timer, void *privdata)
+{
+    nw_loop_break();
+}
+
+static void run(void)
+{
+    nw_timer timer;
+    nw_timer_set(&timer, 0.01, false, on_timer, NULL);
+    nw_timer_start(&timer);
+    nw_loop_run();
+}
+
+/* read every client until it has the whole message, check the bytes */
+static int drain(int *fds, int count, const char *msg)
+{
+    static char buf[MSG_SIZE];
+    size_t *got = calloc(count, sizeof(size_t));
+    int done = 0, error = 0;
+    while (done < count) {
+        for (int i = 0; i < count; ++i) {
+            if (got[i] == MSG_SIZE)
+                continue;
+            ssize_t ret = read(fds[i], buf, MSG_SIZE - got[i]);
+            if (ret > 0) {
+                if (memcmp(buf, msg + got[i], ret) != 0)
+                    error = 1;
+                got[i] += ret;
+                if (got[i] == MSG_SIZE)
+                    done++;
+            }
+        }
+        run();
+    }
+    free(got);
+    return error;
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000;
+    struct rlimit rlim;
+    if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 && (rlim_t)count * 2 + 64 > rlim.rlim_cur) {
+        count = (rlim.rlim_cur - 64) / 2;
+    }
+
+    const char *path = "/tmp/test_shared.sock";
+    unlink(path);
+    char bind[100];
+    snprintf(bind, sizeof(bind), "stream@%s", path);
+
+    nw_svr_bind bind_arr;
+    nw_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    if (nw_sock_cfg_parse(bind, &bind_arr.addr, &bind_arr.sock_type) < 0)
+        return 1;
+    cfg.bind_count = 1;
+    cfg.bind_arr = &bind_arr;
+    cfg.max_pkg_size = 10240;
+
+    nw_svr_type type;
+    memset(&type, 0, sizeof(type));
+    type.decode_pkg = decode_pkg;
+    type.on_recv_pkg = on_recv_pkg;
+    type.on_error_msg = on_error_msg;
+
+    svr = nw_svr_create(&cfg, &type, NULL);
+    if (svr == NULL || nw_svr_start(svr) < 0)
+        return 1;
+
+    int *fds = malloc(sizeof(int) * count);
+    for (int i = 0; i < count; ++i) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0 || nw_svr_add_clt_fd(svr, sv[1]) < 0) {
+            printf("add connection %d fail\n", i);
+            return 1;
+        }
+        fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+        fds[i] = sv[0];
+    }
+
+    char *msg = malloc(MSG_SIZE);
+    for (int i = 0; i < MSG_SIZE; ++i) {
+        msg[i] = i * 7;
+    }
+    int error = 0;
+
+    /* a copy per session, the rest of the message stays in its write buf */
+    double start = now();
+    for (nw_ses *curr = svr->clt_list_head; curr; curr = curr->next) {
+        nw_ses_send(curr, msg, MSG_SIZE);
+    }
+    double cost = now() - start;
+    printf("copy:   %d sessions, %8.1f us, buf mem used: %"PRIu64"\n", count, cost * 1e6, svr->buf_pool->mem_used);
+    error |= drain(fds, count, msg);
+
+    /* the same shared, every session queues the rest by reference */
+    nw_buf_shared *shared = nw_buf_shared_create(MSG_SIZE);
+    memcpy(shared->data, msg, MSG_SIZE);
+    start = now();
+    for (nw_ses *curr = svr->clt_list_head; curr; curr = curr->next) {
+        nw_ses_send_shared(curr, shared);
+    }
+    cost = now() - start;
+    printf("shared: %d sessions, %8.1f us, refs: %u, buf mem used: %"PRIu64"\n",
+            count, cost * 1e6, shared->ref, svr->buf_pool->mem_used);
+    if (shared->ref != (uint32_t)count + 1 || svr->buf_pool->mem_used != 0)
+        error = 1;
+    error |= drain(fds, count, msg);
+    printf("drained: refs: %u\n", shared->ref);
+    if (shared->ref != 1)
+        error = 1;
+    nw_buf_shared_release(shared);
+
+    for (int i = 0; i < count; ++i) {
+        close(fds[i]);
+    }
+    run();
+    nw_svr_release(svr);
+    unlink(path);
+    free(msg);
+    free(fds);
+
+    printf("%s\n", error ? "FAIL" : "ok");
+    return error;
+}
+
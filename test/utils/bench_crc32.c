@@ -0,0 +1,86 @@
+/*
+ * Description: crc32 throughput per implementation
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "ut_crc32.h"
+
+static const char *names[] = { "bytewise", "slice8", "pclmul" };
+static volatile uint32_t sink;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* every implementation must agree on every length and alignment */
+static int check(char *data, size_t max)
+{
+    int error = 0;
+    for (int i = 0; i < 20000; ++i) {
+        size_t offset = rand() % 16;
+        size_t size = rand() % (max - offset);
+        uint32_t expect = generate_crc32c_impl(CRC32_IMPL_BYTEWISE, data + offset, size);
+        for (int impl = CRC32_IMPL_SLICE8; impl <= CRC32_IMPL_PCLMUL; ++impl) {
+            uint32_t crc = generate_crc32c_impl(impl, data + offset, size);
+            if (crc != expect) {
+                printf("%s mismatch, offset: %zu, size: %zu, crc: %08x, expect: %08x\n",
+                        names[impl], offset, size, crc, expect);
+                error = 1;
+            }
+        }
+    }
+    /* the standard check value of CRC-32 */
+    if (generate_crc32c("123456789", 9) != 0xcbf43926) {
+        printf("check value mismatch: %08x\n", generate_crc32c("123456789", 9));
+        error = 1;
+    }
+    return error;
+}
+
+static void bench(char *data, size_t size)
+{
+    printf("size: %8zu", size);
+    for (int impl = CRC32_IMPL_BYTEWISE; impl <= CRC32_IMPL_PCLMUL; ++impl) {
+        size_t total = 0;
+        uint32_t crc = 0;
+        double start = now();
+        while (total < 256 * 1024 * 1024) {
+            crc ^= generate_crc32c_impl(impl, data, size);
+            total += size;
+        }
+        double cost = now() - start;
+        sink = crc;
+        printf(", %s: %8.1f MB/s", names[impl], total / cost / 1024 / 1024);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max = 1024 * 1024;
+    char *data = malloc(max);
+    srand(time(NULL));
+    for (size_t i = 0; i < max; ++i) {
+        data[i] = rand();
+    }
+
+    printf("default: %s\n", names[crc32c_impl()]);
+    int error = check(data, 4096);
+
+    size_t sizes[] = { 64, 256, 1024, 16 * 1024, 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        bench(data, sizes[i]);
+    }
+
+    free(data);
+    return error;
+}
+
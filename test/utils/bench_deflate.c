@@ -0,0 +1,231 @@
+/*
+ * Description: gzip and permessage-deflate round trip, cpu cost and ratio per level
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+# include <zlib.h>
+
+# include "ut_deflate.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* replies shaped like order.depth, market.kline and market.deals */
+static sds make_depth(int count)
+{
+    sds s = sdsnew("{\"error\": null, \"result\": {\"asks\": [");
+    for (int i = 0; i < count; ++i) {
+        s = sdscatprintf(s, "%s[\"%d.%02d\", \"%d.%04d\"]", i ? ", " : "", 8000 + i, rand() % 100, rand() % 20, rand() % 10000);
+    }
+    s = sdscat(s, "], \"bids\": [");
+    for (int i = 0; i < count; ++i) {
+        s = sdscatprintf(s, "%s[\"%d.%02d\", \"%d.%04d\"]", i ? ", " : "", 7999 - i, rand() % 100, rand() % 20, rand() % 10000);
+    }
+    return sdscat(s, "]}");
+}
+
+static sds make_kline(int count)
+{
+    sds s = sdsnew("{\"error\": null, \"result\": [");
+    for (int i = 0; i < count; ++i) {
+        s = sdscatprintf(s, "%s[%d, \"%d.%02d\", \"%d.%02d\", \"%d.%02d\", \"%d.%02d\", \"%d.%04d\", \"%d.%04d\", \"BTCUSDT\"]",
+                i ? ", " : "", 1500000000 + i * 60, 8000 + rand() % 50, rand() % 100, 8000 + rand() % 50, rand() % 100,
+                8050 + rand() % 50, rand() % 100, 7950 + rand() % 50, rand() % 100, rand() % 100, rand() % 10000,
+                rand() % 800000, rand() % 10000);
+    }
+    return sdscat(s, "]");
+}
+
+static sds make_deals(int count)
+{
+    sds s = sdsnew("{\"error\": null, \"result\": [");
+    for (int i = 0; i < count; ++i) {
+        s = sdscatprintf(s, "%s{\"id\": %d, \"time\": %d.%06d, \"price\": \"%d.%02d\", \"amount\": \"%d.%04d\", \"type\": \"%s\"}",
+                i ? ", " : "", 100000 + i, 1500000000 + i, rand() % 1000000, 8000 + rand() % 50, rand() % 100,
+                rand() % 5, rand() % 10000, rand() % 2 ? "buy" : "sell");
+    }
+    return sdscat(s, "]");
+}
+
+static sds inflate_all(const void *data, size_t size, int window_bits)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, window_bits) != Z_OK)
+        return NULL;
+    sds out = sdsempty();
+    strm.next_in = (Bytef *)data;
+    strm.avail_in = size;
+    int ret;
+    do {
+        out = sdsMakeRoomFor(out, 65536);
+        size_t avail = sdsavail(out);
+        strm.next_out = (Bytef *)out + sdslen(out);
+        strm.avail_out = avail;
+        ret = inflate(&strm, Z_FINISH);
+        sdsIncrLen(out, avail - strm.avail_out);
+    } while (ret == Z_BUF_ERROR && strm.avail_out == 0);
+    inflateEnd(&strm);
+    if (ret != Z_STREAM_END) {
+        sdsfree(out);
+        return NULL;
+    }
+    return out;
+}
+
+/* a client keeping one inflater across messages, as rfc 7692 allows */
+static sds inflate_message(z_stream *strm, const void *data, size_t size)
+{
+    static const unsigned char tail[] = { 0x00, 0x00, 0xff, 0xff };
+    sds out = sdsempty();
+    for (int i = 0; i < 2; ++i) {
+        strm->next_in = (Bytef *)(i == 0 ? data : (const void *)tail);
+        strm->avail_in = i == 0 ? size : sizeof(tail);
+        do {
+            out = sdsMakeRoomFor(out, 65536);
+            size_t avail = sdsavail(out);
+            strm->next_out = (Bytef *)out + sdslen(out);
+            strm->avail_out = avail;
+            int ret = inflate(strm, Z_SYNC_FLUSH);
+            sdsIncrLen(out, avail - strm->avail_out);
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                sdsfree(out);
+                return NULL;
+            }
+        } while (strm->avail_in != 0 || strm->avail_out == 0);
+    }
+    return out;
+}
+
+static int expect(const char *name, sds got, sds want)
+{
+    int error = got == NULL || sdscmp(got, want) != 0;
+    if (error)
+        printf("%s round trip mismatch\n", name);
+    if (got)
+        sdsfree(got);
+    return error;
+}
+
+static int check(sds text)
+{
+    const char *tail = ", \"id\": 12345}";
+    sds full = sdscat(sdsdup(text), tail);
+    int error = 0;
+
+    sds gz = gzip_encode(full, sdslen(full), 6);
+    error |= expect("gzip", inflate_all(gz, sdslen(gz), MAX_WBITS + 16), full);
+    sdsfree(gz);
+
+    sds ws = ws_deflate_encode(full, sdslen(full), 6);
+    error |= expect("ws", ws_deflate_decode(ws, sdslen(ws), sdslen(full)), full);
+    sdsfree(ws);
+
+    deflate_head *head = deflate_head_create(text, sdslen(text), 6);
+    sds head_gz = deflate_head_gzip(head, tail, strlen(tail));
+    error |= expect("head gzip", inflate_all(head_gz, sdslen(head_gz), MAX_WBITS + 16), full);
+    sdsfree(head_gz);
+    sds head_ws = deflate_head_ws(head, tail, strlen(tail));
+    error |= expect("head ws", ws_deflate_decode(head_ws, sdslen(head_ws), sdslen(full)), full);
+    sds head_empty = deflate_head_ws(head, "", 0);
+    error |= expect("head ws empty tail", ws_deflate_decode(head_empty, sdslen(head_empty), sdslen(full)), text);
+
+    /* every message leaves the stream at a block boundary */
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    inflateInit2(&strm, -MAX_WBITS);
+    error |= expect("stream head ws", inflate_message(&strm, head_ws, sdslen(head_ws)), full);
+    error |= expect("stream head ws again", inflate_message(&strm, head_ws, sdslen(head_ws)), full);
+    error |= expect("stream head ws empty tail", inflate_message(&strm, head_empty, sdslen(head_empty)), text);
+    sds ws_again = ws_deflate_encode(full, sdslen(full), 6);
+    error |= expect("stream ws", inflate_message(&strm, ws_again, sdslen(ws_again)), full);
+    error |= expect("stream head ws last", inflate_message(&strm, head_ws, sdslen(head_ws)), full);
+    sdsfree(ws_again);
+    inflateEnd(&strm);
+    sdsfree(head_ws);
+    sdsfree(head_empty);
+    deflate_head_release(head);
+
+    /* the decoder refuses to grow past max */
+    ws = ws_deflate_encode(full, sdslen(full), 6);
+    sds over = ws_deflate_decode(ws, sdslen(ws), sdslen(full) / 2);
+    if (over) {
+        printf("ws decode exceeds max\n");
+        sdsfree(over);
+        error = 1;
+    }
+    sdsfree(ws);
+
+    sdsfree(full);
+    return error;
+}
+
+static void bench(const char *name, sds text)
+{
+    const char *tail = ", \"id\": 12345}";
+    printf("%-6s %7zu bytes\n", name, sdslen(text));
+    int levels[] = { 1, 3, 6, 9 };
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i) {
+        int count = 0;
+        size_t packed_size = 0;
+        double start = now();
+        while (now() - start < 0.2) {
+            sds gz = gzip_encode(text, sdslen(text), levels[i]);
+            packed_size = sdslen(gz);
+            sdsfree(gz);
+            count++;
+        }
+        double cost = (now() - start) / count;
+
+        /* the per reply cost once the head is compressed */
+        deflate_head *head = deflate_head_create(text, sdslen(text), levels[i]);
+        sdsfree(deflate_head_gzip(head, tail, strlen(tail)));
+        int reply_count = 0;
+        start = now();
+        while (now() - start < 0.2) {
+            sdsfree(deflate_head_gzip(head, tail, strlen(tail)));
+            reply_count++;
+        }
+        double reply_cost = (now() - start) / reply_count;
+        deflate_head_release(head);
+
+        printf("  level %d: %7zu bytes, ratio %5.1f%%, encode %8.1f us, %7.1f MB/s, shared head reply %6.2f us\n",
+                levels[i], packed_size, packed_size * 100.0 / sdslen(text), cost * 1e6,
+                sdslen(text) / cost / 1024 / 1024, reply_cost * 1e6);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    srand(time(NULL));
+    sds depth = make_depth(100);
+    sds kline = make_kline(1000);
+    sds deals = make_deals(100);
+
+    int error = 0;
+    error |= check(depth);
+    error |= check(kline);
+    error |= check(deals);
+    sds empty = sdsempty();
+    error |= check(empty);
+    sdsfree(empty);
+    printf("round trip: %s\n", error ? "fail" : "ok");
+
+    bench("depth", depth);
+    bench("kline", kline);
+    bench("deals", deals);
+
+    sdsfree(depth);
+    sdsfree(kline);
+    sdsfree(deals);
+    return error;
+}
+
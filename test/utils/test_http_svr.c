@@ -0,0 +1,205 @@
+/*
+ * Description: http_svr request slices, fragmented, pipelined and chunked requests
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <pthread.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# include <zlib.h>
+
+# include "ut_http_svr.h"
+
+static int port;
+static int error;
+
+/* echo "<url> <x-test header> <body>" */
+static int on_request(nw_ses *ses, http_svr_request_t *request)
+{
+    const http_slice_t *test = http_svr_request_header(request, "x-test");
+    char reply[1024];
+    int len = snprintf(reply, sizeof(reply), "%.*s %.*s %.*s",
+            (int)request->url.size, request->url.data,
+            test ? (int)test->size : 1, test ? test->data : "-",
+            (int)request->body.size, request->body.data);
+    send_http_response_compressed(ses, 200, reply, len, http_svr_request_accept_gzip(request));
+    return 0;
+}
+
+static int connect_svr(void)
+{
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        return -1;
+    return sockfd;
+}
+
+/* read replies until every expected body is seen, in order */
+static void expect(int sockfd, const char **bodies, int count)
+{
+    static char buf[65536];
+    size_t size = 0;
+    int found = 0;
+    while (found < count) {
+        int ret = read(sockfd, buf + size, sizeof(buf) - size - 1);
+        if (ret <= 0)
+            break;
+        size += ret;
+        buf[size] = 0;
+        found = 0;
+        char *p = buf;
+        while (found < count && (p = strstr(p, "\r\n\r\n")) != NULL) {
+            p += 4;
+            if (strncmp(p, bodies[found], strlen(bodies[found])) != 0)
+                break;
+            p += strlen(bodies[found]);
+            found++;
+        }
+    }
+    if (found != count) {
+        printf("expect %d replies, got %d:\n%s\n", count, found, buf);
+        error = 1;
+    }
+}
+
+/* one reply, gzip or not as wanted, the body inflated */
+static void expect_gzip(int sockfd, const char *body, int gzip)
+{
+    static char buf[65536];
+    size_t size = 0;
+    char *content = NULL;
+    size_t content_size = 0;
+    while (content == NULL || size < (size_t)(content - buf) + content_size) {
+        int ret = read(sockfd, buf + size, sizeof(buf) - size - 1);
+        if (ret <= 0)
+            break;
+        size += ret;
+        buf[size] = 0;
+        char *end = strstr(buf, "\r\n\r\n");
+        char *length = strstr(buf, "Content-Length: ");
+        if (end && length) {
+            content = end + 4;
+            content_size = atoi(length + 16);
+        }
+    }
+    if (content == NULL || (strstr(buf, "Content-Encoding: gzip") != NULL) != gzip) {
+        printf("expect gzip: %d, got:\n%s\n", gzip, buf);
+        error = 1;
+        return;
+    }
+
+    char plain[4096];
+    size_t plain_size = content_size;
+    if (gzip) {
+        z_stream strm;
+        memset(&strm, 0, sizeof(strm));
+        inflateInit2(&strm, MAX_WBITS + 16);
+        strm.next_in = (Bytef *)content;
+        strm.avail_in = content_size;
+        strm.next_out = (Bytef *)plain;
+        strm.avail_out = sizeof(plain);
+        int ret = inflate(&strm, Z_FINISH);
+        plain_size = sizeof(plain) - strm.avail_out;
+        inflateEnd(&strm);
+        if (ret != Z_STREAM_END) {
+            printf("inflate fail: %d\n", ret);
+            error = 1;
+            return;
+        }
+    } else {
+        memcpy(plain, content, content_size);
+    }
+    if (plain_size != strlen(body) || memcmp(plain, body, plain_size) != 0) {
+        printf("expect: %s, got: %.*s\n", body, (int)plain_size, plain);
+        error = 1;
+    }
+}
+
+static void *run_client(void *arg)
+{
+    /* two pipelined requests in one write */
+    int sockfd = connect_svr();
+    const char *pipelined =
+        "POST /a HTTP/1.1\r\nX-Test: 1\r\nContent-Length: 5\r\n\r\nhello"
+        "POST /b HTTP/1.1\r\nContent-Length: 5\r\nx-test: 2\r\n\r\nworld";
+    write(sockfd, pipelined, strlen(pipelined));
+    const char *replies1[] = { "/a 1 hello", "/b 2 world" };
+    expect(sockfd, replies1, 2);
+
+    /* one byte at a time on the same connection */
+    const char *slow = "POST /slow HTTP/1.1\r\nX-Test: slow\r\nContent-Length: 4\r\n\r\nbody";
+    for (size_t i = 0; i < strlen(slow); ++i) {
+        write(sockfd, slow + i, 1);
+        usleep(1000);
+    }
+    const char *replies2[] = { "/slow slow body" };
+    expect(sockfd, replies2, 1);
+
+    /* chunked body, joined in place */
+    const char *chunked = "POST /chunked HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "3\r\nabc\r\n4\r\ndefg\r\n0\r\n\r\n";
+    write(sockfd, chunked, strlen(chunked));
+    const char *replies3[] = { "/chunked - abcdefg" };
+    expect(sockfd, replies3, 1);
+
+    /* gzip when accepted and not below gzip_min_size */
+    const char *gzip =
+        "POST /gzip HTTP/1.1\r\nAccept-Encoding: deflate, gzip;q=0.5\r\nContent-Length: 32\r\n\r\n"
+        "0123456789abcdef0123456789abcdef";
+    write(sockfd, gzip, strlen(gzip));
+    expect_gzip(sockfd, "/gzip - 0123456789abcdef0123456789abcdef", 1);
+    const char *refused =
+        "POST /gzip HTTP/1.1\r\nAccept-Encoding: gzip;q=0, identity\r\nContent-Length: 32\r\n\r\n"
+        "0123456789abcdef0123456789abcdef";
+    write(sockfd, refused, strlen(refused));
+    expect_gzip(sockfd, "/gzip - 0123456789abcdef0123456789abcdef", 0);
+    const char *small = "POST /small HTTP/1.1\r\nAccept-Encoding: gzip\r\nContent-Length: 1\r\n\r\nx";
+    write(sockfd, small, strlen(small));
+    expect_gzip(sockfd, "/small - x", 0);
+    close(sockfd);
+
+    nw_loop_break();
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    port = 20000 + getpid() % 10000;
+    char bind[100];
+    snprintf(bind, sizeof(bind), "tcp@127.0.0.1:%d", port);
+
+    nw_svr_bind bind_arr;
+    if (nw_sock_cfg_parse(bind, &bind_arr.addr, &bind_arr.sock_type) < 0)
+        return 1;
+    http_svr_cfg cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.bind_count = 1;
+    cfg.bind_arr = &bind_arr;
+    cfg.max_pkg_size = 10240;
+    cfg.gzip_level = 1;
+    cfg.gzip_min_size = 32;
+
+    http_svr *svr = http_svr_create(&cfg, on_request);
+    if (svr == NULL || http_svr_start(svr) < 0)
+        return 1;
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, run_client, NULL);
+    nw_loop_run();
+    pthread_join(tid, NULL);
+
+    http_svr_release(svr);
+    printf("%s\n", error ? "fail" : "ok");
+    return error;
+}
+
@@ -0,0 +1,281 @@
+/*
+ * Description: binary market data round trip, size and encode cost against json
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "ut_market_bin.h"
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static json_t *decimal_str(const char *fmt, int a, int b)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), fmt, a, b);
+    return json_string(buf);
+}
+
+/* params shaped like depth.update, deals.update, kline.update and price.update */
+static json_t *make_depth_side(int count, int start, int step)
+{
+    json_t *side = json_array();
+    for (int i = 0; i < count; ++i) {
+        json_t *level = json_array();
+        json_array_append_new(level, decimal_str("%d.%02d", start + i * step, rand() % 100));
+        json_array_append_new(level, decimal_str("%d.%04d", rand() % 20, rand() % 10000));
+        json_array_append_new(side, level);
+    }
+    return side;
+}
+
+static json_t *make_depth(int count)
+{
+    json_t *depth = json_object();
+    json_object_set_new(depth, "asks", make_depth_side(count, 8000, 1));
+    json_object_set_new(depth, "bids", make_depth_side(count, 7999, -1));
+    json_t *params = json_array();
+    json_array_append_new(params, json_true());
+    json_array_append_new(params, depth);
+    json_array_append_new(params, json_string("BTCUSDT"));
+    return params;
+}
+
+static json_t *make_diff(const char *price1, const char *amount1, const char *price2, const char *amount2)
+{
+    json_t *bids = json_array();
+    json_t *level = json_array();
+    json_array_append_new(level, json_string(price1));
+    json_array_append_new(level, json_string(amount1));
+    json_array_append_new(bids, level);
+    level = json_array();
+    json_array_append_new(level, json_string(price2));
+    json_array_append_new(level, json_string(amount2));
+    json_array_append_new(bids, level);
+
+    json_t *diff = json_object();
+    json_object_set_new(diff, "bids", bids);
+    json_t *params = json_array();
+    json_array_append_new(params, json_false());
+    json_array_append_new(params, diff);
+    json_array_append_new(params, json_string("BTCUSDT"));
+    return params;
+}
+
+static json_t *make_deals(int count)
+{
+    json_t *deals = json_array();
+    for (int i = 0; i < count; ++i) {
+        json_t *deal = json_object();
+        json_object_set_new(deal, "id", json_integer(100000 - i));
+        /* microseconds, as the decoder gives them back */
+        json_object_set_new(deal, "time", json_real((1500000000000000LL - i * 1000000LL + rand() % 1000000) / 1e6));
+        json_object_set_new(deal, "price", decimal_str("%d.%02d", 8000 + rand() % 50, rand() % 100));
+        json_object_set_new(deal, "amount", decimal_str("%d.%04d", rand() % 5, rand() % 10000));
+        json_object_set_new(deal, "type", json_string(rand() % 2 ? "buy" : "sell"));
+        json_array_append_new(deals, deal);
+    }
+    json_t *params = json_array();
+    json_array_append_new(params, json_string("BTCUSDT"));
+    json_array_append_new(params, deals);
+    return params;
+}
+
+static json_t *make_kline(int count)
+{
+    json_t *params = json_array();
+    for (int i = 0; i < count; ++i) {
+        json_t *unit = json_array();
+        json_array_append_new(unit, json_integer(1500000000 + i * 60));
+        json_array_append_new(unit, decimal_str("%d.%02d", 8000 + rand() % 50, rand() % 100));
+        json_array_append_new(unit, decimal_str("%d.%02d", 8000 + rand() % 50, rand() % 100));
+        json_array_append_new(unit, decimal_str("%d.%02d", 8050 + rand() % 50, rand() % 100));
+        json_array_append_new(unit, decimal_str("%d.%02d", 7950 + rand() % 50, rand() % 100));
+        json_array_append_new(unit, decimal_str("%d.%04d", rand() % 100, rand() % 10000));
+        json_array_append_new(unit, decimal_str("%d.%04d", rand() % 800000, rand() % 10000));
+        json_array_append_new(unit, json_string("BTCUSDT"));
+        json_array_append_new(params, unit);
+    }
+    return params;
+}
+
+static json_t *make_price(const char *price)
+{
+    json_t *params = json_array();
+    json_array_append_new(params, json_string("BTCUSDT"));
+    json_array_append_new(params, json_string(price));
+    return params;
+}
+
+static json_t *make_notify(const char *method, json_t *params)
+{
+    json_t *notify = json_object();
+    json_object_set_new(notify, "method", json_string(method));
+    json_object_set    (notify, "params", params);
+    json_object_set_new(notify, "id", json_null());
+    return notify;
+}
+
+/* decodes to want, or to params itself if want is NULL */
+static int roundtrip(const char *method, json_t *params, json_t *want)
+{
+    size_t size;
+    char *data = market_bin_encode(method, params, &size);
+    if (data == NULL)
+        return -__LINE__;
+    json_t *back = market_bin_decode(data, size);
+    if (back == NULL) {
+        free(data);
+        return -__LINE__;
+    }
+    json_t *notify = make_notify(method, want ? want : params);
+    int ret = json_equal(notify, back) ? 0 : -__LINE__;
+    if (ret < 0) {
+        char *str = json_dumps(back, 0);
+        printf("%s decoded as: %.200s\n", method, str);
+        free(str);
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        json_t *cut = market_bin_decode(data, i);
+        if (cut) {
+            printf("%s truncated at %zu decoded\n", method, i);
+            json_decref(cut);
+            ret = -__LINE__;
+        }
+    }
+
+    json_decref(notify);
+    json_decref(back);
+    free(data);
+    return ret;
+}
+
+static int expect_none(const char *method, json_t *params)
+{
+    size_t size;
+    char *data = market_bin_encode(method, params, &size);
+    json_decref(params);
+    if (data) {
+        printf("%s encoded, expect json fallback\n", method);
+        free(data);
+        return -__LINE__;
+    }
+    return 0;
+}
+
+static int check(void)
+{
+    int error = 0;
+    struct {
+        const char *method;
+        json_t *params;
+        json_t *want;
+    } cases[] = {
+        { "depth.update", make_depth(50), NULL },
+        { "depth.update", make_depth(0), NULL },
+        { "deals.update", make_deals(100), NULL },
+        { "kline.update", make_kline(100), NULL },
+        { "price.update", make_price("8000.12"), NULL },
+        { "price.update", make_price("-0.5"), NULL },
+        /* a field comes back at the largest scale of the message */
+        { "price.update", make_price("1E-8"), make_price("0.00000001") },
+        { "price.update", make_price("1.5E+3"), make_price("1500") },
+    };
+
+    /* a diff with one side, amount 0 removes a level */
+    json_t *diff = make_diff("7999.5", "0", "7998.25", "1.5");
+    json_t *diff_want = make_diff("7999.50", "0.0", "7998.25", "1.5");
+    error |= roundtrip("depth.update", diff, diff_want) < 0;
+    json_decref(diff);
+    json_decref(diff_want);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        int ret = roundtrip(cases[i].method, cases[i].params, cases[i].want);
+        if (ret < 0) {
+            printf("case %zu fail: %d\n", i, ret);
+            error = 1;
+        }
+        json_decref(cases[i].params);
+        if (cases[i].want)
+            json_decref(cases[i].want);
+    }
+
+    error |= expect_none("state.update", make_price("8000"));
+    error |= expect_none("price.update", make_price("8000.1234567890123456789"));
+    error |= expect_none("price.update", make_price("abc"));
+    error |= expect_none("kline.update", json_array());
+
+    return error;
+}
+
+static void bench(const char *name, const char *method, json_t *params)
+{
+    json_t *notify = make_notify(method, params);
+    char *text = json_dumps(notify, 0);
+    size_t text_size = strlen(text);
+    free(text);
+    size_t size;
+    char *data = market_bin_encode(method, params, &size);
+    free(data);
+
+    int count = 0;
+    double start = now();
+    while (now() - start < 0.2) {
+        free(json_dumps(notify, 0));
+        count++;
+    }
+    double json_cost = (now() - start) / count;
+
+    count = 0;
+    start = now();
+    while (now() - start < 0.2) {
+        free(market_bin_encode(method, params, &size));
+        count++;
+    }
+    double bin_cost = (now() - start) / count;
+
+    data = market_bin_encode(method, params, &size);
+    count = 0;
+    start = now();
+    while (now() - start < 0.2) {
+        json_decref(market_bin_decode(data, size));
+        count++;
+    }
+    double decode_cost = (now() - start) / count;
+    free(data);
+
+    printf("%-6s json %6zu bytes %8.1f us, binary %6zu bytes (%4.1f%%) %8.1f us, binary decode %8.1f us\n",
+            name, text_size, json_cost * 1e6, size, size * 100.0 / text_size, bin_cost * 1e6, decode_cost * 1e6);
+    json_decref(notify);
+}
+
+int main(int argc, char *argv[])
+{
+    srand(time(NULL));
+    int error = check();
+    printf("round trip: %s\n", error ? "fail" : "ok");
+
+    json_t *depth = make_depth(50);
+    json_t *deals = make_deals(100);
+    json_t *kline = make_kline(1000);
+    json_t *price = make_price("8000.12");
+    bench("depth", "depth.update", depth);
+    bench("deals", "deals.update", deals);
+    bench("kline", "kline.update", kline);
+    bench("price", "price.update", price);
+    json_decref(depth);
+    json_decref(deals);
+    json_decref(kline);
+    json_decref(price);
+
+    return error;
+}
@@ -0,0 +1,136 @@
+/*
+ * Description:
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "ut_params.h"
+
+static const char *valid[] = {
+    "[]",
+    " [ 1 , -2 ] ",
+    "[1, \"BTCBCH\", 1, \"0.1\", \"9000\", \"0.001\", \"0.001\", \"\"]",
+    "[true, false, null, 1.5e3, -0.25, {\"a\": [1, {}]}, []]",
+    "[\"\\u00e9\\ud83d\\ude00\\n\\\"\"]",
+    "[9223372036854775807, -9223372036854775808]",
+};
+
+static const char *invalid[] = {
+    "", "[", "[1,]", "[01]", "[1.]", "[\"a]", "{}", "[1] x", "[tru]",
+    "[\"\\u0000\"]", "[\"\\ud800\"]", "[\"\\x\"]", "[\"\xc0\x80\"]",
+    "[9223372036854775808]", "[{\"a\" 1}]", "[{1: 2}]",
+};
+
+static int check(void)
+{
+    int error = 0;
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i) {
+        params_t params;
+        if (params_parse(&params, valid[i], strlen(valid[i])) < 0) {
+            printf("valid case fail: %s\n", valid[i]);
+            error = 1;
+            continue;
+        }
+        json_t *json = json_loads(valid[i], 0, NULL);
+        json_t *back = params_to_json(&params);
+        if (json == NULL || back == NULL || !json_equal(json, back) || params_size(&params) != json_array_size(json)) {
+            printf("valid case mismatch: %s\n", valid[i]);
+            error = 1;
+        }
+        json_decref(json);
+        json_decref(back);
+    }
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+        params_t params;
+        if (params_parse(&params, invalid[i], strlen(invalid[i])) == 0) {
+            printf("invalid case pass: %s\n", invalid[i]);
+            error = 1;
+        }
+    }
+
+    params_t params;
+    const char *text = valid[2];
+    params_parse(&params, text, strlen(text));
+    int64_t user_id;
+    char market[32];
+    mpd_t *amount = params_get_decimal(&params, 3, 8);
+    mpd_t *expect = decimal("0.1", 0);
+    if (params_get_int(&params, 0, &user_id) < 0 || user_id != 1 ||
+            params_get_str(&params, 1, market, sizeof(market)) != 6 || strcmp(market, "BTCBCH") != 0 ||
+            params_get_int(&params, 1, &user_id) == 0 || params_get_str(&params, 1, market, 6) >= 0 ||
+            amount == NULL || mpd_cmp(amount, expect, &mpd_ctx) != 0) {
+        printf("accessor fail\n");
+        error = 1;
+    }
+    if (amount)
+        mpd_del(amount);
+    mpd_del(expect);
+
+    text = valid[4];
+    params_parse(&params, text, strlen(text));
+    char str[32];
+    if (params_get_str(&params, 0, str, sizeof(str)) != 8 || strcmp(str, "\xc3\xa9\xf0\x9f\x98\x80\n\"") != 0) {
+        printf("unescape fail\n");
+        error = 1;
+    }
+
+    return error;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* parse order.put_limit params and read every field, the way a handler does */
+static void bench(int count)
+{
+    const char *text = "[1, \"BTCBCH\", 1, \"0.1\", \"9000\", \"0.001\", \"0.001\", \"\"]";
+    size_t size = strlen(text);
+
+    double start = now();
+    for (int i = 0; i < count; ++i) {
+        json_t *params = json_loadb(text, size, 0, NULL);
+        volatile int64_t user_id = json_integer_value(json_array_get(params, 0));
+        volatile const char *market = json_string_value(json_array_get(params, 1));
+        for (int j = 3; j < 7; ++j) {
+            mpd_t *val = decimal(json_string_value(json_array_get(params, j)), 8);
+            mpd_del(val);
+        }
+        (void)user_id;
+        (void)market;
+        json_decref(params);
+    }
+    double json_cost = now() - start;
+
+    start = now();
+    for (int i = 0; i < count; ++i) {
+        params_t params;
+        params_parse(&params, text, size);
+        int64_t user_id;
+        char market[32];
+        params_get_int(&params, 0, &user_id);
+        params_get_str(&params, 1, market, sizeof(market));
+        for (int j = 3; j < 7; ++j) {
+            mpd_t *val = params_get_decimal(&params, j, 8);
+            mpd_del(val);
+        }
+    }
+    double params_cost = now() - start;
+
+    printf("order.put_limit params x %d: jansson %.3fs, params %.3fs\n", count, json_cost, params_cost);
+}
+
+int main(int argc, char *argv[])
+{
+    init_mpd();
+    int error = check();
+    bench(argc > 1 ? atoi(argv[1]) : 1000000);
+    return error;
+}
@@ -0,0 +1,256 @@
+/*
+ * Description:
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>
+
+# include "ut_rpc_bin.h"
+# include "ut_rpc_cmd.h"
+# include "ut_params.h"
+
+static const char *cases[] = {
+    "[]",
+    "[1, -1, 0, 9223372036854775807, -9223372036854775808]",
+    "[true, false, null, 1.5, -0.25]",
+    "[\"BTCCNY\", \"\", \"limit\"]",
+    "[\"0\", \"-0\", \"0.0\", \"1.00\", \"-12.3400\", \"007\", \"1e5\", \"123456789012345678\", \"1234567890123456789\"]",
+    "{\"error\": null, \"result\": {\"asks\": [[\"8000.00\", \"1.2\"]], \"bids\": []}, \"id\": 12}",
+};
+
+static int roundtrip(const char *text)
+{
+    json_t *json = json_loads(text, 0, NULL);
+    if (json == NULL)
+        return -__LINE__;
+    size_t size;
+    char *data = rpc_bin_encode(json, &size);
+    if (data == NULL)
+        return -__LINE__;
+    json_t *back = rpc_bin_decode(data, size);
+    if (back == NULL)
+        return -__LINE__;
+    int ret = json_equal(json, back) ? 0 : -__LINE__;
+
+    char *json_str = json_dumps(json, 0);
+    printf("%-4s json: %4zu bytes, binary: %4zu bytes, %s\n", ret == 0 ? "ok" : "FAIL", strlen(json_str), size, json_str);
+    free(json_str);
+
+    for (size_t i = 0; i < size; ++i) {
+        json_t *cut = rpc_bin_decode(data, i);
+        if (cut) {
+            printf("truncated body at %zu decoded\n", i);
+            json_decref(cut);
+            ret = -__LINE__;
+        }
+    }
+
+    free(data);
+    json_decref(back);
+    json_decref(json);
+    return ret;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *text, int count)
+{
+    json_t *json = json_loads(text, 0, NULL);
+
+    double start = now();
+    for (int i = 0; i < count; ++i) {
+        char *str = json_dumps(json, 0);
+        json_t *back = json_loads(str, 0, NULL);
+        json_decref(back);
+        free(str);
+    }
+    double json_cost = now() - start;
+
+    start = now();
+    for (int i = 0; i < count; ++i) {
+        size_t size;
+        char *data = rpc_bin_encode(json, &size);
+        json_t *back = rpc_bin_decode(data, size);
+        json_decref(back);
+        free(data);
+    }
+    double bin_cost = now() - start;
+
+    printf("roundtrip x %d: json %.3fs, binary %.3fs\n", count, json_cost, bin_cost);
+    json_decref(json);
+}
+
+static const struct {
+    uint32_t command;
+    const char *params;
+    int encoding;
+} params_cases[] = {
+    { CMD_ORDER_PUT_LIMIT, "[1, \"BTCUSDT\", 1, \"1.5\", \"8000.12\", \"0.002\", \"0.001\", \"api\"]", RPC_ENCODING_BINARY },
+    { CMD_ORDER_PUT_LIMIT, "[1, \"BTCUSDT\", 2, \"1.5\", \"8000.12\", \"0.002\", \"0.001\", \"\u6d4b\u8bd5\", 1700000000]", RPC_ENCODING_BINARY },
+    { CMD_ORDER_PUT_LIMIT, "[1, \"BTCUSDT\", 2, \"1.5\", \"8000.12\", \"0.002\", \"0.001\", \"api\", 1700000000.5]", RPC_ENCODING_BINARY },
+    { CMD_ORDER_CANCEL, "[1, \"BTCUSDT\", 9223372036854775807]", RPC_ENCODING_BINARY },
+    { CMD_BALANCE_QUERY, "[1, \"BTC\", \"USDT\", \"ETH\"]", RPC_ENCODING_BINARY },
+    { CMD_BALANCE_UPDATE, "[1, \"BTC\", \"deposit\", 100, \"-1.20\", {\"txid\": \"abc\", \"n\": [1, null]}]", RPC_ENCODING_BINARY },
+    { CMD_MARKET_KLINE, "[\"BTCUSDT\", -60, 0, 60]", RPC_ENCODING_BINARY },
+    { CMD_MARKET_LIST, "[]", RPC_ENCODING_BINARY },
+    { CMD_ORDER_HISTORY, "[1, \"BTCUSDT\", 0, 0, 0, 100, 2]", RPC_ENCODING_BINARY },
+    /* not in the table, sent as json */
+    { CMD_ORDER_PUT_LIMIT, "[1, \"BTCUSDT\", 1, \"1e-3\", \"8000\", \"0\", \"0\", \"api\"]", RPC_ENCODING_JSON },
+    { CMD_ORDER_CANCEL, "[-1, \"BTCUSDT\", 1]", RPC_ENCODING_JSON },
+    { CMD_ORDER_CANCEL, "[1, \"BTCUSDT\", 1, 2]", RPC_ENCODING_JSON },
+    { CMD_ORDER_DETAIL, "[\"BTCUSDT\", \"1\"]", RPC_ENCODING_JSON },
+    { RPC_CMD_HEARTBEAT, "[]", RPC_ENCODING_JSON },
+};
+
+static int params_roundtrip(uint32_t command, const char *text, int encoding)
+{
+    json_t *json = json_loads(text, 0, NULL);
+    if (json == NULL)
+        return -__LINE__;
+    rpc_pkg pkg;
+    memset(&pkg, 0, sizeof(pkg));
+    pkg.command = command;
+    if (rpc_params_encode(&pkg, json, RPC_ENCODING_BINARY) < 0)
+        return -__LINE__;
+    int ret = 0;
+    if (rpc_pkg_encoding(&pkg) != encoding)
+        ret = -__LINE__;
+
+    json_t *back = rpc_params_json(&pkg);
+    if (back == NULL || !json_equal(json, back))
+        ret = -__LINE__;
+
+    /* typed accessors straight off the body */
+    params_t params;
+    if (rpc_params_decode(&params, &pkg) < 0 || params_size(&params) != json_array_size(json)) {
+        ret = -__LINE__;
+    } else {
+        for (size_t i = 0; i < params_size(&params); ++i) {
+            json_t *item = json_array_get(json, i);
+            int64_t num;
+            char str[64];
+            if (json_is_integer(item) && (params_get_int(&params, i, &num) < 0 || num != json_integer_value(item)))
+                ret = -__LINE__;
+            if (json_is_string(item) && (params_get_str(&params, i, str, sizeof(str)) < 0 || strcmp(str, json_string_value(item)) != 0))
+                ret = -__LINE__;
+        }
+    }
+    printf("%-4s %-3s json: %4zu bytes, body: %4u bytes, %s\n", ret == 0 ? "ok" : "FAIL",
+            rpc_pkg_encoding(&pkg) == RPC_ENCODING_BINARY ? "bin" : "json", strlen(text), pkg.body_size, text);
+
+    if (rpc_pkg_encoding(&pkg) == RPC_ENCODING_BINARY) {
+        uint32_t size = pkg.body_size;
+        for (pkg.body_size = 0; pkg.body_size < size; ++pkg.body_size) {
+            if (rpc_params_decode(&params, &pkg) == 0) {
+                printf("truncated params at %u decoded\n", pkg.body_size);
+                ret = -__LINE__;
+            }
+        }
+    }
+
+    free(pkg.body);
+    if (back)
+        json_decref(back);
+    json_decref(json);
+    return ret;
+}
+
+/* what on_cmd_order_put_limit reads from its params */
+static int use_params(const params_t *params)
+{
+    int64_t user_id, side;
+    char market[32], source[32];
+    if (params_get_int(params, 0, &user_id) < 0 || params_get_str(params, 1, market, sizeof(market)) < 0)
+        return -__LINE__;
+    if (params_get_int(params, 2, &side) < 0 || params_get_str(params, 7, source, sizeof(source)) < 0)
+        return -__LINE__;
+    int ret = 0;
+    for (size_t i = 3; i <= 6; ++i) {
+        mpd_t *value = params_get_decimal(params, i, 8);
+        if (value == NULL) {
+            ret = -__LINE__;
+            continue;
+        }
+        mpd_del(value);
+    }
+    return ret;
+}
+
+static void bench_params(const char *text, int count)
+{
+    json_t *json = json_loads(text, 0, NULL);
+    rpc_pkg text_pkg, bin_pkg;
+    memset(&text_pkg, 0, sizeof(text_pkg));
+    memset(&bin_pkg, 0, sizeof(bin_pkg));
+    text_pkg.command = bin_pkg.command = CMD_ORDER_PUT_LIMIT;
+    rpc_body_encode(&text_pkg, json, RPC_ENCODING_JSON, 0);
+    rpc_params_encode(&bin_pkg, json, RPC_ENCODING_BINARY);
+    size_t tagged_size;
+    free(rpc_bin_encode(json, &tagged_size));
+    params_t params;
+    int error = 0;
+
+    double start = now();
+    for (int i = 0; i < count; ++i) {
+        json_t *back = json_loadb(text_pkg.body, text_pkg.body_size, 0, NULL);
+        params_from_json(&params, back);
+        error |= use_params(&params);
+        json_decref(back);
+    }
+    double jansson_cost = now() - start;
+
+    start = now();
+    for (int i = 0; i < count; ++i) {
+        rpc_params_decode(&params, &text_pkg);
+        error |= use_params(&params);
+    }
+    double text_cost = now() - start;
+
+    start = now();
+    for (int i = 0; i < count; ++i) {
+        rpc_params_decode(&params, &bin_pkg);
+        error |= use_params(&params);
+    }
+    double bin_cost = now() - start;
+
+    printf("order.put_limit params: json %u bytes, tagged %zu bytes, table %u bytes%s\n",
+            text_pkg.body_size, tagged_size, bin_pkg.body_size, error ? ", FAIL" : "");
+    printf("decode + read x %d: jansson %.3fs, json in place %.3fs, table %.3fs\n", count, jansson_cost, text_cost, bin_cost);
+    free(text_pkg.body);
+    free(bin_pkg.body);
+    json_decref(json);
+}
+
+int main(int argc, char *argv[])
+{
+    init_mpd();
+    int error = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        int ret = roundtrip(cases[i]);
+        if (ret < 0) {
+            printf("case %zu fail: %d\n", i, ret);
+            error = 1;
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(params_cases) / sizeof(params_cases[0]); ++i) {
+        int ret = params_roundtrip(params_cases[i].command, params_cases[i].params, params_cases[i].encoding);
+        if (ret < 0) {
+            printf("params case %zu fail: %d\n", i, ret);
+            error = 1;
+        }
+    }
+
+    bench(cases[sizeof(cases) / sizeof(cases[0]) - 1], 100000);
+    bench_params(params_cases[0].params, 1000000);
+
+    return error;
+}
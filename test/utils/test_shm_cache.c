@@ -0,0 +1,193 @@
+/*
+ * Description: shm_cache keys added from many processes, readers never see a torn snapshot
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <unistd.h>
+# include <inttypes.h>
+# include <sys/wait.h>
+
+# include "ut_shm_cache.h"
+# include "ut_misc.h"
+
+# define READER_NUM     4
+# define KEY_NUM        48
+# define WRITE_TIME     0.5
+
+/* a counter then the counter's low byte repeated, length varies with it */
+static size_t make_data(char *buf, uint64_t n)
+{
+    size_t size = sizeof(n) + n % 1000;
+    memcpy(buf, &n, sizeof(n));
+    memset(buf + sizeof(n), n & 0xff, size - sizeof(n));
+    return size;
+}
+
+static int check_data(sds data, uint64_t *n)
+{
+    if (sdslen(data) < sizeof(*n))
+        return -__LINE__;
+    memcpy(n, data, sizeof(*n));
+    if (sdslen(data) != sizeof(*n) + *n % 1000)
+        return -__LINE__;
+    for (size_t i = sizeof(*n); i < sdslen(data); ++i) {
+        if ((unsigned char)data[i] != (*n & 0xff))
+            return -__LINE__;
+    }
+    return 0;
+}
+
+static int run_reader(shm_cache *cache)
+{
+    /* every process adds the same keys at once, none may be added twice.
+     * a key another process is adding is a miss, asked again later */
+    char key[32];
+    for (int i = 0; i < KEY_NUM; ++i) {
+        snprintf(key, sizeof(key), "key.%d", i);
+        int retry = 0;
+        while (shm_cache_find(cache, key, true) < 0) {
+            if (++retry == 1000)
+                return 1;
+            usleep(100);
+        }
+    }
+
+    int index;
+    while ((index = shm_cache_find(cache, "data", false)) < 0)
+        usleep(100);
+
+    uint64_t version = 0, last = 0;
+    int changes = 0, torn = 0;
+    while (shm_cache_find(cache, "stop", false) < 0) {
+        sds data = NULL;
+        int ret = shm_cache_read(cache, index, &version, &data);
+        if (ret < 0)
+            torn++;
+        if (ret <= 0)
+            continue;
+        uint64_t n;
+        if (check_data(data, &n) < 0 || n < last) {
+            printf("bad snapshot, last: %"PRIu64", size: %zu\n", last, sdslen(data));
+            sdsfree(data);
+            return 1;
+        }
+        last = n;
+        changes++;
+        sdsfree(data);
+    }
+    printf("reader %d: %d changes seen, %d reads gave up\n", getpid(), changes, torn);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    shm_cache *cache = shm_cache_create(64, 4096);
+    if (cache == NULL)
+        return 1;
+    int error = 0;
+
+    pid_t pids[READER_NUM];
+    for (int i = 0; i < READER_NUM; ++i) {
+        pids[i] = fork();
+        if (pids[i] == 0)
+            exit(run_reader(cache));
+    }
+
+    char key[32];
+    for (int i = 0; i < KEY_NUM; ++i) {
+        snprintf(key, sizeof(key), "key.%d", i);
+        shm_cache_find(cache, key, true);
+    }
+    int index = shm_cache_find(cache, "data", true);
+    if (index < 0)
+        return 1;
+    char buf[4096];
+    uint64_t n = 0;
+    double start = current_timestamp();
+    while (current_timestamp() - start < WRITE_TIME) {
+        size_t size = make_data(buf, n++);
+        if (shm_cache_write(cache, index, buf, size) < 0)
+            error = 1;
+    }
+    printf("writer: %"PRIu64" writes\n", n);
+    shm_cache_find(cache, "stop", true);
+
+    for (int i = 0; i < READER_NUM; ++i) {
+        int status;
+        waitpid(pids[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            error = 1;
+    }
+
+    /* each key in one slot */
+    int used = 0;
+    for (int i = 0; i < 64; ++i) {
+        if (shm_cache_key(cache, i))
+            used++;
+    }
+    printf("used slots: %d\n", used);
+    if (used != KEY_NUM + 2)
+        error = 1;
+
+    /* the same data keeps its version, too large data is refused */
+    uint64_t version = 0;
+    sds data = NULL;
+    if (shm_cache_read(cache, index, &version, &data) != 1)
+        error = 1;
+    sdsfree(data);
+    size_t size = make_data(buf, n - 1);
+    shm_cache_write(cache, index, buf, size);
+    if (shm_cache_read(cache, index, &version, &data) != 0)
+        error = 1;
+    if (shm_cache_write(cache, index, buf, 4097) == 0)
+        error = 1;
+
+    /* a slot being added makes a miss at once, a slot whose adder died
+     * is given up and taken again */
+    snprintf(key, sizeof(key), "key.%d", KEY_NUM);
+    int stuck = shm_cache_find(cache, key, true);
+    shm_cache_slot *slot = (shm_cache_slot *)((char *)cache->addr + cache->slot_size * stuck);
+    uint64_t state = slot->state;
+    slot->state = 1 | (uint64_t)(current_timestamp() * 1000) << 8;
+    start = current_timestamp();
+    if (shm_cache_find(cache, key, false) >= 0)
+        error = 1;
+    printf("busy slot missed in %.6fs\n", current_timestamp() - start);
+    if (current_timestamp() - start > 0.1)
+        error = 1;
+    slot->state = 1;
+    int added = shm_cache_find(cache, key, true);
+    if (added != stuck || slot->state != state || shm_cache_find(cache, key, false) != added)
+        error = 1;
+
+    /* a full cache adds nothing */
+    for (int i = KEY_NUM + 1; i < 64; ++i) {
+        snprintf(key, sizeof(key), "key.%d", i);
+        shm_cache_find(cache, key, true);
+    }
+    if (shm_cache_find(cache, "one more", true) >= 0 || shm_cache_find(cache, "key.3", false) < 0)
+        error = 1;
+
+    /* an expired key frees its slot, the new key there starts unwritten
+     * and never gets a version handed out before */
+    int expired = shm_cache_find(cache, "data", false);
+    if (shm_cache_expire(cache, expired) < 0 || shm_cache_find(cache, "data", false) >= 0)
+        error = 1;
+    if (shm_cache_find(cache, "one more", true) != expired)
+        error = 1;
+    uint64_t last_version = version;
+    data = NULL;
+    if (shm_cache_read(cache, expired, &version, &data) != 0)
+        error = 1;
+    shm_cache_write(cache, expired, buf, size);
+    if (shm_cache_read(cache, expired, &version, &data) != 1 || version <= last_version)
+        error = 1;
+    sdsfree(data);
+
+    shm_cache_release(cache);
+    printf("%s\n", error ? "fail" : "ok");
+    return error;
+}
@@ -63,6 +63,11 @@ int main(int argc, char *argv[])
     printf("list len: %ld\n", skiplist_len(list));
     printf("level: %d\n", list->level);
 
+    value = sdsnew("k");
+    skiplist_node *lower = skiplist_lower_bound(list, value);
+    printf("lower bound of k: %s\n", lower ? (char *)lower->value : "none");
+    sdsfree(value);
+
     skiplist_iter *iter = skiplist_get_iterator(list);
     skiplist_node *node;
     while ((node = skiplist_next(iter)) != NULL) {
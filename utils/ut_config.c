@@ -130,6 +130,8 @@ int load_cfg_svr(json_t *root, const char *key, nw_svr_cfg *cfg)
     ERR_RET(read_cfg_uint32(node, "buf_limit", &cfg->buf_limit, false, 0));
     ERR_RET(read_cfg_uint32(node, "read_mem", &cfg->read_mem, false, 0));
     ERR_RET(read_cfg_uint32(node, "write_mem", &cfg->write_mem, false, 0));
+    ERR_RET(read_cfg_bool(node, "cork", &cfg->cork, false, false));
+    ERR_RET(read_cfg_bool(node, "reuse_port", &cfg->reuse_port, false, false));
 
     return 0;
 }
@@ -191,6 +193,38 @@ int load_cfg_rpc_clt(json_t *root, const char *key, rpc_clt_cfg *cfg)
     ERR_RET(read_cfg_uint32(node, "write_mem", &cfg->read_mem, false, 0));
     ERR_RET(read_cfg_real(node, "reconnect_timeout", &cfg->reconnect_timeout, false, 0));
     ERR_RET(read_cfg_real(node, "heartbeat_timeout", &cfg->heartbeat_timeout, false, 0));
+    ERR_RET(read_cfg_real(node, "request_timeout", &cfg->request_timeout, false, 0));
+
+    char *encoding = NULL;
+    ERR_RET(read_cfg_str(node, "encoding", &encoding, "json"));
+    if (strcmp(encoding, "json") == 0) {
+        cfg->encoding = RPC_ENCODING_JSON;
+    } else if (strcmp(encoding, "binary") == 0) {
+        cfg->encoding = RPC_ENCODING_BINARY;
+    } else {
+        free(encoding);
+        return -__LINE__;
+    }
+    free(encoding);
+
+    ERR_RET(read_cfg_uint32(node, "pool_size", &cfg->pool_size, false, 1));
+    ERR_RET(read_cfg_uint32(node, "shm_size", &cfg->shm_size, false, 0));
+    ERR_RET(read_cfg_bool(node, "skip_body_crc", &cfg->skip_body_crc, false, false));
+    char *balance = NULL;
+    ERR_RET(read_cfg_str(node, "balance", &balance, "failover"));
+    if (strcmp(balance, "failover") == 0) {
+        cfg->balance = RPC_CLT_BALANCE_FAILOVER;
+    } else if (strcmp(balance, "round_robin") == 0) {
+        cfg->balance = RPC_CLT_BALANCE_ROUND_ROBIN;
+    } else if (strcmp(balance, "least_inflight") == 0) {
+        cfg->balance = RPC_CLT_BALANCE_LEAST_INFLIGHT;
+    } else if (strcmp(balance, "hash") == 0) {
+        cfg->balance = RPC_CLT_BALANCE_HASH;
+    } else {
+        free(balance);
+        return -__LINE__;
+    }
+    free(balance);
 
     return 0;
 }
@@ -229,7 +263,10 @@ int load_cfg_rpc_svr(json_t *root, const char *key, rpc_svr_cfg *cfg)
     ERR_RET(read_cfg_uint32(node, "buf_limit", &cfg->buf_limit, false, 0));
     ERR_RET(read_cfg_uint32(node, "read_mem", &cfg->read_mem, false, 0));
     ERR_RET(read_cfg_uint32(node, "write_mem", &cfg->write_mem, false, 0));
+    ERR_RET(read_cfg_bool(node, "cork", &cfg->cork, false, false));
     ERR_RET(read_cfg_bool(node, "heartbeat_check", &cfg->heartbeat_check, false, true));
+    ERR_RET(read_cfg_bool(node, "shm", &cfg->shm, false, false));
+    ERR_RET(read_cfg_bool(node, "skip_body_crc", &cfg->skip_body_crc, false, false));
 
     return 0;
 }
@@ -268,7 +305,11 @@ int load_cfg_http_svr(json_t *root, const char *key, http_svr_cfg *cfg)
     ERR_RET(read_cfg_uint32(node, "buf_limit", &cfg->buf_limit, false, 0));
     ERR_RET(read_cfg_uint32(node, "read_mem", &cfg->read_mem, false, 0));
     ERR_RET(read_cfg_uint32(node, "write_mem", &cfg->write_mem, false, 0));
+    ERR_RET(read_cfg_bool(node, "cork", &cfg->cork, false, false));
+    ERR_RET(read_cfg_bool(node, "reuse_port", &cfg->reuse_port, false, false));
     ERR_RET(read_cfg_int(node, "keep_alive", &cfg->keep_alive, false, 3600));
+    ERR_RET(read_cfg_int(node, "gzip_level", &cfg->gzip_level, false, 0));
+    ERR_RET(read_cfg_uint32(node, "gzip_min_size", &cfg->gzip_min_size, false, 1024));
 
     return 0;
 }
@@ -307,7 +348,11 @@ int load_cfg_ws_svr(json_t *root, const char *key, ws_svr_cfg *cfg)
     ERR_RET(read_cfg_uint32(node, "buf_limit", &cfg->buf_limit, false, 0));
     ERR_RET(read_cfg_uint32(node, "read_mem", &cfg->read_mem, false, 0));
     ERR_RET(read_cfg_uint32(node, "write_mem", &cfg->write_mem, false, 0));
+    ERR_RET(read_cfg_bool(node, "cork", &cfg->cork, false, false));
+    ERR_RET(read_cfg_bool(node, "reuse_port", &cfg->reuse_port, false, false));
     ERR_RET(read_cfg_int(node, "keep_alive", &cfg->keep_alive, false, 3600));
+    ERR_RET(read_cfg_int(node, "deflate_level", &cfg->deflate_level, false, 0));
+    ERR_RET(read_cfg_uint32(node, "deflate_min_size", &cfg->deflate_min_size, false, 1024));
     ERR_RET(read_cfg_str(node, "protocol", &cfg->protocol, "chat"));
     ERR_RET(read_cfg_str(node, "origin", &cfg->origin, ""));
 
@@ -3,8 +3,24 @@
  *     History: yang@haipo.me, 2016/03/29, create
  */
 
+# include <string.h>
+# include <endian.h>
+# include <pthread.h>
+
+# if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h>
+# define CRC32_HAVE_PCLMUL 1
+# endif
+
 # include "ut_crc32.h"
 
+/*
+ * despite the name this is the reflected CRC-32 of zlib and ethernet,
+ * polynomial 0xEDB88320, not the Castagnoli one the sse4.2 crc32
+ * instruction computes, so that is of no use here. peers check the
+ * same polynomial, the faster paths below must give identical results.
+ */
+
 #define CRC32C(c,d) (c=(c>>8)^crc_c[(c^(d))&0xFF])
 
 static const unsigned int crc_c[256] = {
@@ -74,13 +90,193 @@ static const unsigned int crc_c[256] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
 };
 
-uint32_t generate_crc32c(const char *buffer, size_t length) {
-  size_t i;
-  uint32_t crc32 = ~0L;
+/* crc_c extended to 8 tables, table k advances a byte k positions early */
+static uint32_t crc_slice[8][256];
+static uint32_t (*crc_impl)(uint32_t crc, const char *buffer, size_t length);
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static uint32_t crc_bytewise(uint32_t crc32, const char *buffer, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        CRC32C(crc32, (unsigned char)buffer[i]);
+    }
+    return crc32;
+}
+
+static uint32_t crc_slice8(uint32_t crc, const char *buffer, size_t length)
+{
+    const unsigned char *p = (const unsigned char *)buffer;
+    while (length && ((uintptr_t)p & 7)) {
+        CRC32C(crc, *p++);
+        length--;
+    }
+    while (length >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo = le32toh(lo) ^ crc;
+        hi = le32toh(hi);
+        crc = crc_slice[7][lo & 0xff] ^ crc_slice[6][(lo >> 8) & 0xff] ^
+              crc_slice[5][(lo >> 16) & 0xff] ^ crc_slice[4][lo >> 24] ^
+              crc_slice[3][hi & 0xff] ^ crc_slice[2][(hi >> 8) & 0xff] ^
+              crc_slice[1][(hi >> 16) & 0xff] ^ crc_slice[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        CRC32C(crc, *p++);
+    }
+    return crc;
+}
+
+# ifdef CRC32_HAVE_PCLMUL
+/*
+ * carry-less multiply folding, "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction", Intel 2009. folds four 128
+ * bit lanes per 64 bytes, then one lane, then Barrett reduces to 32
+ * bits. length must be at least 64 and a multiple of 16.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc_fold(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i *)k1k2);
+    buf += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    x0 = _mm_load_si128((const __m128i *)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)buf)), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    /* 128 to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i *)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return _mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc_pclmul(uint32_t crc, const char *buffer, size_t length)
+{
+    if (length >= 64) {
+        size_t chunk = length & ~(size_t)15;
+        crc = crc_fold(crc, (const unsigned char *)buffer, chunk);
+        buffer += chunk;
+        length -= chunk;
+    }
+    return crc_slice8(crc, buffer, length);
+}
+# endif
+
+static void crc_init(void)
+{
+    for (int i = 0; i < 256; ++i) {
+        crc_slice[0][i] = crc_c[i];
+    }
+    for (int i = 0; i < 256; ++i) {
+        uint32_t crc = crc_c[i];
+        for (int k = 1; k < 8; ++k) {
+            crc = (crc >> 8) ^ crc_c[crc & 0xff];
+            crc_slice[k][i] = crc;
+        }
+    }
+
+    crc_impl = crc_slice8;
+# ifdef CRC32_HAVE_PCLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        crc_impl = crc_pclmul;
+    }
+# endif
+}
+
+uint32_t generate_crc32c(const char *buffer, size_t length)
+{
+    pthread_once(&crc_once, crc_init);
+    return ~crc_impl(~0U, buffer, length);
+}
+
+uint32_t generate_crc32c_impl(int impl, const char *buffer, size_t length)
+{
+    pthread_once(&crc_once, crc_init);
+    switch (impl) {
+    case CRC32_IMPL_BYTEWISE:
+        return ~crc_bytewise(~0U, buffer, length);
+    case CRC32_IMPL_SLICE8:
+        return ~crc_slice8(~0U, buffer, length);
+# ifdef CRC32_HAVE_PCLMUL
+    case CRC32_IMPL_PCLMUL:
+        if (crc_impl == crc_pclmul)
+            return ~crc_pclmul(~0U, buffer, length);
+        break;
+# endif
+    }
+    return generate_crc32c(buffer, length);
+}
 
-  for (i = 0; i < length; i++){
-      CRC32C(crc32, (unsigned char)buffer[i]);
-  }
-  return ~crc32;
+int crc32c_impl(void)
+{
+    pthread_once(&crc_once, crc_init);
+# ifdef CRC32_HAVE_PCLMUL
+    if (crc_impl == crc_pclmul)
+        return CRC32_IMPL_PCLMUL;
+# endif
+    return CRC32_IMPL_SLICE8;
 }
 
@@ -11,4 +11,14 @@
 
 uint32_t generate_crc32c(const char *string, size_t length);
 
+/* implementations behind generate_crc32c, picked once by cpu features */
+# define CRC32_IMPL_BYTEWISE    0
+# define CRC32_IMPL_SLICE8      1
+# define CRC32_IMPL_PCLMUL      2
+
+/* the one generate_crc32c uses */
+int crc32c_impl(void);
+/* run a given implementation, falls back to the default if the cpu lacks it */
+uint32_t generate_crc32c_impl(int impl, const char *string, size_t length);
+
 # endif
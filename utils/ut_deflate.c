@@ -0,0 +1,216 @@
+/*
+ * Description: gzip and permessage-deflate encoding
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+# include <stdbool.h>
+# include <zlib.h>
+
+# include "ut_deflate.h"
+
+static z_stream deflater;
+static int deflater_level;
+static z_stream inflater;
+static bool inflater_ready;
+
+static int deflater_reset(int level)
+{
+    if (level < 1)
+        level = 1;
+    if (level > 9)
+        level = 9;
+    if (deflater_level == level)
+        return deflateReset(&deflater) == Z_OK ? 0 : -__LINE__;
+
+    if (deflater_level)
+        deflateEnd(&deflater);
+    deflater_level = 0;
+    memset(&deflater, 0, sizeof(deflater));
+    if (deflateInit2(&deflater, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -__LINE__;
+    deflater_level = level;
+
+    return 0;
+}
+
+/* Z_SYNC_FLUSH stops at a byte boundary with an empty stored block,
+ * Z_FINISH ends the stream */
+static sds deflate_append(sds out, const void *data, size_t size, int flush)
+{
+    deflater.next_in = (Bytef *)data;
+    deflater.avail_in = size;
+    size_t bound = deflateBound(&deflater, size) + 16;
+    for (;;) {
+        out = sdsMakeRoomFor(out, bound);
+        size_t avail = sdsavail(out);
+        deflater.next_out = (Bytef *)out + sdslen(out);
+        deflater.avail_out = avail;
+        int ret = deflate(&deflater, flush);
+        sdsIncrLen(out, avail - deflater.avail_out);
+        if (ret == Z_STREAM_ERROR) {
+            sdsfree(out);
+            return NULL;
+        }
+        if (flush == Z_FINISH ? ret == Z_STREAM_END : deflater.avail_out != 0)
+            break;
+    }
+
+    return out;
+}
+
+/* stored blocks, the stream must be at a byte boundary */
+static sds append_stored(sds out, const char *data, size_t size, bool final)
+{
+    do {
+        size_t len = size > 0xffff ? 0xffff : size;
+        unsigned char head[5];
+        head[0] = (final && len == size) ? 1 : 0;
+        head[1] = len & 0xff;
+        head[2] = (len >> 8) & 0xff;
+        head[3] = ~len & 0xff;
+        head[4] = (~len >> 8) & 0xff;
+        out = sdscatlen(out, head, sizeof(head));
+        out = sdscatlen(out, data, len);
+        data += len;
+        size -= len;
+    } while (size > 0);
+
+    return out;
+}
+
+static sds gzip_header(void)
+{
+    static const unsigned char header[] = { 0x1f, 0x8b, 0x08, 0, 0, 0, 0, 0, 0, 0x03 };
+    return sdsnewlen(header, sizeof(header));
+}
+
+static sds gzip_trailer(sds out, uint32_t crc, size_t size)
+{
+    unsigned char trailer[8];
+    for (int i = 0; i < 4; ++i) {
+        trailer[i] = (crc >> (i * 8)) & 0xff;
+        trailer[i + 4] = ((uint32_t)size >> (i * 8)) & 0xff;
+    }
+    return sdscatlen(out, trailer, sizeof(trailer));
+}
+
+sds gzip_encode(const void *data, size_t size, int level)
+{
+    if (deflater_reset(level) < 0)
+        return NULL;
+    sds out = deflate_append(gzip_header(), data, size, Z_FINISH);
+    if (out == NULL)
+        return NULL;
+    return gzip_trailer(out, crc32(0, data, size), size);
+}
+
+sds ws_deflate_encode(const void *data, size_t size, int level)
+{
+    if (deflater_reset(level) < 0)
+        return NULL;
+    sds out = deflate_append(sdsempty(), data, size, Z_SYNC_FLUSH);
+    if (out == NULL)
+        return NULL;
+    sdsIncrLen(out, -4);
+    return out;
+}
+
+sds ws_deflate_decode(const void *data, size_t size, size_t max)
+{
+    if (!inflater_ready) {
+        memset(&inflater, 0, sizeof(inflater));
+        if (inflateInit2(&inflater, -MAX_WBITS) != Z_OK)
+            return NULL;
+        inflater_ready = true;
+    } else if (inflateReset(&inflater) != Z_OK) {
+        return NULL;
+    }
+
+    static const unsigned char tail[] = { 0x00, 0x00, 0xff, 0xff };
+    sds out = sdsempty();
+    for (int i = 0; i < 2; ++i) {
+        inflater.next_in = (Bytef *)(i == 0 ? data : (const void *)tail);
+        inflater.avail_in = i == 0 ? size : sizeof(tail);
+        for (;;) {
+            out = sdsMakeRoomFor(out, 4096);
+            size_t avail = sdsavail(out);
+            inflater.next_out = (Bytef *)out + sdslen(out);
+            inflater.avail_out = avail;
+            int ret = inflate(&inflater, Z_SYNC_FLUSH);
+            sdsIncrLen(out, avail - inflater.avail_out);
+            if (ret == Z_STREAM_END)
+                return out;
+            if ((ret != Z_OK && ret != Z_BUF_ERROR) || sdslen(out) > max) {
+                sdsfree(out);
+                return NULL;
+            }
+            if (inflater.avail_in == 0 && inflater.avail_out != 0)
+                break;
+        }
+    }
+
+    return out;
+}
+
+deflate_head *deflate_head_create(const void *data, size_t size, int level)
+{
+    deflate_head *head = malloc(sizeof(deflate_head));
+    if (head == NULL)
+        return NULL;
+    memset(head, 0, sizeof(deflate_head));
+    head->plain = sdsnewlen(data, size);
+    head->level = level;
+
+    return head;
+}
+
+static int deflate_head_pack(deflate_head *head)
+{
+    if (head->packed)
+        return 0;
+    if (deflater_reset(head->level) < 0)
+        return -__LINE__;
+    head->packed = deflate_append(sdsempty(), head->plain, sdslen(head->plain), Z_SYNC_FLUSH);
+    if (head->packed == NULL)
+        return -__LINE__;
+    head->crc = crc32(0, (const Bytef *)head->plain, sdslen(head->plain));
+
+    return 0;
+}
+
+sds deflate_head_gzip(deflate_head *head, const void *tail, size_t tail_size)
+{
+    if (deflate_head_pack(head) < 0)
+        return NULL;
+    sds out = sdscatsds(gzip_header(), head->packed);
+    out = append_stored(out, tail, tail_size, true);
+    uint32_t crc = crc32_combine(head->crc, crc32(0, tail, tail_size), tail_size);
+    return gzip_trailer(out, crc, sdslen(head->plain) + tail_size);
+}
+
+sds deflate_head_ws(deflate_head *head, const void *tail, size_t tail_size)
+{
+    if (deflate_head_pack(head) < 0)
+        return NULL;
+    sds out = sdsdup(head->packed);
+    if (tail_size == 0) {
+        sdsIncrLen(out, -4);
+        return out;
+    }
+    /* the peer appends 00 00 ff ff, which is the length of an empty
+     * stored block, its header byte 00 is written here. a message must
+     * end on it, or an inflater kept across messages sees a broken block */
+    out = append_stored(out, tail, tail_size, false);
+    return sdscatlen(out, "\0", 1);
+}
+
+void deflate_head_release(deflate_head *head)
+{
+    sdsfree(head->plain);
+    if (head->packed)
+        sdsfree(head->packed);
+    free(head);
+}
+
@@ -0,0 +1,47 @@
+/*
+ * Description: gzip and permessage-deflate encoding
+ *              https://tools.ietf.org/html/rfc1952
+ *              https://tools.ietf.org/html/rfc7692
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _UT_DEFLATE_H_
+# define _UT_DEFLATE_H_
+
+# include <stdint.h>
+# include <stddef.h>
+
+# include "ut_sds.h"
+
+/* level 1 to 9, the encoders keep one zlib stream and are not thread safe */
+
+/* a complete gzip body */
+sds gzip_encode(const void *data, size_t size, int level);
+/* a permessage-deflate message, no context takeover and the trailing
+ * 00 00 ff ff removed */
+sds ws_deflate_encode(const void *data, size_t size, int level);
+/* inflate a permessage-deflate message sent without context takeover,
+ * NULL if it is corrupt or inflates to more than max bytes */
+sds ws_deflate_decode(const void *data, size_t size, size_t max);
+
+/*
+ * the head of a text shared by many replies that differ only in a short
+ * tail, like the request id. the head is compressed once on first use
+ * and ends on a byte boundary, each reply then appends its tail as a
+ * stored block, so sending it compressed costs a few bytes and a crc.
+ */
+typedef struct deflate_head {
+    sds         plain;
+    int         level;
+    /* raw deflate of plain with a sync flush, NULL until first use */
+    sds         packed;
+    uint32_t    crc;
+} deflate_head;
+
+deflate_head *deflate_head_create(const void *data, size_t size, int level);
+sds deflate_head_gzip(deflate_head *head, const void *tail, size_t tail_size);
+sds deflate_head_ws(deflate_head *head, const void *tail, size_t tail_size);
+void deflate_head_release(deflate_head *head);
+
+# endif
+
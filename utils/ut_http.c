@@ -268,16 +268,25 @@ const char *get_status_description(uint32_t status)
     return "Unknown";
 }
 
-sds http_response_encode(http_response_t *response)
+const char *http_date(void)
+{
+    static time_t last;
+    static char date[64];
+    time_t now = time(NULL);
+    if (now != last) {
+        struct tm tm;
+        gmtime_r(&now, &tm);
+        strftime(date, sizeof(date), "%a, %d %b %Y %T GMT", &tm);
+        last = now;
+    }
+    return date;
+}
+
+sds http_response_encode_head(http_response_t *response)
 {
     sds msg = sdsempty();
     msg = sdscatprintf(msg, "HTTP/1.1 %u %s\r\n", response->status, get_status_description(response->status));
-
-    time_t now = time(NULL);
-    struct tm * tm = gmtime(&now);
-    char date[100];
-    strftime(date, sizeof(date), "%a, %d %B %Y %T GMT", tm);
-    msg = sdscatprintf(msg, "Date: %s\r\n", date);
+    msg = sdscatprintf(msg, "Date: %s\r\n", http_date());
     msg = sdscatprintf(msg, "Content-Length: %zu\r\n", response->content_size);
 
     dict_iterator *iter = dict_get_iterator(response->headers);
@@ -288,6 +297,13 @@ sds http_response_encode(http_response_t *response)
     dict_release_iterator(iter);
 
     msg = sdscatprintf(msg, "\r\n");
+
+    return msg;
+}
+
+sds http_response_encode(http_response_t *response)
+{
+    sds msg = http_response_encode_head(response);
     if (response->content) {
         msg = sdscatlen(msg, response->content, response->content_size);
     }
@@ -36,8 +36,14 @@ http_response_t *http_response_new(void);
 int http_response_set_header(http_response_t *response, char *field, char *value);
 const char *http_response_get_header(http_response_t *response, const char *field);
 sds http_response_encode(http_response_t *response);
+/* the status line and headers only, the content is left to the caller */
+sds http_response_encode_head(http_response_t *response);
 void http_response_release(http_response_t *response);
 
+const char *get_status_description(uint32_t status);
+/* the Date header value, formatted once per second */
+const char *http_date(void);
+
 const char *http_get_remote_ip(nw_ses *ses, http_request_t *request);
 
 # endif
@@ -3,30 +3,62 @@
  *     History: yang@haipo.me, 2017/04/21, create
  */
 
+# include <stdio.h>
+# include <strings.h>
+
 # include "ut_log.h"
 # include "ut_misc.h"
+# include "ut_deflate.h"
 # include "ut_http_svr.h"
 
+/* offset from the start of the message, the read buffer may move while
+ * a request is incomplete but the message bytes stay in order */
+struct slice_off {
+    uint32_t off;
+    uint32_t size;
+};
+
 struct clt_info {
     nw_ses  *ses;
     double  last_activity;
+    nw_wheel_timer timer;
     struct  http_parser parser;
-    sds     field;
-    bool    field_set;
-    sds     value;
-    bool    value_set;
-    http_request_t *request;
+    /* message start of the current decode_pkg call */
+    char    *base;
+    /* bytes of the current message the parser has seen */
+    size_t  parsed;
+    bool    complete;
+    /* 1 after a field callback, 2 after a value callback */
+    int     header_state;
+    struct  slice_off url;
+    struct  slice_off body;
+    uint32_t header_count;
+    struct  slice_off fields[HTTP_SVR_HEADER_MAX];
+    struct  slice_off values[HTTP_SVR_HEADER_MAX];
 };
 
+/* a callback may come in pieces when the data arrives in pieces, the
+ * pieces are adjacent in the buffer */
+static void slice_append(struct clt_info *info, struct slice_off *slice, const char *at, size_t length)
+{
+    uint32_t off = at - info->base;
+    if (slice->size == 0) {
+        slice->off = off;
+    } else if (slice->off + slice->size != off) {
+        /* chunked body, move the chunk next to the previous ones, the
+         * bytes in between were parsed already */
+        memmove(info->base + slice->off + slice->size, at, length);
+    }
+    slice->size += length;
+}
+
 static int on_message_begin(http_parser* parser)
 {
     struct clt_info *info = parser->data;
-    if (info->request)
-        http_request_release(info->request);
-    info->request = http_request_new();
-    if (info->request == NULL) {
-        return -__LINE__;
-    }
+    memset(&info->url, 0, sizeof(info->url));
+    memset(&info->body, 0, sizeof(info->body));
+    info->header_count = 0;
+    info->header_state = 0;
 
     return 0;
 }
@@ -34,25 +66,17 @@ static int on_message_begin(http_parser* parser)
 static int on_message_complete(http_parser* parser)
 {
     struct clt_info *info = parser->data;
-    info->request->version_major = parser->http_major;
-    info->request->version_minor = parser->http_minor;
-    info->request->method = parser->method;
-
-    http_svr *svr = http_svr_from_ses(info->ses);
-    int ret = svr->on_request(info->ses, info->request);
-    if (ret < 0 && info->ses->id != 0) {
-        nw_svr_close_clt(svr->raw_svr, info->ses);
-    }
+    info->complete = true;
+    /* stop after this message, the next one of a pipeline waits its turn */
+    http_parser_pause(parser, 1);
 
-    return ret;
+    return 0;
 }
 
 static int on_url(http_parser* parser, const char* at, size_t length)
 {
     struct clt_info *info = parser->data;
-    if (info->request->url)
-        sdsfree(info->request->url);
-    info->request->url = sdsnewlen(at, length);
+    slice_append(info, &info->url, at, length);
 
     return 0;
 }
@@ -60,12 +84,15 @@ static int on_url(http_parser* parser, const char* at, size_t length)
 static int on_header_field(http_parser* parser, const char* at, size_t length)
 {
     struct clt_info *info = parser->data;
-    info->field_set = true;
-    if (info->field == NULL) {
-        info->field = sdsnewlen(at, length);
-    } else {
-        info->field = sdscpylen(info->field, at, length);
+    if (info->header_state != 1) {
+        if (info->header_count == HTTP_SVR_HEADER_MAX)
+            return -1;
+        info->header_count++;
+        memset(&info->fields[info->header_count - 1], 0, sizeof(struct slice_off));
+        memset(&info->values[info->header_count - 1], 0, sizeof(struct slice_off));
+        info->header_state = 1;
     }
+    slice_append(info, &info->fields[info->header_count - 1], at, length);
 
     return 0;
 }
@@ -73,18 +100,8 @@ static int on_header_field(http_parser* parser, const char* at, size_t length)
 static int on_header_value(http_parser* parser, const char* at, size_t length)
 {
     struct clt_info *info = parser->data;
-    info->value_set = true;
-    if (info->value == NULL) {
-        info->value = sdsnewlen(at, length);
-    } else {
-        info->value = sdscpylen(info->value, at, length);
-    }
-
-    if (info->field_set && info->value_set) {
-        http_request_set_header(info->request, info->field, info->value);
-        info->field_set = false;
-        info->value_set = false;
-    }
+    info->header_state = 2;
+    slice_append(info, &info->values[info->header_count - 1], at, length);
 
     return 0;
 }
@@ -92,16 +109,36 @@ static int on_header_value(http_parser* parser, const char* at, size_t length)
 static int on_body(http_parser* parser, const char* at, size_t length)
 {
     struct clt_info *info = parser->data;
-    if (info->request->body)
-        sdsfree(info->request->body);
-    info->request->body = sdsnewlen(at, length);
+    slice_append(info, &info->body, at, length);
 
     return 0;
 }
 
+/* feed the parser the new bytes only, return the message size once the
+ * whole message is in the buffer */
 static int decode_pkg(nw_ses *ses, void *data, size_t max)
 {
-    return max;
+    struct clt_info *info = ses->privdata;
+    if (max <= info->parsed)
+        return 0;
+
+    http_svr *svr = http_svr_from_ses(ses);
+    info->base = data;
+    size_t nparsed = http_parser_execute(&info->parser, &svr->settings, data + info->parsed, max - info->parsed);
+    enum http_errno err = HTTP_PARSER_ERRNO(&info->parser);
+    if (err != HPE_OK && err != HPE_PAUSED) {
+        log_error("peer: %s http parse error: %s (%s)", nw_sock_human_addr(&ses->peer_addr),
+                http_errno_description(err), http_errno_name(err));
+        return -1;
+    }
+    info->parsed += nparsed;
+    if (!info->complete)
+        return 0;
+
+    http_parser_pause(&info->parser, 0);
+    size_t size = info->parsed;
+    info->parsed = 0;
+    return size;
 }
 
 static void on_error_msg(nw_ses *ses, const char *msg)
@@ -109,6 +146,21 @@ static void on_error_msg(nw_ses *ses, const char *msg)
     log_error("peer: %s: %s", nw_sock_human_addr(&ses->peer_addr), msg);
 }
 
+/* activity only updates last_activity, the timer is pushed back when it fires */
+static void on_idle_timeout(nw_wheel_timer *timer, void *privdata)
+{
+    nw_ses *ses = privdata;
+    struct clt_info *info = ses->privdata;
+    http_svr *svr = http_svr_from_ses(ses);
+    double idle = current_timestamp() - info->last_activity;
+    if (idle > svr->keep_alive) {
+        log_error("peer: %s: last_activity: %f, idle too long", nw_sock_human_addr(&ses->peer_addr), info->last_activity);
+        nw_svr_close_clt(svr->raw_svr, ses);
+        return;
+    }
+    nw_wheel_add(svr->wheel, timer, svr->keep_alive - idle);
+}
+
 static void on_new_connection(nw_ses *ses)
 {
     log_trace("new connection from: %s", nw_sock_human_addr(&ses->peer_addr));
@@ -118,11 +170,20 @@ static void on_new_connection(nw_ses *ses)
     info->last_activity = current_timestamp();
     http_parser_init(&info->parser, HTTP_REQUEST);
     info->parser.data = info;
+
+    http_svr *svr = http_svr_from_ses(ses);
+    if (svr->keep_alive > 0) {
+        nw_wheel_timer_init(&info->timer, on_idle_timeout, ses);
+        nw_wheel_add(svr->wheel, &info->timer, svr->keep_alive);
+    }
 }
 
 static void on_connection_close(nw_ses *ses)
 {
     log_trace("connection %s close", nw_sock_human_addr(&ses->peer_addr));
+    struct clt_info *info = ses->privdata;
+    http_svr *svr = http_svr_from_ses(ses);
+    nw_wheel_del(svr->wheel, &info->timer);
 }
 
 static void *on_privdata_alloc(void *svr)
@@ -133,16 +194,6 @@ static void *on_privdata_alloc(void *svr)
 
 static void on_privdata_free(void *svr, void *privdata)
 {
-    struct clt_info *info = privdata;
-    if (info->field) {
-        sdsfree(info->field);
-    }
-    if (info->value) {
-        sdsfree(info->value);
-    }
-    if (info->request) {
-        http_request_release(info->request);
-    }
     http_svr *h_svr = ((nw_svr *)svr)->privdata;
     return nw_cache_free(h_svr->privdata_cache, privdata);
 }
@@ -151,34 +202,31 @@ static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
 {
     struct clt_info *info = ses->privdata;
     info->last_activity = current_timestamp();
+    info->complete = false;
+
+    http_svr_request_t request;
+    request.version_major = info->parser.http_major;
+    request.version_minor = info->parser.http_minor;
+    request.method = info->parser.method;
+    request.url.data = data + info->url.off;
+    request.url.size = info->url.size;
+    request.body.data = data + info->body.off;
+    request.body.size = info->body.size;
+    request.header_count = info->header_count;
+    for (uint32_t i = 0; i < info->header_count; ++i) {
+        request.headers[i].field.data = data + info->fields[i].off;
+        request.headers[i].field.size = info->fields[i].size;
+        request.headers[i].value.data = data + info->values[i].off;
+        request.headers[i].value.size = info->values[i].size;
+    }
+
     http_svr *svr = http_svr_from_ses(ses);
-    size_t nparsed = http_parser_execute(&info->parser, &svr->settings, data, size);
-    if (nparsed != size) {
-        log_error("peer: %s http parse error: %s (%s)", nw_sock_human_addr(&ses->peer_addr),
-                http_errno_description(HTTP_PARSER_ERRNO(&info->parser)),
-                http_errno_name(HTTP_PARSER_ERRNO(&info->parser)));
+    int ret = svr->on_request(ses, &request);
+    if (ret < 0 && ses->id != 0) {
         nw_svr_close_clt(svr->raw_svr, ses);
     }
 }
 
-static void on_timer(nw_timer *timer, void *privdata)
-{
-   http_svr *svr = privdata;
-   double now = current_timestamp();
-
-   nw_ses *curr = svr->raw_svr->clt_list_head;
-   nw_ses *next;
-   while (curr) {
-       next = curr->next;
-       struct clt_info *info = curr->privdata;
-       if (now - info->last_activity > svr->keep_alive) {
-           log_error("peer: %s: last_activity: %f, idle too long", nw_sock_human_addr(&curr->peer_addr), info->last_activity);
-           nw_svr_close_clt(svr->raw_svr, curr);
-       }
-       curr = next;
-   }
-}
-
 http_svr *http_svr_create(http_svr_cfg *cfg, http_request_callback on_request)
 {
     http_svr *svr = malloc(sizeof(http_svr));
@@ -192,6 +240,8 @@ http_svr *http_svr_create(http_svr_cfg *cfg, http_request_callback on_request)
     raw_cfg.buf_limit = cfg->buf_limit;
     raw_cfg.read_mem = cfg->read_mem;
     raw_cfg.write_mem = cfg->write_mem;
+    raw_cfg.cork = cfg->cork;
+    raw_cfg.reuse_port = cfg->reuse_port;
 
     nw_svr_type type;
     memset(&type, 0, sizeof(type));
@@ -218,13 +268,12 @@ http_svr *http_svr_create(http_svr_cfg *cfg, http_request_callback on_request)
     svr->settings.on_message_complete = on_message_complete;
 
     svr->keep_alive = cfg->keep_alive;
+    svr->gzip_level = cfg->gzip_level;
+    svr->gzip_min_size = cfg->gzip_min_size;
     svr->privdata_cache = nw_cache_create(sizeof(struct clt_info));
     svr->on_request = on_request;
 
-    if (cfg->keep_alive > 0) {
-        nw_timer_set(&svr->timer, 60, true, on_timer, svr);
-        nw_timer_start(&svr->timer);
-    }
+    svr->wheel = nw_wheel_default();
 
     return svr;
 }
@@ -249,29 +298,124 @@ int http_svr_stop(http_svr *svr)
 
 int send_http_response(nw_ses *ses, http_response_t *response)
 {
-    sds msg = http_response_encode(response);
-    if (msg == NULL)
+    sds head = http_response_encode_head(response);
+    if (head == NULL)
         return -__LINE__;
-    int ret = nw_ses_send(ses, msg, sdslen(msg));
-    sdsfree(msg);
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = sdslen(head);
+    iov[1].iov_base = response->content;
+    iov[1].iov_len = response->content ? response->content_size : 0;
+    int ret = nw_ses_sendv(ses, iov, iov[1].iov_len ? 2 : 1);
+    sdsfree(head);
 
     return ret;
 }
 
 int send_http_response_simple(nw_ses *ses, uint32_t status, void *content, size_t size)
 {
-    http_response_t *response = http_response_new();
-    if (response == NULL)
+    char head[256];
+    int len = snprintf(head, sizeof(head), "HTTP/1.1 %u %s\r\nDate: %s\r\nContent-Length: %zu\r\n\r\n",
+            status, get_status_description(status), http_date(), content ? size : 0);
+    if (len < 0 || len >= (int)sizeof(head))
+        return -__LINE__;
+
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = len;
+    iov[1].iov_base = content;
+    iov[1].iov_len = content ? size : 0;
+
+    return nw_ses_sendv(ses, iov, iov[1].iov_len ? 2 : 1);
+}
+
+int send_http_response_gzip(nw_ses *ses, uint32_t status, void *content, size_t size)
+{
+    char head[256];
+    int len = snprintf(head, sizeof(head), "HTTP/1.1 %u %s\r\nDate: %s\r\nContent-Encoding: gzip\r\n"
+            "Vary: Accept-Encoding\r\nContent-Length: %zu\r\n\r\n",
+            status, get_status_description(status), http_date(), size);
+    if (len < 0 || len >= (int)sizeof(head))
         return -__LINE__;
-    response->status = status;
-    response->content = content;
-    response->content_size = size;
-    int ret = send_http_response(ses, response);
-    http_response_release(response);
+
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = len;
+    iov[1].iov_base = content;
+    iov[1].iov_len = size;
+
+    return nw_ses_sendv(ses, iov, 2);
+}
+
+int send_http_response_compressed(nw_ses *ses, uint32_t status, void *content, size_t size, bool accept_gzip)
+{
+    http_svr *svr = http_svr_from_ses(ses);
+    if (!accept_gzip || svr->gzip_level <= 0 || content == NULL || size < svr->gzip_min_size)
+        return send_http_response_simple(ses, status, content, size);
+
+    sds data = gzip_encode(content, size, svr->gzip_level);
+    if (data == NULL)
+        return send_http_response_simple(ses, status, content, size);
+    int ret = send_http_response_gzip(ses, status, data, sdslen(data));
+    sdsfree(data);
 
     return ret;
 }
 
+bool http_svr_request_accept_gzip(http_svr_request_t *request)
+{
+    const http_slice_t *value = http_svr_request_header(request, "Accept-Encoding");
+    if (value == NULL)
+        return false;
+
+    /* "gzip", "gzip;q=0.8", but not "gzip;q=0" */
+    const char *p = value->data;
+    const char *end = value->data + value->size;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == ','))
+            p++;
+        const char *token = p;
+        while (p < end && *p != ',')
+            p++;
+        size_t len = p - token;
+        if (len < 4 || strncasecmp(token, "gzip", 4) != 0)
+            continue;
+        const char *q = token + 4;
+        while (q < p && *q == ' ')
+            q++;
+        if (q == p)
+            return true;
+        if (*q != ';')
+            continue;
+        q++;
+        while (q < p && *q == ' ')
+            q++;
+        if (p - q >= 3 && strncasecmp(q, "q=0", 3) == 0) {
+            q += 3;
+            if (q < p && *q == '.')
+                q++;
+            while (q < p && *q == '0')
+                q++;
+            if (q == p || *q == ' ')
+                continue;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+const http_slice_t *http_svr_request_header(http_svr_request_t *request, const char *field)
+{
+    size_t len = strlen(field);
+    for (uint32_t i = 0; i < request->header_count; ++i) {
+        http_slice_t *curr = &request->headers[i].field;
+        if (curr->size == len && strncasecmp(curr->data, field, len) == 0)
+            return &request->headers[i].value;
+    }
+    return NULL;
+}
+
 http_svr *http_svr_from_ses(nw_ses *ses)
 {
     return ((nw_svr *)ses->svr)->privdata;
@@ -285,7 +429,6 @@ void http_svr_close_clt(http_svr *svr, nw_ses *ses)
 void http_svr_release(http_svr *svr)
 {
     nw_svr_release(svr->raw_svr);
-    nw_timer_stop(&svr->timer);
     nw_cache_release(svr->privdata_cache);
     free(svr);
 }
@@ -9,7 +9,7 @@
 # include "ut_http.h"
 # include "nw_buf.h"
 # include "nw_svr.h"
-# include "nw_timer.h"
+# include "nw_wheel.h"
 
 typedef struct http_svr_cfg {
     uint32_t bind_count;
@@ -18,16 +18,48 @@ typedef struct http_svr_cfg {
     uint32_t buf_limit;
     uint32_t read_mem;
     uint32_t write_mem;
+    bool cork;
+    bool reuse_port;
     int keep_alive;
+    /* gzip replies to clients accepting it, 0 is off */
+    int gzip_level;
+    uint32_t gzip_min_size;
 } http_svr_cfg;
 
-typedef int (*http_request_callback)(nw_ses *ses, http_request_t *request);
+# define HTTP_SVR_HEADER_MAX 32
+
+/* a piece of the session read buffer, not nul terminated */
+typedef struct http_slice_t {
+    const char *data;
+    size_t      size;
+} http_slice_t;
+
+typedef struct http_svr_header_t {
+    http_slice_t field;
+    http_slice_t value;
+} http_svr_header_t;
+
+/* a request as slices of the session read buffer, nothing is copied.
+ * valid until the callback returns, a chunked body is joined in place */
+typedef struct http_svr_request_t {
+    uint16_t    version_major;
+    uint16_t    version_minor;
+    uint32_t    method;
+    http_slice_t url;
+    http_slice_t body;
+    uint32_t    header_count;
+    http_svr_header_t headers[HTTP_SVR_HEADER_MAX];
+} http_svr_request_t;
+
+typedef int (*http_request_callback)(nw_ses *ses, http_svr_request_t *request);
 
 typedef struct http_svr {
     nw_svr *raw_svr;
-    nw_timer timer;
+    nw_wheel *wheel;
     nw_cache *privdata_cache;
     int keep_alive;
+    int gzip_level;
+    uint32_t gzip_min_size;
     http_parser_settings settings;
     http_request_callback on_request;
 } http_svr;
@@ -35,8 +67,18 @@ typedef struct http_svr {
 http_svr *http_svr_create(http_svr_cfg *cfg, http_request_callback on_request);
 int http_svr_start(http_svr *svr);
 int http_svr_stop(http_svr *svr);
+/* header and content go out with one writev, the content is not copied
+ * unless the socket is busy */
 int send_http_response(nw_ses *ses, http_response_t *response);
 int send_http_response_simple(nw_ses *ses, uint32_t status, void *content, size_t size);
+/* content is gzip already, sent with Content-Encoding: gzip */
+int send_http_response_gzip(nw_ses *ses, uint32_t status, void *content, size_t size);
+/* gzip the content when the client accepts it and it is at least gzip_min_size */
+int send_http_response_compressed(nw_ses *ses, uint32_t status, void *content, size_t size, bool accept_gzip);
+/* Accept-Encoding lists gzip */
+bool http_svr_request_accept_gzip(http_svr_request_t *request);
+/* case insensitive, NULL if absent */
+const http_slice_t *http_svr_request_header(http_svr_request_t *request, const char *field);
 http_svr *http_svr_from_ses(nw_ses *ses);
 void http_svr_close_clt(http_svr *svr, nw_ses *ses);
 void http_svr_release(http_svr *svr);
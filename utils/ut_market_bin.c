@@ -0,0 +1,687 @@
+/*
+ * Description: compact binary market data notify for websocket clients
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+# include <stdint.h>
+# include <stdbool.h>
+# include <math.h>
+
+# include "ut_market_bin.h"
+
+# define SCALE_MAX      18
+# define SIDE_SELL      1
+# define SIDE_BUY       2
+
+static const int64_t pow10_table[SCALE_MAX + 1] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL, 10000000000LL, 100000000000LL, 1000000000000LL,
+    10000000000000LL, 100000000000000LL, 1000000000000000LL,
+    10000000000000000LL, 100000000000000000LL, 1000000000000000000LL,
+};
+
+struct bin_buf {
+    char   *data;
+    size_t  len;
+    size_t  cap;
+};
+
+static int buf_reserve(struct bin_buf *buf, size_t size)
+{
+    if (buf->len + size <= buf->cap)
+        return 0;
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->len + size)
+        cap *= 2;
+    char *data = realloc(buf->data, cap);
+    if (data == NULL)
+        return -1;
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+static int put_byte(struct bin_buf *buf, uint8_t c)
+{
+    if (buf_reserve(buf, 1) < 0)
+        return -1;
+    buf->data[buf->len++] = c;
+    return 0;
+}
+
+static int put_varint(struct bin_buf *buf, uint64_t num)
+{
+    if (buf_reserve(buf, 10) < 0)
+        return -1;
+    uint8_t *p = (uint8_t *)buf->data + buf->len;
+    while (num >= 0x80) {
+        *p++ = (uint8_t)num | 0x80;
+        num >>= 7;
+    }
+    *p++ = (uint8_t)num;
+    buf->len = (char *)p - buf->data;
+    return 0;
+}
+
+static uint64_t zigzag(int64_t num)
+{
+    return ((uint64_t)num << 1) ^ (uint64_t)(num >> 63);
+}
+
+static int64_t unzigzag(uint64_t num)
+{
+    return (int64_t)(num >> 1) ^ -(int64_t)(num & 1);
+}
+
+/* deltas wrap, so any two values round trip */
+static int put_delta(struct bin_buf *buf, int64_t value, int64_t last)
+{
+    return put_varint(buf, zigzag((int64_t)((uint64_t)value - (uint64_t)last)));
+}
+
+static int put_string(struct bin_buf *buf, const char *str)
+{
+    size_t len = strlen(str);
+    if (put_varint(buf, len) < 0 || buf_reserve(buf, len) < 0)
+        return -1;
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+    return 0;
+}
+
+/* "-?[0-9]+(\.[0-9]+)?([eE][+-]?[0-9]+)?" with at most 18 digits after
+ * the leading zeros, as mpd_to_sci writes them */
+static bool parse_decimal(const char *str, int64_t *mantissa, int *scale)
+{
+    const char *p = str;
+    bool negative = *p == '-';
+    if (negative)
+        p++;
+    if (*p < '0' || *p > '9')
+        return false;
+
+    uint64_t value = 0;
+    int digits = 0;
+    int frac = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+        digits += value != 0;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p < '0' || *p > '9')
+            return false;
+        while (*p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+            digits += value != 0;
+            frac++;
+        }
+    }
+    if (digits > SCALE_MAX)
+        return false;
+
+    if (*p == 'e' || *p == 'E') {
+        char *end;
+        long exp = strtol(p + 1, &end, 10);
+        if (end == p + 1 || exp > SCALE_MAX || exp < -SCALE_MAX)
+            return false;
+        frac -= exp;
+        p = end;
+    }
+    if (*p)
+        return false;
+    if (frac < 0) {
+        if (digits - frac > SCALE_MAX)
+            return false;
+        value *= pow10_table[-frac];
+        frac = 0;
+    }
+    if (frac > SCALE_MAX)
+        return false;
+
+    *mantissa = negative ? -(int64_t)value : (int64_t)value;
+    *scale = frac;
+    return true;
+}
+
+/* decimals of a field share one scale, the scale bytes are written when
+ * the message is done */
+# define FIELD_MAX      3
+
+struct encoder {
+    struct bin_buf buf;
+    size_t  scale_offset;
+    int     field_count;
+    int     scale[FIELD_MAX];
+    bool    used[FIELD_MAX];
+    bool    retry;
+};
+
+static int put_scales(struct encoder *enc, int field_count)
+{
+    enc->scale_offset = enc->buf.len;
+    enc->field_count = field_count;
+    for (int i = 0; i < field_count; ++i) {
+        if (put_byte(&enc->buf, 0) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* a field takes the scale of its first value, a larger one later makes
+ * the message take another pass */
+static int get_scaled(struct encoder *enc, int field, const json_t *json, int64_t *value)
+{
+    int scale;
+    if (!json_is_string(json) || !parse_decimal(json_string_value(json), value, &scale))
+        return -1;
+    if (scale > enc->scale[field]) {
+        if (enc->used[field])
+            enc->retry = true;
+        enc->scale[field] = scale;
+    }
+    enc->used[field] = true;
+    if (__builtin_mul_overflow(*value, pow10_table[enc->scale[field] - scale], value))
+        return -1;
+    return 0;
+}
+
+static int get_amount(struct encoder *enc, int field, const json_t *json, int64_t *value)
+{
+    if (get_scaled(enc, field, json, value) < 0 || *value < 0)
+        return -1;
+    return 0;
+}
+
+static int encode_depth_side(struct encoder *enc, const json_t *side)
+{
+    if (!json_is_array(side) || put_varint(&enc->buf, json_array_size(side)) < 0)
+        return -1;
+    int64_t last = 0;
+    for (size_t i = 0; i < json_array_size(side); ++i) {
+        json_t *level = json_array_get(side, i);
+        if (json_array_size(level) != 2)
+            return -1;
+        int64_t price, amount;
+        if (get_scaled(enc, 0, json_array_get(level, 0), &price) < 0)
+            return -1;
+        if (get_amount(enc, 1, json_array_get(level, 1), &amount) < 0)
+            return -1;
+        if (put_delta(&enc->buf, price, last) < 0 || put_varint(&enc->buf, amount) < 0)
+            return -1;
+        last = price;
+    }
+    return 0;
+}
+
+/* [clean, {"asks": [[price, amount], ...], "bids": [...]}, market] */
+static int encode_depth(struct encoder *enc, const json_t *params)
+{
+    json_t *clean  = json_array_get(params, 0);
+    json_t *depth  = json_array_get(params, 1);
+    json_t *market = json_array_get(params, 2);
+    if (json_array_size(params) != 3 || !json_is_boolean(clean) || !json_is_object(depth) || !json_is_string(market))
+        return -1;
+    json_t *asks = json_object_get(depth, "asks");
+    json_t *bids = json_object_get(depth, "bids");
+    if (json_object_size(depth) != (asks ? 1 : 0) + (bids ? 1 : 0))
+        return -1;
+
+    uint8_t flags = (json_is_true(clean) ? 1 : 0) | (asks ? 2 : 0) | (bids ? 4 : 0);
+    if (put_byte(&enc->buf, MARKET_BIN_DEPTH) < 0 || put_string(&enc->buf, json_string_value(market)) < 0)
+        return -1;
+    if (put_byte(&enc->buf, flags) < 0 || put_scales(enc, 2) < 0)
+        return -1;
+    if (asks && encode_depth_side(enc, asks) < 0)
+        return -1;
+    if (bids && encode_depth_side(enc, bids) < 0)
+        return -1;
+    return 0;
+}
+
+/* [market, [{"id", "time", "price", "amount", "type"}, ...]] */
+static int encode_deals(struct encoder *enc, const json_t *params)
+{
+    json_t *market = json_array_get(params, 0);
+    json_t *deals  = json_array_get(params, 1);
+    if (json_array_size(params) != 2 || !json_is_string(market) || !json_is_array(deals))
+        return -1;
+
+    if (put_byte(&enc->buf, MARKET_BIN_DEALS) < 0 || put_string(&enc->buf, json_string_value(market)) < 0)
+        return -1;
+    if (put_scales(enc, 2) < 0 || put_varint(&enc->buf, json_array_size(deals)) < 0)
+        return -1;
+    int64_t last_id = 0, last_time = 0, last_price = 0;
+    for (size_t i = 0; i < json_array_size(deals); ++i) {
+        json_t *deal = json_array_get(deals, i);
+        if (json_object_size(deal) != 5)
+            return -1;
+        json_t *id   = json_object_get(deal, "id");
+        json_t *time = json_object_get(deal, "time");
+        json_t *type = json_object_get(deal, "type");
+        if (!json_is_integer(id) || !json_is_number(time) || !json_is_string(type))
+            return -1;
+        double time_us = json_number_value(time) * 1e6;
+        if (!(fabs(time_us) < 1e18))
+            return -1;
+        uint8_t side;
+        if (strcmp(json_string_value(type), "sell") == 0) {
+            side = SIDE_SELL;
+        } else if (strcmp(json_string_value(type), "buy") == 0) {
+            side = SIDE_BUY;
+        } else {
+            return -1;
+        }
+
+        int64_t price, amount;
+        if (get_scaled(enc, 0, json_object_get(deal, "price"), &price) < 0)
+            return -1;
+        if (get_amount(enc, 1, json_object_get(deal, "amount"), &amount) < 0)
+            return -1;
+        int64_t deal_id = json_integer_value(id);
+        int64_t deal_time = llround(time_us);
+        if (put_delta(&enc->buf, deal_id, last_id) < 0 || put_delta(&enc->buf, deal_time, last_time) < 0)
+            return -1;
+        if (put_delta(&enc->buf, price, last_price) < 0 || put_varint(&enc->buf, amount) < 0)
+            return -1;
+        if (put_byte(&enc->buf, side) < 0)
+            return -1;
+        last_id = deal_id;
+        last_time = deal_time;
+        last_price = price;
+    }
+    return 0;
+}
+
+/* [[time, open, close, high, low, volume, deal, market], ...] */
+static int encode_kline(struct encoder *enc, const json_t *params)
+{
+    json_t *market = json_array_get(json_array_get(params, 0), 7);
+    if (!json_is_string(market))
+        return -1;
+
+    if (put_byte(&enc->buf, MARKET_BIN_KLINE) < 0 || put_string(&enc->buf, json_string_value(market)) < 0)
+        return -1;
+    if (put_scales(enc, 3) < 0 || put_varint(&enc->buf, json_array_size(params)) < 0)
+        return -1;
+    int64_t last_time = 0, last_open = 0;
+    for (size_t i = 0; i < json_array_size(params); ++i) {
+        json_t *unit = json_array_get(params, i);
+        if (json_array_size(unit) != 8 || !json_is_integer(json_array_get(unit, 0)))
+            return -1;
+        json_t *unit_market = json_array_get(unit, 7);
+        if (!json_is_string(unit_market) || strcmp(json_string_value(unit_market), json_string_value(market)) != 0)
+            return -1;
+
+        int64_t time = json_integer_value(json_array_get(unit, 0));
+        int64_t prices[4], volume, deal;
+        for (size_t j = 0; j < 4; ++j) {
+            if (get_scaled(enc, 0, json_array_get(unit, j + 1), &prices[j]) < 0)
+                return -1;
+        }
+        if (get_amount(enc, 1, json_array_get(unit, 5), &volume) < 0)
+            return -1;
+        if (get_amount(enc, 2, json_array_get(unit, 6), &deal) < 0)
+            return -1;
+
+        if (put_delta(&enc->buf, time, last_time) < 0 || put_delta(&enc->buf, prices[0], last_open) < 0)
+            return -1;
+        for (size_t j = 1; j < 4; ++j) {
+            if (put_delta(&enc->buf, prices[j], prices[0]) < 0)
+                return -1;
+        }
+        if (put_varint(&enc->buf, volume) < 0 || put_varint(&enc->buf, deal) < 0)
+            return -1;
+        last_time = time;
+        last_open = prices[0];
+    }
+    return 0;
+}
+
+/* [market, price] */
+static int encode_price(struct encoder *enc, const json_t *params)
+{
+    json_t *market = json_array_get(params, 0);
+    if (json_array_size(params) != 2 || !json_is_string(market))
+        return -1;
+
+    if (put_byte(&enc->buf, MARKET_BIN_PRICE) < 0 || put_string(&enc->buf, json_string_value(market)) < 0)
+        return -1;
+    int64_t price;
+    if (put_scales(enc, 1) < 0 || get_scaled(enc, 0, json_array_get(params, 1), &price) < 0)
+        return -1;
+    if (put_varint(&enc->buf, zigzag(price)) < 0)
+        return -1;
+    return 0;
+}
+
+char *market_bin_encode(const char *method, const json_t *params, size_t *size)
+{
+    int (*encode)(struct encoder *enc, const json_t *params);
+    if (strcmp(method, "depth.update") == 0) {
+        encode = encode_depth;
+    } else if (strcmp(method, "deals.update") == 0) {
+        encode = encode_deals;
+    } else if (strcmp(method, "kline.update") == 0) {
+        encode = encode_kline;
+    } else if (strcmp(method, "price.update") == 0) {
+        encode = encode_price;
+    } else {
+        return NULL;
+    }
+    if (!json_is_array(params))
+        return NULL;
+
+    /* scales only grow, so a second pass is the last */
+    struct encoder enc;
+    memset(&enc, 0, sizeof(enc));
+    do {
+        enc.buf.len = 0;
+        enc.retry = false;
+        memset(enc.used, 0, sizeof(enc.used));
+        if (encode(&enc, params) < 0) {
+            free(enc.buf.data);
+            return NULL;
+        }
+    } while (enc.retry);
+    for (int i = 0; i < enc.field_count; ++i) {
+        enc.buf.data[enc.scale_offset + i] = enc.scale[i];
+    }
+
+    *size = enc.buf.len;
+    return enc.buf.data;
+}
+
+struct bin_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+};
+
+static int get_byte(struct bin_reader *r, uint8_t *c)
+{
+    if (r->p == r->end)
+        return -1;
+    *c = *r->p++;
+    return 0;
+}
+
+static int get_varint(struct bin_reader *r, uint64_t *num)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end)
+            return -1;
+        uint8_t c = *r->p++;
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            *num = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int get_delta(struct bin_reader *r, int64_t last, int64_t *value)
+{
+    uint64_t num;
+    if (get_varint(r, &num) < 0)
+        return -1;
+    *value = (int64_t)((uint64_t)last + (uint64_t)unzigzag(num));
+    return 0;
+}
+
+static int get_amount_value(struct bin_reader *r, int64_t *value)
+{
+    uint64_t num;
+    if (get_varint(r, &num) < 0 || num > INT64_MAX)
+        return -1;
+    *value = num;
+    return 0;
+}
+
+static int get_scale(struct bin_reader *r, int *scale)
+{
+    uint64_t num;
+    if (get_varint(r, &num) < 0 || num > SCALE_MAX)
+        return -1;
+    *scale = num;
+    return 0;
+}
+
+/* a count can not exceed the bytes left, each item takes at least one */
+static int get_count(struct bin_reader *r, uint64_t *count)
+{
+    if (get_varint(r, count) < 0 || *count > (uint64_t)(r->end - r->p))
+        return -1;
+    return 0;
+}
+
+static json_t *get_string(struct bin_reader *r)
+{
+    uint64_t len;
+    if (get_varint(r, &len) < 0 || (uint64_t)(r->end - r->p) < len)
+        return NULL;
+    json_t *str = json_stringn((const char *)r->p, len);
+    r->p += len;
+    return str;
+}
+
+static json_t *decode_decimal(int64_t mantissa, int scale)
+{
+    char digits[32];
+    char str[64];
+    uint64_t value = mantissa < 0 ? -(uint64_t)mantissa : (uint64_t)mantissa;
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n <= scale)
+        digits[n++] = '0';
+
+    int len = 0;
+    if (mantissa < 0)
+        str[len++] = '-';
+    for (int i = n - 1; i >= 0; --i) {
+        if (i == scale - 1)
+            str[len++] = '.';
+        str[len++] = digits[i];
+    }
+    str[len] = '\0';
+
+    return json_string(str);
+}
+
+static json_t *decode_depth_side(struct bin_reader *r, int price_scale, int amount_scale)
+{
+    uint64_t count;
+    if (get_count(r, &count) < 0)
+        return NULL;
+    json_t *side = json_array();
+    int64_t price = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        int64_t amount;
+        if (get_delta(r, price, &price) < 0 || get_amount_value(r, &amount) < 0) {
+            json_decref(side);
+            return NULL;
+        }
+        json_t *level = json_array();
+        json_array_append_new(level, decode_decimal(price, price_scale));
+        json_array_append_new(level, decode_decimal(amount, amount_scale));
+        json_array_append_new(side, level);
+    }
+    return side;
+}
+
+static json_t *decode_depth(struct bin_reader *r, json_t *market)
+{
+    uint8_t flags;
+    int price_scale, amount_scale;
+    if (get_byte(r, &flags) < 0 || get_scale(r, &price_scale) < 0 || get_scale(r, &amount_scale) < 0)
+        return NULL;
+
+    json_t *depth = json_object();
+    if (flags & 2) {
+        json_t *asks = decode_depth_side(r, price_scale, amount_scale);
+        if (asks == NULL)
+            goto error;
+        json_object_set_new(depth, "asks", asks);
+    }
+    if (flags & 4) {
+        json_t *bids = decode_depth_side(r, price_scale, amount_scale);
+        if (bids == NULL)
+            goto error;
+        json_object_set_new(depth, "bids", bids);
+    }
+
+    json_t *params = json_array();
+    json_array_append_new(params, json_boolean(flags & 1));
+    json_array_append_new(params, depth);
+    json_array_append(params, market);
+    return params;
+
+error:
+    json_decref(depth);
+    return NULL;
+}
+
+static json_t *decode_deals(struct bin_reader *r, json_t *market)
+{
+    int price_scale, amount_scale;
+    uint64_t count;
+    if (get_scale(r, &price_scale) < 0 || get_scale(r, &amount_scale) < 0 || get_count(r, &count) < 0)
+        return NULL;
+
+    json_t *deals = json_array();
+    int64_t id = 0, time = 0, price = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        int64_t amount;
+        uint8_t side;
+        if (get_delta(r, id, &id) < 0 || get_delta(r, time, &time) < 0 || get_delta(r, price, &price) < 0)
+            goto error;
+        if (get_amount_value(r, &amount) < 0 || get_byte(r, &side) < 0)
+            goto error;
+        if (side != SIDE_SELL && side != SIDE_BUY)
+            goto error;
+
+        json_t *deal = json_object();
+        json_object_set_new(deal, "id", json_integer(id));
+        json_object_set_new(deal, "time", json_real(time / 1e6));
+        json_object_set_new(deal, "price", decode_decimal(price, price_scale));
+        json_object_set_new(deal, "amount", decode_decimal(amount, amount_scale));
+        json_object_set_new(deal, "type", json_string(side == SIDE_SELL ? "sell" : "buy"));
+        json_array_append_new(deals, deal);
+    }
+
+    json_t *params = json_array();
+    json_array_append(params, market);
+    json_array_append_new(params, deals);
+    return params;
+
+error:
+    json_decref(deals);
+    return NULL;
+}
+
+static json_t *decode_kline(struct bin_reader *r, json_t *market)
+{
+    int price_scale, volume_scale, deal_scale;
+    uint64_t count;
+    if (get_scale(r, &price_scale) < 0 || get_scale(r, &volume_scale) < 0 || get_scale(r, &deal_scale) < 0)
+        return NULL;
+    if (get_count(r, &count) < 0)
+        return NULL;
+
+    json_t *params = json_array();
+    int64_t time = 0, open = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        int64_t prices[4], volume, deal;
+        if (get_delta(r, time, &time) < 0 || get_delta(r, open, &open) < 0)
+            goto error;
+        prices[0] = open;
+        for (size_t j = 1; j < 4; ++j) {
+            if (get_delta(r, open, &prices[j]) < 0)
+                goto error;
+        }
+        if (get_amount_value(r, &volume) < 0 || get_amount_value(r, &deal) < 0)
+            goto error;
+
+        json_t *unit = json_array();
+        json_array_append_new(unit, json_integer(time));
+        for (size_t j = 0; j < 4; ++j) {
+            json_array_append_new(unit, decode_decimal(prices[j], price_scale));
+        }
+        json_array_append_new(unit, decode_decimal(volume, volume_scale));
+        json_array_append_new(unit, decode_decimal(deal, deal_scale));
+        json_array_append(unit, market);
+        json_array_append_new(params, unit);
+    }
+    return params;
+
+error:
+    json_decref(params);
+    return NULL;
+}
+
+static json_t *decode_price(struct bin_reader *r, json_t *market)
+{
+    int scale;
+    int64_t price;
+    if (get_scale(r, &scale) < 0 || get_delta(r, 0, &price) < 0)
+        return NULL;
+
+    json_t *params = json_array();
+    json_array_append(params, market);
+    json_array_append_new(params, decode_decimal(price, scale));
+    return params;
+}
+
+json_t *market_bin_decode(const void *data, size_t size)
+{
+    struct bin_reader r = { .p = data, .end = (const uint8_t *)data + size };
+    uint8_t type;
+    if (get_byte(&r, &type) < 0)
+        return NULL;
+    json_t *market = get_string(&r);
+    if (market == NULL)
+        return NULL;
+
+    const char *method;
+    json_t *params;
+    switch (type) {
+    case MARKET_BIN_DEPTH:
+        method = "depth.update";
+        params = decode_depth(&r, market);
+        break;
+    case MARKET_BIN_DEALS:
+        method = "deals.update";
+        params = decode_deals(&r, market);
+        break;
+    case MARKET_BIN_KLINE:
+        method = "kline.update";
+        params = decode_kline(&r, market);
+        break;
+    case MARKET_BIN_PRICE:
+        method = "price.update";
+        params = decode_price(&r, market);
+        break;
+    default:
+        params = NULL;
+        break;
+    }
+    json_decref(market);
+    if (params == NULL)
+        return NULL;
+    if (r.p != r.end) {
+        json_decref(params);
+        return NULL;
+    }
+
+    json_t *notify = json_object();
+    json_object_set_new(notify, "method", json_string(method));
+    json_object_set_new(notify, "params", params);
+    json_object_set_new(notify, "id", json_null());
+    return notify;
+}
@@ -0,0 +1,47 @@
+/*
+ * Description: compact binary market data notify for websocket clients
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _UT_MARKET_BIN_H_
+# define _UT_MARKET_BIN_H_
+
+# include <stddef.h>
+# include <jansson.h>
+
+/*
+ * Message layout, numbers are varints, signed ones zigzag varints:
+ *   type           one byte, MARKET_BIN_*
+ *   market         varint length + bytes
+ *   depth          flags: bit 0 clean, bit 1 asks, bit 2 bids present
+ *                  price scale, amount scale
+ *                  asks then bids: count + (price, amount) levels
+ *   deals          price scale, amount scale
+ *                  count + (id, time in microseconds, price, amount, side)
+ *                  side 1 is sell, 2 is buy
+ *   kline          price scale, volume scale, deal scale
+ *                  count + (time, open, close, high, low, volume, deal)
+ *   price          scale, price
+ *
+ * A decimal is sent as the integer value * 10^scale, the scale of a field
+ * is the largest of the message so "8000.1" beside "8000.12" decodes as
+ * "8000.10". Prices, ids and times are signed deltas from the same field
+ * of the previous level, deal or kline, the first from 0, except close,
+ * high and low which are deltas from the open of their kline. Amounts,
+ * volumes and deals are plain, a depth diff level with amount 0 is removed.
+ */
+
+# define MARKET_BIN_DEPTH       1
+# define MARKET_BIN_DEALS       2
+# define MARKET_BIN_KLINE       3
+# define MARKET_BIN_PRICE       4
+
+/* the binary form of a depth, deals, kline or price update notify params,
+ * NULL if the method has none or a value does not fit. return malloc'ed
+ * buffer, free with free() */
+char *market_bin_encode(const char *method, const json_t *params, size_t *size);
+/* the notify back as {"method", "params", "id": null} */
+json_t *market_bin_decode(const void *data, size_t size);
+
+# endif
+
@@ -51,3 +51,25 @@ bool is_table_exists(MYSQL *conn, const char *table)
     return false;
 }
 
+
+bool is_column_exists(MYSQL *conn, const char *table, const char *column)
+{
+    sds sql = sdsempty();
+    sql = sdscatprintf(sql, "SHOW COLUMNS FROM `%s` LIKE '%s'", table, column);
+    log_trace("exec sql: %s", sql);
+    int ret = mysql_real_query(conn, sql, sdslen(sql));
+    if (ret != 0) {
+        log_error("exec sql: %s fail: %d %s", sql, mysql_errno(conn), mysql_error(conn));
+        sdsfree(sql);
+        return false;
+    }
+    sdsfree(sql);
+
+    MYSQL_RES *result = mysql_store_result(conn);
+    size_t num_rows = mysql_num_rows(result);
+    mysql_free_result(result);
+    if (num_rows == 1)
+        return true;
+
+    return false;
+}
@@ -12,6 +12,7 @@
 
 MYSQL *mysql_connect(mysql_cfg *cfg);
 bool is_table_exists(MYSQL *conn, const char *table);
+bool is_column_exists(MYSQL *conn, const char *table, const char *column);
 
 # endif
 
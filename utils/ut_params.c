@@ -0,0 +1,638 @@
+/*
+ * Description: in place tokenizer for rpc json params
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+
+# include "ut_params.h"
+# include "ut_rpc_bin.h"
+
+struct scanner {
+    const char *p;
+    const char *end;
+};
+
+static void skip_space(struct scanner *s)
+{
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r'))
+        s->p++;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* p points after "\u" */
+static int32_t get_ucs2(const char *p)
+{
+    int32_t code = 0;
+    for (int i = 0; i < 4; ++i) {
+        int v = hex_value(p[i]);
+        if (v < 0)
+            return -1;
+        code = (code << 4) | v;
+    }
+    return code;
+}
+
+/* p points at the backslash, return the code point and the escape length */
+static int32_t get_unicode_escape(const char *p, const char *end, int *len)
+{
+    if (end - p < 6)
+        return -1;
+    int32_t code = get_ucs2(p + 2);
+    if (code <= 0)
+        return -1;
+    *len = 6;
+    if (code >= 0xdc00 && code <= 0xdfff)
+        return -1;
+    if (code >= 0xd800 && code <= 0xdbff) {
+        if (end - p < 12 || p[6] != '\\' || p[7] != 'u')
+            return -1;
+        int32_t low = get_ucs2(p + 8);
+        if (low < 0xdc00 || low > 0xdfff)
+            return -1;
+        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        *len = 12;
+    }
+    return code;
+}
+
+/* length of a valid utf-8 sequence, 0 if invalid */
+static int utf8_len(const unsigned char *p, const unsigned char *end)
+{
+    int n;
+    uint32_t code;
+    if (p[0] >= 0xc2 && p[0] <= 0xdf) {
+        n = 2;
+        code = p[0] & 0x1f;
+    } else if (p[0] >= 0xe0 && p[0] <= 0xef) {
+        n = 3;
+        code = p[0] & 0x0f;
+    } else if (p[0] >= 0xf0 && p[0] <= 0xf4) {
+        n = 4;
+        code = p[0] & 0x07;
+    } else {
+        return 0;
+    }
+    if (end - p < n)
+        return 0;
+    for (int i = 1; i < n; ++i) {
+        if ((p[i] & 0xc0) != 0x80)
+            return 0;
+        code = (code << 6) | (p[i] & 0x3f);
+    }
+    if ((n == 3 && code < 0x800) || (n == 4 && code < 0x10000))
+        return 0;
+    if ((code >= 0xd800 && code <= 0xdfff) || code > 0x10ffff)
+        return 0;
+    return n;
+}
+
+static int scan_string(struct scanner *s, bool *escaped)
+{
+    s->p++;
+    while (s->p < s->end) {
+        unsigned char c = *s->p;
+        if (c == '"') {
+            s->p++;
+            return 0;
+        }
+        if (c == '\\') {
+            *escaped = true;
+            if (s->end - s->p < 2)
+                return -__LINE__;
+            char e = s->p[1];
+            if (e == 'u') {
+                int len;
+                if (get_unicode_escape(s->p, s->end, &len) < 0)
+                    return -__LINE__;
+                s->p += len;
+            } else if (e == '"' || e == '\\' || e == '/' || e == 'b' || e == 'f' || e == 'n' || e == 'r' || e == 't') {
+                s->p += 2;
+            } else {
+                return -__LINE__;
+            }
+        } else if (c < 0x20) {
+            return -__LINE__;
+        } else if (c < 0x80) {
+            s->p++;
+        } else {
+            int n = utf8_len((const unsigned char *)s->p, (const unsigned char *)s->end);
+            if (n == 0)
+                return -__LINE__;
+            s->p += n;
+        }
+    }
+    return -__LINE__;
+}
+
+static int parse_int(const char *p, size_t len, int64_t *val)
+{
+    bool negative = false;
+    if (len && *p == '-') {
+        negative = true;
+        p++;
+        len--;
+    }
+    if (len == 0)
+        return -__LINE__;
+
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    uint64_t num = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (p[i] < '0' || p[i] > '9')
+            return -__LINE__;
+        uint64_t digit = p[i] - '0';
+        if (num > (limit - digit) / 10)
+            return -__LINE__;
+        num = num * 10 + digit;
+    }
+    *val = negative ? (int64_t)(0 - num) : (int64_t)num;
+    return 0;
+}
+
+static bool is_digit(const struct scanner *s)
+{
+    return s->p < s->end && *s->p >= '0' && *s->p <= '9';
+}
+
+static int scan_number(struct scanner *s, uint8_t *type)
+{
+    const char *start = s->p;
+    *type = PARAMS_TYPE_INTEGER;
+    if (*s->p == '-')
+        s->p++;
+    if (!is_digit(s))
+        return -__LINE__;
+    if (*s->p == '0') {
+        s->p++;
+    } else {
+        while (is_digit(s))
+            s->p++;
+    }
+    if (s->p < s->end && *s->p == '.') {
+        *type = PARAMS_TYPE_REAL;
+        s->p++;
+        if (!is_digit(s))
+            return -__LINE__;
+        while (is_digit(s))
+            s->p++;
+    }
+    if (s->p < s->end && (*s->p == 'e' || *s->p == 'E')) {
+        *type = PARAMS_TYPE_REAL;
+        s->p++;
+        if (s->p < s->end && (*s->p == '+' || *s->p == '-'))
+            s->p++;
+        if (!is_digit(s))
+            return -__LINE__;
+        while (is_digit(s))
+            s->p++;
+    }
+
+    /* out of range integers are rejected the same as jansson does */
+    if (*type == PARAMS_TYPE_INTEGER) {
+        int64_t val;
+        if (parse_int(start, s->p - start, &val) < 0)
+            return -__LINE__;
+    }
+    return 0;
+}
+
+static int scan_literal(struct scanner *s, const char *literal, size_t len)
+{
+    if ((size_t)(s->end - s->p) < len || memcmp(s->p, literal, len) != 0)
+        return -__LINE__;
+    s->p += len;
+    return 0;
+}
+
+static int scan_value(struct scanner *s, int depth, uint8_t *type, bool *escaped)
+{
+    if (depth > PARAMS_MAX_DEPTH)
+        return -__LINE__;
+    skip_space(s);
+    if (s->p >= s->end)
+        return -__LINE__;
+
+    uint8_t child_type;
+    bool child_escaped;
+    switch (*s->p) {
+    case '"':
+        *type = PARAMS_TYPE_STRING;
+        return scan_string(s, escaped);
+    case 't':
+        *type = PARAMS_TYPE_TRUE;
+        return scan_literal(s, "true", 4);
+    case 'f':
+        *type = PARAMS_TYPE_FALSE;
+        return scan_literal(s, "false", 5);
+    case 'n':
+        *type = PARAMS_TYPE_NULL;
+        return scan_literal(s, "null", 4);
+    case '[':
+        *type = PARAMS_TYPE_ARRAY;
+        s->p++;
+        skip_space(s);
+        if (s->p < s->end && *s->p == ']') {
+            s->p++;
+            return 0;
+        }
+        while (true) {
+            if (scan_value(s, depth + 1, &child_type, &child_escaped) < 0)
+                return -__LINE__;
+            skip_space(s);
+            if (s->p >= s->end)
+                return -__LINE__;
+            if (*s->p == ']') {
+                s->p++;
+                return 0;
+            }
+            if (*s->p++ != ',')
+                return -__LINE__;
+        }
+    case '{':
+        *type = PARAMS_TYPE_OBJECT;
+        s->p++;
+        skip_space(s);
+        if (s->p < s->end && *s->p == '}') {
+            s->p++;
+            return 0;
+        }
+        while (true) {
+            skip_space(s);
+            if (s->p >= s->end || *s->p != '"')
+                return -__LINE__;
+            if (scan_string(s, &child_escaped) < 0)
+                return -__LINE__;
+            skip_space(s);
+            if (s->p >= s->end || *s->p++ != ':')
+                return -__LINE__;
+            if (scan_value(s, depth + 1, &child_type, &child_escaped) < 0)
+                return -__LINE__;
+            skip_space(s);
+            if (s->p >= s->end)
+                return -__LINE__;
+            if (*s->p == '}') {
+                s->p++;
+                return 0;
+            }
+            if (*s->p++ != ',')
+                return -__LINE__;
+        }
+    default:
+        return scan_number(s, type);
+    }
+}
+
+static int add_item(params_t *params, struct scanner *s)
+{
+    if (params->count >= PARAMS_MAX_SIZE)
+        return -__LINE__;
+    skip_space(s);
+    params_item *item = &params->items[params->count];
+    const char *start = s->p;
+    bool escaped = false;
+    if (scan_value(s, 1, &item->type, &escaped) < 0)
+        return -__LINE__;
+    item->escaped = escaped;
+    item->offset = start - params->data;
+    item->len = s->p - start;
+    params->count++;
+    return 0;
+}
+
+int params_parse(params_t *params, const char *data, size_t size)
+{
+    if (size > UINT32_MAX)
+        return -__LINE__;
+    params->data   = data;
+    params->size   = size;
+    params->json   = NULL;
+    params->binary = false;
+    params->count  = 0;
+
+    struct scanner s = { .p = data, .end = data + size };
+    skip_space(&s);
+    if (s.p >= s.end || *s.p++ != '[')
+        return -__LINE__;
+    skip_space(&s);
+    if (s.p < s.end && *s.p == ']') {
+        s.p++;
+    } else {
+        while (true) {
+            if (add_item(params, &s) < 0)
+                return -__LINE__;
+            skip_space(&s);
+            if (s.p >= s.end)
+                return -__LINE__;
+            if (*s.p == ']') {
+                s.p++;
+                break;
+            }
+            if (*s.p++ != ',')
+                return -__LINE__;
+        }
+    }
+    skip_space(&s);
+    if (s.p != s.end)
+        return -__LINE__;
+
+    return 0;
+}
+
+int params_from_json(params_t *params, json_t *json)
+{
+    if (!json_is_array(json))
+        return -__LINE__;
+    params->data   = NULL;
+    params->size   = 0;
+    params->json   = json;
+    params->binary = false;
+    params->count  = json_array_size(json);
+    return 0;
+}
+
+size_t params_size(const params_t *params)
+{
+    return params->count;
+}
+
+int params_type(const params_t *params, size_t index)
+{
+    if (index >= params->count)
+        return -1;
+    if (params->json == NULL)
+        return params->items[index].type;
+
+    switch (json_typeof(json_array_get(params->json, index))) {
+    case JSON_OBJECT:
+        return PARAMS_TYPE_OBJECT;
+    case JSON_ARRAY:
+        return PARAMS_TYPE_ARRAY;
+    case JSON_STRING:
+        return PARAMS_TYPE_STRING;
+    case JSON_INTEGER:
+        return PARAMS_TYPE_INTEGER;
+    case JSON_REAL:
+        return PARAMS_TYPE_REAL;
+    case JSON_TRUE:
+        return PARAMS_TYPE_TRUE;
+    case JSON_FALSE:
+        return PARAMS_TYPE_FALSE;
+    default:
+        return PARAMS_TYPE_NULL;
+    }
+}
+
+int params_get_int(const params_t *params, size_t index, int64_t *val)
+{
+    if (!params_is_integer(params, index))
+        return -__LINE__;
+    if (params->json) {
+        *val = json_integer_value(json_array_get(params->json, index));
+        return 0;
+    }
+    const params_item *item = &params->items[index];
+    if (params->binary) {
+        *val = item->num;
+        return 0;
+    }
+    return parse_int(params->data + item->offset, item->len, val);
+}
+
+int params_get_number(const params_t *params, size_t index, double *val)
+{
+    if (!params_is_number(params, index))
+        return -__LINE__;
+    if (params->json) {
+        *val = json_number_value(json_array_get(params->json, index));
+        return 0;
+    }
+    const params_item *item = &params->items[index];
+    if (params->binary) {
+        if (item->type == PARAMS_TYPE_INTEGER)
+            *val = item->num;
+        else
+            memcpy(val, &item->num, sizeof(*val));
+        return 0;
+    }
+    char buf[PARAMS_DECIMAL_MAX_LEN];
+    if (item->len >= sizeof(buf))
+        return -__LINE__;
+    memcpy(buf, params->data + item->offset, item->len);
+    buf[item->len] = '\0';
+    *val = strtod(buf, NULL);
+    return 0;
+}
+
+int params_get_strview(const params_t *params, size_t index, const char **str, size_t *len)
+{
+    if (!params_is_string(params, index))
+        return -__LINE__;
+    if (params->json) {
+        json_t *node = json_array_get(params->json, index);
+        *str = json_string_value(node);
+        *len = json_string_length(node);
+        return 0;
+    }
+    const params_item *item = &params->items[index];
+    if (params->binary) {
+        if (item->decimal)
+            return -__LINE__;
+        *str = params->data + item->offset;
+        *len = item->len;
+        return 0;
+    }
+    if (item->escaped)
+        return -__LINE__;
+    *str = params->data + item->offset + 1;
+    *len = item->len - 2;
+    return 0;
+}
+
+static size_t utf8_encode(int32_t code, char *buf)
+{
+    if (code < 0x80) {
+        buf[0] = code;
+        return 1;
+    } else if (code < 0x800) {
+        buf[0] = 0xc0 | (code >> 6);
+        buf[1] = 0x80 | (code & 0x3f);
+        return 2;
+    } else if (code < 0x10000) {
+        buf[0] = 0xe0 | (code >> 12);
+        buf[1] = 0x80 | ((code >> 6) & 0x3f);
+        buf[2] = 0x80 | (code & 0x3f);
+        return 3;
+    }
+    buf[0] = 0xf0 | (code >> 18);
+    buf[1] = 0x80 | ((code >> 12) & 0x3f);
+    buf[2] = 0x80 | ((code >> 6) & 0x3f);
+    buf[3] = 0x80 | (code & 0x3f);
+    return 4;
+}
+
+int params_get_str(const params_t *params, size_t index, char *buf, size_t size)
+{
+    const char *str;
+    size_t len;
+    if (params->binary && params_is_string(params, index) && params->items[index].decimal) {
+        char tmp[64];
+        const params_item *item = &params->items[index];
+        len = rpc_bin_decimal_str(tmp, item->scale, item->num);
+        if (len >= size)
+            return -__LINE__;
+        memcpy(buf, tmp, len + 1);
+        return len;
+    }
+    if (params->json || !params_is_string(params, index) || !params->items[index].escaped) {
+        if (params_get_strview(params, index, &str, &len) < 0)
+            return -__LINE__;
+        if (len >= size)
+            return -__LINE__;
+        memcpy(buf, str, len);
+        buf[len] = '\0';
+        return len;
+    }
+
+    /* the string is already validated by params_parse */
+    const params_item *item = &params->items[index];
+    const char *p = params->data + item->offset + 1;
+    const char *end = params->data + item->offset + item->len - 1;
+    size_t n = 0;
+    while (p < end) {
+        char tmp[4];
+        size_t tmp_len;
+        if (*p != '\\') {
+            tmp[0] = *p++;
+            tmp_len = 1;
+        } else if (p[1] == 'u') {
+            int escape_len;
+            int32_t code = get_unicode_escape(p, end, &escape_len);
+            if (code < 0)
+                return -__LINE__;
+            tmp_len = utf8_encode(code, tmp);
+            p += escape_len;
+        } else {
+            switch (p[1]) {
+            case 'b': tmp[0] = '\b'; break;
+            case 'f': tmp[0] = '\f'; break;
+            case 'n': tmp[0] = '\n'; break;
+            case 'r': tmp[0] = '\r'; break;
+            case 't': tmp[0] = '\t'; break;
+            default:  tmp[0] = p[1]; break;
+            }
+            tmp_len = 1;
+            p += 2;
+        }
+        if (n + tmp_len >= size)
+            return -__LINE__;
+        memcpy(buf + n, tmp, tmp_len);
+        n += tmp_len;
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+mpd_t *params_get_decimal(const params_t *params, size_t index, int prec)
+{
+    char buf[PARAMS_DECIMAL_MAX_LEN];
+    if (params->binary && params_is_string(params, index) && params->items[index].decimal) {
+        /* the same value mpd_set_string gives for the plain string */
+        const params_item *item = &params->items[index];
+        mpd_t *result = mpd_new(&mpd_ctx);
+        mpd_set_i64(result, item->num, &mpd_ctx);
+        result->exp = -(mpd_ssize_t)item->scale;
+        if (prec) {
+            mpd_rescale(result, result, -prec, &mpd_ctx);
+        }
+        return result;
+    }
+    if (params->json) {
+        if (!params_is_string(params, index))
+            return NULL;
+        return decimal(json_string_value(json_array_get(params->json, index)), prec);
+    }
+    if (params_get_str(params, index, buf, sizeof(buf)) < 0)
+        return NULL;
+    return decimal(buf, prec);
+}
+
+static json_t *binary_item_json(const params_t *params, const params_item *item)
+{
+    switch (item->type) {
+    case PARAMS_TYPE_NULL:
+        return json_null();
+    case PARAMS_TYPE_TRUE:
+        return json_true();
+    case PARAMS_TYPE_FALSE:
+        return json_false();
+    case PARAMS_TYPE_INTEGER:
+        return json_integer(item->num);
+    case PARAMS_TYPE_REAL:
+        {
+            double value;
+            memcpy(&value, &item->num, sizeof(value));
+            return json_real(value);
+        }
+    case PARAMS_TYPE_STRING:
+        if (item->decimal) {
+            char buf[64];
+            rpc_bin_decimal_str(buf, item->scale, item->num);
+            return json_string(buf);
+        }
+        return json_stringn(params->data + item->offset, item->len);
+    default:
+        return rpc_bin_decode(params->data + item->offset, item->len);
+    }
+}
+
+json_t *params_get_json(const params_t *params, size_t index)
+{
+    if (index >= params->count)
+        return NULL;
+    if (params->json)
+        return json_incref(json_array_get(params->json, index));
+    const params_item *item = &params->items[index];
+    if (params->binary)
+        return binary_item_json(params, item);
+    return json_loadb(params->data + item->offset, item->len, JSON_DECODE_ANY, NULL);
+}
+
+json_t *params_to_json(const params_t *params)
+{
+    if (params->json)
+        return json_incref(params->json);
+    if (!params->binary)
+        return json_loadb(params->data, params->size, 0, NULL);
+
+    json_t *json = json_array();
+    for (size_t i = 0; i < params->count; ++i) {
+        json_t *value = binary_item_json(params, &params->items[i]);
+        if (value == NULL) {
+            json_decref(json);
+            return NULL;
+        }
+        json_array_append_new(json, value);
+    }
+    return json;
+}
+
+const char *params_raw(const params_t *params, size_t *len)
+{
+    if (params->json || params->binary)
+        return NULL;
+    *len = params->size;
+    return params->data;
+}
+
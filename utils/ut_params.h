@@ -0,0 +1,102 @@
+/*
+ * Description: in place tokenizer for rpc json params
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _UT_PARAMS_H_
+# define _UT_PARAMS_H_
+
+# include <stddef.h>
+# include <stdint.h>
+# include <stdbool.h>
+# include <jansson.h>
+
+# include "ut_decimal.h"
+
+/*
+ * params_parse validates a json array and records where each top level
+ * element lives in the original buffer, nothing is allocated and the
+ * buffer must outlive the params. Nested arrays and objects are
+ * validated and skipped, use params_get_json for them.
+ *
+ * params_from_json wraps an already decoded jansson array, so handlers
+ * use the same accessors whatever the body encoding was. Binary request
+ * bodies are filled in by rpc_params_decode: numbers are kept decoded,
+ * strings point at their raw bytes and decimals keep scale and mantissa.
+ */
+
+# define PARAMS_MAX_SIZE        32
+# define PARAMS_MAX_DEPTH       32
+# define PARAMS_DECIMAL_MAX_LEN 128
+
+# define PARAMS_TYPE_NULL       0
+# define PARAMS_TYPE_TRUE       1
+# define PARAMS_TYPE_FALSE      2
+# define PARAMS_TYPE_INTEGER    3
+# define PARAMS_TYPE_REAL       4
+# define PARAMS_TYPE_STRING     5
+# define PARAMS_TYPE_ARRAY      6
+# define PARAMS_TYPE_OBJECT     7
+
+typedef struct params_item {
+    uint8_t     type;
+    uint8_t     escaped;
+    uint8_t     decimal;
+    uint8_t     scale;
+    uint32_t    offset;
+    uint32_t    len;
+    int64_t     num;
+} params_item;
+
+typedef struct params_t {
+    const char  *data;
+    size_t      size;
+    json_t      *json;
+    bool        binary;
+    size_t      count;
+    params_item items[PARAMS_MAX_SIZE];
+} params_t;
+
+int params_parse(params_t *params, const char *data, size_t size);
+int params_from_json(params_t *params, json_t *json);
+
+size_t params_size(const params_t *params);
+/* -1 if index out of range */
+int params_type(const params_t *params, size_t index);
+
+static inline bool params_is_integer(const params_t *params, size_t index)
+{
+    return params_type(params, index) == PARAMS_TYPE_INTEGER;
+}
+
+static inline bool params_is_number(const params_t *params, size_t index)
+{
+    int type = params_type(params, index);
+    return type == PARAMS_TYPE_INTEGER || type == PARAMS_TYPE_REAL;
+}
+
+static inline bool params_is_string(const params_t *params, size_t index)
+{
+    return params_type(params, index) == PARAMS_TYPE_STRING;
+}
+
+/* return 0 on success, < 0 on type mismatch */
+int params_get_int(const params_t *params, size_t index, int64_t *val);
+int params_get_number(const params_t *params, size_t index, double *val);
+
+/* view into the buffer without quotes, fail if the string has escapes */
+int params_get_strview(const params_t *params, size_t index, const char **str, size_t *len);
+/* unescaped and null terminated copy, return the length */
+int params_get_str(const params_t *params, size_t index, char *buf, size_t size);
+/* same as decimal(), NULL if not a decimal string */
+mpd_t *params_get_decimal(const params_t *params, size_t index, int prec);
+
+/* adapters for code still on jansson, return new reference */
+json_t *params_get_json(const params_t *params, size_t index);
+json_t *params_to_json(const params_t *params);
+
+/* the array text, NULL when wrapping a jansson array or a binary body */
+const char *params_raw(const params_t *params, size_t *len);
+
+# endif
+
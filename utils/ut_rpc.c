@@ -9,6 +9,7 @@
 # include "ut_rpc.h"
 # include "ut_crc32.h"
 # include "ut_misc.h"
+# include "nw_shm.h"
 
 int rpc_decode(nw_ses *ses, void *data, size_t max)
 {
@@ -22,15 +23,24 @@ int rpc_decode(nw_ses *ses, void *data, size_t max)
     if (max < pkg_size)
         return 0;
 
-    uint32_t crc32 = le32toh(pkg->crc32);
-    pkg->crc32 = 0;
-    if (crc32 != generate_crc32c(data, pkg_size))
-        return -3;
-    pkg->crc32 = crc32;
+    /* the shm rings never leave the host memory, skip the crc */
+    if (!(ses->shm && nw_shm_reading(ses->shm))) {
+        uint32_t crc_size = pkg_size;
+        if (le16toh(pkg->pkg_type) & RPC_PKG_FLAG_NO_BODY_CRC) {
+            if (!(ses->peer_flags & RPC_PEER_SKIP_BODY_CRC))
+                return -4;
+            crc_size = RPC_PKG_HEAD_SIZE + le16toh(pkg->ext_size);
+        }
+        uint32_t crc32 = le32toh(pkg->crc32);
+        pkg->crc32 = 0;
+        if (crc32 != generate_crc32c(data, crc_size))
+            return -3;
+        pkg->crc32 = crc32;
+    }
 
     pkg->magic     = le32toh(pkg->magic);
     pkg->command   = le32toh(pkg->command);
-    pkg->pkg_type  = le16toh(pkg->pkg_type);
+    pkg->pkg_type  = le16toh(pkg->pkg_type) & ~RPC_PKG_FLAG_NO_BODY_CRC;
     pkg->result    = le32toh(pkg->result);
     pkg->sequence  = le32toh(pkg->sequence);
     pkg->req_id    = le64toh(pkg->req_id);
@@ -40,7 +50,34 @@ int rpc_decode(nw_ses *ses, void *data, size_t max)
     return pkg_size;
 }
 
-int rpc_pack(rpc_pkg *pkg, void **data, uint32_t *size)
+/* crc_size 0 leaves crc32 empty */
+static void pack_to(rpc_pkg *pkg, void *buf, uint32_t pkg_size, uint32_t crc_size)
+{
+    memcpy(buf, pkg, RPC_PKG_HEAD_SIZE);
+    if (pkg->ext_size)
+        memcpy(buf + RPC_PKG_HEAD_SIZE, pkg->ext, pkg->ext_size);
+    if (pkg->body_size)
+        memcpy(buf + RPC_PKG_HEAD_SIZE + pkg->ext_size, pkg->body, pkg->body_size);
+
+    pkg = buf;
+    pkg->magic     = htole32(RPC_PKG_MAGIC);
+    pkg->command   = htole32(pkg->command);
+    pkg->pkg_type  = htole16(pkg->pkg_type);
+    pkg->result    = htole32(pkg->result);
+    pkg->sequence  = htole32(pkg->sequence);
+    pkg->req_id    = htole64(pkg->req_id);
+    pkg->body_size = htole32(pkg->body_size);
+    pkg->ext_size  = htole16(pkg->ext_size);
+
+    pkg->crc32 = 0;
+    if (crc_size) {
+        if (crc_size < pkg_size)
+            pkg->pkg_type |= htole16(RPC_PKG_FLAG_NO_BODY_CRC);
+        pkg->crc32 = htole32(generate_crc32c(buf, crc_size));
+    }
+}
+
+static int pack(rpc_pkg *pkg, void **data, uint32_t *size, bool body_crc)
 {
     static void *send_buf;
     static size_t send_buf_size;
@@ -59,38 +96,56 @@ int rpc_pack(rpc_pkg *pkg, void **data, uint32_t *size)
         }
     }
 
-    memcpy(send_buf, pkg, RPC_PKG_HEAD_SIZE);
-    if (pkg->ext_size)
-        memcpy(send_buf + RPC_PKG_HEAD_SIZE, pkg->ext, pkg->ext_size);
-    if (pkg->body_size)
-        memcpy(send_buf + RPC_PKG_HEAD_SIZE + pkg->ext_size, pkg->body, pkg->body_size);
-
-    pkg = send_buf;
-    pkg->magic     = htole32(RPC_PKG_MAGIC);
-    pkg->command   = htole32(pkg->command);
-    pkg->pkg_type  = htole16(pkg->pkg_type);
-    pkg->result    = htole32(pkg->result);
-    pkg->sequence  = htole32(pkg->sequence);
-    pkg->req_id    = htole64(pkg->req_id);
-    pkg->body_size = htole32(pkg->body_size);
-    pkg->ext_size  = htole16(pkg->ext_size);
-
-    pkg->crc32 = 0;
-    pkg->crc32 = htole32(generate_crc32c(send_buf, pkg_size));
-
+    uint32_t crc_size = body_crc ? pkg_size : RPC_PKG_HEAD_SIZE + pkg->ext_size;
+    pack_to(pkg, send_buf, pkg_size, crc_size);
     *data = send_buf;
     *size = pkg_size;
 
     return 0;
 }
 
+int rpc_pack(rpc_pkg *pkg, void **data, uint32_t *size)
+{
+    return pack(pkg, data, size, true);
+}
+
 int rpc_send(nw_ses *ses, rpc_pkg *pkg)
 {
+    /* build the package right in the shm ring, no crc and no copies */
+    if (ses->shm && pkg->body_size <= RPC_PKG_MAX_BODY_SIZE) {
+        uint32_t pkg_size = RPC_PKG_HEAD_SIZE + pkg->ext_size + pkg->body_size;
+        void *buf = nw_shm_reserve(ses->shm, pkg_size);
+        if (buf) {
+            pack_to(pkg, buf, pkg_size, 0);
+            nw_shm_commit(ses->shm, pkg_size);
+            return 0;
+        }
+    }
+
+    /* heartbeats carry the negotiation, they always have the full crc */
+    bool body_crc = !(ses->peer_flags & RPC_PEER_SKIP_BODY_CRC) || pkg->command == RPC_CMD_HEARTBEAT;
     void *data;
     uint32_t size;
-    int ret = rpc_pack(pkg, &data, &size);
+    int ret = pack(pkg, &data, &size, body_crc);
     if (ret < 0)
         return ret;
     return nw_ses_send(ses, data, size);
 }
 
+bool rpc_peer_is_local(nw_addr_t *addr)
+{
+    switch (addr->family) {
+    case AF_UNIX:
+        return true;
+    case AF_INET:
+        return (ntohl(addr->in.sin_addr.s_addr) >> 24) == 127;
+    case AF_INET6:
+        if (IN6_IS_ADDR_LOOPBACK(&addr->in6.sin6_addr))
+            return true;
+        if (IN6_IS_ADDR_V4MAPPED(&addr->in6.sin6_addr))
+            return addr->in6.sin6_addr.s6_addr[12] == 127;
+        return false;
+    }
+    return false;
+}
+
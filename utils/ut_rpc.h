@@ -7,6 +7,7 @@
 # define _UT_RPC_H_
 
 # include <stdint.h>
+# include <stdbool.h>
 # include "nw_ses.h"
 
 # define RPC_PKG_MAGIC 0x70656562
@@ -15,6 +16,17 @@
 # define RPC_PKG_TYPE_REPLY   1
 # define RPC_PKG_TYPE_PUSH    2
 
+/* high bit of pkg_type, crc32 covers the head and ext only. sent only to
+ * peers that agreed with RPC_PEER_SKIP_BODY_CRC in the heartbeat */
+# define RPC_PKG_FLAG_NO_BODY_CRC 0x8000
+
+/* nw_ses peer_flags */
+# define RPC_PEER_SKIP_BODY_CRC   0x1
+
+/* body encoding, carried in the first ext byte, json if ext is empty */
+# define RPC_ENCODING_JSON    0
+# define RPC_ENCODING_BINARY  1
+
 # pragma pack(1)
 typedef struct rpc_pkg {
     uint32_t magic;
@@ -37,6 +49,8 @@ typedef struct rpc_pkg {
 int rpc_decode(nw_ses *ses, void *data, size_t max);
 int rpc_pack(rpc_pkg *pkg, void **data, uint32_t *size);
 int rpc_send(nw_ses *ses, rpc_pkg *pkg);
+/* unix socket or loopback, where skipping the body crc is allowed */
+bool rpc_peer_is_local(nw_addr_t *addr);
 
 # define RPC_CMD_HEARTBEAT 0
 
@@ -46,6 +60,12 @@ int rpc_send(nw_ses *ses, rpc_pkg *pkg);
 # define RPC_HEARTBEAT_TIMEOUT_MAX      600
 
 # define RPC_HEARTBEAT_TYPE_TIMEOUT     1
+# define RPC_HEARTBEAT_TYPE_ENCODING    2
+# define RPC_HEARTBEAT_TYPE_FEATURES    3
+
+/* RPC_HEARTBEAT_TYPE_FEATURES bits, the client asks, the server echoes
+ * what it accepts */
+# define RPC_FEATURE_SKIP_BODY_CRC      0x1
 
 # endif
 
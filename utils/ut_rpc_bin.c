@@ -0,0 +1,787 @@
+/*
+ * Description: compact binary rpc body encoding
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+# include <stdint.h>
+# include <endian.h>
+
+# include "ut_rpc_bin.h"
+# include "ut_rpc_cmd.h"
+# include "ut_params.h"
+
+struct bin_buf {
+    char   *data;
+    size_t  len;
+    size_t  cap;
+};
+
+static int buf_reserve(struct bin_buf *buf, size_t size)
+{
+    if (buf->len + size <= buf->cap)
+        return 0;
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->len + size)
+        cap *= 2;
+    char *data = realloc(buf->data, cap);
+    if (data == NULL)
+        return -1;
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+static int buf_append(struct bin_buf *buf, const void *data, size_t size)
+{
+    if (buf_reserve(buf, size) < 0)
+        return -1;
+    memcpy(buf->data + buf->len, data, size);
+    buf->len += size;
+    return 0;
+}
+
+static int put_tag(struct bin_buf *buf, uint8_t tag)
+{
+    return buf_append(buf, &tag, 1);
+}
+
+static int put_varint(struct bin_buf *buf, uint64_t num)
+{
+    if (buf_reserve(buf, 10) < 0)
+        return -1;
+    uint8_t *p = (uint8_t *)buf->data + buf->len;
+    while (num >= 0x80) {
+        *p++ = (uint8_t)num | 0x80;
+        num >>= 7;
+    }
+    *p++ = (uint8_t)num;
+    buf->len = (char *)p - buf->data;
+    return 0;
+}
+
+static uint64_t zigzag(int64_t num)
+{
+    return ((uint64_t)num << 1) ^ (uint64_t)(num >> 63);
+}
+
+static int64_t unzigzag(uint64_t num)
+{
+    return (int64_t)(num >> 1) ^ -(int64_t)(num & 1);
+}
+
+/* "-?(0|[1-9][0-9]*)(\.[0-9]+)?" with at most 18 digits, but not negative zero */
+static bool parse_decimal(const char *str, size_t len, int64_t *mantissa, uint64_t *scale)
+{
+    const char *p = str;
+    const char *end = str + len;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    if (*p == '0' && p + 1 < end && p[1] != '.')
+        return false;
+
+    int64_t value = 0;
+    int digits = 0;
+    uint64_t frac = 0;
+    bool point = false;
+    for (; p < end; ++p) {
+        if (*p == '.') {
+            if (point || p + 1 == end)
+                return false;
+            point = true;
+            continue;
+        }
+        if (*p < '0' || *p > '9')
+            return false;
+        if (++digits > 18)
+            return false;
+        value = value * 10 + (*p - '0');
+        if (point)
+            frac++;
+    }
+    if (negative && value == 0)
+        return false;
+
+    *mantissa = negative ? -value : value;
+    *scale = frac;
+    return true;
+}
+
+static int encode_value(struct bin_buf *buf, const json_t *json, int depth)
+{
+    if (depth > RPC_BIN_MAX_DEPTH)
+        return -1;
+
+    switch (json_typeof(json)) {
+    case JSON_NULL:
+        return put_tag(buf, RPC_BIN_TAG_NULL);
+    case JSON_FALSE:
+        return put_tag(buf, RPC_BIN_TAG_FALSE);
+    case JSON_TRUE:
+        return put_tag(buf, RPC_BIN_TAG_TRUE);
+    case JSON_INTEGER:
+        if (put_tag(buf, RPC_BIN_TAG_INT) < 0)
+            return -1;
+        return put_varint(buf, zigzag(json_integer_value(json)));
+    case JSON_REAL:
+        {
+            double value = json_real_value(json);
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            bits = htole64(bits);
+            if (put_tag(buf, RPC_BIN_TAG_REAL) < 0)
+                return -1;
+            return buf_append(buf, &bits, sizeof(bits));
+        }
+    case JSON_STRING:
+        {
+            const char *str = json_string_value(json);
+            size_t len = json_string_length(json);
+            int64_t mantissa;
+            uint64_t scale;
+            if (parse_decimal(str, len, &mantissa, &scale)) {
+                if (put_tag(buf, RPC_BIN_TAG_DECIMAL) < 0)
+                    return -1;
+                if (put_varint(buf, scale) < 0)
+                    return -1;
+                return put_varint(buf, zigzag(mantissa));
+            }
+            if (put_tag(buf, RPC_BIN_TAG_STRING) < 0)
+                return -1;
+            if (put_varint(buf, len) < 0)
+                return -1;
+            return buf_append(buf, str, len);
+        }
+    case JSON_ARRAY:
+        {
+            size_t size = json_array_size(json);
+            if (put_tag(buf, RPC_BIN_TAG_ARRAY) < 0)
+                return -1;
+            if (put_varint(buf, size) < 0)
+                return -1;
+            for (size_t i = 0; i < size; ++i) {
+                if (encode_value(buf, json_array_get(json, i), depth + 1) < 0)
+                    return -1;
+            }
+            return 0;
+        }
+    case JSON_OBJECT:
+        {
+            if (put_tag(buf, RPC_BIN_TAG_OBJECT) < 0)
+                return -1;
+            if (put_varint(buf, json_object_size(json)) < 0)
+                return -1;
+            const char *key;
+            json_t *value;
+            json_object_foreach((json_t *)json, key, value) {
+                size_t len = strlen(key);
+                if (put_varint(buf, len) < 0)
+                    return -1;
+                if (buf_append(buf, key, len) < 0)
+                    return -1;
+                if (encode_value(buf, value, depth + 1) < 0)
+                    return -1;
+            }
+            return 0;
+        }
+    default:
+        return -1;
+    }
+}
+
+char *rpc_bin_encode(const json_t *json, size_t *size)
+{
+    struct bin_buf buf;
+    memset(&buf, 0, sizeof(buf));
+    if (encode_value(&buf, json, 0) < 0) {
+        free(buf.data);
+        return NULL;
+    }
+
+    *size = buf.len;
+    return buf.data;
+}
+
+struct bin_reader {
+    const uint8_t *p;
+    const uint8_t *end;
+};
+
+static int get_varint(struct bin_reader *r, uint64_t *num)
+{
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end)
+            return -1;
+        uint8_t c = *r->p++;
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0) {
+            *num = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+size_t rpc_bin_decimal_str(char *buf, uint64_t scale, int64_t mantissa)
+{
+    char digits[32];
+    uint64_t value = mantissa < 0 ? -(uint64_t)mantissa : (uint64_t)mantissa;
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n <= (int)scale)
+        digits[n++] = '0';
+
+    size_t len = 0;
+    if (mantissa < 0)
+        buf[len++] = '-';
+    for (int i = n - 1; i >= 0; --i) {
+        if (i == (int)scale - 1)
+            buf[len++] = '.';
+        buf[len++] = digits[i];
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+static json_t *decode_decimal(uint64_t scale, int64_t mantissa)
+{
+    char str[64];
+    rpc_bin_decimal_str(str, scale, mantissa);
+    return json_string(str);
+}
+
+static json_t *decode_value(struct bin_reader *r, int depth)
+{
+    if (depth > RPC_BIN_MAX_DEPTH || r->p == r->end)
+        return NULL;
+
+    uint8_t tag = *r->p++;
+    switch (tag) {
+    case RPC_BIN_TAG_NULL:
+        return json_null();
+    case RPC_BIN_TAG_FALSE:
+        return json_false();
+    case RPC_BIN_TAG_TRUE:
+        return json_true();
+    case RPC_BIN_TAG_INT:
+        {
+            uint64_t num;
+            if (get_varint(r, &num) < 0)
+                return NULL;
+            return json_integer(unzigzag(num));
+        }
+    case RPC_BIN_TAG_REAL:
+        {
+            uint64_t bits;
+            if (r->end - r->p < (ptrdiff_t)sizeof(bits))
+                return NULL;
+            memcpy(&bits, r->p, sizeof(bits));
+            r->p += sizeof(bits);
+            bits = le64toh(bits);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return json_real(value);
+        }
+    case RPC_BIN_TAG_STRING:
+        {
+            uint64_t len;
+            if (get_varint(r, &len) < 0 || (uint64_t)(r->end - r->p) < len)
+                return NULL;
+            json_t *str = json_stringn((const char *)r->p, len);
+            r->p += len;
+            return str;
+        }
+    case RPC_BIN_TAG_DECIMAL:
+        {
+            uint64_t scale, mantissa;
+            if (get_varint(r, &scale) < 0 || scale > 18)
+                return NULL;
+            if (get_varint(r, &mantissa) < 0)
+                return NULL;
+            return decode_decimal(scale, unzigzag(mantissa));
+        }
+    case RPC_BIN_TAG_ARRAY:
+        {
+            uint64_t size;
+            if (get_varint(r, &size) < 0 || size > (uint64_t)(r->end - r->p))
+                return NULL;
+            json_t *array = json_array();
+            for (uint64_t i = 0; i < size; ++i) {
+                json_t *value = decode_value(r, depth + 1);
+                if (value == NULL) {
+                    json_decref(array);
+                    return NULL;
+                }
+                json_array_append_new(array, value);
+            }
+            return array;
+        }
+    case RPC_BIN_TAG_OBJECT:
+        {
+            uint64_t size;
+            if (get_varint(r, &size) < 0 || size > (uint64_t)(r->end - r->p))
+                return NULL;
+            json_t *object = json_object();
+            sds key = sdsempty();
+            for (uint64_t i = 0; i < size; ++i) {
+                uint64_t len;
+                if (get_varint(r, &len) < 0 || (uint64_t)(r->end - r->p) < len)
+                    goto object_error;
+                sdsclear(key);
+                key = sdscatlen(key, r->p, len);
+                r->p += len;
+                json_t *value = decode_value(r, depth + 1);
+                if (value == NULL)
+                    goto object_error;
+                json_object_set_new(object, key, value);
+            }
+            sdsfree(key);
+            return object;
+
+object_error:
+            sdsfree(key);
+            json_decref(object);
+            return NULL;
+        }
+    default:
+        return NULL;
+    }
+}
+
+json_t *rpc_bin_decode(const void *data, size_t size)
+{
+    struct bin_reader r = { .p = data, .end = (const uint8_t *)data + size };
+    json_t *json = decode_value(&r, 0);
+    if (json && r.p != r.end) {
+        json_decref(json);
+        return NULL;
+    }
+    return json;
+}
+
+static uint8_t binary_ext[] = { RPC_ENCODING_BINARY };
+
+/* request params per command, see ut_rpc_bin.h */
+static const rpc_bin_fields fields_table[] = {
+    { CMD_BALANCE_QUERY,            "u",            RPC_FIELD_STRING },
+    { CMD_BALANCE_UPDATE,           "ussuda",       0 },
+    { CMD_BALANCE_HISTORY,          "ussiiuu",      0 },
+    { CMD_ASSET_LIST,               "",             RPC_FIELD_ANY },
+    { CMD_ASSET_SUMMARY,            "",             RPC_FIELD_STRING },
+
+    { CMD_ORDER_PUT_LIMIT,          "usuddddsa",    0 },
+    { CMD_ORDER_PUT_MARKET,         "usudds",       0 },
+    { CMD_ORDER_QUERY,              "usuu",         0 },
+    { CMD_ORDER_CANCEL,             "usu",          0 },
+    { CMD_ORDER_BOOK,               "suuu",         0 },
+    { CMD_ORDER_BOOK_DEPTH,         "sud",          0 },
+    { CMD_ORDER_DETAIL,             "su",           0 },
+    { CMD_ORDER_HISTORY,            "usiiuuu",      0 },
+    { CMD_ORDER_DEALS,              "uuu",          0 },
+    { CMD_ORDER_DETAIL_FINISHED,    "u",            0 },
+    { CMD_ORDER_PUT_STOP_LIMIT,     "usuddddds",    0 },
+    { CMD_ORDER_PUT_STOP_MARKET,    "usuddds",      0 },
+    { CMD_ORDER_CANCEL_STOP,        "usu",          0 },
+    { CMD_ORDER_QUERY_STOP,         "usuu",         0 },
+    { CMD_ORDER_QUERY_ALL,          "uuu",          0 },
+    { CMD_ORDER_BOOK_LEVELS,        "su",           0 },
+
+    { CMD_MARKET_STATUS,            "su",           0 },
+    { CMD_MARKET_KLINE,             "siiu",         0 },
+    { CMD_MARKET_DEALS,             "suu",          0 },
+    { CMD_MARKET_LAST,              "s",            0 },
+    { CMD_MARKET_STATUS_TODAY,      "s",            0 },
+    { CMD_MARKET_USER_DEALS,        "usuu",         0 },
+    { CMD_MARKET_LIST,              "",             RPC_FIELD_ANY },
+    { CMD_MARKET_SUMMARY,           "",             RPC_FIELD_STRING },
+};
+
+const rpc_bin_fields *rpc_bin_get_fields(uint32_t command)
+{
+    for (size_t i = 0; i < sizeof(fields_table) / sizeof(fields_table[0]); ++i) {
+        if (fields_table[i].command == command)
+            return &fields_table[i];
+    }
+    return NULL;
+}
+
+static char field_type(const rpc_bin_fields *fields, size_t listed, size_t index)
+{
+    return index < listed ? fields->types[index] : fields->rest;
+}
+
+static int encode_field(struct bin_buf *buf, char type, const json_t *json)
+{
+    switch (type) {
+    case RPC_FIELD_UINT:
+        if (!json_is_integer(json) || json_integer_value(json) < 0)
+            return -1;
+        return put_varint(buf, json_integer_value(json));
+    case RPC_FIELD_INT:
+        if (!json_is_integer(json))
+            return -1;
+        return put_varint(buf, zigzag(json_integer_value(json)));
+    case RPC_FIELD_STRING:
+        {
+            if (!json_is_string(json))
+                return -1;
+            const char *str = json_string_value(json);
+            size_t len = json_string_length(json);
+            if (memchr(str, '\0', len))
+                return -1;
+            if (put_varint(buf, len) < 0)
+                return -1;
+            return buf_append(buf, str, len);
+        }
+    case RPC_FIELD_DECIMAL:
+        {
+            int64_t mantissa;
+            uint64_t scale;
+            if (!json_is_string(json))
+                return -1;
+            if (!parse_decimal(json_string_value(json), json_string_length(json), &mantissa, &scale))
+                return -1;
+            if (put_varint(buf, scale) < 0)
+                return -1;
+            return put_varint(buf, zigzag(mantissa));
+        }
+    case RPC_FIELD_ANY:
+        return encode_value(buf, json, 1);
+    default:
+        return -1;
+    }
+}
+
+int rpc_params_encode(rpc_pkg *pkg, const json_t *params, int encoding)
+{
+    const rpc_bin_fields *fields = rpc_bin_get_fields(pkg->command);
+    if (encoding != RPC_ENCODING_BINARY || fields == NULL || !json_is_array(params))
+        return rpc_body_encode(pkg, params, RPC_ENCODING_JSON, 0);
+    size_t count = json_array_size(params);
+    if (count > PARAMS_MAX_SIZE)
+        return rpc_body_encode(pkg, params, RPC_ENCODING_JSON, 0);
+
+    struct bin_buf buf;
+    memset(&buf, 0, sizeof(buf));
+    size_t listed = strlen(fields->types);
+    if (put_varint(&buf, count) < 0)
+        goto json;
+    for (size_t i = 0; i < count; ++i) {
+        if (encode_field(&buf, field_type(fields, listed, i), json_array_get(params, i)) < 0)
+            goto json;
+    }
+
+    pkg->body = buf.data;
+    pkg->body_size = buf.len;
+    pkg->ext = binary_ext;
+    pkg->ext_size = sizeof(binary_ext);
+    return 0;
+
+json:
+    free(buf.data);
+    return rpc_body_encode(pkg, params, RPC_ENCODING_JSON, 0);
+}
+
+/* utf-8 without nul, the strings jansson accepts */
+static bool is_valid_string(const uint8_t *p, size_t len)
+{
+    const uint8_t *end = p + len;
+    while (p < end) {
+        uint8_t c = *p;
+        if (c == 0)
+            return false;
+        if (c < 0x80) {
+            p++;
+            continue;
+        }
+
+        int n;
+        uint32_t code;
+        if ((c & 0xe0) == 0xc0) {
+            n = 2;
+            code = c & 0x1f;
+        } else if ((c & 0xf0) == 0xe0) {
+            n = 3;
+            code = c & 0x0f;
+        } else if ((c & 0xf8) == 0xf0) {
+            n = 4;
+            code = c & 0x07;
+        } else {
+            return false;
+        }
+        if (end - p < n)
+            return false;
+        for (int i = 1; i < n; ++i) {
+            if ((p[i] & 0xc0) != 0x80)
+                return false;
+            code = (code << 6) | (p[i] & 0x3f);
+        }
+        if ((n == 2 && code < 0x80) || (n == 3 && code < 0x800) || (n == 4 && code < 0x10000))
+            return false;
+        if (code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff))
+            return false;
+        p += n;
+    }
+    return true;
+}
+
+/* validate a tagged value without building it */
+static int skip_value(struct bin_reader *r, int depth)
+{
+    if (depth > RPC_BIN_MAX_DEPTH || r->p == r->end)
+        return -1;
+
+    uint64_t num, size;
+    uint8_t tag = *r->p++;
+    switch (tag) {
+    case RPC_BIN_TAG_NULL:
+    case RPC_BIN_TAG_FALSE:
+    case RPC_BIN_TAG_TRUE:
+        return 0;
+    case RPC_BIN_TAG_INT:
+        return get_varint(r, &num);
+    case RPC_BIN_TAG_REAL:
+        if (r->end - r->p < (ptrdiff_t)sizeof(uint64_t))
+            return -1;
+        r->p += sizeof(uint64_t);
+        return 0;
+    case RPC_BIN_TAG_STRING:
+        if (get_varint(r, &size) < 0 || (uint64_t)(r->end - r->p) < size)
+            return -1;
+        if (!is_valid_string(r->p, size))
+            return -1;
+        r->p += size;
+        return 0;
+    case RPC_BIN_TAG_DECIMAL:
+        if (get_varint(r, &size) < 0 || size > 18)
+            return -1;
+        return get_varint(r, &num);
+    case RPC_BIN_TAG_ARRAY:
+    case RPC_BIN_TAG_OBJECT:
+        if (get_varint(r, &size) < 0 || size > (uint64_t)(r->end - r->p))
+            return -1;
+        for (uint64_t i = 0; i < size; ++i) {
+            if (tag == RPC_BIN_TAG_OBJECT) {
+                uint64_t len;
+                if (get_varint(r, &len) < 0 || (uint64_t)(r->end - r->p) < len)
+                    return -1;
+                r->p += len;
+            }
+            if (skip_value(r, depth + 1) < 0)
+                return -1;
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static int decode_string(struct bin_reader *r, const params_t *params, params_item *item)
+{
+    uint64_t len;
+    if (get_varint(r, &len) < 0 || (uint64_t)(r->end - r->p) < len)
+        return -1;
+    if (!is_valid_string(r->p, len))
+        return -1;
+    item->type = PARAMS_TYPE_STRING;
+    item->offset = (const char *)r->p - params->data;
+    item->len = len;
+    r->p += len;
+    return 0;
+}
+
+static int decode_decimal_field(struct bin_reader *r, params_item *item)
+{
+    uint64_t scale, mantissa;
+    if (get_varint(r, &scale) < 0 || scale > 18)
+        return -1;
+    if (get_varint(r, &mantissa) < 0)
+        return -1;
+    item->type = PARAMS_TYPE_STRING;
+    item->decimal = 1;
+    item->scale = scale;
+    item->num = unzigzag(mantissa);
+    return 0;
+}
+
+static int decode_any(struct bin_reader *r, const params_t *params, params_item *item)
+{
+    if (r->p == r->end)
+        return -1;
+    const uint8_t *start = r->p;
+    uint64_t num;
+    switch (*r->p++) {
+    case RPC_BIN_TAG_NULL:
+        item->type = PARAMS_TYPE_NULL;
+        return 0;
+    case RPC_BIN_TAG_FALSE:
+        item->type = PARAMS_TYPE_FALSE;
+        return 0;
+    case RPC_BIN_TAG_TRUE:
+        item->type = PARAMS_TYPE_TRUE;
+        return 0;
+    case RPC_BIN_TAG_INT:
+        if (get_varint(r, &num) < 0)
+            return -1;
+        item->type = PARAMS_TYPE_INTEGER;
+        item->num = unzigzag(num);
+        return 0;
+    case RPC_BIN_TAG_REAL:
+        if (r->end - r->p < (ptrdiff_t)sizeof(num))
+            return -1;
+        memcpy(&num, r->p, sizeof(num));
+        r->p += sizeof(num);
+        item->type = PARAMS_TYPE_REAL;
+        item->num = le64toh(num);
+        return 0;
+    case RPC_BIN_TAG_STRING:
+        return decode_string(r, params, item);
+    case RPC_BIN_TAG_DECIMAL:
+        return decode_decimal_field(r, item);
+    case RPC_BIN_TAG_ARRAY:
+    case RPC_BIN_TAG_OBJECT:
+        r->p = start;
+        if (skip_value(r, 1) < 0)
+            return -1;
+        item->type = *start == RPC_BIN_TAG_ARRAY ? PARAMS_TYPE_ARRAY : PARAMS_TYPE_OBJECT;
+        item->offset = (const char *)start - params->data;
+        item->len = r->p - start;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static int decode_field(struct bin_reader *r, const params_t *params, char type, params_item *item)
+{
+    uint64_t num;
+    switch (type) {
+    case RPC_FIELD_UINT:
+        if (get_varint(r, &num) < 0 || num > INT64_MAX)
+            return -1;
+        item->type = PARAMS_TYPE_INTEGER;
+        item->num = num;
+        return 0;
+    case RPC_FIELD_INT:
+        if (get_varint(r, &num) < 0)
+            return -1;
+        item->type = PARAMS_TYPE_INTEGER;
+        item->num = unzigzag(num);
+        return 0;
+    case RPC_FIELD_STRING:
+        return decode_string(r, params, item);
+    case RPC_FIELD_DECIMAL:
+        return decode_decimal_field(r, item);
+    case RPC_FIELD_ANY:
+        return decode_any(r, params, item);
+    default:
+        return -1;
+    }
+}
+
+int rpc_params_decode(params_t *params, const rpc_pkg *pkg)
+{
+    int encoding = rpc_pkg_encoding(pkg);
+    if (encoding == RPC_ENCODING_JSON)
+        return params_parse(params, pkg->body, pkg->body_size);
+    if (encoding != RPC_ENCODING_BINARY)
+        return -__LINE__;
+    const rpc_bin_fields *fields = rpc_bin_get_fields(pkg->command);
+    if (fields == NULL)
+        return -__LINE__;
+
+    params->data   = pkg->body;
+    params->size   = pkg->body_size;
+    params->json   = NULL;
+    params->binary = true;
+    params->count  = 0;
+
+    struct bin_reader r = { .p = pkg->body, .end = (const uint8_t *)pkg->body + pkg->body_size };
+    uint64_t count;
+    if (get_varint(&r, &count) < 0 || count > PARAMS_MAX_SIZE)
+        return -__LINE__;
+    size_t listed = strlen(fields->types);
+    for (size_t i = 0; i < count; ++i) {
+        params_item *item = &params->items[i];
+        memset(item, 0, sizeof(*item));
+        if (decode_field(&r, params, field_type(fields, listed, i), item) < 0)
+            return -__LINE__;
+        params->count++;
+    }
+    if (r.p != r.end)
+        return -__LINE__;
+
+    return 0;
+}
+
+json_t *rpc_params_json(const rpc_pkg *pkg)
+{
+    if (rpc_pkg_encoding(pkg) == RPC_ENCODING_JSON)
+        return json_loadb(pkg->body, pkg->body_size, 0, NULL);
+
+    params_t params;
+    if (rpc_params_decode(&params, pkg) < 0)
+        return NULL;
+    return params_to_json(&params);
+}
+
+int rpc_pkg_encoding(const rpc_pkg *pkg)
+{
+    if (pkg->ext_size == 0)
+        return RPC_ENCODING_JSON;
+    return ((const uint8_t *)pkg->ext)[0];
+}
+
+int rpc_body_encode(rpc_pkg *pkg, const json_t *json, int encoding, size_t flags)
+{
+    if (encoding == RPC_ENCODING_BINARY) {
+        size_t size;
+        char *data = rpc_bin_encode(json, &size);
+        if (data == NULL)
+            return -1;
+        pkg->body = data;
+        pkg->body_size = size;
+        pkg->ext = binary_ext;
+        pkg->ext_size = sizeof(binary_ext);
+    } else {
+        char *data = json_dumps(json, flags);
+        if (data == NULL)
+            return -1;
+        pkg->body = data;
+        pkg->body_size = strlen(data);
+        pkg->ext = NULL;
+        pkg->ext_size = 0;
+    }
+
+    return 0;
+}
+
+json_t *rpc_body_decode(const rpc_pkg *pkg)
+{
+    switch (rpc_pkg_encoding(pkg)) {
+    case RPC_ENCODING_JSON:
+        return json_loadb(pkg->body, pkg->body_size, 0, NULL);
+    case RPC_ENCODING_BINARY:
+        return rpc_bin_decode(pkg->body, pkg->body_size);
+    default:
+        return NULL;
+    }
+}
+
+sds rpc_body_str(const rpc_pkg *pkg)
+{
+    if (rpc_pkg_encoding(pkg) == RPC_ENCODING_JSON)
+        return sdsnewlen(pkg->body, pkg->body_size);
+    return sdscatprintf(sdsempty(), "(binary %u bytes)", pkg->body_size);
+}
+
@@ -0,0 +1,97 @@
+/*
+ * Description: compact binary rpc body encoding
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _UT_RPC_BIN_H_
+# define _UT_RPC_BIN_H_
+
+# include <stddef.h>
+# include <jansson.h>
+
+# include "ut_sds.h"
+# include "ut_rpc.h"
+
+/*
+ * Body layout, every value starts with a one byte tag:
+ *   null / false / true    tag only
+ *   int                    zigzag varint
+ *   real                   8 bytes little endian double
+ *   string                 varint length + bytes
+ *   decimal                varint scale + zigzag varint mantissa,
+ *                          used for plain decimal strings like "-12.3400",
+ *                          decoded back to exactly the same string
+ *   array                  varint count + values
+ *   object                 varint count + (varint length + key + value)
+ *
+ * Replies use the tagged layout. Request params use the field table of
+ * their command instead, no tags and no keys:
+ *   varint count, then each field as its table type
+ *   u   varint, a non negative integer
+ *   i   zigzag varint
+ *   s   varint length + bytes
+ *   d   varint scale + zigzag varint mantissa, a plain decimal string
+ *   a   any tagged value, for objects or fields taking several types
+ * Fields past the listed ones take the rest type. Params that do not fit
+ * the table of their command, or a command with no table, are sent as
+ * json, so the server decodes whatever the ext byte says.
+ */
+
+# define RPC_BIN_TAG_NULL       0
+# define RPC_BIN_TAG_FALSE      1
+# define RPC_BIN_TAG_TRUE       2
+# define RPC_BIN_TAG_INT        3
+# define RPC_BIN_TAG_REAL       4
+# define RPC_BIN_TAG_STRING     5
+# define RPC_BIN_TAG_DECIMAL    6
+# define RPC_BIN_TAG_ARRAY      7
+# define RPC_BIN_TAG_OBJECT     8
+
+# define RPC_BIN_MAX_DEPTH      64
+
+# define RPC_FIELD_UINT         'u'
+# define RPC_FIELD_INT          'i'
+# define RPC_FIELD_STRING       's'
+# define RPC_FIELD_DECIMAL      'd'
+# define RPC_FIELD_ANY          'a'
+
+typedef struct rpc_bin_fields {
+    uint32_t    command;
+    const char  *types;
+    char        rest;
+} rpc_bin_fields;
+
+struct params_t;
+
+/* return malloc'ed buffer, free with free() */
+char *rpc_bin_encode(const json_t *json, size_t *size);
+json_t *rpc_bin_decode(const void *data, size_t size);
+
+/* body encoding of a received package, from the ext header */
+int rpc_pkg_encoding(const rpc_pkg *pkg);
+
+/* set pkg body/ext, body must be freed with free(). binary is the tagged
+ * layout, used for replies */
+int rpc_body_encode(rpc_pkg *pkg, const json_t *json, int encoding, size_t flags);
+json_t *rpc_body_decode(const rpc_pkg *pkg);
+
+/* request params table of a command, NULL if it has none */
+const rpc_bin_fields *rpc_bin_get_fields(uint32_t command);
+
+/* set pkg body/ext for the request params of pkg->command, body must be
+ * freed with free() */
+int rpc_params_encode(rpc_pkg *pkg, const json_t *params, int encoding);
+/* request params of either encoding into params, which points into the
+ * body, no jansson values are made */
+int rpc_params_decode(struct params_t *params, const rpc_pkg *pkg);
+/* request params of either encoding as a jansson array */
+json_t *rpc_params_json(const rpc_pkg *pkg);
+
+/* a decimal as its plain string, buf needs 32 bytes, return the length */
+size_t rpc_bin_decimal_str(char *buf, uint64_t scale, int64_t mantissa);
+
+/* body as printable string for logging, binary body is not decoded */
+sds rpc_body_str(const rpc_pkg *pkg);
+
+# endif
+
@@ -4,6 +4,8 @@
  */
 
 # include <assert.h>
+# include <stdlib.h>
+# include <inttypes.h>
 
 # include "ut_rpc_clt.h"
 # include "ut_misc.h"
@@ -11,6 +13,88 @@
 # include "ut_log.h"
 # include "nw_sock.h"
 
+static rpc_clt_conn *get_conn(rpc_clt *clt, nw_ses *ses)
+{
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        if (&clt->conns[i].raw_clt->ses == ses)
+            return &clt->conns[i];
+    }
+    return NULL;
+}
+
+static void clear_pending(rpc_clt_conn *conn)
+{
+    memset(conn->pending, 0, sizeof(struct rpc_clt_pending) * RPC_CLT_PENDING_SIZE);
+    conn->in_flight = 0;
+}
+
+static void on_request_sent(rpc_clt_conn *conn, rpc_pkg *pkg)
+{
+    if (pkg->pkg_type != RPC_PKG_TYPE_REQUEST)
+        return;
+    struct rpc_clt_pending *pending = &conn->pending[pkg->sequence & (RPC_CLT_PENDING_SIZE - 1)];
+    if (!pending->used) {
+        pending->used = true;
+        conn->in_flight += 1;
+    }
+    pending->sequence = pkg->sequence;
+    pending->send_time = current_timestamp();
+    conn->request_count += 1;
+}
+
+static void on_reply_recv(rpc_clt_conn *conn, rpc_pkg *pkg)
+{
+    if (pkg->pkg_type != RPC_PKG_TYPE_REPLY)
+        return;
+    struct rpc_clt_pending *pending = &conn->pending[pkg->sequence & (RPC_CLT_PENDING_SIZE - 1)];
+    if (!pending->used || pending->sequence != pkg->sequence)
+        return;
+    double latency = current_timestamp() - pending->send_time;
+    pending->used = false;
+    conn->in_flight -= 1;
+    conn->reply_count += 1;
+    conn->latency_total += latency;
+    if (latency > conn->latency_max)
+        conn->latency_max = latency;
+}
+
+static void on_heartbeat_reply(rpc_clt_conn *conn, rpc_pkg *pkg)
+{
+    void *p = pkg->body;
+    size_t left = pkg->body_size;
+    while (left > 0) {
+        uint16_t type;
+        uint16_t len;
+        if (unpack_uint16_le(&p, &left, &type) < 0 || unpack_uint16_le(&p, &left, &len) < 0)
+            return;
+        if (left < len)
+            return;
+        switch (type) {
+        case RPC_HEARTBEAT_TYPE_ENCODING:
+            if (len == sizeof(uint32_t)) {
+                uint32_t encodings = le32toh(*((uint32_t *)p));
+                if (conn->peer_encodings != encodings) {
+                    log_info("peer: %s encodings: %#x", nw_sock_human_addr(&conn->raw_clt->ses.peer_addr), encodings);
+                    conn->peer_encodings = encodings;
+                }
+            }
+            break;
+        case RPC_HEARTBEAT_TYPE_FEATURES:
+            if (len == sizeof(uint32_t)) {
+                nw_ses *ses = &conn->raw_clt->ses;
+                uint32_t features = le32toh(*((uint32_t *)p));
+                if ((features & RPC_FEATURE_SKIP_BODY_CRC) && !(ses->peer_flags & RPC_PEER_SKIP_BODY_CRC)) {
+                    log_info("peer: %s skip body crc", nw_sock_human_addr(&ses->peer_addr));
+                    ses->peer_flags |= RPC_PEER_SKIP_BODY_CRC;
+                }
+            }
+            break;
+        }
+        p += len;
+        left -= len;
+    }
+}
+
 static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
 {
     struct rpc_pkg pkg;
@@ -19,10 +103,17 @@ static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
     pkg.body = pkg.ext + pkg.ext_size;
 
     rpc_clt *clt = ses->privdata;
+    rpc_clt_conn *conn = get_conn(clt, ses);
     if (pkg.command == RPC_CMD_HEARTBEAT) {
-        clt->last_heartbeat = current_timestamp();
+        if (conn) {
+            conn->last_heartbeat = current_timestamp();
+            on_heartbeat_reply(conn, &pkg);
+        }
         return;
     }
+    if (conn) {
+        on_reply_recv(conn, &pkg);
+    }
     clt->on_recv_pkg(ses, &pkg);
 }
 
@@ -34,8 +125,13 @@ static void on_error_msg(nw_ses *ses, const char *msg)
 static void on_connect(nw_ses *ses, bool result)
 {
     rpc_clt *clt = ses->privdata;
-    if (result) {
-        clt->last_heartbeat = current_timestamp();
+    rpc_clt_conn *conn = get_conn(clt, ses);
+    if (conn) {
+        conn->peer_encodings = 0;
+        clear_pending(conn);
+        if (result) {
+            conn->last_heartbeat = current_timestamp();
+        }
     }
     if (clt->on_connect) {
         clt->on_connect(ses, result);
@@ -46,20 +142,25 @@ static int on_close(nw_ses *ses)
 {
     rpc_clt *clt = ses->privdata;
     log_error("connection %s -> %s close", clt->name, nw_sock_human_addr(&ses->peer_addr));
-    if (clt->addr_count == 1)
+    rpc_clt_conn *conn = get_conn(clt, ses);
+    if (conn == NULL)
+        return 0;
+    clear_pending(conn);
+    /* balanced connections stay on their own addr */
+    if (clt->balance != RPC_CLT_BALANCE_FAILOVER || clt->addr_count == 1)
         return 0;
 
     int nowait = 1;
-    if (clt->curr_index == clt->addr_count) {
-        clt->curr_index = 0;
+    if (conn->curr_index == clt->addr_count) {
+        conn->curr_index = 0;
         nowait = 0;
     }
-    memcpy(&ses->peer_addr, &clt->addr_arr[clt->curr_index], sizeof(nw_addr_t));
-    clt->curr_index += 1;
+    memcpy(&ses->peer_addr, &clt->addr_arr[conn->curr_index], sizeof(nw_addr_t));
+    conn->curr_index += 1;
     return nowait;
 }
 
-static int send_heartbeat(rpc_clt *clt)
+static int send_heartbeat(rpc_clt *clt, rpc_clt_conn *conn)
 {
     char buf[100];
     void *p = buf;
@@ -68,6 +169,12 @@ static int send_heartbeat(rpc_clt *clt)
     pack_uint16_le(&p, &left, RPC_HEARTBEAT_TYPE_TIMEOUT);
     pack_uint16_le(&p, &left, sizeof(timeout));
     pack_uint32_le(&p, &left, timeout);
+    nw_ses *ses = &conn->raw_clt->ses;
+    if (clt->skip_body_crc && !(ses->peer_flags & RPC_PEER_SKIP_BODY_CRC) && rpc_peer_is_local(&ses->peer_addr)) {
+        pack_uint16_le(&p, &left, RPC_HEARTBEAT_TYPE_FEATURES);
+        pack_uint16_le(&p, &left, sizeof(uint32_t));
+        pack_uint32_le(&p, &left, RPC_FEATURE_SKIP_BODY_CRC);
+    }
 
     rpc_pkg pkg;
     memset(&pkg, 0, sizeof(pkg));
@@ -75,28 +182,186 @@ static int send_heartbeat(rpc_clt *clt)
     pkg.command = RPC_CMD_HEARTBEAT;
     pkg.body = buf;
     pkg.body_size = sizeof(buf) - left;
-    return rpc_send(&clt->raw_clt->ses, &pkg);
+    return rpc_send(ses, &pkg);
+}
+
+/* a reply after this is dropped by the caller's own timeout anyway */
+static void expire_pending(rpc_clt *clt, rpc_clt_conn *conn, double now)
+{
+    for (uint32_t i = 0; i < RPC_CLT_PENDING_SIZE && conn->in_flight > 0; ++i) {
+        struct rpc_clt_pending *pending = &conn->pending[i];
+        if (pending->used && (now - pending->send_time) > clt->request_timeout) {
+            pending->used = false;
+            conn->in_flight -= 1;
+        }
+    }
 }
 
 static void on_timer(nw_timer *timer, void *privdata)
 {
     rpc_clt *clt = privdata;
-    if (!nw_clt_connected(clt->raw_clt))
-        return;
-    if (clt->raw_clt->ses.sock_type == SOCK_DGRAM)
-        return;
-
     double now = current_timestamp();
-    if ((now - clt->last_heartbeat) > clt->heartbeat_timeout) {
-        log_error("peer: %s: heartbeat timeout", nw_sock_human_addr(&clt->raw_clt->ses.peer_addr));
-        nw_clt_close(clt->raw_clt);
-        nw_clt_start(clt->raw_clt);
-    } else {
-        int ret = send_heartbeat(clt);
-        if (ret < 0) {
-            log_error("send heartbeat to: %s fail: %d", nw_sock_human_addr(&clt->raw_clt->ses.peer_addr), ret);
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        rpc_clt_conn *conn = &clt->conns[i];
+        expire_pending(clt, conn, now);
+        if (!nw_clt_connected(conn->raw_clt))
+            continue;
+        if (conn->raw_clt->ses.sock_type == SOCK_DGRAM)
+            continue;
+
+        if ((now - conn->last_heartbeat) > clt->heartbeat_timeout) {
+            log_error("peer: %s: heartbeat timeout", nw_sock_human_addr(&conn->raw_clt->ses.peer_addr));
+            nw_clt_close(conn->raw_clt);
+            nw_clt_start(conn->raw_clt);
+        } else {
+            int ret = send_heartbeat(clt, conn);
+            if (ret < 0) {
+                log_error("send heartbeat to: %s fail: %d", nw_sock_human_addr(&conn->raw_clt->ses.peer_addr), ret);
+            }
+        }
+    }
+}
+
+/* splitmix64 finalizer, spreads sequential keys such as user_id */
+static uint32_t hash_key(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return (uint32_t)key;
+}
+
+static int ring_node_cmp(const void *a, const void *b)
+{
+    const struct rpc_clt_ring_node *x = a;
+    const struct rpc_clt_ring_node *y = b;
+    if (x->hash < y->hash)
+        return -1;
+    if (x->hash > y->hash)
+        return 1;
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+
+/* points depend only on the addr, so adding a backend moves about 1/n keys */
+static int init_ring(rpc_clt *clt)
+{
+    clt->ring_size = clt->conn_count * RPC_CLT_HASH_REPLICAS;
+    clt->ring = malloc(sizeof(struct rpc_clt_ring_node) * clt->ring_size);
+    if (clt->ring == NULL)
+        return -__LINE__;
+
+    uint32_t pool_size = clt->conn_count / clt->addr_count;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        const char *addr = nw_sock_human_addr(&clt->addr_arr[i / pool_size]);
+        uint64_t seed = 14695981039346656037ULL;
+        for (const char *c = addr; *c; ++c) {
+            seed = (seed ^ (uint8_t)*c) * 1099511628211ULL;
+        }
+        seed = hash_key(seed ^ (i % pool_size));
+        for (uint32_t j = 0; j < RPC_CLT_HASH_REPLICAS; ++j) {
+            clt->ring[n].hash = hash_key(seed + j);
+            clt->ring[n].index = i;
+            n++;
         }
     }
+    qsort(clt->ring, clt->ring_size, sizeof(struct rpc_clt_ring_node), ring_node_cmp);
+
+    return 0;
+}
+
+static int pick_round_robin(rpc_clt *clt)
+{
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        uint32_t index = clt->next_index++ % clt->conn_count;
+        if (nw_clt_connected(clt->conns[index].raw_clt))
+            return index;
+    }
+    return -1;
+}
+
+static int pick_least_inflight(rpc_clt *clt)
+{
+    /* start after the last pick, so ties rotate */
+    int best = -1;
+    uint32_t start = clt->next_index++;
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        uint32_t index = (start + i) % clt->conn_count;
+        if (!nw_clt_connected(clt->conns[index].raw_clt))
+            continue;
+        if (best < 0 || clt->conns[index].in_flight < clt->conns[best].in_flight)
+            best = index;
+    }
+    return best;
+}
+
+static int pick_hash(rpc_clt *clt, uint64_t key)
+{
+    uint32_t hash = hash_key(key);
+    uint32_t low = 0, high = clt->ring_size;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (clt->ring[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    /* walk clockwise past the connections that are down */
+    for (uint32_t i = 0; i < clt->ring_size; ++i) {
+        uint32_t index = clt->ring[(low + i) % clt->ring_size].index;
+        if (nw_clt_connected(clt->conns[index].raw_clt))
+            return index;
+    }
+    return -1;
+}
+
+static int pick_conn(rpc_clt *clt, bool has_key, uint64_t key)
+{
+    if (clt->conn_count == 1)
+        return 0;
+
+    int index;
+    switch (clt->balance) {
+    case RPC_CLT_BALANCE_LEAST_INFLIGHT:
+        index = pick_least_inflight(clt);
+        break;
+    case RPC_CLT_BALANCE_HASH:
+        index = has_key ? pick_hash(clt, key) : pick_round_robin(clt);
+        break;
+    default:
+        index = pick_round_robin(clt);
+        break;
+    }
+
+    /* nothing connected, let rpc_send report the error */
+    return index < 0 ? 0 : index;
+}
+
+static int send_on(rpc_clt *clt, int index, rpc_pkg *pkg)
+{
+    rpc_clt_conn *conn = &clt->conns[index];
+    clt->last_index = index;
+    int ret = rpc_send(&conn->raw_clt->ses, pkg);
+    if (ret == 0) {
+        on_request_sent(conn, pkg);
+    }
+    return ret;
+}
+
+static int parse_balance(int balance)
+{
+    switch (balance) {
+    case RPC_CLT_BALANCE_FAILOVER:
+    case RPC_CLT_BALANCE_ROUND_ROBIN:
+    case RPC_CLT_BALANCE_LEAST_INFLIGHT:
+    case RPC_CLT_BALANCE_HASH:
+        return balance;
+    default:
+        return -1;
+    }
 }
 
 rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type)
@@ -107,16 +372,37 @@ rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type)
         return NULL;
     if (type->on_recv_pkg == NULL)
         return NULL;
+    if (parse_balance(cfg->balance) < 0)
+        return NULL;
+    if (cfg->pool_size > RPC_CLT_POOL_SIZE_MAX)
+        return NULL;
+
+    uint32_t pool_size = cfg->pool_size ? cfg->pool_size : 1;
+    uint32_t conn_count = pool_size;
+    if (cfg->balance != RPC_CLT_BALANCE_FAILOVER)
+        conn_count = pool_size * cfg->addr_count;
+
+    rpc_clt *clt = malloc(sizeof(rpc_clt));
+    assert(clt != NULL);
+    memset(clt, 0, sizeof(rpc_clt));
 
     nw_clt_cfg raw_cfg;
     memset(&raw_cfg, 0, sizeof(raw_cfg));
-    memcpy(&raw_cfg.addr, &cfg->addr_arr[0], sizeof(nw_addr_t));
     raw_cfg.sock_type = cfg->sock_type;
     raw_cfg.buf_limit = cfg->buf_limit;
     raw_cfg.read_mem = cfg->read_mem;
     raw_cfg.write_mem = cfg->write_mem;
     raw_cfg.reconnect_timeout = cfg->reconnect_timeout;
     raw_cfg.max_pkg_size = cfg->max_pkg_size;
+    raw_cfg.shm_size = cfg->shm_size;
+    if (conn_count > 1) {
+        clt->buf_pool = nw_buf_pool_create(cfg->max_pkg_size);
+        if (clt->buf_pool == NULL) {
+            free(clt);
+            return NULL;
+        }
+        raw_cfg.buf_pool = clt->buf_pool;
+    }
 
     nw_clt_type raw_type;
     memset(&raw_type, 0, sizeof(raw_type));
@@ -127,21 +413,51 @@ rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type)
     raw_type.on_error_msg = on_error_msg;
     raw_type.on_recv_fd = type->on_recv_fd;
 
-    rpc_clt *clt = malloc(sizeof(rpc_clt));
-    assert(clt != NULL);
-
-    clt->raw_clt = nw_clt_create(&raw_cfg, &raw_type, clt);
-    if (clt->raw_clt == NULL) {
-        free(clt);
+    clt->conns = malloc(sizeof(rpc_clt_conn) * conn_count);
+    if (clt->conns == NULL) {
+        rpc_clt_release(clt);
         return NULL;
     }
+    memset(clt->conns, 0, sizeof(rpc_clt_conn) * conn_count);
+    for (uint32_t i = 0; i < conn_count; ++i) {
+        rpc_clt_conn *conn = &clt->conns[i];
+        /* in failover mode the pool spreads over the addrs at start, the
+         * balanced modes keep pool_size connections on every addr */
+        uint32_t addr_index;
+        if (cfg->balance == RPC_CLT_BALANCE_FAILOVER) {
+            addr_index = i % cfg->addr_count;
+        } else {
+            addr_index = i / pool_size;
+        }
+        memcpy(&raw_cfg.addr, &cfg->addr_arr[addr_index], sizeof(nw_addr_t));
+        conn->curr_index = addr_index + 1;
+        conn->pending = malloc(sizeof(struct rpc_clt_pending) * RPC_CLT_PENDING_SIZE);
+        if (conn->pending == NULL) {
+            clt->conn_count = i + 1;
+            rpc_clt_release(clt);
+            return NULL;
+        }
+        clear_pending(conn);
+        conn->raw_clt = nw_clt_create(&raw_cfg, &raw_type, clt);
+        if (conn->raw_clt == NULL) {
+            clt->conn_count = i + 1;
+            rpc_clt_release(clt);
+            return NULL;
+        }
+        clt->conn_count = i + 1;
+    }
 
     clt->name = strdup(cfg->name);
     assert(clt->name != NULL);
+    clt->balance = cfg->balance;
     clt->addr_count = cfg->addr_count;
     clt->addr_arr = malloc(sizeof(nw_addr_t) * clt->addr_count);
     assert(clt->addr_arr != NULL);
     memcpy(clt->addr_arr, cfg->addr_arr, sizeof(nw_addr_t) * clt->addr_count);
+    if (clt->balance == RPC_CLT_BALANCE_HASH && init_ring(clt) < 0) {
+        rpc_clt_release(clt);
+        return NULL;
+    }
     if (cfg->heartbeat_timeout > 0) {
         if (cfg->heartbeat_timeout > RPC_HEARTBEAT_TIMEOUT_MAX) {
             clt->heartbeat_timeout = RPC_HEARTBEAT_TIMEOUT_MAX;
@@ -153,6 +469,13 @@ rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type)
     } else {
         clt->heartbeat_timeout = RPC_HEARTBEAT_TIMEOUT_DEFAULT;
     }
+    if (cfg->request_timeout > 0) {
+        clt->request_timeout = cfg->request_timeout;
+    } else {
+        clt->request_timeout = RPC_CLT_REQUEST_TIMEOUT;
+    }
+    clt->encoding = cfg->encoding;
+    clt->skip_body_crc = cfg->skip_body_crc;
     clt->on_recv_pkg = type->on_recv_pkg;
     clt->on_connect = type->on_connect;
     nw_timer_set(&clt->timer, RPC_HEARTBEAT_INTERVAL, true, on_timer, clt);
@@ -162,9 +485,11 @@ rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type)
 
 int rpc_clt_start(rpc_clt *clt)
 {
-    int ret = nw_clt_start(clt->raw_clt);
-    if (ret < 0) {
-        return ret;
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        int ret = nw_clt_start(clt->conns[i].raw_clt);
+        if (ret < 0) {
+            return ret;
+        }
     }
     nw_timer_start(&clt->timer);
     return 0;
@@ -172,9 +497,11 @@ int rpc_clt_start(rpc_clt *clt)
 
 int rpc_clt_close(rpc_clt *clt)
 {
-    int ret = nw_clt_close(clt->raw_clt);
-    if (ret < 0) {
-        return ret;
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        int ret = nw_clt_close(clt->conns[i].raw_clt);
+        if (ret < 0) {
+            return ret;
+        }
     }
     nw_timer_stop(&clt->timer);
     return 0;
@@ -182,18 +509,64 @@ int rpc_clt_close(rpc_clt *clt)
 
 int rpc_clt_send(rpc_clt *clt, rpc_pkg *pkg)
 {
-    return rpc_send(&clt->raw_clt->ses, pkg);
+    return send_on(clt, pick_conn(clt, false, 0), pkg);
+}
+
+int rpc_clt_send_key(rpc_clt *clt, rpc_pkg *pkg, uint64_t key)
+{
+    return send_on(clt, pick_conn(clt, true, key), pkg);
 }
 
 void rpc_clt_release(rpc_clt *clt)
 {
-    nw_clt_release(clt->raw_clt);
     nw_timer_stop(&clt->timer);
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        if (clt->conns[i].raw_clt)
+            nw_clt_release(clt->conns[i].raw_clt);
+        free(clt->conns[i].pending);
+    }
+    if (clt->buf_pool)
+        nw_buf_pool_release(clt->buf_pool);
+    free(clt->conns);
+    free(clt->ring);
+    free(clt->addr_arr);
+    free(clt->name);
     free(clt);
 }
 
 bool rpc_clt_connected(rpc_clt *clt)
 {
-    return nw_clt_connected(clt->raw_clt);
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        if (nw_clt_connected(clt->conns[i].raw_clt))
+            return true;
+    }
+    return false;
+}
+
+int rpc_clt_encoding(rpc_clt *clt)
+{
+    bool connected = false;
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        rpc_clt_conn *conn = &clt->conns[i];
+        if (!nw_clt_connected(conn->raw_clt))
+            continue;
+        connected = true;
+        if (!(conn->peer_encodings & (1 << clt->encoding)))
+            return RPC_ENCODING_JSON;
+    }
+    return connected ? clt->encoding : RPC_ENCODING_JSON;
+}
+
+sds rpc_clt_status(rpc_clt *clt, sds reply)
+{
+    for (uint32_t i = 0; i < clt->conn_count; ++i) {
+        rpc_clt_conn *conn = &clt->conns[i];
+        double latency_avg = conn->reply_count ? conn->latency_total / conn->reply_count : 0;
+        reply = sdscatprintf(reply, "%s %u %s connected: %s, in flight: %u, requests: %"PRIu64", replies: %"PRIu64
+                ", latency avg: %.3fms, max: %.3fms\n", clt->name, i, nw_sock_human_addr(&conn->raw_clt->ses.peer_addr),
+                nw_clt_connected(conn->raw_clt) ? "yes" : "no", conn->in_flight, conn->request_count, conn->reply_count,
+                latency_avg * 1000, conn->latency_max * 1000);
+    }
+    return reply;
 }
 
@@ -7,9 +7,30 @@
 # define _UT_RPC_CLT_H_
 
 # include "ut_rpc.h"
+# include "ut_rpc_bin.h"
+# include "ut_sds.h"
 # include "nw_clt.h"
 # include "nw_timer.h"
 
+/*
+ * failover:        pool_size connections to one addr at a time, an addr
+ *                  is left only when its connection closes
+ * round_robin:     pool_size connections to every addr, requests rotate
+ * least_inflight:  same connections, the one with fewest pending requests
+ * hash:            same connections, rpc_clt_send_key maps a key such as
+ *                  user_id onto a consistent hash ring, so a key sticks to
+ *                  one connection while the backend set is stable
+ */
+# define RPC_CLT_BALANCE_FAILOVER       0
+# define RPC_CLT_BALANCE_ROUND_ROBIN    1
+# define RPC_CLT_BALANCE_LEAST_INFLIGHT 2
+# define RPC_CLT_BALANCE_HASH           3
+
+# define RPC_CLT_POOL_SIZE_MAX          64
+# define RPC_CLT_PENDING_SIZE           1024
+# define RPC_CLT_HASH_REPLICAS          64
+# define RPC_CLT_REQUEST_TIMEOUT        10.0
+
 typedef struct rpc_clt_cfg {
     char *name;
     uint32_t addr_count;
@@ -21,6 +42,16 @@ typedef struct rpc_clt_cfg {
     uint32_t write_mem;
     double reconnect_timeout;
     double heartbeat_timeout;
+    int encoding;
+    uint32_t pool_size;
+    int balance;
+    /* shared memory ring size for unix seqpacket addrs, 0 to disable */
+    uint32_t shm_size;
+    /* ask local peers to drop the body crc, see RPC_PKG_FLAG_NO_BODY_CRC */
+    bool skip_body_crc;
+    /* a request not replied in time stops counting as in flight,
+     * 0 for RPC_CLT_REQUEST_TIMEOUT */
+    double request_timeout;
 } rpc_clt_cfg;
 
 typedef struct rpc_clt_type {
@@ -29,15 +60,50 @@ typedef struct rpc_clt_type {
     void (*on_recv_fd)(nw_ses *ses, int fd);
 } rpc_clt_type;
 
+struct rpc_clt_pending {
+    bool used;
+    uint32_t sequence;
+    double send_time;
+};
+
+typedef struct rpc_clt_conn {
+    nw_clt *raw_clt;
+    /* next addr to try in failover mode */
+    uint32_t curr_index;
+    double last_heartbeat;
+    uint32_t peer_encodings;
+    /* requests sent and not replied yet, timed out requests leave on
+     * the next timer */
+    uint32_t in_flight;
+    uint64_t request_count;
+    uint64_t reply_count;
+    double latency_total;
+    double latency_max;
+    struct rpc_clt_pending *pending;
+} rpc_clt_conn;
+
+struct rpc_clt_ring_node {
+    uint32_t hash;
+    uint32_t index;
+};
+
 typedef struct rpc_clt {
     char *name;
-    nw_clt *raw_clt;
     uint32_t addr_count;
-    uint32_t curr_index;
     nw_addr_t *addr_arr;
+    int balance;
+    uint32_t conn_count;
+    rpc_clt_conn *conns;
+    uint32_t next_index;
+    uint32_t last_index;
+    uint32_t ring_size;
+    struct rpc_clt_ring_node *ring;
+    nw_buf_pool *buf_pool;
     nw_timer timer;
-    double last_heartbeat;
     double heartbeat_timeout;
+    double request_timeout;
+    int encoding;
+    bool skip_body_crc;
     void (*on_recv_pkg)(nw_ses *ses, rpc_pkg *pkg);
     void (*on_connect)(nw_ses *ses, bool result);
 } rpc_clt;
@@ -46,10 +112,18 @@ rpc_clt *rpc_clt_create(rpc_clt_cfg *cfg, rpc_clt_type *type);
 int rpc_clt_start(rpc_clt *clt);
 int rpc_clt_close(rpc_clt *clt);
 int rpc_clt_send(rpc_clt *clt, rpc_pkg *pkg);
+/* same as rpc_clt_send, but route by key in hash mode */
+int rpc_clt_send_key(rpc_clt *clt, rpc_pkg *pkg, uint64_t key);
 void rpc_clt_release(rpc_clt *clt);
+/* true if any connection is up */
 bool rpc_clt_connected(rpc_clt *clt);
+/* the configured encoding if every connected peer supports it */
+int rpc_clt_encoding(rpc_clt *clt);
+/* append one line per connection: addr, state, in flight and latency */
+sds rpc_clt_status(rpc_clt *clt, sds reply);
 
-# define rpc_clt_peer_addr(clt) (&(clt)->raw_clt->ses.peer_addr)
+/* peer of the connection the last request was sent on */
+# define rpc_clt_peer_addr(clt) (&(clt)->conns[(clt)->last_index].raw_clt->ses.peer_addr)
 
 # endif
 
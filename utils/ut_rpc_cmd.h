@@ -24,6 +24,12 @@
 # define CMD_ORDER_HISTORY          208
 # define CMD_ORDER_DEALS            209
 # define CMD_ORDER_DETAIL_FINISHED  210
+# define CMD_ORDER_PUT_STOP_LIMIT   211
+# define CMD_ORDER_PUT_STOP_MARKET  212
+# define CMD_ORDER_CANCEL_STOP      213
+# define CMD_ORDER_QUERY_STOP       214
+# define CMD_ORDER_QUERY_ALL        215
+# define CMD_ORDER_BOOK_LEVELS      216
 
 // market
 # define CMD_MARKET_STATUS          301
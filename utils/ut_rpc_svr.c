@@ -35,6 +35,7 @@ static int on_heartbeat(nw_ses *ses, rpc_pkg *pkg)
 {
     struct clt_info *info = ses->privdata;
     info->last_heartbeat = current_timestamp();
+    uint32_t features = 0;
 
     void *p = pkg->body;
     size_t left = pkg->body_size;
@@ -66,13 +67,46 @@ static int on_heartbeat(nw_ses *ses, rpc_pkg *pkg)
                 }
             }
             break;
+        case RPC_HEARTBEAT_TYPE_FEATURES:
+            {
+                if (len != sizeof(uint32_t)) {
+                    return -__LINE__;
+                }
+                features = le32toh(*((uint32_t *)p));
+            }
+            break;
         }
         p += len;
         left -= len;
     }
 
+    /* the reply below still has the full crc, everything after it may not */
+    rpc_svr *svr = rpc_svr_from_ses(ses);
+    uint32_t accepted = 0;
+    if ((features & RPC_FEATURE_SKIP_BODY_CRC) && svr->skip_body_crc && rpc_peer_is_local(&ses->peer_addr)) {
+        accepted |= RPC_FEATURE_SKIP_BODY_CRC;
+        if (!(ses->peer_flags & RPC_PEER_SKIP_BODY_CRC)) {
+            log_info("peer: %s skip body crc", nw_sock_human_addr(&ses->peer_addr));
+            ses->peer_flags |= RPC_PEER_SKIP_BODY_CRC;
+        }
+    }
+
+    char buf[32];
+    p = buf;
+    left = sizeof(buf);
+    pack_uint16_le(&p, &left, RPC_HEARTBEAT_TYPE_ENCODING);
+    pack_uint16_le(&p, &left, sizeof(uint32_t));
+    pack_uint32_le(&p, &left, (1 << RPC_ENCODING_JSON) | (1 << RPC_ENCODING_BINARY));
+    if (features) {
+        pack_uint16_le(&p, &left, RPC_HEARTBEAT_TYPE_FEATURES);
+        pack_uint16_le(&p, &left, sizeof(uint32_t));
+        pack_uint32_le(&p, &left, accepted);
+    }
+
     pkg->pkg_type = RPC_PKG_TYPE_REPLY;
-    pkg->body_size = 0;
+    pkg->ext_size = 0;
+    pkg->body = buf;
+    pkg->body_size = sizeof(buf) - left;
     rpc_send(ses, pkg);
 
     return 0;
@@ -145,6 +179,8 @@ rpc_svr *rpc_svr_create(rpc_svr_cfg *cfg, rpc_svr_type *type)
     raw_cfg.buf_limit = cfg->buf_limit;
     raw_cfg.read_mem = cfg->read_mem;
     raw_cfg.write_mem = cfg->write_mem;
+    raw_cfg.cork = cfg->cork;
+    raw_cfg.shm = cfg->shm;
 
     nw_svr_type raw_type;
     memset(&raw_type, 0, sizeof(raw_type));
@@ -171,6 +207,7 @@ rpc_svr *rpc_svr_create(rpc_svr_cfg *cfg, rpc_svr_type *type)
     svr->privdata_cache = nw_cache_create(sizeof(struct clt_info));
     assert(svr->privdata_cache != NULL);
     svr->heartbeat_check = cfg->heartbeat_check;
+    svr->skip_body_crc = cfg->skip_body_crc;
     svr->on_recv_pkg = type->on_recv_pkg;
     svr->on_new_connection = type->on_new_connection;
 
@@ -7,6 +7,7 @@
 # define _UT_RPC_SVR_H_
 
 # include "ut_rpc.h"
+# include "ut_rpc_bin.h"
 # include "nw_svr.h"
 # include "nw_buf.h"
 # include "nw_timer.h"
@@ -18,7 +19,12 @@ typedef struct rpc_svr_cfg {
     uint32_t buf_limit;
     uint32_t read_mem;
     uint32_t write_mem;
+    bool cork;
     bool heartbeat_check;
+    /* accept shared memory rings from unix seqpacket clients */
+    bool shm;
+    /* let local clients that ask for it send and receive without body crc */
+    bool skip_body_crc;
 } rpc_svr_cfg;
 
 typedef struct rpc_svr_type {
@@ -33,6 +39,7 @@ typedef struct rpc_svr {
     nw_timer timer;
     nw_cache *privdata_cache;
     bool heartbeat_check;
+    bool skip_body_crc;
     void (*on_recv_pkg)(nw_ses *ses, rpc_pkg *pkg);
     void (*on_new_connection)(nw_ses *ses);
 } rpc_svr;
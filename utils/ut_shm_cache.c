@@ -0,0 +1,243 @@
+/*
+ * Description: keyed snapshots in shared memory, one writer and many
+ *              reader processes, seqlock versioned
+ *     History: agent, 2026/10/18, create
+ */
+
+# include <stdlib.h>
+# include <string.h>
+# include <sched.h>
+# include <sys/mman.h>
+
+# include "ut_shm_cache.h"
+# include "ut_dict.h"
+# include "ut_misc.h"
+
+# define SLOT_FREE      0
+# define SLOT_ADDING    1
+# define SLOT_USED      2
+# define SLOT_DEAD      3
+
+# define SLOT_STATE(state)  ((state) & 0xff)
+
+# define READ_RETRY_MAX 1000
+# define ADD_SPIN_MAX   1000
+# define ADD_WAIT_MAX   1.0
+
+static shm_cache_slot *get_slot(shm_cache *cache, int index)
+{
+    return (shm_cache_slot *)((char *)cache->addr + cache->slot_size * index);
+}
+
+static char *slot_data(shm_cache_slot *slot)
+{
+    return (char *)slot + sizeof(shm_cache_slot);
+}
+
+shm_cache *shm_cache_create(uint32_t slot_count, uint32_t data_size)
+{
+    if (slot_count == 0 || data_size == 0)
+        return NULL;
+    shm_cache *cache = malloc(sizeof(shm_cache));
+    if (cache == NULL)
+        return NULL;
+    memset(cache, 0, sizeof(shm_cache));
+    cache->slot_count = slot_count;
+    cache->data_size = data_size;
+    cache->slot_size = (sizeof(shm_cache_slot) + data_size + 63) & ~(size_t)63;
+    cache->map_size = cache->slot_size * slot_count;
+
+    /* pages are zero filled and only backed once touched */
+    cache->addr = mmap(NULL, cache->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (cache->addr == MAP_FAILED) {
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void shm_cache_release(shm_cache *cache)
+{
+    munmap(cache->addr, cache->map_size);
+    free(cache);
+}
+
+static uint64_t adding_state(void)
+{
+    return SLOT_ADDING | (uint64_t)(current_timestamp() * 1000) << 8;
+}
+
+static bool is_add_stale(uint64_t state)
+{
+    return current_timestamp() * 1000 - (double)(state >> 8) > ADD_WAIT_MAX * 1000;
+}
+
+static int add_key(shm_cache_slot *slot, uint64_t state, const char *key, size_t key_len)
+{
+    uint64_t adding = adding_state();
+    if (!__atomic_compare_exchange_n(&slot->state, &state, adding, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return -__LINE__;
+    memcpy(slot->key, key, key_len + 1);
+    double now = current_timestamp();
+    __atomic_store(&slot->want_time, &now, __ATOMIC_RELAXED);
+    __atomic_store(&slot->update_time, &now, __ATOMIC_RELAXED);
+    /* fails if we were too slow and the slot was given up */
+    if (!__atomic_compare_exchange_n(&slot->state, &adding, SLOT_USED, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return -__LINE__;
+    return 0;
+}
+
+int shm_cache_find(shm_cache *cache, const char *key, bool create)
+{
+    size_t key_len = strlen(key);
+    if (key_len >= SHM_CACHE_KEY_MAX)
+        return -__LINE__;
+
+    /* dead slots are skipped, the key may be further on, and the first
+     * one is where a missing key goes */
+    int reuse = -1;
+    uint64_t reuse_state = 0;
+    uint32_t start = dict_generic_hash_function(key, key_len) % cache->slot_count;
+    for (uint32_t i = 0; i < cache->slot_count; ++i) {
+        int index = (start + i) % cache->slot_count;
+        shm_cache_slot *slot = get_slot(cache, index);
+        uint64_t state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        /* another process is writing the key, it may be ours. that takes
+         * a moment, one left like this for long lost its adder */
+        for (int spin = 0; SLOT_STATE(state) == SLOT_ADDING; ++spin) {
+            if (is_add_stale(state)) {
+                if (__atomic_compare_exchange_n(&slot->state, &state, SLOT_DEAD, false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+                    state = SLOT_DEAD;
+                continue;
+            }
+            if (spin == ADD_SPIN_MAX)
+                return -__LINE__;
+            state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        }
+
+        if (state == SLOT_USED) {
+            if (strcmp(slot->key, key) == 0)
+                return index;
+            continue;
+        }
+        if (reuse < 0) {
+            reuse = index;
+            reuse_state = state;
+        }
+        if (state == SLOT_FREE)
+            break;
+    }
+
+    if (!create || reuse < 0)
+        return -__LINE__;
+    int ret = add_key(get_slot(cache, reuse), reuse_state, key, key_len);
+    if (ret < 0)
+        return ret;
+
+    return reuse;
+}
+
+const char *shm_cache_key(shm_cache *cache, int index)
+{
+    shm_cache_slot *slot = get_slot(cache, index);
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != SLOT_USED)
+        return NULL;
+    return slot->key;
+}
+
+void shm_cache_want(shm_cache *cache, int index)
+{
+    double now = current_timestamp();
+    __atomic_store(&get_slot(cache, index)->want_time, &now, __ATOMIC_RELAXED);
+}
+
+double shm_cache_want_time(shm_cache *cache, int index)
+{
+    double t;
+    __atomic_load(&get_slot(cache, index)->want_time, &t, __ATOMIC_RELAXED);
+    return t;
+}
+
+double shm_cache_update_time(shm_cache *cache, int index)
+{
+    double t;
+    __atomic_load(&get_slot(cache, index)->update_time, &t, __ATOMIC_RELAXED);
+    return t;
+}
+
+int shm_cache_write(shm_cache *cache, int index, const void *data, size_t size)
+{
+    if (size > cache->data_size)
+        return -__LINE__;
+    shm_cache_slot *slot = get_slot(cache, index);
+    double now = current_timestamp();
+
+    /* the only writer, it may read the slot without the lock */
+    uint64_t seq = slot->seq;
+    if (seq == 0 || (seq & 1) || slot->size != size || memcmp(slot_data(slot), data, size) != 0) {
+        /* seq may be left odd by a writer that died mid write */
+        seq = ++cache->seq * 2;
+        __atomic_store_n(&slot->seq, seq - 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->size = size;
+        memcpy(slot_data(slot), data, size);
+        __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+    }
+    __atomic_store(&slot->update_time, &now, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+int shm_cache_expire(shm_cache *cache, int index)
+{
+    shm_cache_slot *slot = get_slot(cache, index);
+    uint64_t state = SLOT_USED;
+    if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != state)
+        return -__LINE__;
+    /* unwritten before anyone may take the slot for another key */
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELEASE);
+    if (!__atomic_compare_exchange_n(&slot->state, &state, SLOT_DEAD, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        return -__LINE__;
+
+    return 0;
+}
+
+int shm_cache_read(shm_cache *cache, int index, uint64_t *version, sds *data)
+{
+    shm_cache_slot *slot = get_slot(cache, index);
+    sds buf = NULL;
+    for (int i = 0; i < READ_RETRY_MAX; ++i) {
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq == 0 || seq == *version) {
+            if (buf)
+                sdsfree(buf);
+            return 0;
+        }
+        if (seq & 1) {
+            sched_yield();
+            continue;
+        }
+
+        uint32_t size = slot->size;
+        if (size > cache->data_size)
+            continue;
+        if (buf == NULL)
+            buf = sdsempty();
+        sdsclear(buf);
+        buf = sdsMakeRoomFor(buf, size);
+        memcpy(buf, slot_data(slot), size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+            continue;
+
+        sdsIncrLen(buf, size);
+        *version = seq;
+        *data = buf;
+        return 1;
+    }
+
+    if (buf)
+        sdsfree(buf);
+    return -__LINE__;
+}
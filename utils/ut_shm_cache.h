@@ -0,0 +1,81 @@
+/*
+ * Description: keyed snapshots in shared memory, one writer and many
+ *              reader processes, seqlock versioned
+ *     History: agent, 2026/10/18, create
+ */
+
+# ifndef _UT_SHM_CACHE_H_
+# define _UT_SHM_CACHE_H_
+
+# include <stdint.h>
+# include <stddef.h>
+# include <stdbool.h>
+
+# include "ut_sds.h"
+
+/*
+ * the cache is an anonymous shared mapping, create it before fork and
+ * every child sees the same slots. a slot holds a key and the latest
+ * snapshot for it, any process may add keys, one process writes the
+ * snapshots. the writer expires keys that are no longer wanted, their
+ * slots are then taken by new keys.
+ *
+ * the writer makes seq odd, copies the data and makes it even again, a
+ * reader copies the data out and retries if seq moved meanwhile. seq is
+ * also the version, a reader skips snapshots it already has. versions
+ * are never handed out twice, even across slots.
+ */
+
+# define SHM_CACHE_KEY_MAX  128
+
+typedef struct shm_cache_slot {
+    /* low byte 0 free, 1 being added, 2 used, 3 dead: expired or its
+     * adder did not finish. being added also holds when, in ms */
+    uint64_t state;
+    uint32_t size;
+    uint32_t reserved;
+    uint64_t seq;
+    /* timestamps, set with atomic stores */
+    double   want_time;
+    double   update_time;
+    char     key[SHM_CACHE_KEY_MAX];
+} shm_cache_slot;
+
+typedef struct shm_cache {
+    void     *addr;
+    size_t   map_size;
+    size_t   slot_size;
+    uint32_t slot_count;
+    uint32_t data_size;
+    /* writer only, the last version handed out */
+    uint64_t seq;
+} shm_cache;
+
+shm_cache *shm_cache_create(uint32_t slot_count, uint32_t data_size);
+void shm_cache_release(shm_cache *cache);
+
+/* index of the slot of key, with create it is added if missing.
+ * < 0 if not found, the cache is full or another process is adding a
+ * key on the way right now, it never waits for that. a slot left being
+ * added for over a second is taken for dead and reused */
+int shm_cache_find(shm_cache *cache, const char *key, bool create);
+/* key of a used slot, NULL if the slot is free */
+const char *shm_cache_key(shm_cache *cache, int index);
+
+/* readers mark the key as still wanted */
+void shm_cache_want(shm_cache *cache, int index);
+double shm_cache_want_time(shm_cache *cache, int index);
+/* last write, or when the key was added if never written */
+double shm_cache_update_time(shm_cache *cache, int index);
+
+/* writer only, the version changes only if the data does */
+int shm_cache_write(shm_cache *cache, int index, const void *data, size_t size);
+/* writer only, drop the key and its data, the slot goes to the next new
+ * key. a reader still holding the index reads it as never written */
+int shm_cache_expire(shm_cache *cache, int index);
+/* 1 and a copy of the data if its version is not *version, 0 if it is
+ * unchanged or never written, < 0 if no stable copy could be taken */
+int shm_cache_read(shm_cache *cache, int index, uint64_t *version, sds *data);
+
+# endif
+
@@ -105,6 +105,17 @@ skiplist_node *skiplist_find(skiplist_t *list, void *value)
     return NULL;
 }
 
+skiplist_node *skiplist_lower_bound(skiplist_t *list, void *value)
+{
+    skiplist_node *node = list->header;
+    for (int i = list->level - 1; i >= 0; i--) {
+        while (node->forward[i] && list->type.compare(node->forward[i]->value, value) < 0) {
+            node = node->forward[i];
+        }
+    }
+    return node->forward[0];
+}
+
 void skiplist_delete(skiplist_t *list, skiplist_node *x)
 {
     skiplist_node *update[SKIPLIST_MAX_LEVEL];
@@ -34,6 +34,8 @@ typedef struct skiplist_t {
 skiplist_t *skiplist_create(skiplist_type *type);
 skiplist_t *skiplist_insert(skiplist_t *list, void *value);
 skiplist_node *skiplist_find(skiplist_t *list, void *value);
+/* the first node not less than value, NULL if there is none */
+skiplist_node *skiplist_lower_bound(skiplist_t *list, void *value);
 void skiplist_delete(skiplist_t *list, skiplist_node *node);
 void skiplist_release(skiplist_t *list);
 
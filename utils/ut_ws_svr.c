@@ -11,28 +11,45 @@
 # include "ut_base64.h"
 # include "ut_ws_svr.h"
 
+# define WS_FRAME_HEAD_MAX 10
+
 struct ws_frame {
     uint8_t     fin;
+    uint8_t     rsv1;
     uint8_t     opcode;
     uint64_t    payload_len;
     void        *payload;
 };
 
+/* the newest frame of a channel, held while the session waits to write */
+struct ws_held {
+    sds             channel;
+    nw_buf_shared   *frame;
+    struct ws_held  *next;
+};
+
 struct clt_info {
     nw_ses      *ses;
     void        *privdata;
     double      last_activity;
+    nw_wheel_timer timer;
     struct      http_parser parser;
     sds         field;
     bool        field_set;
     sds         value;
     bool        value_set;
     bool        upgrade;
+    /* permessage-deflate negotiated, and the current message uses it */
+    bool        deflate;
+    bool        compressed;
     sds         remote;
     sds         url;
+    /* the negotiated subprotocol, NULL if the client asked for none */
+    sds         protocol;
     sds         message;
     http_request_t *request;
     struct ws_frame frame;
+    struct ws_held *held;
 };
 
 static int on_http_message_begin(http_parser* parser)
@@ -48,7 +65,7 @@ static int on_http_message_begin(http_parser* parser)
     return 0;
 }
 
-static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key)
+static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key, bool deflate)
 {
     unsigned char hash[20];
     sds data = sdsnew(key);
@@ -66,6 +83,10 @@ static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key)
     if (protocol) {
         http_response_set_header(response, "Sec-WebSocket-Protocol", protocol);
     }
+    if (deflate) {
+        http_response_set_header(response, "Sec-WebSocket-Extensions",
+                "permessage-deflate; server_no_context_takeover; client_no_context_takeover");
+    }
     response->status = 101;
 
     sds message = http_response_encode(response);
@@ -77,19 +98,75 @@ static int send_hand_shake_reply(nw_ses *ses, char *protocol, const char *key)
     return 0;
 }
 
-static bool is_good_protocol(const char *protocol_list, const char *protocol)
+/* the first protocol of the client's list the server supports */
+static sds get_protocol(const char *protocol_list, const char *supported)
 {
-    char *tmp = strdup(protocol_list);
-    char *pch = strtok(tmp, ", ");
-    while (pch != NULL) {
-        if (strcmp(pch, protocol) == 0) {
-            free(tmp);
-            return true;
+    sds result = NULL;
+    int count, supported_count;
+    sds *protocols = sdssplitlen(protocol_list, strlen(protocol_list), ",", 1, &count);
+    sds *supports = sdssplitlen(supported, strlen(supported), ",", 1, &supported_count);
+    for (int j = 0; j < supported_count; ++j) {
+        sdstrim(supports[j], " ");
+    }
+    for (int i = 0; i < count && result == NULL; ++i) {
+        sdstrim(protocols[i], " ");
+        for (int j = 0; j < supported_count; ++j) {
+            if (sdslen(protocols[i]) > 0 && sdscmp(protocols[i], supports[j]) == 0) {
+                result = sdsdup(protocols[i]);
+                break;
+            }
         }
-        pch = strtok(NULL, ", ");
     }
-    free(tmp);
-    return false;
+    sdsfreesplitres(protocols, count);
+    sdsfreesplitres(supports, supported_count);
+    return result;
+}
+
+/* a smaller server window than 15 bits is not supported, the offer
+ * asking for it is declined. client_no_context_takeover is always in the
+ * reply, so one inflater serves every session */
+static bool is_good_deflate_offer(sds offer)
+{
+    int count;
+    sds *params = sdssplitlen(offer, sdslen(offer), ";", 1, &count);
+    if (params == NULL)
+        return false;
+    bool good = false;
+    if (count > 0) {
+        sdstrim(params[0], " ");
+        good = strcasecmp(params[0], "permessage-deflate") == 0;
+    }
+    for (int i = 1; i < count && good; ++i) {
+        sdstrim(params[i], " ");
+        if (strncasecmp(params[i], "server_max_window_bits", 22) != 0)
+            continue;
+        const char *value = strchr(params[i], '=');
+        if (value == NULL)
+            continue;
+        value++;
+        while (*value == ' ' || *value == '"')
+            value++;
+        if (atoi(value) != 15)
+            good = false;
+    }
+    sdsfreesplitres(params, count);
+    return good;
+}
+
+static bool accept_deflate(const char *extensions)
+{
+    if (strlen(extensions) > UT_WS_SVR_MAX_HEADER_SIZE)
+        return false;
+    int count;
+    sds *offers = sdssplitlen(extensions, strlen(extensions), ",", 1, &count);
+    if (offers == NULL)
+        return false;
+    bool found = false;
+    for (int i = 0; i < count && !found; ++i) {
+        found = is_good_deflate_offer(offers[i]);
+    }
+    sdsfreesplitres(offers, count);
+    return found;
 }
 
 static bool is_good_origin(const char *origin, const char *require)
@@ -156,8 +233,11 @@ static int on_http_message_complete(http_parser* parser)
     if (ws_key == NULL)
         goto error;
     const char *protocol_list = http_request_get_header(info->request, "Sec-WebSocket-Protocol");
-    if (protocol_list && !is_good_protocol(protocol_list, svr->protocol))
-        goto error;
+    if (protocol_list) {
+        info->protocol = get_protocol(protocol_list, svr->protocol);
+        if (info->protocol == NULL)
+            goto error;
+    }
     if (strlen(svr->origin) > 0) {
         const char *origin = http_request_get_header(info->request, "Origin");
         if (origin == NULL || !is_good_origin(origin, svr->origin))
@@ -169,17 +249,17 @@ static int on_http_message_complete(http_parser* parser)
         if (info->privdata == NULL)
             goto error;
     }
+    const char *extensions = http_request_get_header(info->request, "Sec-WebSocket-Extensions");
+    if (svr->deflate_level > 0 && extensions && accept_deflate(extensions)) {
+        info->deflate = true;
+    }
     info->upgrade = true;
     info->remote = sdsnew(http_get_remote_ip(info->ses, info->request));
     info->url = sdsnew(info->request->url);
     if (svr->type.on_upgrade) {
         svr->type.on_upgrade(info->ses, info->remote);
     }
-    if (protocol_list) {
-        send_hand_shake_reply(info->ses, svr->protocol, ws_key);
-    } else {
-        send_hand_shake_reply(info->ses, NULL, ws_key);
-    }
+    send_hand_shake_reply(info->ses, info->protocol, ws_key, info->deflate);
 
     return 0;
 
@@ -262,9 +342,13 @@ static int decode_pkg(nw_ses *ses, void *data, size_t max)
     size_t pkg_size = 0;
     memset(&info->frame, 0, sizeof(info->frame));
     info->frame.fin = p[0] & 0x80;
+    info->frame.rsv1 = p[0] & 0x40;
     info->frame.opcode = p[0] & 0x0f;
     if (!is_good_opcode(info->frame.opcode))
         return -1;
+    /* rsv1 marks a compressed message, set on its first frame only */
+    if (info->frame.rsv1 && (!info->deflate || info->frame.opcode == 0x0 || info->frame.opcode >= 0x8))
+        return -1;
     uint8_t mask = p[1] & 0x80;
     if (mask == 0)
         return -1;
@@ -286,6 +370,8 @@ static int decode_pkg(nw_ses *ses, void *data, size_t max)
     }
 
     uint8_t masks[4];
+    if (max < pkg_size + sizeof(masks))
+        return 0;
     memcpy(masks, p + pkg_size, sizeof(masks));
     pkg_size += sizeof(masks);
     info->frame.payload = p + pkg_size;
@@ -306,6 +392,21 @@ static void on_error_msg(nw_ses *ses, const char *msg)
     log_error("peer: %s: %s", nw_sock_human_addr(&ses->peer_addr), msg);
 }
 
+/* activity only updates last_activity, the timer is pushed back when it fires */
+static void on_idle_timeout(nw_wheel_timer *timer, void *privdata)
+{
+    nw_ses *ses = privdata;
+    struct clt_info *info = ses->privdata;
+    ws_svr *svr = ws_svr_from_ses(ses);
+    double idle = current_timestamp() - info->last_activity;
+    if (idle > svr->keep_alive) {
+        log_error("peer: %s: last_activity: %f, idle too long", nw_sock_human_addr(&ses->peer_addr), info->last_activity);
+        nw_svr_close_clt(svr->raw_svr, ses);
+        return;
+    }
+    nw_wheel_add(svr->wheel, timer, svr->keep_alive - idle);
+}
+
 static void on_new_connection(nw_ses *ses)
 {
     log_trace("new connection from: %s", nw_sock_human_addr(&ses->peer_addr));
@@ -315,6 +416,12 @@ static void on_new_connection(nw_ses *ses)
     info->last_activity = current_timestamp();
     http_parser_init(&info->parser, HTTP_REQUEST);
     info->parser.data = info;
+
+    ws_svr *svr = ws_svr_from_ses(ses);
+    if (svr->keep_alive > 0) {
+        nw_wheel_timer_init(&info->timer, on_idle_timeout, ses);
+        nw_wheel_add(svr->wheel, &info->timer, svr->keep_alive);
+    }
 }
 
 static void on_connection_close(nw_ses *ses)
@@ -322,6 +429,7 @@ static void on_connection_close(nw_ses *ses)
     log_trace("connection %s close", nw_sock_human_addr(&ses->peer_addr));
     struct clt_info *info = ses->privdata;
     struct ws_svr *svr = ws_svr_from_ses(ses);
+    nw_wheel_del(svr->wheel, &info->timer);
     if (info->upgrade) {
         if (svr->type.on_close) {
             svr->type.on_close(ses, info->remote);
@@ -353,70 +461,80 @@ static void on_privdata_free(void *svr, void *privdata)
     if (info->url) {
         sdsfree(info->url);
     }
+    if (info->protocol) {
+        sdsfree(info->protocol);
+    }
     if (info->message) {
         sdsfree(info->message);
     }
     if (info->request) {
         http_request_release(info->request);
     }
+    while (info->held) {
+        struct ws_held *held = info->held;
+        info->held = held->next;
+        sdsfree(held->channel);
+        nw_buf_shared_release(held->frame);
+        free(held);
+    }
     ws_svr *w_svr = ((nw_svr *)svr)->privdata;
     nw_cache_free(w_svr->privdata_cache, privdata);
 }
 
-static int send_reply(nw_ses *ses, uint8_t opcode, void *payload, size_t payload_len)
+static size_t encode_frame_head(uint8_t *p, uint8_t opcode, bool rsv1, size_t payload_len)
 {
-    if (payload == NULL)
-        payload_len = 0;
-
-    static void *buf;
-    static size_t buf_size = 1024;
-    if (buf == NULL) {
-        buf = malloc(1024);
-        if (buf == NULL)
-            return -1;
-    }
-    size_t require_len = 10 + payload_len;
-    if (buf_size < require_len) {
-        void *new = realloc(buf, require_len);
-        if (new == NULL)
-            return -1;
-        buf = new;
-        buf_size = require_len;
-    }
-
-    size_t pkg_len = 0;
-    uint8_t *p = buf;
-    p[0] = 0;
-    p[0] |= 0x1 << 7;
+    p[0] = 0x1 << 7;
     p[0] |= opcode;
+    if (rsv1)
+        p[0] |= 0x40;
     p[1] = 0;
     if (payload_len < 126) {
-        uint8_t len = payload_len;
-        p[1] |= len;
-        pkg_len = 2;
+        p[1] |= payload_len;
+        return 2;
     } else if (payload_len <= 0xffff) {
         p[1] |= 126;
         uint16_t len = htobe16((uint16_t)payload_len);
         memcpy(p + 2, &len, sizeof(len));
-        pkg_len = 2 + sizeof(len);
+        return 2 + sizeof(len);
     } else {
         p[1] |= 127;
         uint64_t len = htobe64(payload_len);
         memcpy(p + 2, &len, sizeof(len));
-        pkg_len = 2 + sizeof(len);
+        return 2 + sizeof(len);
     }
+}
 
-    if (payload) {
-        memcpy(p + pkg_len, payload, payload_len);
-        pkg_len += payload_len;
-    }
+/* the frame head and the payload go out with one writev */
+static int send_reply(nw_ses *ses, uint8_t opcode, bool rsv1, void *payload, size_t payload_len)
+{
+    if (payload == NULL)
+        payload_len = 0;
+
+    uint8_t head[WS_FRAME_HEAD_MAX];
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = encode_frame_head(head, opcode, rsv1, payload_len);
+    iov[1].iov_base = payload;
+    iov[1].iov_len = payload_len;
 
-    return nw_ses_send(ses, buf, pkg_len);
+    return nw_ses_sendv(ses, iov, payload_len ? 2 : 1);
+}
+
+static nw_buf_shared *create_frame(uint8_t opcode, bool rsv1, const void *payload, size_t payload_len)
+{
+    uint8_t head[WS_FRAME_HEAD_MAX];
+    size_t head_size = encode_frame_head(head, opcode, rsv1, payload_len);
+    nw_buf_shared *frame = nw_buf_shared_create(head_size + payload_len);
+    if (frame == NULL)
+        return NULL;
+    memcpy(frame->data, head, head_size);
+    memcpy(frame->data + head_size, payload, payload_len);
+    return frame;
 }
 
 static int send_pong_message(nw_ses *ses)
 {
-    return send_reply(ses, 0xa, NULL, 0);
+    return send_reply(ses, 0xa, false, NULL, 0);
 }
 
 static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
@@ -446,10 +564,22 @@ static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
         return;
     }
 
+    if (info->frame.opcode != 0x0)
+        info->compressed = info->frame.rsv1;
     if (info->message == NULL)
         info->message = sdsempty();
     info->message = sdscatlen(info->message, info->frame.payload, info->frame.payload_len);
     if (info->frame.fin) {
+        if (info->compressed) {
+            sds message = ws_deflate_decode(info->message, sdslen(info->message), svr->max_pkg_size);
+            if (message == NULL) {
+                log_error("peer: %s inflate message fail", nw_sock_human_addr(&ses->peer_addr));
+                nw_svr_close_clt(svr->raw_svr, ses);
+                return;
+            }
+            sdsfree(info->message);
+            info->message = message;
+        }
         int ret = svr->type.on_message(ses, info->remote, info->url, info->message, sdslen(info->message));
         if (ses->id != 0) {
             if (ret < 0) {
@@ -462,22 +592,22 @@ static void on_recv_pkg(nw_ses *ses, void *data, size_t size)
     }
 }
 
-static void on_timer(nw_timer *timer, void *privdata)
+/* held frames of a session that caught up */
+static void on_drain(nw_ses *ses)
 {
-   ws_svr *svr = privdata;
-   double now = current_timestamp();
-
-   nw_ses *curr = svr->raw_svr->clt_list_head;
-   nw_ses *next;
-   while (curr) {
-       next = curr->next;
-       struct clt_info *info = curr->privdata;
-       if (now - info->last_activity > svr->keep_alive) {
-           log_error("peer: %s: last_activity: %f, idle too long", nw_sock_human_addr(&curr->peer_addr), info->last_activity);
-           nw_svr_close_clt(svr->raw_svr, curr);
-       }
-       curr = next;
-   }
+    struct clt_info *info = ses->privdata;
+    struct ws_held *held = info->held;
+    info->held = NULL;
+    while (held) {
+        struct ws_held *next = held->next;
+        if (ses->sockfd >= 0) {
+            nw_ses_send_shared(ses, held->frame);
+        }
+        sdsfree(held->channel);
+        nw_buf_shared_release(held->frame);
+        free(held);
+        held = next;
+    }
 }
 
 ws_svr *ws_svr_create(ws_svr_cfg *cfg, ws_svr_type *type)
@@ -498,6 +628,8 @@ ws_svr *ws_svr_create(ws_svr_cfg *cfg, ws_svr_type *type)
     raw_cfg.buf_limit = cfg->buf_limit;
     raw_cfg.read_mem = cfg->read_mem;
     raw_cfg.write_mem = cfg->write_mem;
+    raw_cfg.cork = cfg->cork;
+    raw_cfg.reuse_port = cfg->reuse_port;
 
     nw_svr_type st;
     memset(&st, 0, sizeof(st));
@@ -508,6 +640,7 @@ ws_svr *ws_svr_create(ws_svr_cfg *cfg, ws_svr_type *type)
     st.on_recv_pkg = on_recv_pkg;
     st.on_privdata_alloc = on_privdata_alloc;
     st.on_privdata_free = on_privdata_free;
+    st.on_drain = on_drain;
 
     svr->raw_svr = nw_svr_create(&raw_cfg, &st, svr);
     if (svr->raw_svr == NULL) {
@@ -524,15 +657,15 @@ ws_svr *ws_svr_create(ws_svr_cfg *cfg, ws_svr_type *type)
     svr->settings.on_message_complete = on_http_message_complete;
 
     svr->keep_alive = cfg->keep_alive;
+    svr->deflate_level = cfg->deflate_level;
+    svr->deflate_min_size = cfg->deflate_min_size;
+    svr->max_pkg_size = cfg->max_pkg_size;
     svr->protocol = strdup(cfg->protocol);
     svr->origin   = strdup(cfg->origin);
     svr->privdata_cache = nw_cache_create(sizeof(struct clt_info));
     memcpy(&svr->type, type, sizeof(ws_svr_type));
 
-    if (cfg->keep_alive > 0) {
-        nw_timer_set(&svr->timer, 60, true, on_timer, svr);
-        nw_timer_start(&svr->timer);
-    }
+    svr->wheel = nw_wheel_default();
 
     return svr;
 }
@@ -566,41 +699,196 @@ void *ws_ses_privdata(nw_ses *ses)
     return info->privdata;
 }
 
+const char *ws_ses_protocol(nw_ses *ses)
+{
+    struct clt_info *info = ses->privdata;
+    return info->protocol;
+}
+
+/* messages from min size up go compressed to sessions using deflate */
+static int send_message(nw_ses *ses, uint8_t opcode, void *data, size_t size)
+{
+    struct clt_info *info = ses->privdata;
+    ws_svr *svr = ws_svr_from_ses(ses);
+    if (info->deflate && size >= svr->deflate_min_size) {
+        sds packed = ws_deflate_encode(data, size, svr->deflate_level);
+        if (packed) {
+            int ret = send_reply(ses, opcode, true, packed, sdslen(packed));
+            sdsfree(packed);
+            return ret;
+        }
+    }
+
+    return send_reply(ses, opcode, false, data, size);
+}
+
 int ws_send_text(nw_ses *ses, char *message)
 {
-    return send_reply(ses, 0x1, message, strlen(message));
+    return send_message(ses, 0x1, message, strlen(message));
 }
 
 int ws_send_binary(nw_ses *ses, void *data, size_t size)
 {
-    return send_reply(ses, 0x2, data, size);
+    return send_message(ses, 0x2, data, size);
+}
+
+int ws_send_text_head(nw_ses *ses, deflate_head *head, const char *tail, size_t tail_size)
+{
+    struct clt_info *info = ses->privdata;
+    ws_svr *svr = ws_svr_from_ses(ses);
+    size_t size = sdslen(head->plain) + tail_size;
+    if (info->deflate && size >= svr->deflate_min_size) {
+        sds packed = deflate_head_ws(head, tail, tail_size);
+        if (packed) {
+            int ret = send_reply(ses, 0x1, true, packed, sdslen(packed));
+            sdsfree(packed);
+            return ret;
+        }
+    }
+
+    sds message = sdscatlen(sdsdup(head->plain), tail, tail_size);
+    int ret = send_reply(ses, 0x1, false, message, sdslen(message));
+    sdsfree(message);
+    return ret;
+}
+
+ws_message *ws_message_create(const void *data, size_t size, bool binary)
+{
+    ws_message *message = malloc(sizeof(ws_message));
+    if (message == NULL)
+        return NULL;
+    memset(message, 0, sizeof(ws_message));
+    message->opcode = binary ? 0x2 : 0x1;
+    message->size = size;
+    message->plain = create_frame(message->opcode, false, data, size);
+    if (message->plain == NULL) {
+        free(message);
+        return NULL;
+    }
+    message->head_size = message->plain->size - size;
+
+    return message;
+}
+
+/* the frame this session gets, compressed or not */
+static nw_buf_shared *message_frame(nw_ses *ses, ws_message *message)
+{
+    struct clt_info *info = ses->privdata;
+    ws_svr *svr = ws_svr_from_ses(ses);
+    if (info->deflate && message->size >= svr->deflate_min_size) {
+        if (message->packed == NULL && !message->pack_fail) {
+            sds data = ws_deflate_encode(message->plain->data + message->head_size, message->size, svr->deflate_level);
+            if (data) {
+                message->packed = create_frame(message->opcode, true, data, sdslen(data));
+                sdsfree(data);
+            }
+            message->pack_fail = message->packed == NULL;
+        }
+        if (message->packed)
+            return message->packed;
+    }
+
+    return message->plain;
+}
+
+int ws_send_message(nw_ses *ses, ws_message *message)
+{
+    return nw_ses_send_shared(ses, message_frame(ses, message));
+}
+
+static struct ws_held **find_held(struct clt_info *info, const char *channel)
+{
+    struct ws_held **curr = &info->held;
+    while (*curr && strcmp((*curr)->channel, channel) != 0) {
+        curr = &(*curr)->next;
+    }
+    return curr;
+}
+
+int ws_send_message_latest(nw_ses *ses, const char *channel, ws_message *message, ws_message *replace)
+{
+    struct clt_info *info = ses->privdata;
+    struct ws_held **pos = find_held(info, channel);
+    struct ws_held *held = *pos;
+    if (held == NULL) {
+        if (!ses->wait_write || ses->sock_type != SOCK_STREAM)
+            return ws_send_message(ses, message);
+        held = malloc(sizeof(struct ws_held));
+        if (held == NULL)
+            return -__LINE__;
+        held->channel = sdsnew(channel);
+        held->frame = message_frame(ses, message);
+        held->next = NULL;
+        nw_buf_shared_hold(held->frame);
+        *pos = held;
+        return 0;
+    }
+
+    if (replace) {
+        nw_buf_shared *frame = message_frame(ses, replace);
+        nw_buf_shared_hold(frame);
+        nw_buf_shared_release(held->frame);
+        held->frame = frame;
+        return 0;
+    }
+
+    /* not replaceable, the held frame goes first */
+    *pos = held->next;
+    int ret = nw_ses_send_shared(ses, held->frame);
+    sdsfree(held->channel);
+    nw_buf_shared_release(held->frame);
+    free(held);
+    if (ret < 0)
+        return ret;
+
+    return ws_send_message(ses, message);
+}
+
+bool ws_ses_held(nw_ses *ses, const char *channel)
+{
+    struct clt_info *info = ses->privdata;
+    return *find_held(info, channel) != NULL;
+}
+
+void ws_message_release(ws_message *message)
+{
+    nw_buf_shared_release(message->plain);
+    if (message->packed)
+        nw_buf_shared_release(message->packed);
+    free(message);
 }
 
-static int broadcast_message(ws_svr *svr, uint8_t opcode, void *data, size_t size)
+static int broadcast_message(ws_svr *svr, void *data, size_t size, bool binary)
 {
+    ws_message *message = ws_message_create(data, size, binary);
+    if (message == NULL)
+        return -__LINE__;
+
+    int ret = 0;
     nw_ses *curr = svr->raw_svr->clt_list_head;
     while (curr) {
         nw_ses *next = curr->next;
         struct clt_info *info = curr->privdata;
         if (info->upgrade) {
-            int ret = send_reply(curr, opcode, data, size);
+            ret = ws_send_message(curr, message);
             if (ret < 0)
-                return ret;
+                break;
         }
         curr = next;
     }
+    ws_message_release(message);
 
-    return 0;
+    return ret;
 }
 
 int ws_svr_broadcast_text(ws_svr *svr, char *message)
 {
-    return broadcast_message(svr, 0x1, message, strlen(message));
+    return broadcast_message(svr, message, strlen(message), false);
 }
 
 int ws_svr_broadcast_binary(ws_svr *svr, void *data, size_t size)
 {
-    return broadcast_message(svr, 0x2, data, size);
+    return broadcast_message(svr, data, size, true);
 }
 
 void ws_svr_close_clt(ws_svr *svr, nw_ses *ses)
@@ -611,7 +899,6 @@ void ws_svr_close_clt(ws_svr *svr, nw_ses *ses)
 void ws_svr_release(ws_svr *svr)
 {
     nw_svr_release(svr->raw_svr);
-    nw_timer_stop(&svr->timer);
     nw_cache_release(svr->privdata_cache);
     free(svr->protocol);
     free(svr);
@@ -8,9 +8,10 @@
 # define _UT_WS_SVR_H_
 
 # include "ut_http.h"
+# include "ut_deflate.h"
 # include "nw_svr.h"
 # include "nw_buf.h"
-# include "nw_timer.h"
+# include "nw_wheel.h"
 
 # define UT_WS_SVR_MAX_HEADER_SIZE 1024
 
@@ -21,7 +22,13 @@ typedef struct ws_svr_cfg {
     uint32_t buf_limit;
     uint32_t read_mem;
     uint32_t write_mem;
+    bool cork;
+    bool reuse_port;
     int keep_alive;
+    /* permessage-deflate for clients offering it, 0 is off */
+    int deflate_level;
+    uint32_t deflate_min_size;
+    /* supported subprotocols, comma separated */
     char *protocol;
     char *origin;
 } ws_svr_cfg;
@@ -36,22 +43,55 @@ typedef struct ws_svr_type {
 
 typedef struct ws_svr {
     nw_svr *raw_svr;
-    nw_timer timer;
+    nw_wheel *wheel;
     nw_cache *privdata_cache;
     int keep_alive;
+    int deflate_level;
+    uint32_t deflate_min_size;
+    uint32_t max_pkg_size;
     char *protocol;
     char *origin;
     http_parser_settings settings;
     ws_svr_type type;
 } ws_svr;
 
+/* a message framed once for many sessions, each session queues the frame
+ * by reference. the permessage-deflate frame is made on first use */
+typedef struct ws_message {
+    uint8_t     opcode;
+    bool        pack_fail;
+    size_t      size;
+    size_t      head_size;
+    nw_buf_shared *plain;
+    nw_buf_shared *packed;
+} ws_message;
+
 ws_svr *ws_svr_create(ws_svr_cfg *cfg, ws_svr_type *type);
 int ws_svr_start(ws_svr *svr);
 int ws_svr_stop(ws_svr *svr);
 ws_svr *ws_svr_from_ses(nw_ses *ses);
 void *ws_ses_privdata(nw_ses *ses);
+/* the subprotocol chosen in the handshake, NULL if the client offered none */
+const char *ws_ses_protocol(nw_ses *ses);
 int ws_send_text(nw_ses *ses, char *message);
 int ws_send_binary(nw_ses *ses, void *data, size_t size);
+/* head plain text then tail, the head compressed once for every session
+ * using permessage-deflate */
+int ws_send_text_head(nw_ses *ses, deflate_head *head, const char *tail, size_t tail_size);
+ws_message *ws_message_create(const void *data, size_t size, bool binary);
+int ws_send_message(nw_ses *ses, ws_message *message);
+/*
+ * conflated send for channels where only the latest state matters. while
+ * the session waits for its socket the message is held per channel, and
+ * a newer one swaps in replace for it: the message itself for full state,
+ * a full snapshot when the message is a diff. with replace NULL the held
+ * frame is sent first and nothing is dropped. held frames go out when the
+ * session has written everything queued before them.
+ */
+int ws_send_message_latest(nw_ses *ses, const char *channel, ws_message *message, ws_message *replace);
+/* a frame is held for the channel, so a diff would need a snapshot */
+bool ws_ses_held(nw_ses *ses, const char *channel);
+void ws_message_release(ws_message *message);
 int ws_svr_broadcast_text(ws_svr *svr, char *message);
 int ws_svr_broadcast_binary(ws_svr *svr, void *data, size_t size);
 void ws_svr_release(ws_svr *svr);